@@ -37,6 +37,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,6 +54,7 @@ extern "C" {
 #include "dbfeatures.h"
 #include "dblock.h"
 #include "dbindex.h"
+#include "dbstats.h"
 
 /* don't output 'segment does not have enough space' messages */
 #define SUPPRESS_LOWLEVEL_ERR 1
@@ -68,6 +72,7 @@ static gint init_logging(void* db);
 static gint init_strhash_area(void* db, db_hash_area_header* areah);
 static gint init_hash_subarea(void* db, db_hash_area_header* areah, gint arraylength);
 static gint init_db_recptr_bitmap(void* db);
+static gint init_db_tables(void* db);
 #ifdef USE_REASONER
 static gint init_anonconst_table(void* db);
 static gint intern_anonconst(void* db, char* str, gint enr);
@@ -82,10 +87,31 @@ static gint extend_fixedlen_area(void* db, void* area_header);
 static gint split_free(void* db, void* area_header, gint nr, gint* freebuckets, gint i);
 static gint extend_varlen_area(void* db, void* area_header, gint minbytes);
 
+static db_area_header *usage_area_header(void *db, gint area);
+static gint fixlen_area_usage(void* db, db_area_header *areah, wg_area_usage *usage);
+static gint varlen_area_usage(void* db, db_area_header *areah, wg_area_usage *usage);
+
+static int bitmap_lowest_bit(wg_uint word);
+
 static gint show_dballoc_error_nr(void* db, char* errmsg, gint nr);
 static gint show_dballoc_error(void* db, char* errmsg);
 
 
+/* ======== Data ========================= */
+
+static char *area_names[WG_AREA_COUNT] = {
+  "datarec",
+  "longstr",
+  "listcell",
+  "shortstr",
+  "word",
+  "doubleword",
+  "tnode",
+  "indexhdr",
+  "indextmpl",
+  "indexhash"
+};
+
 /* ====== Functions ============== */
 
 
@@ -233,6 +259,10 @@ gint wg_init_db_memsegment(void* db, gint key, gint size) {
   tmp=init_db_recptr_bitmap(db);
   if (tmp) { show_dballoc_error(db," cannot initialize record pointer bitmap"); return -1; }
 
+  /* initialize table directory: table bitmaps are allocated when tables are created */
+  tmp=init_db_tables(db);
+  if (tmp) { show_dballoc_error(db," cannot initialize table directory"); return -1; }
+
 #ifdef USE_REASONER
   /* initialize anonconst table */
   tmp=init_anonconst_table(db);
@@ -243,6 +273,12 @@ gint wg_init_db_memsegment(void* db, gint key, gint size) {
 
 
   tmp=init_logging(db);
+#ifdef USE_DBSTATS
+  wg_init_stats(db);
+#endif
+#ifdef USE_LOCKSTATS
+  wg_init_lockstats(db);
+#endif
  /* tmp=init_db_subarea(db,&(dbh->logging_area_header),0,INITIAL_SUBAREA_SIZE);
   if (tmp) {  show_dballoc_error(db," cannot create logging area"); return -1; }
   (dbh->logging_area_header).fixedlength=0;
@@ -389,6 +425,7 @@ static gint init_db_index_area_header(void* db) {
   memset(dbh->index_control_area_header.index_table, 0,
     (MAX_INDEXED_FIELDNR+1)*sizeof(gint));
   dbh->index_control_area_header.index_list=0;
+  dbh->index_control_area_header.path_index_list=0;
 #ifdef USE_INDEX_TEMPLATE
   dbh->index_control_area_header.index_template_list=0;
   memset(dbh->index_control_area_header.index_template_table, 0,
@@ -406,6 +443,10 @@ static gint init_logging(void* db) {
   dbh->logging.dirty = 0;
   dbh->logging.serial = 1; /* non-zero, so that zero value in db handle
                             * indicates uninitialized state. */
+  dbh->logging.replica = 0;
+  dbh->logging.replica_pos = 0;
+  dbh->logging.replica_lag = 0;
+  dbh->logging.replica_synced = 0;
   return 0;
 }
 
@@ -458,15 +499,11 @@ static gint init_db_recptr_bitmap(void* db) {
 
 #ifdef USE_RECPTR_BITMAP
   gint segmentchunk;
-  gint asize;
   
-  // recs minimal alignment 8 bytes, multiply by 8 bits in byte = 64
-  asize=((dbh->size)/64)+16; 
-  segmentchunk=alloc_db_segmentchunk(db,asize);
+  segmentchunk=wg_alloc_offset_bitmap(db);
   if (!segmentchunk) return -2; // errcase
   dbh->recptr_bitmap.offset=segmentchunk;
-  dbh->recptr_bitmap.size=asize;
-  memset(offsettoptr(db,segmentchunk),0,asize);
+  dbh->recptr_bitmap.size=((dbh->size)/64)+16;
   return 0;
 #else  
   dbh->recptr_bitmap.offset=0;
@@ -476,6 +513,21 @@ static gint init_db_recptr_bitmap(void* db) {
 }
 
 
+/** initializes table directory
+*
+*/
+static gint init_db_tables(void* db) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  int i;
+
+  for(i=0; i<WG_MAX_TABLES; i++) {
+    dbh->tables.bitmap[i]=0;
+    dbh->tables.records[i]=-1;
+    dbh->tables.columns[i]=0;
+  }
+  return 0;
+}
+
 #ifdef USE_REASONER
 
 /** initializes anonymous constants (special uris with attached funs)
@@ -722,11 +774,13 @@ gint wg_alloc_fixlen_object(void* db, void* area_header) {
 
   areah=(db_area_header*)area_header;
   freelist=areah->freelist;
+  WG_STAT_INC(db, WG_STAT_ALLOC_FIXLEN);
   if (!freelist) {
     if(!extend_fixedlen_area(db,areah)) {
       show_dballoc_error_nr(db,"cannot extend fixed length object area for size ",areah->objlength);
       return 0;
     }
+    WG_STAT_INC(db, WG_STAT_ALLOC_EXTEND);
     freelist=areah->freelist;
     if (!freelist) {
       show_dballoc_error_nr(db,"no free fixed length objects available for size ",areah->objlength);
@@ -794,6 +848,7 @@ done:
 void wg_free_listcell(void* db, gint offset) {
   dbstore(db,offset,(dbmemsegh(db)->listcell_area_header).freelist);
   (dbmemsegh(db)->listcell_area_header).freelist=offset;
+  WG_STAT_INC(db, WG_STAT_FREE_FIXLEN);
 }
 
 
@@ -806,6 +861,7 @@ void wg_free_listcell(void* db, gint offset) {
 void wg_free_shortstr(void* db, gint offset) {
   dbstore(db,offset,(dbmemsegh(db)->shortstr_area_header).freelist);
   (dbmemsegh(db)->shortstr_area_header).freelist=offset;
+  WG_STAT_INC(db, WG_STAT_FREE_FIXLEN);
 }
 
 /** free an existing word-len object
@@ -817,6 +873,7 @@ void wg_free_shortstr(void* db, gint offset) {
 void wg_free_word(void* db, gint offset) {
   dbstore(db,offset,(dbmemsegh(db)->word_area_header).freelist);
   (dbmemsegh(db)->word_area_header).freelist=offset;
+  WG_STAT_INC(db, WG_STAT_FREE_FIXLEN);
 }
 
 
@@ -830,6 +887,7 @@ void wg_free_word(void* db, gint offset) {
 void wg_free_doubleword(void* db, gint offset) {
   dbstore(db,offset,(dbmemsegh(db)->doubleword_area_header).freelist); //bug fixed here
   (dbmemsegh(db)->doubleword_area_header).freelist=offset;
+  WG_STAT_INC(db, WG_STAT_FREE_FIXLEN);
 }
 
 /** free an existing tnode object
@@ -841,6 +899,7 @@ void wg_free_doubleword(void* db, gint offset) {
 void wg_free_tnode(void* db, gint offset) {
   dbstore(db,offset,(dbmemsegh(db)->tnode_area_header).freelist);
   (dbmemsegh(db)->tnode_area_header).freelist=offset;
+  WG_STAT_INC(db, WG_STAT_FREE_FIXLEN);
 }
 
 /** free generic fixlen object
@@ -852,6 +911,7 @@ void wg_free_tnode(void* db, gint offset) {
 void wg_free_fixlen_object(void* db, db_area_header *hdr, gint offset) {
   dbstore(db,offset,hdr->freelist);
   hdr->freelist=offset;
+  WG_STAT_INC(db, WG_STAT_FREE_FIXLEN);
 }
 
 
@@ -899,6 +959,7 @@ gint wg_alloc_gints(void* db, void* area_header, gint nr) {
     nextobject=res+usedbytes;
     tmp=dbfetch(db,nextobject);
     if (isnormalusedobject(tmp)) dbstore(db,nextobject,makeusedobjectsizeprevused(tmp));
+    WG_STAT_INC(db, WG_STAT_ALLOC_EXACT);
     return res;
   }
   // next try to find first free object in a few nearest exact-length buckets (shorter first)
@@ -911,6 +972,7 @@ gint wg_alloc_gints(void* db, void* area_header, gint nr) {
       if (tmp<0) return 0; // error case
       // prev elem cannot be free (no consecutive free elems)
       dbstore(db,res,makeusedobjectsizeprevused(wantedbytes)); // store wanted size to the returned object
+      WG_STAT_INC(db, WG_STAT_ALLOC_SPLIT);
       return res;
     }
   }
@@ -925,6 +987,7 @@ gint wg_alloc_gints(void* db, void* area_header, gint nr) {
       freebuckets[DVSIZEBUCKET]=0;
       // prev elem of dv cannot be free
       dbstore(db,res,makeusedobjectsizeprevused(wantedbytes)); // store wanted size to the returned object
+      WG_STAT_INC(db, WG_STAT_ALLOC_DV);
       return res;
     } else if (usedbytes+MIN_VARLENOBJ_SIZE<=size) {
       // found a designated victim somewhat larger: take the first part and keep the rest as dv
@@ -934,6 +997,7 @@ gint wg_alloc_gints(void* db, void* area_header, gint nr) {
       freebuckets[DVSIZEBUCKET]=size-usedbytes; // rest of victim becomes shorter
       // prev elem of dv cannot be free
       dbstore(db,res,makeusedobjectsizeprevused(wantedbytes)); // store wanted size to the returned object
+      WG_STAT_INC(db, WG_STAT_ALLOC_DV);
       return res;
     }
   }
@@ -947,6 +1011,7 @@ gint wg_alloc_gints(void* db, void* area_header, gint nr) {
       if (tmp<0) return 0; // error case
       // prev elem cannot be free (no consecutive free elems)
       dbstore(db,res,makeusedobjectsizeprevused(wantedbytes)); // store wanted size to the returned object
+      WG_STAT_INC(db, WG_STAT_ALLOC_SPLIT);
       return res;
     }
   }
@@ -963,6 +1028,7 @@ gint wg_alloc_gints(void* db, void* area_header, gint nr) {
         if (nextel!=0) dbstore(db,nextel+2*sizeof(gint),dbaddr(db,&freebuckets[i]));
         // prev elem cannot be free (no consecutive free elems)
         dbstore(db,res,makeusedobjectsizeprevused(wantedbytes)); // store wanted size to the returned object
+        WG_STAT_INC(db, WG_STAT_ALLOC_EXACT);
         return res;
       } else if (size>=usedbytes+MIN_VARLENOBJ_SIZE) {
         // found one somewhat larger: now split and store the rest
@@ -972,6 +1038,7 @@ gint wg_alloc_gints(void* db, void* area_header, gint nr) {
         if (tmp<0) return 0; // error case
         // prev elem cannot be free (no consecutive free elems)
         dbstore(db,res,makeusedobjectsizeprevused(wantedbytes)); // store wanted size to the returned object
+        WG_STAT_INC(db, WG_STAT_ALLOC_SPLIT);
         return res;
       }
     }
@@ -981,6 +1048,7 @@ gint wg_alloc_gints(void* db, void* area_header, gint nr) {
   //printf("ABOUT TO CREATE A NEW SUBAREA\n");
   tmp=extend_varlen_area(db,areah,usedbytes);
   if (!tmp) {  show_dballoc_error(db," cannot initialize new varlen subarea"); return 0; }
+  WG_STAT_INC(db, WG_STAT_ALLOC_EXTEND);
   // here we have successfully allocated a new subarea
   // call self recursively: this call will use the new free area
   tmp=wg_alloc_gints(db,areah,nr);
@@ -1198,6 +1266,7 @@ gint wg_free_object(void* db, void* area_header, gint object) {
     show_dballoc_error(db,"wg_free_object second arg has a too small size");
     return -3; // error: wrong size info (too small)
   }
+  WG_STAT_INC(db, WG_STAT_FREE_VARLEN);
   freebuckets=areah->freebuckets;
 
   // first try to merge with the previous free object, if so marked
@@ -1394,6 +1463,80 @@ gint wg_create_hash(void *db, db_hash_area_header* areah, gint size) {
   return 0;
 }
 
+/******************** Record offset bitmaps *********************/
+
+/*
+ * Allocate a bitmap with one bit for each possible record offset
+ * in the segment. The bitmap is taken from the free space at the end
+ * of the segment and cannot be released.
+ * returns the offset of the zeroed bitmap, 0 if out of space.
+ */
+gint wg_alloc_offset_bitmap(void *db) {
+  gint segmentchunk;
+  gint asize;
+
+  // recs minimal alignment 8 bytes, multiply by 8 bits in byte = 64
+  asize=((dbmemsegh(db)->size)/64)+16;
+  segmentchunk=alloc_db_segmentchunk(db,asize);
+  if (!segmentchunk) return 0;
+  memset(offsettoptr(db,segmentchunk),0,asize);
+  return segmentchunk;
+}
+
+/*
+ * Find the first set bit in an offset bitmap, starting from offset.
+ * Words are skipped while they are zero. The search stops at the
+ * end of the last datarec subarea.
+ * returns the record offset, 0 if there are no more bits set.
+ */
+gint wg_next_bitmap_offset(void *db, gint bitmap, gint offset) {
+  db_area_header* areah = &(dbmemsegh(db)->datarec_area_header);
+  db_subarea_header* last;
+  wg_uint *words;
+  wg_uint word, bit, idx, endidx;
+  const wg_uint wordbits = sizeof(wg_uint)*8;
+
+  last=&((areah->subarea_array)[areah->last_subarea_index]);
+  endidx=((wg_uint) (last->offset+last->size)/8 + wordbits-1)/wordbits;
+  words=(wg_uint *) offsettoptr(db,bitmap);
+
+  bit=((wg_uint) offset)/8;
+  idx=bit/wordbits;
+  if (idx>=endidx) return 0;
+  /* mask out the bits below the current position */
+  word=words[idx] & (~((wg_uint) 0) << (bit%wordbits));
+  while (!word) {
+    if (++idx>=endidx) return 0;
+    word=words[idx];
+  }
+  bit=idx*wordbits+bitmap_lowest_bit(word);
+  return (gint) bit*8;
+}
+
+/*
+ * Return the position of the lowest set bit in a non-zero word.
+ */
+static int bitmap_lowest_bit(wg_uint word) {
+#if defined(__GNUC__)
+  return __builtin_ctzll((unsigned long long) word);
+#elif defined(_MSC_VER) && defined(_WIN64)
+  unsigned long idx;
+  _BitScanForward64(&idx, word);
+  return (int) idx;
+#elif defined(_MSC_VER)
+  unsigned long idx;
+  _BitScanForward(&idx, word);
+  return (int) idx;
+#else
+  int i=0;
+  while (!(word & 1)) {
+    word>>=1;
+    i++;
+  }
+  return i;
+#endif
+}
+
 /********** Helper functions for accessing the header ********/
 
 /*
@@ -1415,6 +1558,147 @@ gint wg_database_size(void *db) {
   return dbh->size;
 }
 
+/* ------------- memory usage of the areas ---------------------*/
+
+/*
+ * Return the name of an allocation area, NULL if the area does not exist.
+ */
+char *wg_get_area_name(gint area) {
+  if(area < 0 || area >= WG_AREA_COUNT)
+    return NULL;
+  return area_names[area];
+}
+
+/*
+ * Collect the memory usage of an allocation area.
+ * Walks all the objects of the area, so the cost is proportional
+ * to the area size. The caller should hold a read lock.
+ *
+ * returns 0 on success
+ * returns -1 if the area does not exist
+ * returns -2 if the area structure is inconsistent
+ */
+gint wg_get_area_usage(void *db, gint area, wg_area_usage *usage) {
+  db_area_header *areah;
+  gint i;
+
+  memset(usage, 0, sizeof(wg_area_usage));
+  areah = usage_area_header(db, area);
+  if(!areah)
+    return -1;
+  if(!areah->subarea_array[0].size)
+    return 0; /* area not used in this build (indextmpl) */
+
+  usage->fixedlength = areah->fixedlength;
+  usage->objlength = (areah->fixedlength ? areah->objlength : 0);
+  for(i=0; i<=areah->last_subarea_index && i<SUBAREA_ARRAY_SIZE; i++) {
+    usage->subareas++;
+    usage->size += areah->subarea_array[i].size;
+  }
+  if(areah->fixedlength)
+    return fixlen_area_usage(db, areah, usage);
+  else
+    return varlen_area_usage(db, areah, usage);
+}
+
+/** Find the area header by the area number.
+ */
+static db_area_header *usage_area_header(void *db, gint area) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  switch(area) {
+    case WG_AREA_DATAREC: return &(dbh->datarec_area_header);
+    case WG_AREA_LONGSTR: return &(dbh->longstr_area_header);
+    case WG_AREA_LISTCELL: return &(dbh->listcell_area_header);
+    case WG_AREA_SHORTSTR: return &(dbh->shortstr_area_header);
+    case WG_AREA_WORD: return &(dbh->word_area_header);
+    case WG_AREA_DOUBLEWORD: return &(dbh->doubleword_area_header);
+    case WG_AREA_TNODE: return &(dbh->tnode_area_header);
+    case WG_AREA_INDEXHDR: return &(dbh->indexhdr_area_header);
+    case WG_AREA_INDEXTMPL: return &(dbh->indextmpl_area_header);
+    case WG_AREA_INDEXHASH: return &(dbh->indexhash_area_header);
+    default: return NULL;
+  }
+}
+
+/** Fixed length area usage: count the objects in the freelist.
+ *  Every object in the freelist is kept in the "exact" counters.
+ */
+static gint fixlen_area_usage(void* db, db_area_header *areah, wg_area_usage *usage) {
+  gint capacity = 0;
+  gint freelist;
+  gint i;
+
+  for(i=0; i<=areah->last_subarea_index && i<SUBAREA_ARRAY_SIZE; i++)
+    capacity += areah->subarea_array[i].alignedsize / areah->objlength;
+
+  for(freelist=areah->freelist; freelist; freelist=dbfetch(db, freelist)) {
+    if(++(usage->free_objects) > capacity)
+      return -2; /* loop in the freelist */
+  }
+  usage->free_bytes = usage->free_objects * areah->objlength;
+  usage->exact_objects = usage->free_objects;
+  usage->exact_bytes = usage->free_bytes;
+  usage->used_objects = capacity - usage->free_objects;
+  usage->used_bytes = usage->used_objects * areah->objlength;
+  if(usage->free_objects)
+    usage->largest_free = areah->objlength;
+  return 0;
+}
+
+/** Variable length area usage: walk the objects of each subarea
+ *  from the start marker to the end marker.
+ *  Free objects that fit in the exact size buckets are counted
+ *  separately from those in the variable size buckets. The designated
+ *  victim is counted as free space, but not as a free object.
+ */
+static gint varlen_area_usage(void* db, db_area_header *areah, wg_area_usage *usage) {
+  gint i;
+
+  for(i=0; i<=areah->last_subarea_index && i<SUBAREA_ARRAY_SIZE; i++) {
+    gint offset = areah->subarea_array[i].alignedoffset;
+    gint end = offset + areah->subarea_array[i].alignedsize;
+    gint head, size;
+
+    /* skip the start marker */
+    offset += MIN_VARLENOBJ_SIZE;
+    while(offset < end) {
+      head = dbfetch(db, offset);
+      if(isfreeobject(head)) {
+        size = getfreeobjectsize(head);
+        usage->free_objects++;
+        usage->free_bytes += size;
+        if(wg_freebuckets_index(db, size) < EXACTBUCKETS_NR) {
+          usage->exact_objects++;
+          usage->exact_bytes += size;
+        } else {
+          usage->var_objects++;
+          usage->var_bytes += size;
+        }
+      } else if(isspecialusedobject(head)) {
+        size = getspecialusedobjectsize(head);
+        if(dbfetch(db, offset+sizeof(gint)) != SPECIALGINT1DV)
+          break; /* end marker */
+        usage->dv_bytes += size;
+        usage->free_bytes += size;
+      } else {
+        size = getusedobjectsize(head);
+        usage->used_objects++;
+        usage->used_bytes += size;
+        offset += size;
+        continue;
+      }
+      if(size < MIN_VARLENOBJ_SIZE)
+        return -2;
+      if(size > usage->largest_free)
+        usage->largest_free = size;
+      offset += size;
+    }
+    if(offset != end - MIN_VARLENOBJ_SIZE)
+      return -2; /* ran past the end marker */
+  }
+  return 0;
+}
+
 
 /* --------------- error handling ------------------------------*/
 
@@ -195,7 +195,7 @@ typedef __int64 gint64;    /** 64-bit fixed size storage */
 
 #define dbfetch(db,offset) (*((gint*)(dbmemsegbytes(db)+(offset)))) /** get gint from address */
 #define dbstore(db,offset,data) (*((gint*)(dbmemsegbytes(db)+(offset)))=data) /** store gint to address */
-#define dbaddr(db,realptr) ((gint)(((char*)(realptr))-dbmemsegbytes(db))) /** give offset of real adress */
+#define dbaddr(db,realptr) (((gint)((char*)(realptr)))-((gint)dbmemsegbytes(db))) /** give offset of real adress */
 #define offsettoptr(db,offset) ((void*)(dbmemsegbytes(db)+(offset))) /** give real address from offset */
 #define ptrtooffset(db,realptr) (dbaddr((db),(realptr)))
 #define dbcheckh(dbh) (dbh!=NULL && *((gint32 *) dbh)==MEMSEGMENT_MAGIC_MARK) /** check that correct db ptr */
@@ -386,6 +386,8 @@ typedef struct {
     struct __wg_hashidx_header h;
   } ctl;                    /** shared fields for different index types */
   gint template_offset;     /** matchrec template, 0 if full index */
+  gint table;               /** table of the records, 0 if all records */
+  gint key;                 /** key function, WG_INDEX_KEY_VALUE if none */
 } wg_index_header;
 
 
@@ -396,6 +398,7 @@ typedef struct {
 typedef struct {
   gint fixed_columns;       /** number of fixed columns in the template */
   gint offset_matchrec;     /** offset to the record that stores the fields */
+  gint offset_conds;        /** record of WG_COND_* per field, 0 if all equal */
   gint refcount;            /** number of indexes using this template */
 } wg_index_template;
 #endif
@@ -407,6 +410,7 @@ typedef struct {
 typedef struct {
   gint number_of_indexes;       /** unused, reserved */
   gint index_list;              /** master index list */
+  gint path_index_list;         /** JSON path indexes, updated by documents */
   gint index_table[MAX_INDEXED_FIELDNR+1];    /** index lookup by column */
 #ifdef USE_INDEX_TEMPLATE
   gint index_template_list;     /** sorted list of index masks */
@@ -433,6 +437,10 @@ typedef struct {
   gint active;          /** logging mode on/off */
   gint dirty;           /** log file is clean/dirty */
   gint serial;          /** incremented when the log file is backed up */
+  gint replica;         /** a journal is being applied, see wg_start_replica() */
+  gint replica_pos;     /** position applied in the journal of the primary */
+  gint replica_lag;     /** journal bytes waiting at the last apply */
+  gint replica_synced;  /** time when the whole journal was last applied */
 } db_logging_area_header;
 
 
@@ -445,6 +453,88 @@ typedef struct {
   gint size; /** actual used size in bytes */  
 } db_recptr_bitmap_header;
 
+/** table directory
+*
+* Table 0 means "no table", so WG_MAX_TABLES-1 tables can exist.
+* Each table has a bitmap of its record offsets, in the same format
+* as the record pointer bitmap. The bitmap of a dropped table is
+* kept and reused by the next table created.
+*
+* A table may also have a column projection: copies of some of its
+* columns in contiguous arrays, one row slot per record.
+*/
+
+#define WG_MAX_TABLES 32
+#define WG_MAX_TABLE_COLUMNS 16
+
+typedef struct {
+  gint bitmap[WG_MAX_TABLES];  /** offset of the record bitmap, 0 if none */
+  gint records[WG_MAX_TABLES]; /** number of records, -1 if not in use */
+  gint columns[WG_MAX_TABLES]; /** offset of the column projection, 0 if none */
+} db_table_area_header;
+
+/** column projection of a table
+*
+* The data block holds capacity record offsets followed by
+* an array of capacity encoded values for each column. A slot
+* of a deleted record has offset 0 and WG_ILLEGAL values.
+*/
+
+typedef struct {
+  gint count;       /** number of projected columns */
+  gint column[WG_MAX_TABLE_COLUMNS]; /** projected field numbers */
+  gint capacity;    /** number of slots in the data block */
+  gint used;        /** number of slots handed out */
+  gint data;        /** offset of the data block */
+} db_table_projection;
+
+/** runtime statistics area
+*
+* Counters are striped to reduce cache line contention: each
+* CPU updates its own stripe and readers sum all of them.
+* The capacity is fixed so that adding counters does not change
+* the layout of the segment header.
+*/
+
+#define WG_STATS_STRIPES 16
+#define WG_STATS_CAPACITY 32
+
+#ifdef USE_DBSTATS
+typedef struct {
+  gint stripe[WG_STATS_STRIPES][WG_STATS_CAPACITY];
+} db_stats_area;
+#endif
+
+/** lock timing area
+*
+* Wait and hold times of the database lock are collected into
+* log2-scale histograms (bucket i counts times of 2^i..2^(i+1)-1
+* nanoseconds), separately for each call site tag and lock mode.
+*/
+
+#define WG_LOCKSTAT_TAGS 16     /** number of call site tags */
+#define WG_LOCKSTAT_TAGLEN 16   /** max length of tag name, including \0 */
+#define WG_LOCKSTAT_BUCKETS 32  /** histogram buckets (up to ~4 seconds) */
+#define WG_LOCKSTAT_READ 0
+#define WG_LOCKSTAT_WRITE 1
+
+#ifdef USE_LOCKSTATS
+typedef struct {
+  gint count;     /** locks acquired */
+  gint timeouts;  /** lock requests that timed out */
+  gint spins;     /** spin loop iterations while waiting */
+  gint sleeps;    /** times the CPU was yielded while waiting */
+  gint wait[WG_LOCKSTAT_BUCKETS]; /** time to acquire the lock */
+  gint hold[WG_LOCKSTAT_BUCKETS]; /** time between acquire and release */
+} db_lockstat_hist;
+
+typedef struct {
+  volatile gint tag_used[WG_LOCKSTAT_TAGS];
+  char tag_name[WG_LOCKSTAT_TAGS][WG_LOCKSTAT_TAGLEN];
+  db_lockstat_hist hist[WG_LOCKSTAT_TAGS][2]; /** indexed by tag, mode */
+} db_lockstats_area;
+#endif
+
 /** anonconst area header
 *
 */
@@ -494,16 +584,64 @@ typedef struct _db_memsegment_header {
   db_logging_area_header logging;
   // recptr bitmap
   db_recptr_bitmap_header recptr_bitmap;
+  // tables
+  db_table_area_header tables;
   // anonconst table
 #ifdef USE_REASONER
   db_anonconst_area_header anonconst;
 #endif
   // statistics
+#ifdef USE_DBSTATS
+  db_stats_area stats;
+#endif
+#ifdef USE_LOCKSTATS
+  db_lockstats_area lockstats;
+#endif
   // field/table name structures
   syn_var_area locks;   /** currently holds a single global lock */
   extdb_area extdbs;    /** offset ranges of external databases */
 } db_memsegment_header;
 
+/** area numbers for wg_get_area_usage()
+*
+*/
+
+#define WG_AREA_DATAREC 0
+#define WG_AREA_LONGSTR 1
+#define WG_AREA_LISTCELL 2
+#define WG_AREA_SHORTSTR 3
+#define WG_AREA_WORD 4
+#define WG_AREA_DOUBLEWORD 5
+#define WG_AREA_TNODE 6
+#define WG_AREA_INDEXHDR 7
+#define WG_AREA_INDEXTMPL 8
+#define WG_AREA_INDEXHASH 9
+
+#define WG_AREA_COUNT 10
+
+/** memory usage of one area, filled by wg_get_area_usage()
+*
+*  free_bytes includes the designated victim, free_objects does not.
+*  For fixed length areas all free objects are counted as exact.
+*/
+
+typedef struct {
+  gint fixedlength;     /** 1 if fixed length area, 0 if variable length */
+  gint objlength;       /** object length for fixed length areas */
+  gint subareas;        /** number of subareas allocated */
+  gint size;            /** total size of the subareas in bytes */
+  gint used_objects;    /** objects in use */
+  gint used_bytes;      /** bytes in objects in use */
+  gint free_objects;    /** objects in freelists */
+  gint free_bytes;      /** bytes in free objects and the designated victim */
+  gint exact_objects;   /** free objects in exact size buckets */
+  gint exact_bytes;
+  gint var_objects;     /** free objects in variable size buckets */
+  gint var_bytes;
+  gint dv_bytes;        /** size of the designated victim */
+  gint largest_free;    /** largest free object or designated victim */
+} wg_area_usage;
+
 #ifdef USE_DATABASE_HANDLE
 /** Database handle in local memory. Contains the pointer to the
 *  shared memory area.
@@ -590,9 +728,13 @@ void *wg_create_child_db(void* db, gint size);
 #endif
 gint wg_register_external_db(void *db, void *extdb);
 gint wg_create_hash(void *db, db_hash_area_header* areah, gint size);
+gint wg_alloc_offset_bitmap(void *db);
+gint wg_next_bitmap_offset(void *db, gint bitmap, gint offset);
 
 gint wg_database_freesize(void *db);
 gint wg_database_size(void *db);
+char *wg_get_area_name(gint area);
+gint wg_get_area_usage(void *db, gint area, wg_area_usage *usage);
 
 /* ------- testing ------------ */
 
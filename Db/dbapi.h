@@ -78,8 +78,15 @@ extern "C" {
 #define WG_QTYPE_TTREE      0x01
 #define WG_QTYPE_HASH       0x02
 #define WG_QTYPE_SCAN       0x04
+#define WG_QTYPE_COLUMNS    0x08
 #define WG_QTYPE_PREFETCH   0x80
 
+/* Journal entry types in change events, see wg_fetch_journal_event() */
+#define WG_JOURNAL_ENTRY_CRE ((unsigned char) 0x40)
+#define WG_JOURNAL_ENTRY_DEL ((unsigned char) 0x80)
+#define WG_JOURNAL_ENTRY_SET ((unsigned char) 0xc0)
+#define WG_JOURNAL_ENTRY_META ((unsigned char) 0x20)
+
 /* Direct access to field */
 #define RECORD_HEADER_GINTS 3
 #define wg_field_addr(db,record,fieldnr) (((wg_int*)(record))+RECORD_HEADER_GINTS+(fieldnr))
@@ -89,6 +96,40 @@ extern "C" {
 typedef ptrdiff_t wg_int;
 typedef size_t wg_uint;
 
+/** Typed value for wg_insert_batch() */
+typedef struct {
+  wg_int type;          /** WG_INTTYPE, WG_STRTYPE etc */
+  union {
+    wg_int i;           /** int, var, date and time values */
+    double d;           /** double and fixpoint values */
+    char c;             /** char value */
+    char *s;            /** str, xmlliteral, uri and blob data */
+    void *rec;          /** record pointer */
+  } v;
+  char *ext;            /** lang, xsdtype, prefix or blob type */
+  wg_int len;           /** length of blob data */
+} wg_batch_value;
+
+/** Memory usage of one area, see wg_get_area_usage() */
+#ifndef DEFINED_DBALLOC_H /* same structure is defined there */
+typedef struct {
+  wg_int fixedlength;     /** 1 if fixed length area, 0 if variable length */
+  wg_int objlength;       /** object length for fixed length areas */
+  wg_int subareas;        /** number of subareas allocated */
+  wg_int size;            /** total size of the subareas in bytes */
+  wg_int used_objects;    /** objects in use */
+  wg_int used_bytes;      /** bytes in objects in use */
+  wg_int free_objects;    /** objects in freelists */
+  wg_int free_bytes;      /** bytes in free objects and the designated victim */
+  wg_int exact_objects;   /** free objects in exact size buckets */
+  wg_int exact_bytes;
+  wg_int var_objects;     /** free objects in variable size buckets */
+  wg_int var_bytes;
+  wg_int dv_bytes;        /** size of the designated victim */
+  wg_int largest_free;    /** largest free object or designated victim */
+} wg_area_usage;
+#endif
+
 /** Query argument list object */
 typedef struct {
   wg_int column;      /** column (field) number this argument applies to */
@@ -102,7 +143,10 @@ typedef struct {
   /* Argument list based query is the only one supported at the moment. */
   wg_query_arg *arglist;    /** check each row in result set against these */
   wg_int argc;              /** number of elements in arglist */
+  wg_int *argmodes;         /** comparison mode of each element in arglist */
+  wg_int *argpos;           /** projection column of each element, if used */
   wg_int column;            /** index on this column used */
+  wg_int table;             /** only return records of this table, if non-0 */
   /* Fields for T-tree query (XXX: some may be re-usable for
    * other types as well) */
   wg_int curr_offset;
@@ -117,8 +161,42 @@ typedef struct {
   void *curr_page;          /** current page of results */
   wg_int curr_pidx;         /** current index on page */
   wg_uint res_count;        /** number of rows in results */
+  wg_int examined;          /** rows checked against the argument list */
 } wg_query;
 
+/** Query plan and execution profile, see wg_explain_query() */
+typedef struct {
+  wg_int qtype;         /** WG_QTYPE_TTREE, WG_QTYPE_SCAN or WG_QTYPE_COLUMNS */
+  wg_int column;        /** indexed column, -1 for full scan */
+  wg_int index_id;      /** index used, 0 for full scan */
+  wg_int start_bound;   /** encoded start of the index range, WG_ILLEGAL if open */
+  wg_int start_inclusive;
+  wg_int end_bound;     /** encoded end of the index range, WG_ILLEGAL if open */
+  wg_int end_inclusive;
+  wg_int argc;          /** conditions checked for each row examined */
+  wg_int estimated;     /** estimated number of rows examined */
+  wg_int examined;      /** rows checked against the conditions */
+  wg_int returned;      /** rows in the result set */
+  double elapsed;       /** time spent executing the query, in seconds */
+} wg_query_explain;
+
+/** Change event decoded from the journal, see wg_fetch_journal_event() */
+typedef struct {
+  wg_int op;          /** WG_JOURNAL_ENTRY_CRE, _DEL, _SET or _META */
+  wg_int pos;         /** journal position of the entry */
+  wg_int offset;      /** record offset */
+  wg_int column;      /** field number (SET) */
+  wg_int length;      /** record length (CRE) */
+  wg_int meta;        /** record metadata (META) */
+  wg_int enc;         /** encoded value as it was written (SET) */
+  wg_int type;        /** decoded value type (SET), 0 if not known */
+  wg_int intval;      /** int value, record offset for records,
+                       *  length of str, uri, xmlliteral or blob data */
+  double doubleval;   /** double value */
+  char *strval;       /** str, uri, xmlliteral or blob data */
+  char *extstr;       /** lang, xsdtype or prefix */
+} wg_journal_event;
+
 /* prototypes of wg database api functions
 
 */
@@ -142,11 +220,15 @@ void wg_delete_local_database(void* dbase);
 
 wg_int wg_database_freesize(void *db);
 wg_int wg_database_size(void *db);
+char *wg_get_area_name(wg_int area); ///< NULL if no such area
+wg_int wg_get_area_usage(void *db, wg_int area, wg_area_usage *usage); ///< 0 if ok, -1 no such area
 
 /* -------- creating and scanning records --------- */
 
 void* wg_create_record(void* db, wg_int length); ///< returns NULL when error, ptr to rec otherwise
 void* wg_create_raw_record(void* db, wg_int length); ///< returns NULL when error, ptr to rec otherwise
+wg_int wg_insert_batch(void* db, wg_int rowcount, wg_int *rowlen,
+  wg_batch_value *values, void **records); ///< returns 0 when ok, negative int on error
 wg_int wg_delete_record(void* db, void *rec);  ///< returns 0 on success, non-0 on error
 
 void* wg_get_first_record(void* db);              ///< returns NULL when error or no recs
@@ -155,6 +237,20 @@ void* wg_get_next_record(void* db, void* record); ///< returns NULL when error o
 void *wg_get_first_parent(void* db, void *record);
 void *wg_get_next_parent(void* db, void* record, void *parent);
 
+/* -------- tables --------- */
+
+wg_int wg_create_table(void *db); ///< returns table id > 0, negative int on error
+wg_int wg_drop_table(void *db, wg_int table); ///< table must be empty, returns 0 if ok
+void* wg_create_table_record(void *db, wg_int table, wg_int length); ///< returns NULL when error
+wg_int wg_get_record_table(void *db, void *record); ///< 0 if record is not in a table
+wg_int wg_get_table_record_count(void *db, wg_int table); ///< -1 if no such table
+void* wg_get_first_table_record(void *db, wg_int table); ///< returns NULL when error or no recs
+void* wg_get_next_table_record(void *db, wg_int table, void *record); ///< returns NULL when error or no more recs
+wg_int wg_create_table_columns(void *db, wg_int table, wg_int *columns, wg_int count); ///< returns 0 if ok
+wg_int wg_drop_table_columns(void *db, wg_int table); ///< returns 0 if ok
+wg_int* wg_get_table_column(void *db, wg_int table, wg_int column, wg_int *count); ///< NULL if column is not projected
+void* wg_get_table_column_record(void *db, wg_int table, wg_int slot); ///< NULL if slot is not in use
+
 /* -------- setting and fetching record field values --------- */
 
 wg_int wg_get_record_len(void* db, void* record); ///< returns negative int when error
@@ -164,6 +260,10 @@ wg_int* wg_get_record_dataarray(void* db, void* record); ///< pointer to record
 wg_int wg_set_field(void* db, void* record, wg_int fieldnr, wg_int data);
 wg_int wg_set_new_field(void* db, void* record, wg_int fieldnr, wg_int data);
 
+wg_int wg_open_record_update(void* db, void* record);
+wg_int wg_close_record_update(void* db, void* record);
+wg_int wg_close_record_updates(void* db, void** records, wg_int count);
+
 wg_int wg_set_int_field(void* db, void* record, wg_int fieldnr, wg_int data);
 wg_int wg_set_double_field(void* db, void* record, wg_int fieldnr, double data);
 wg_int wg_set_str_field(void* db, void* record, wg_int fieldnr, char* data);
@@ -228,6 +328,11 @@ void wg_time_to_hms(void* db, int time, int *hr, int *min, int *sec, int *prt);
 
 wg_int wg_encode_str(void* db, char* str, char* lang); ///< let lang==NULL if not used
 
+/* Strings shorter than sizeof(wg_int) without lang are kept in the encoded
+ * value. For these, the returned pointer is to a per-thread buffer that is
+ * reused after 16 further decoding calls: copy the string to keep it longer.
+ * This also applies to wg_decode_uri(), wg_decode_xmlliteral() and the
+ * prefix and xsdtype decoders. */
 char* wg_decode_str(void* db, wg_int data);
 char* wg_decode_str_lang(void* db, wg_int data);
 
@@ -306,12 +411,28 @@ wg_int wg_start_logging(void *db); /* activate journal logging globally */
 wg_int wg_stop_logging(void *db); /* deactivate journal logging */
 wg_int wg_replay_log(void *db, char *filename); /* restore from journal */
 
+/* journal change events, NULL filename follows the database journal */
+void *wg_open_journal_cursor(void *db, char *filename, wg_int serial, wg_int pos);
+void *wg_load_journal_cursor(void *db, char *posfile);
+wg_int wg_save_journal_cursor(void *db, void *cursor, char *posfile);
+wg_int wg_fetch_journal_event(void *db, void *cursor, wg_journal_event *ev);
+void wg_free_journal_cursor(void *db, void *cursor);
+
+/* read replica, applies the journal of the primary database continuously */
+void *wg_start_replica(void *db, char *filename);
+wg_int wg_apply_replica(void *db, void *replica); /* needs write lock */
+wg_int wg_replica_lag(void *db, wg_int *bytes, wg_int *seconds);
+void wg_stop_replica(void *db, void *replica);
+
 /* ---------- concurrency support  ---------- */
 
 wg_int wg_start_write(void * dbase);          /* start write transaction */
 wg_int wg_end_write(void * dbase, wg_int lock); /* end write transaction */
 wg_int wg_start_read(void * dbase);           /* start read transaction */
 wg_int wg_end_read(void * dbase, wg_int lock);  /* end read transaction */
+wg_int wg_lock_tag(void *db, char *name);       /* lock timing call site tag */
+wg_int wg_set_lock_tag(void *db, wg_int tag);   /* select tag for this thread */
+wg_int wg_reset_lockstats(void *db);            /* clear lock timing data */
 
 /* ------------- utilities ----------------- */
 
@@ -323,6 +444,12 @@ wg_int wg_parse_and_encode_param(void *db, char *buf);
 void wg_export_db_csv(void *db, char *filename);
 wg_int wg_import_db_csv(void *db, char *filename);
 
+/* ---------- runtime statistics ----------- */
+
+wg_int wg_get_stats(void *db, wg_int *counters, wg_int count); /* -1 if not enabled */
+char *wg_get_stat_name(wg_int id);
+wg_int wg_reset_stats(void *db);
+
 /* ---------- query functions -------------- */
 
 wg_query *wg_make_query(void *db, void *matchrec, wg_int reclen,
@@ -330,6 +457,10 @@ wg_query *wg_make_query(void *db, void *matchrec, wg_int reclen,
 #define wg_make_prefetch_query wg_make_query
 wg_query *wg_make_query_rc(void *db, void *matchrec, wg_int reclen,
   wg_query_arg *arglist, wg_int argc, wg_uint rowlimit);
+wg_query *wg_make_table_query(void *db, wg_int table, void *matchrec,
+  wg_int reclen, wg_query_arg *arglist, wg_int argc);
+wg_int wg_explain_query(void *db, void *matchrec, wg_int reclen,
+  wg_query_arg *arglist, wg_int argc, wg_query_explain *explain);
 void *wg_fetch(void *db, wg_query *query);
 void wg_free_query(void *db, wg_query *query);
 
@@ -66,10 +66,18 @@ gint wg_compare(void *db, gint a, gint b, int depth) {
  * (once recursion depth runs out).
  */
 
-  /* XXX: might be able to save time here to mask and compare
-   * the type bits instead */
-  gint typea = wg_get_encoded_type(db, a);
-  gint typeb = wg_get_encoded_type(db, b);
+  gint typea, typeb;
+
+  /* Values that are ordered like their encoding can be compared
+   * without decoding (see WG_COMPARE_MODE()). */
+  if((issmallint(a) && issmallint(b)) ||\
+    (!((a^b)&LASTBYTEMASK) && WG_COMPARE_MODE(a)==WG_CMP_TAGGED)) {
+    if(a==b) return WG_EQUAL;
+    return (a>b ? WG_GREATER : WG_LESSTHAN);
+  }
+
+  typea = wg_get_encoded_type(db, a);
+  typeb = wg_get_encoded_type(db, b);
 
   /* assume types are >2 (NULLs are always equal) and
    * <13 (not implemented as of now)
@@ -188,6 +196,16 @@ gint wg_compare(void *db, gint a, gint b, int depth) {
       char *deca, *decb, *exa=NULL, *exb=NULL;
       char buf[4];
       gint res;
+#ifdef USETINYSTR
+      if(istinystr(a) && istinystr(b)) {
+        /* Both values are immediate, no need to look up the data */
+        char tinya[sizeof(gint)+1], tinyb[sizeof(gint)+1];
+        res = strcmp(wg_decode_tinystr(a, tinya), wg_decode_tinystr(b, tinyb));
+        if(res > 0) return WG_GREATER;
+        else if(res < 0) return WG_LESSTHAN;
+        else return WG_EQUAL;
+      }
+#endif
       if(typea==WG_STRTYPE) {
         /* lang is ignored */
         deca = wg_decode_str(db, a);
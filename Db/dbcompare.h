@@ -60,6 +60,27 @@
 #define WG_COMPARE(d,a,b) (a==b ? WG_EQUAL :\
   wg_compare(d,a,b,WG_COMPARE_REC_DEPTH))
 
+/* Comparison modes for the hot loops of queries and indexes. The
+ * mode is picked once from a fixed operand (a query argument or a
+ * search key) with WG_COMPARE_MODE(). Small ints, dates and fixpoints
+ * are ordered like their encoded values, so if the other operand has
+ * the same encoding, a single integer compare is enough. Otherwise
+ * wg_compare() is called. Times are not included, as their encoding
+ * wraps around in 32 bits.
+ */
+#define WG_CMP_GENERIC 0    /** always call wg_compare() */
+#define WG_CMP_SMALLINT 1   /** compare small ints directly */
+#define WG_CMP_TAGGED 2     /** compare dates and fixpoints directly */
+
+#define WG_COMPARE_MODE(a) (issmallint(a) ? WG_CMP_SMALLINT :\
+  ((isdate(a) || isfixpoint(a)) ? WG_CMP_TAGGED : WG_CMP_GENERIC))
+
+#define WG_COMPARE_FAST(d,m,a,b) (a==b ? WG_EQUAL :\
+  ((((m)==WG_CMP_SMALLINT && issmallint(a) && issmallint(b)) ||\
+  ((m)==WG_CMP_TAGGED && !(((a)^(b))&LASTBYTEMASK))) ?\
+  (a>b ? WG_GREATER : WG_LESSTHAN) :\
+  wg_compare(d,a,b,WG_COMPARE_REC_DEPTH)))
+
 /* ==== Protos ==== */
 
 gint wg_compare(void *db, gint a, gint b, int depth);
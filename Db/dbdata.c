@@ -62,6 +62,8 @@ extern "C" {
 #include "dbindex.h"
 #include "dbcompare.h"
 #include "dblock.h"
+#include "dbstats.h"
+#include "dbtable.h"
 
 /* ====== Private headers and defs ======== */
 
@@ -72,10 +74,59 @@ static struct tm * localtime_r (const time_t *timer, struct tm *result);
 #define snprintf sprintf_s
 #endif
 
+#ifdef USETINYSTR
+/* Tiny strings are not stored anywhere in the database, so decoding
+ * them returns a pointer to one of these buffers instead. They are
+ * reused in rotation, so the pointer remains valid for the next
+ * TINYSTR_BUFFERS decoding calls in the same thread.
+ */
+#define TINYSTR_BUFFERS 16
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+static THREAD_LOCAL char tinystr_buf[TINYSTR_BUFFERS][sizeof(gint)+1];
+static THREAD_LOCAL int tinystr_next = 0;
+#endif
+
+#ifdef USE_RECPTR_BITMAP
+/* The record pointer bitmap is handled in words of this many bits */
+#define RECPTR_WORDBITS (sizeof(wg_uint)*8)
+#endif
+
+#ifdef USE_BACKLINKING
+/* Format of the backlinks field, stored in the low bits of the offset */
+#define BACKLINK_TAGMASK 0x3
+#define BACKLINK_PAIR 0x1         /** list cell with two parents */
+#define BACKLINK_SET 0x2          /** hash set of parents */
+
+/* Backlink set object. Each slot holds a parent offset and the
+ * number of references from that parent. */
+#define BACKLINK_SET_CAP_POS 1    /** number of slots, power of 2 */
+#define BACKLINK_SET_COUNT_POS 2  /** number of parents */
+#define BACKLINK_SET_USED_POS 3   /** parents and removed slots */
+#define BACKLINK_SET_HEADER_GINTS 4
+#define BACKLINK_SET_MIN_CAP 8
+#define BACKLINK_REMOVED 1        /** marks the slot of a removed parent */
+
+#define backlink_slot(set, i) ((set) + BACKLINK_SET_HEADER_GINTS + 2*(i))
+#define backlink_hash(parent, cap) \
+  ((gint) ((((wg_uint) (parent)) >> 2) * 2654435761U) & ((cap) - 1))
+#endif
+
 
 /* ======= Private protos ================ */
 
 #ifdef USE_BACKLINKING
+static gint add_backlink(void *db, gint *child, gint parent);
+static gint remove_backlink(void *db, gint *child, gint parent);
+static gint next_backlink(void *db, gint *record, gint *pos);
+static gint *find_backlink_slot(gint *set, gint parent);
+static void insert_backlink_slot(gint *set, gint parent, gint refs);
+static gint new_backlink_set(void *db, gint capacity);
 static gint remove_backlink_index_entries(void *db, gint *record,
   gint value, gint depth);
 static gint restore_backlink_index_entries(void *db, gint *record,
@@ -88,17 +139,28 @@ static long years_to_days (unsigned yr);
 static long ymd_to_scalar (unsigned yr, unsigned mo, unsigned day);
 static void scalar_to_ymd (long scalar, unsigned *yr, unsigned *mo, unsigned *day);
 
+static gint set_new_field(void* db, void* record, gint fieldnr, gint data,
+  int update_index);
+static gint encode_batch_value(void* db, wg_batch_value *val);
 static gint free_field_encoffset(void* db,gint encoffset);
 static gint find_create_longstr(void* db, char* data, char* extrastr, gint type, gint length);
+#ifdef USETINYSTR
+static char *tinystr_buffer(gint data);
+#endif
 
 #ifdef USE_CHILD_DB
 static void *get_ptr_owner(void *db, gint encoded);
 static int is_local_offset(void *db, gint offset);
 #endif
 
+static void *next_raw_record(void *db, gint offset);
+
 #ifdef USE_RECPTR_BITMAP
+static int recptr_testbit(void *db,gint offset);
+static int recptr_valid(void *db,gint offset);
 static void recptr_setbit(void *db,void *ptr);
 static void recptr_clearbit(void *db,void *ptr);
+static void *recptr_next_record(void *db, gint offset);
 #endif
 
 static gint show_data_error(void* db, char* errmsg);
@@ -179,6 +241,10 @@ void* wg_create_raw_record(void* db, wg_int length) {
   for(i=RECORD_HEADER_GINTS;i<length+RECORD_HEADER_GINTS;i++) {
     dbstore(db,offset+(i*(sizeof(gint))),0);
   }
+#ifdef USE_RECPTR_BITMAP
+  recptr_setbit(db,offsettoptr(db,offset));
+#endif
+  WG_STAT_INC(db, WG_STAT_RECORDS_CREATED);
 
 #ifdef USE_DBLOG
   /* Append the created offset to log */
@@ -191,6 +257,168 @@ void* wg_create_raw_record(void* db, wg_int length) {
   return offsettoptr(db,offset);
 }
 
+/** Create several records from typed values.
+ *
+ *  rowcount records are created. The length of record i is
+ *  given by rowlen[i]. values contains the field values of all the
+ *  records in row-major order, so that the values of record i
+ *  immediately follow those of record i-1. If records is not NULL,
+ *  the pointers to the created records are stored there.
+ *
+ *  Each value is encoded according to its type and written to a
+ *  record created with wg_create_raw_record(). The completed records
+ *  are then indexed together with wg_index_add_recs(), which sorts
+ *  the new keys of each T-tree index before inserting them.
+ *
+ *  Like the other functions modifying the database, this does not
+ *  acquire the write lock. The caller should hold the lock for the
+ *  duration of the call so that the whole batch is written at once.
+ *
+ *  returns 0 if successful
+ *  returns -1 if invalid arguments were passed
+ *  returns -2 if a record could not be created
+ *  returns -3 if a value could not be encoded
+ *  returns -4 if writing a field or indexing the record failed
+ *
+ *  On error, the records completed before the failing row remain
+ *  in the database (and are indexed). Values of the failing row that
+ *  were already encoded are freed when possible.
+ */
+wg_int wg_insert_batch(void* db, wg_int rowcount, wg_int *rowlen,
+  wg_batch_value *values, void **records) {
+  gint i, j, err = 0;
+  gint *enc = NULL, enclen = 0;
+  wg_batch_value *val = values;
+  void **recs = records;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_data_error(db,"wrong database pointer given to wg_insert_batch");
+    return -1;
+  }
+#endif
+  if(rowcount < 0 || (rowcount && (!rowlen || !values))) {
+    show_data_error(db, "invalid arguments given to wg_insert_batch");
+    return -1;
+  }
+  if(!recs && rowcount) {
+    recs = (void **) malloc(rowcount * sizeof(void *));
+    if(!recs) {
+      show_data_error(db, "cannot allocate memory for batch insert");
+      return -2;
+    }
+  }
+
+  for(i=0; i<rowcount; i++) {
+    void *rec;
+
+    if(rowlen[i] < 0) {
+      show_data_error_nr(db, "invalid record length:", rowlen[i]);
+      err = -1;
+      break;
+    }
+    if(rowlen[i] > enclen) {
+      gint *tmp = (gint *) realloc(enc, rowlen[i] * sizeof(gint));
+      if(!tmp) {
+        show_data_error(db, "cannot allocate memory for batch insert");
+        err = -2;
+        break;
+      }
+      enc = tmp;
+      enclen = rowlen[i];
+    }
+
+    /* Encode the row first, so that a failing value does not leave
+     * a half-initialized record in the database.
+     */
+    for(j=0; j<rowlen[i]; j++, val++) {
+      enc[j] = encode_batch_value(db, val);
+      if(enc[j] == WG_ILLEGAL) {
+        show_data_error_nr(db, "cannot encode batch value of type ",
+          val->type);
+        err = -3;
+        break;
+      }
+    }
+    if(!err) {
+      rec = wg_create_raw_record(db, rowlen[i]);
+      if(!rec)
+        err = -2;
+    }
+    if(err) {
+      while(--j >= 0)
+        wg_free_encoded(db, enc[j]);
+      break;
+    }
+
+    recs[i] = rec;
+    for(j=0; j<rowlen[i]; j++) {
+      /* Raw record fields are already NULL (encoded as 0) */
+      if(enc[j] && set_new_field(db, rec, j, enc[j], 0)) {
+        err = -4;
+        break;
+      }
+    }
+    if(err) {
+      i++; /* index the partially written record, too */
+      break;
+    }
+  }
+
+  if(wg_index_add_recs(db, recs, i) < -1)
+    err = -4;
+  if(enc)
+    free(enc);
+  if(recs != records)
+    free(recs);
+  return err;
+}
+
+/** Encode a single value of wg_insert_batch() input.
+ *  returns WG_ILLEGAL on failure.
+ */
+static gint encode_batch_value(void* db, wg_batch_value *val) {
+  switch(val->type) {
+    case WG_NULLTYPE:
+      return wg_encode_null(db, NULL);
+    case WG_RECORDTYPE:
+      return wg_encode_record(db, val->v.rec);
+    case WG_INTTYPE:
+      return wg_encode_int(db, val->v.i);
+    case WG_DOUBLETYPE:
+      return wg_encode_double(db, val->v.d);
+    case WG_STRTYPE:
+      if(!val->v.s)
+        return WG_ILLEGAL;
+      return wg_encode_str(db, val->v.s, val->ext);
+    case WG_XMLLITERALTYPE:
+      if(!val->v.s || !val->ext)
+        return WG_ILLEGAL;
+      return wg_encode_xmlliteral(db, val->v.s, val->ext);
+    case WG_URITYPE:
+      if(!val->v.s)
+        return WG_ILLEGAL;
+      return wg_encode_uri(db, val->v.s, val->ext);
+    case WG_BLOBTYPE:
+      if(!val->v.s)
+        return WG_ILLEGAL;
+      return wg_encode_blob(db, val->v.s, val->ext, val->len);
+    case WG_CHARTYPE:
+      return wg_encode_char(db, val->v.c);
+    case WG_FIXPOINTTYPE:
+      return wg_encode_fixpoint(db, val->v.d);
+    case WG_DATETYPE:
+      return wg_encode_date(db, (int) val->v.i);
+    case WG_TIMETYPE:
+      return wg_encode_time(db, (int) val->v.i);
+    case WG_VARTYPE:
+      return wg_encode_var(db, val->v.i);
+    default:
+      break;
+  }
+  return WG_ILLEGAL;
+}
+
 /** Delete record from database
  * returns 0 on success
  * returns -1 if the record is referenced by others and cannot be deleted.
@@ -211,6 +439,12 @@ gint wg_delete_record(void* db, void *rec) {
     show_data_error(db, "wrong database pointer given to wg_delete_record");
     return -2;
   }
+#ifdef USE_RECPTR_BITMAP
+  if (!recptr_valid(db,ptrtooffset(db,rec))) {
+    show_data_error(db, "invalid record pointer given to wg_delete_record");
+    return -2;
+  }
+#endif
 #endif
 
 #ifdef USE_BACKLINKING
@@ -227,7 +461,7 @@ gint wg_delete_record(void* db, void *rec) {
 #endif
 
   /* Remove data from index */
-  if(!is_special_record(rec)) {
+  if(!is_special_record(rec) && !is_record_updating(rec)) {
     if(wg_index_del_rec(db, rec) < -1)
       return -3; /* index error */
   }
@@ -255,32 +489,24 @@ gint wg_delete_record(void* db, void *rec) {
     if(wg_get_encoded_type(db, data) == WG_RECORDTYPE) {
 #endif
       gint *child = (gint *) wg_decode_record(db, data);
-      gint *next_offset = child + RECORD_BACKLINKS_POS;
-      gcell *old = NULL;
-
-      while(*next_offset) {
-        old = (gcell *) offsettoptr(db, *next_offset);
-        if(old->car == offset) {
-          gint old_offset = *next_offset;
-          *next_offset = old->cdr; /* remove from list chain */
-          wg_free_listcell(db, old_offset); /* free storage */
-          goto recdel_backlink_removed;
-        }
-        next_offset = &(old->cdr);
-      }
-      show_data_error(db, "Corrupt backlink chain");
-      return -3; /* backlink error */
+      if(remove_backlink(db, child, offset))
+        return -3; /* backlink error */
     }
-recdel_backlink_removed:
 #endif
 
     if(isptr(data)) free_field_encoffset(db,data);
   }
 
   /* Free the record storage */
+  if(record_table(rec))
+    wg_table_remove_record(db, rec);
+#ifdef USE_RECPTR_BITMAP
+  recptr_clearbit(db,rec);
+#endif
   wg_free_object(db,
     &(dbmemsegh(db)->datarec_area_header),
     offset);
+  WG_STAT_INC(db, WG_STAT_RECORDS_DELETED);
 
   return 0;
 }
@@ -314,7 +540,6 @@ void* wg_get_next_record(void* db, void* record) {
 void* wg_get_first_raw_record(void* db) {
   db_subarea_header* arrayadr;
   gint firstoffset;
-  void* res;
 
 #ifdef CHECK
   if (!dbcheck(db)) {
@@ -325,14 +550,32 @@ void* wg_get_first_raw_record(void* db) {
   arrayadr=&((dbmemsegh(db)->datarec_area_header).subarea_array[0]);
   firstoffset=((arrayadr[0]).alignedoffset); // do NOT skip initial "used" marker
   //printf("arrayadr %x firstoffset %d \n",(uint)arrayadr,firstoffset);
-  res=wg_get_next_raw_record(db,offsettoptr(db,firstoffset));
-  return res;
+  return next_raw_record(db,firstoffset);
 }
 
 /** Get the next record from the database
  *
  */
 void* wg_get_next_raw_record(void* db, void* record) {
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_data_error(db,"wrong database pointer given to wg_get_first_record");
+    return NULL;
+  }
+  if (isfreeobject(dbfetch(db,ptrtooffset(db,record)))) {
+    show_data_error(db,"wrong record pointer (free) given to wg_get_next_record");
+    return NULL;
+  }
+#endif
+  return next_raw_record(db,ptrtooffset(db,record));
+}
+
+/** Find the record following the object at offset.
+ *  The object may be a record or the start marker of a subarea.
+ *  Without the record pointer bitmap, the object headers of the
+ *  datarec area are walked until a used object is found.
+ */
+static void *next_raw_record(void *db, gint offset) {
   gint curoffset;
   gint head;
   db_subarea_header* arrayadr;
@@ -343,19 +586,12 @@ void* wg_get_next_raw_record(void* db, void* record) {
   gint subareaend;
   gint freemarker;
 
-  curoffset=ptrtooffset(db,record);
-  //printf("curroffset %d record %x\n",curoffset,(uint)record);
-#ifdef CHECK
-  if (!dbcheck(db)) {
-    show_data_error(db,"wrong database pointer given to wg_get_first_record");
-    return NULL;
-  }
-  head=dbfetch(db,curoffset);
-  if (isfreeobject(head)) {
-    show_data_error(db,"wrong record pointer (free) given to wg_get_next_record");
-    return NULL;
-  }
+#ifdef USE_RECPTR_BITMAP
+  if (dbmemsegh(db)->recptr_bitmap.offset)
+    return recptr_next_record(db,offset);
 #endif
+  curoffset=offset;
+  //printf("curroffset %d\n",curoffset);
   freemarker=0; //assume input pointer to used object
   head=dbfetch(db,curoffset);
   while(1) {
@@ -413,18 +649,16 @@ void* wg_get_next_raw_record(void* db, void* record) {
  */
 void *wg_get_first_parent(void* db, void *record) {
 #ifdef USE_BACKLINKING
-  gint backlink_list;
+  gint backlink_list, pos = 0;
 #ifdef CHECK
   if (!dbcheck(db)) {
     show_data_error(db,"invalid database pointer given to wg_get_first_parent");
     return NULL;
   }
 #endif
-  backlink_list = *((gint *) record + RECORD_BACKLINKS_POS);
-  if(backlink_list) {
-    gcell *cell = (gcell *) offsettoptr(db, backlink_list);
-    return (void *) offsettoptr(db, cell->car);
-  }
+  backlink_list = next_backlink(db, (gint *) record, &pos);
+  if(backlink_list)
+    return (void *) offsettoptr(db, backlink_list);
 #endif /* USE_BACKLINKING */
   return NULL; /* no parents or backlinking not enabled */
 }
@@ -442,14 +676,20 @@ void *wg_get_next_parent(void* db, void* record, void *parent) {
   }
 #endif
   backlink_list = *((gint *) record + RECORD_BACKLINKS_POS);
-  if(backlink_list) {
-    gcell *next = (gcell *) offsettoptr(db, backlink_list);
-    while(next->cdr) {
-      void *pp = (void *) offsettoptr(db, next->car);
-      next = (gcell *) offsettoptr(db, next->cdr);
-      if(pp == parent && next->car) {
-        return (void *) offsettoptr(db, next->car);
-      }
+  if((backlink_list & BACKLINK_TAGMASK) == BACKLINK_PAIR) {
+    gcell *cell = (gcell *) offsettoptr(db, backlink_list & ~BACKLINK_TAGMASK);
+    if(cell->car == ptrtooffset(db, parent) && cell->cdr != cell->car)
+      return (void *) offsettoptr(db, cell->cdr);
+  }
+  else if((backlink_list & BACKLINK_TAGMASK) == BACKLINK_SET) {
+    /* Continue the iteration from the slot of the parent */
+    gint *set = (gint *) offsettoptr(db, backlink_list & ~BACKLINK_TAGMASK);
+    gint *slot = find_backlink_slot(set, ptrtooffset(db, parent));
+    if(slot) {
+      gint pos = (slot - backlink_slot(set, 0))/2 + 1;
+      backlink_list = next_backlink(db, (gint *) record, &pos);
+      if(backlink_list)
+        return (void *) offsettoptr(db, backlink_list);
     }
   }
 #endif /* USE_BACKLINKING */
@@ -457,6 +697,226 @@ void *wg_get_next_parent(void* db, void* record, void *parent) {
 }
 
 
+/* ------------ backlink storage ------------------- */
+
+#ifdef USE_BACKLINKING
+
+/*
+ * The backlinks field of a record holds:
+ * - 0 if there are no references to the record
+ * - the offset of the parent, if there is a single reference
+ * - a list cell with the two parents in car and cdr, if there are
+ *   two references, tagged with BACKLINK_PAIR
+ * - an open addressing hash set of parents with their reference
+ *   counts, tagged with BACKLINK_SET
+ * Adding and removing a reference takes constant time on average.
+ * A set is only released when the last reference is removed.
+ */
+
+/** Add a reference from parent to the backlinks of child.
+ *  returns 0 on success
+ *  returns -1 if out of memory
+ */
+static gint add_backlink(void *db, gint *child, gint parent) {
+  db_memsegment_header *dbh = dbmemsegh(db);
+  gint *field = child + RECORD_BACKLINKS_POS;
+  gint *set, *slot;
+
+  if(!*field) {
+    *field = parent;
+    return 0;
+  }
+  else if(!(*field & BACKLINK_TAGMASK)) {
+    gint cell_offset = wg_alloc_fixlen_object(db, &(dbh->listcell_area_header));
+    gcell *cell;
+    if(!cell_offset)
+      return -1;
+    cell = (gcell *) offsettoptr(db, cell_offset);
+    cell->car = *field;
+    cell->cdr = parent;
+    *field = cell_offset | BACKLINK_PAIR;
+    return 0;
+  }
+  else if((*field & BACKLINK_TAGMASK) == BACKLINK_PAIR) {
+    /* Third reference, move the pair to a set */
+    gint cell_offset = *field & ~BACKLINK_TAGMASK;
+    gcell *cell = (gcell *) offsettoptr(db, cell_offset);
+    gint set_offset = new_backlink_set(db, BACKLINK_SET_MIN_CAP);
+    if(!set_offset)
+      return -1;
+    set = (gint *) offsettoptr(db, set_offset);
+    insert_backlink_slot(set, cell->car, 1);
+    if(cell->cdr == cell->car)
+      find_backlink_slot(set, cell->car)[1]++;
+    else
+      insert_backlink_slot(set, cell->cdr, 1);
+    wg_free_listcell(db, cell_offset);
+    *field = set_offset | BACKLINK_SET;
+  }
+  else
+    set = (gint *) offsettoptr(db, *field & ~BACKLINK_TAGMASK);
+
+  if((slot = find_backlink_slot(set, parent))) {
+    slot[1]++;
+    return 0;
+  }
+
+  /* Keep the load under 3/4. The set is rebuilt, which also
+   * drops the removed slots, and doubled if half full. */
+  if((set[BACKLINK_SET_USED_POS] + 1)*4 > set[BACKLINK_SET_CAP_POS]*3) {
+    gint capacity = set[BACKLINK_SET_CAP_POS];
+    gint set_offset, i;
+    gint *newset;
+    if((set[BACKLINK_SET_COUNT_POS] + 1)*2 > capacity)
+      capacity *= 2;
+    set_offset = new_backlink_set(db, capacity);
+    if(!set_offset)
+      return -1;
+    newset = (gint *) offsettoptr(db, set_offset);
+    for(i=0; i<set[BACKLINK_SET_CAP_POS]; i++) {
+      slot = backlink_slot(set, i);
+      if(slot[0] > BACKLINK_REMOVED)
+        insert_backlink_slot(newset, slot[0], slot[1]);
+    }
+    wg_free_object(db, &(dbh->longstr_area_header),
+      *field & ~BACKLINK_TAGMASK);
+    *field = set_offset | BACKLINK_SET;
+    set = newset;
+  }
+  insert_backlink_slot(set, parent, 1);
+  return 0;
+}
+
+/** Remove a reference from parent from the backlinks of child.
+ *  returns 0 on success
+ *  returns -1 if the reference was not found
+ */
+static gint remove_backlink(void *db, gint *child, gint parent) {
+  db_memsegment_header *dbh = dbmemsegh(db);
+  gint *field = child + RECORD_BACKLINKS_POS;
+
+  if(*field == parent) {
+    *field = 0;
+    return 0;
+  }
+  else if((*field & BACKLINK_TAGMASK) == BACKLINK_PAIR) {
+    gint cell_offset = *field & ~BACKLINK_TAGMASK;
+    gcell *cell = (gcell *) offsettoptr(db, cell_offset);
+    if(cell->car == parent || cell->cdr == parent) {
+      *field = (cell->car == parent ? cell->cdr : cell->car);
+      wg_free_listcell(db, cell_offset);
+      return 0;
+    }
+  }
+  else if((*field & BACKLINK_TAGMASK) == BACKLINK_SET) {
+    gint *set = (gint *) offsettoptr(db, *field & ~BACKLINK_TAGMASK);
+    gint *slot = find_backlink_slot(set, parent);
+    if(slot) {
+      if(--slot[1] == 0) {
+        slot[0] = BACKLINK_REMOVED;
+        if(--set[BACKLINK_SET_COUNT_POS] == 0) {
+          wg_free_object(db, &(dbh->longstr_area_header),
+            *field & ~BACKLINK_TAGMASK);
+          *field = 0;
+        }
+      }
+      return 0;
+    }
+  }
+  show_data_error(db, "Corrupt backlink chain");
+  return -1;
+}
+
+/** Iterate over the parents of a record.
+ *  *pos holds the position of the iteration and should be 0 to
+ *  get the first parent. Each parent is returned once, regardless
+ *  of the number of references.
+ *  returns the offset of the next parent, 0 if there are no more
+ */
+static gint next_backlink(void *db, gint *record, gint *pos) {
+  gint field = *(record + RECORD_BACKLINKS_POS);
+
+  if(!(field & BACKLINK_TAGMASK)) {
+    if(*pos)
+      return 0;
+    *pos = 1;
+    return field;
+  }
+  else if((field & BACKLINK_TAGMASK) == BACKLINK_PAIR) {
+    gcell *cell = (gcell *) offsettoptr(db, field & ~BACKLINK_TAGMASK);
+    (*pos)++;
+    if(*pos == 1)
+      return cell->car;
+    if(*pos == 2 && cell->cdr != cell->car)
+      return cell->cdr;
+    return 0;
+  }
+  else {
+    gint *set = (gint *) offsettoptr(db, field & ~BACKLINK_TAGMASK);
+    while(*pos < set[BACKLINK_SET_CAP_POS]) {
+      gint *slot = backlink_slot(set, (*pos)++);
+      if(slot[0] > BACKLINK_REMOVED)
+        return slot[0];
+    }
+    return 0;
+  }
+}
+
+/** Find the slot of a parent in a backlink set.
+ *  returns a pointer to the slot, NULL if not found
+ */
+static gint *find_backlink_slot(gint *set, gint parent) {
+  gint mask = set[BACKLINK_SET_CAP_POS] - 1;
+  gint i = backlink_hash(parent, set[BACKLINK_SET_CAP_POS]);
+
+  for(;;) {
+    gint *slot = backlink_slot(set, i);
+    if(slot[0] == parent)
+      return slot;
+    if(!slot[0])
+      return NULL;
+    i = (i + 1) & mask;
+  }
+}
+
+/** Insert a parent that is not in the set yet.
+ *  The set must have a free slot.
+ */
+static void insert_backlink_slot(gint *set, gint parent, gint refs) {
+  gint mask = set[BACKLINK_SET_CAP_POS] - 1;
+  gint i = backlink_hash(parent, set[BACKLINK_SET_CAP_POS]);
+  gint *slot;
+
+  for(;;) {
+    slot = backlink_slot(set, i);
+    if(!slot[0])
+      break;
+    i = (i + 1) & mask;
+  }
+  slot[0] = parent;
+  slot[1] = refs;
+  set[BACKLINK_SET_COUNT_POS]++;
+  set[BACKLINK_SET_USED_POS]++;
+}
+
+/** Allocate an empty backlink set.
+ *  returns the offset of the set, 0 if out of memory
+ */
+static gint new_backlink_set(void *db, gint capacity) {
+  gint offset = wg_alloc_gints(db, &(dbmemsegh(db)->longstr_area_header),
+    BACKLINK_SET_HEADER_GINTS + 2*capacity);
+  if(offset) {
+    gint *set = (gint *) offsettoptr(db, offset);
+    memset(set + 1, 0,
+      (BACKLINK_SET_HEADER_GINTS - 1 + 2*capacity) * sizeof(gint));
+    set[BACKLINK_SET_CAP_POS] = capacity;
+  }
+  return offset;
+}
+
+#endif /* USE_BACKLINKING */
+
+
 /* ------------ backlink chain recursive functions ------------------- */
 
 #ifdef USE_BACKLINKING
@@ -473,7 +933,8 @@ static gint remove_backlink_index_entries(void *db, gint *record,
   gint col, length, err = 0;
   db_memsegment_header *dbh = dbmemsegh(db);
 
-  if(!is_special_record(record)) {
+  /* Open records are not in the indexes */
+  if(!is_special_record(record) && !is_record_updating(record)) {
     /* Find all fields in the record that match value (which is actually
      * a reference to a child record in encoded form) and remove it from
      * indexes. It will be recreated in the indexes by wg_set_field() later.
@@ -492,6 +953,11 @@ static gint remove_backlink_index_entries(void *db, gint *record,
           if(wg_index_del_field(db, record, col) < -1)
             return -1;
         }
+        if(dbh->index_control_area_header.path_index_list &&\
+          is_schema_document(record)) {
+          if(wg_index_del_doc_field(db, record, col) < -1)
+            return -1;
+        }
       }
     }
   }
@@ -500,19 +966,13 @@ static gint remove_backlink_index_entries(void *db, gint *record,
    * of this record.
    */
   if(depth > 0) {
-    gint backlink_list = *(record + RECORD_BACKLINKS_POS);
-    if(backlink_list) {
-      gcell *next = (gcell *) offsettoptr(db, backlink_list);
-      for(;;) {
-        err = remove_backlink_index_entries(db,
-          (gint *) offsettoptr(db, next->car),
-          wg_encode_record(db, record), depth-1);
-        if(err)
-          return err;
-        if(!next->cdr)
-          break;
-        next = (gcell *) offsettoptr(db, next->cdr);
-      }
+    gint pos = 0, parent;
+    while((parent = next_backlink(db, record, &pos))) {
+      err = remove_backlink_index_entries(db,
+        (gint *) offsettoptr(db, parent),
+        wg_encode_record(db, record), depth-1);
+      if(err)
+        return err;
     }
   }
 
@@ -531,7 +991,8 @@ static gint restore_backlink_index_entries(void *db, gint *record,
   gint col, length, err = 0;
   db_memsegment_header *dbh = dbmemsegh(db);
 
-  if(!is_special_record(record)) {
+  /* Open records are not in the indexes */
+  if(!is_special_record(record) && !is_record_updating(record)) {
     /* Find all fields in the record that match value (which is actually
      * a reference to a child record in encoded form) and add it back to
      * indexes.
@@ -546,25 +1007,24 @@ static gint restore_backlink_index_entries(void *db, gint *record,
           if(wg_index_add_field(db, record, col) < -1)
             return -1;
         }
+        if(dbh->index_control_area_header.path_index_list &&\
+          is_schema_document(record)) {
+          if(wg_index_add_doc_field(db, record, col) < -1)
+            return -1;
+        }
       }
     }
   }
 
   /* Continue to the parents until depth==0 */
   if(depth > 0) {
-    gint backlink_list = *(record + RECORD_BACKLINKS_POS);
-    if(backlink_list) {
-      gcell *next = (gcell *) offsettoptr(db, backlink_list);
-      for(;;) {
-        err = restore_backlink_index_entries(db,
-          (gint *) offsettoptr(db, next->car),
-          wg_encode_record(db, record), depth-1);
-        if(err)
-          return err;
-        if(!next->cdr)
-          break;
-        next = (gcell *) offsettoptr(db, next->cdr);
-      }
+    gint pos = 0, parent;
+    while((parent = next_backlink(db, record, &pos))) {
+      err = restore_backlink_index_entries(db,
+        (gint *) offsettoptr(db, parent),
+        wg_encode_record(db, record), depth-1);
+      if(err)
+        return err;
     }
   }
 
@@ -611,6 +1071,7 @@ wg_int wg_set_field(void* db, void* record, wg_int fieldnr, wg_int data) {
   gint* fieldadr;
   gint fielddata;
   gint* strptr;
+  int update_index;
 #ifdef USE_BACKLINKING
   gint backlink_list;           /** start of backlinks for this record */
   gint rec_enc = WG_ILLEGAL;    /** this record as encoded value. */
@@ -636,19 +1097,31 @@ wg_int wg_set_field(void* db, void* record, wg_int fieldnr, wg_int data) {
   fieldadr=((gint*)record)+RECORD_HEADER_GINTS+fieldnr;
   fielddata=*fieldadr;
 
+  /* Records opened with wg_open_record_update() are indexed
+   * when they are closed.
+   */
+  update_index = !is_special_record(record) && !is_record_updating(record);
+
   /* Update index(es) while the old value is still in the db */
 #ifdef USE_INDEX_TEMPLATE
-  if(!is_special_record(record) && fieldnr<=MAX_INDEXED_FIELDNR &&\
+  if(update_index && fieldnr<=MAX_INDEXED_FIELDNR &&\
     (dbh->index_control_area_header.index_table[fieldnr] ||\
      dbh->index_control_area_header.index_template_table[fieldnr])) {
 #else
-  if(!is_special_record(record) && fieldnr<=MAX_INDEXED_FIELDNR &&\
+  if(update_index && fieldnr<=MAX_INDEXED_FIELDNR &&\
     dbh->index_control_area_header.index_table[fieldnr]) {
 #endif
     if(wg_index_del_field(db, record, fieldnr) < -1)
       return -3; /* index error */
   }
 
+  /* JSON path indexes hold the pairs under the fields of documents */
+  if(update_index && dbh->index_control_area_header.path_index_list &&\
+    is_schema_document(record)) {
+    if(wg_index_del_doc_field(db, record, fieldnr) < -1)
+      return -3;
+  }
+
   /* If there are backlinks, go up the chain and remove the reference
    * to this record from all indexes (updating a field in the record
    * causes the value of the record to change). Note that we only go
@@ -656,21 +1129,18 @@ wg_int wg_set_field(void* db, void* record, wg_int fieldnr, wg_int data) {
    * hierarchy are not affected.
    */
 #if defined(USE_BACKLINKING) && (WG_COMPARE_REC_DEPTH > 0)
-  backlink_list = *((gint *) record + RECORD_BACKLINKS_POS);
+  backlink_list = is_record_updating(record) ? 0 :\
+    *((gint *) record + RECORD_BACKLINKS_POS);
   if(backlink_list) {
-    gint err;
-    gcell *next = (gcell *) offsettoptr(db, backlink_list);
+    gint err, pos = 0, parent;
     rec_enc = wg_encode_record(db, record);
-    for(;;) {
+    while((parent = next_backlink(db, (gint *) record, &pos))) {
       err = remove_backlink_index_entries(db,
-        (gint *) offsettoptr(db, next->car),
+        (gint *) offsettoptr(db, parent),
         rec_enc, WG_COMPARE_REC_DEPTH-1);
       if(err) {
         return -4; /* override the error code, for now. */
       }
-      if(!next->cdr)
-        break;
-      next = (gcell *) offsettoptr(db, next->cdr);
     }
   }
 #endif
@@ -699,24 +1169,9 @@ wg_int wg_set_field(void* db, void* record, wg_int fieldnr, wg_int data) {
   if(wg_get_encoded_type(db, fielddata) == WG_RECORDTYPE) {
 #endif
     gint *rec = (gint *) wg_decode_record(db, fielddata);
-    gint *next_offset = rec + RECORD_BACKLINKS_POS;
-    gint parent_offset = ptrtooffset(db, record);
-    gcell *old = NULL;
-
-    while(*next_offset) {
-      old = (gcell *) offsettoptr(db, *next_offset);
-      if(old->car == parent_offset) {
-        gint old_offset = *next_offset;
-        *next_offset = old->cdr; /* remove from list chain */
-        wg_free_listcell(db, old_offset); /* free storage */
-        goto setfld_backlink_removed;
-      }
-      next_offset = &(old->cdr);
-    }
-    show_data_error(db, "Corrupt backlink chain");
-    return -4; /* backlink error */
+    if(remove_backlink(db, rec, ptrtooffset(db, record)))
+      return -4; /* backlink error */
   }
-setfld_backlink_removed:
 #endif
 
   //printf("wg_set_field adr %d offset %d\n",fieldadr,ptrtooffset(db,fieldadr));
@@ -734,19 +1189,26 @@ setfld_backlink_removed:
     strptr = (gint *) offsettoptr(db,decode_longstr_offset(data));
     ++(*(strptr+LONGSTR_REFCOUNT_POS));
   }
+  if(record_column_slot(record))
+    wg_table_set_column(db, record, fieldnr, data);
 
   /* Update index after new value is written */
 #ifdef USE_INDEX_TEMPLATE
-  if(!is_special_record(record) && fieldnr<=MAX_INDEXED_FIELDNR &&\
+  if(update_index && fieldnr<=MAX_INDEXED_FIELDNR &&\
     (dbh->index_control_area_header.index_table[fieldnr] ||\
      dbh->index_control_area_header.index_template_table[fieldnr])) {
 #else
-  if(!is_special_record(record) && fieldnr<=MAX_INDEXED_FIELDNR &&\
+  if(update_index && fieldnr<=MAX_INDEXED_FIELDNR &&\
     dbh->index_control_area_header.index_table[fieldnr]) {
 #endif
     if(wg_index_add_field(db, record, fieldnr) < -1)
       return -3;
   }
+  if(update_index && dbh->index_control_area_header.path_index_list &&\
+    is_schema_document(record)) {
+    if(wg_index_add_doc_field(db, record, fieldnr) < -1)
+      return -3;
+  }
 
 #ifdef USE_BACKLINKING
   /* Is the new field value a record pointer? If so, add a backlink */
@@ -757,34 +1219,24 @@ setfld_backlink_removed:
   if(wg_get_encoded_type(db, data) == WG_RECORDTYPE) {
 #endif
     gint *rec = (gint *) wg_decode_record(db, data);
-    gint *next_offset = rec + RECORD_BACKLINKS_POS;
-    gint new_offset = wg_alloc_fixlen_object(db,
-      &(dbmemsegh(db)->listcell_area_header));
-    gcell *new_cell = (gcell *) offsettoptr(db, new_offset);
-
-    while(*next_offset)
-      next_offset = &(((gcell *) offsettoptr(db, *next_offset))->cdr);
-    new_cell->car = ptrtooffset(db, record);
-    new_cell->cdr = 0;
-    *next_offset = new_offset;
+    if(add_backlink(db, rec, ptrtooffset(db, record))) {
+      show_data_error(db, "Failed to allocate backlink storage");
+      return -4; /* backlink error */
+    }
   }
 #endif
 
 #if defined(USE_BACKLINKING) && (WG_COMPARE_REC_DEPTH > 0)
   /* Create new entries in indexes in all referring records */
   if(backlink_list) {
-    gint err;
-    gcell *next = (gcell *) offsettoptr(db, backlink_list);
-    for(;;) {
+    gint err, pos = 0, parent;
+    while((parent = next_backlink(db, (gint *) record, &pos))) {
       err = restore_backlink_index_entries(db,
-        (gint *) offsettoptr(db, next->car),
+        (gint *) offsettoptr(db, parent),
         rec_enc, WG_COMPARE_REC_DEPTH-1);
       if(err) {
         return -4;
       }
-      if(!next->cdr)
-        break;
-      next = (gcell *) offsettoptr(db, next->cdr);
     }
   }
 #endif
@@ -812,6 +1264,17 @@ setfld_backlink_removed:
  *  returns -6 for journal error
  */
 wg_int wg_set_new_field(void* db, void* record, wg_int fieldnr, wg_int data) {
+  return set_new_field(db, record, fieldnr, data, 1);
+}
+
+/** Write contents of a new field, optionally skipping index update.
+ *
+ *  Implements wg_set_new_field(). If update_index is 0, the caller
+ *  is responsible for indexing the record later with wg_index_add_rec().
+ *  Return values are the same as for wg_set_new_field().
+ */
+static gint set_new_field(void* db, void* record, gint fieldnr, gint data,
+  int update_index) {
   gint* fieldadr;
   gint* strptr;
 #ifdef USE_BACKLINKING
@@ -864,19 +1327,31 @@ wg_int wg_set_new_field(void* db, void* record, wg_int fieldnr, wg_int data) {
     strptr = (gint *) offsettoptr(db,decode_longstr_offset(data));
     ++(*(strptr+LONGSTR_REFCOUNT_POS));
   }
+  if(record_column_slot(record))
+    wg_table_set_column(db, record, fieldnr, data);
 
   /* Update index after new value is written */
+  if(is_record_updating(record))
+    update_index = 0;
 #ifdef USE_INDEX_TEMPLATE
-  if(!is_special_record(record) && fieldnr<=MAX_INDEXED_FIELDNR &&\
+  if(update_index && !is_special_record(record) &&\
+    fieldnr<=MAX_INDEXED_FIELDNR &&\
     (dbh->index_control_area_header.index_table[fieldnr] ||\
      dbh->index_control_area_header.index_template_table[fieldnr])) {
 #else
-  if(!is_special_record(record) && fieldnr<=MAX_INDEXED_FIELDNR &&\
+  if(update_index && !is_special_record(record) &&\
+    fieldnr<=MAX_INDEXED_FIELDNR &&\
     dbh->index_control_area_header.index_table[fieldnr]) {
 #endif
     if(wg_index_add_field(db, record, fieldnr) < -1)
       return -3;
   }
+  if(update_index && !is_special_record(record) &&\
+    dbh->index_control_area_header.path_index_list &&\
+    is_schema_document(record)) {
+    if(wg_index_add_doc_field(db, record, fieldnr) < -1)
+      return -3;
+  }
 
 #ifdef USE_BACKLINKING
   /* Is the new field value a record pointer? If so, add a backlink */
@@ -887,16 +1362,10 @@ wg_int wg_set_new_field(void* db, void* record, wg_int fieldnr, wg_int data) {
   if(wg_get_encoded_type(db, data) == WG_RECORDTYPE) {
 #endif
     gint *rec = (gint *) wg_decode_record(db, data);
-    gint *next_offset = rec + RECORD_BACKLINKS_POS;
-    gint new_offset = wg_alloc_fixlen_object(db,
-      &(dbmemsegh(db)->listcell_area_header));
-    gcell *new_cell = (gcell *) offsettoptr(db, new_offset);
-
-    while(*next_offset)
-      next_offset = &(((gcell *) offsettoptr(db, *next_offset))->cdr);
-    new_cell->car = ptrtooffset(db, record);
-    new_cell->cdr = 0;
-    *next_offset = new_offset;
+    if(add_backlink(db, rec, ptrtooffset(db, record))) {
+      show_data_error(db, "Failed to allocate backlink storage");
+      return -4; /* backlink error */
+    }
   }
 #endif
 
@@ -905,21 +1374,131 @@ wg_int wg_set_new_field(void* db, void* record, wg_int fieldnr, wg_int data) {
    * usage scenario would be that the record is also new, so that
    * there are no backlinks, however this is not guaranteed.
    */
-  backlink_list = *((gint *) record + RECORD_BACKLINKS_POS);
+  backlink_list = is_record_updating(record) ? 0 :\
+    *((gint *) record + RECORD_BACKLINKS_POS);
   if(backlink_list) {
-    gint err;
-    gcell *next = (gcell *) offsettoptr(db, backlink_list);
+    gint err, pos = 0, parent;
     gint rec_enc = wg_encode_record(db, record);
-    for(;;) {
+    while((parent = next_backlink(db, (gint *) record, &pos))) {
       err = restore_backlink_index_entries(db,
-        (gint *) offsettoptr(db, next->car),
+        (gint *) offsettoptr(db, parent),
         rec_enc, WG_COMPARE_REC_DEPTH-1);
       if(err) {
         return -4;
       }
-      if(!next->cdr)
-        break;
-      next = (gcell *) offsettoptr(db, next->cdr);
+    }
+  }
+#endif
+
+  return 0;
+}
+
+/** Open a record for updating several fields.
+ *
+ *  The record is removed from the indexes, together with the index
+ *  entries of the records referring to it. Subsequent wg_set_field()
+ *  calls on the record skip the index maintenance, which is done
+ *  once when the record is closed with wg_close_record_update() or
+ *  wg_close_record_updates().
+ *
+ *  While the record is open, it cannot be found using the indexes.
+ *  It is up to the programmer to ensure that the records linked to
+ *  it (referring to it or referred to by it, directly or through other
+ *  records) are not modified or opened before it is closed.
+ *
+ *  returns 0 if successful
+ *  returns -1 if invalid db pointer passed
+ *  returns -2 if invalid record passed or the record is already open
+ *  returns -3 for fatal index error
+ *  returns -4 for backlink-related error
+ */
+wg_int wg_open_record_update(void* db, void* record) {
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_data_error(db,"wrong database pointer given to wg_open_record_update");
+    return -1;
+  }
+#endif
+  if(!record || is_special_record(record) || is_record_updating(record)) {
+    show_data_error(db,"invalid record given to wg_open_record_update");
+    return -2;
+  }
+
+  if(wg_index_del_rec(db, record) < -1)
+    return -3; /* index error */
+
+#if defined(USE_BACKLINKING) && (WG_COMPARE_REC_DEPTH > 0)
+  if(*((gint *) record + RECORD_BACKLINKS_POS)) {
+    gint pos = 0, parent;
+    gint rec_enc = wg_encode_record(db, record);
+    while((parent = next_backlink(db, (gint *) record, &pos))) {
+      if(remove_backlink_index_entries(db,
+        (gint *) offsettoptr(db, parent), rec_enc, WG_COMPARE_REC_DEPTH-1))
+        return -4;
+    }
+  }
+#endif
+
+  *((gint *) record + RECORD_META_POS) |= RECORD_META_UPDATE;
+  return 0;
+}
+
+/** Close a record opened with wg_open_record_update().
+ *
+ *  The record is added back to the indexes.
+ *  Return values are the same as for wg_close_record_updates().
+ */
+wg_int wg_close_record_update(void* db, void* record) {
+  return wg_close_record_updates(db, &record, 1);
+}
+
+/** Close several records opened with wg_open_record_update().
+ *
+ *  The records are added to each index in a single batch, in the
+ *  order of the index key (see wg_index_add_recs()). This is
+ *  faster than closing the records one by one when many records
+ *  were updated. Each record may appear in the array only once.
+ *
+ *  returns 0 if successful
+ *  returns -1 if invalid db pointer passed
+ *  returns -2 if invalid records were passed
+ *  returns -3 for fatal index error
+ *  returns -4 for backlink-related error
+ */
+wg_int wg_close_record_updates(void* db, void** records, wg_int count) {
+  gint i;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_data_error(db,"wrong database pointer given to wg_close_record_updates");
+    return -1;
+  }
+#endif
+  if(count < 0 || (count && !records)) {
+    show_data_error(db,"invalid arguments given to wg_close_record_updates");
+    return -2;
+  }
+  for(i=0; i<count; i++) {
+    if(!records[i] || !is_record_updating(records[i])) {
+      show_data_error(db,"record is not open for update");
+      return -2;
+    }
+  }
+
+  for(i=0; i<count; i++)
+    *((gint *) records[i] + RECORD_META_POS) &= ~RECORD_META_UPDATE;
+  if(wg_index_add_recs(db, records, count) < -1)
+    return -3; /* index error */
+
+#if defined(USE_BACKLINKING) && (WG_COMPARE_REC_DEPTH > 0)
+  /* Re-create the index entries of the referring records */
+  for(i=0; i<count; i++) {
+    gint pos = 0, parent;
+    gint rec_enc = wg_encode_record(db, records[i]);
+    while((parent = next_backlink(db, (gint *) records[i], &pos))) {
+      if(restore_backlink_index_entries(db,
+        (gint *) offsettoptr(db, parent), rec_enc, WG_COMPARE_REC_DEPTH-1))
+        return -4;
     }
   }
 #endif
@@ -990,7 +1569,7 @@ wg_int wg_set_rec_field(void* db, void* record, wg_int fieldnr, void* data) {
  *  returns -10 if new value non-immediate
  *  returns -11 if old value non-immediate
  *  returns -12 if cannot fetch old data
- *  returns -13 if the field has an index
+ *  returns -13 if the field has an index or a column projection
  *  returns -14 if logging is active
  *  returns -15 if the field value has been changed from old_data
  *  may return other field-setting error codes from wg_set_new_field
@@ -1020,6 +1599,11 @@ wg_int wg_update_atomic_field(void* db, void* record, wg_int fieldnr, wg_int dat
 #endif
     return -13;
   }
+  // projected columns are not updated atomically either
+  if(record_column_slot(record) &&\
+    wg_table_column_pos(db, record_table(record), fieldnr) >= 0) {
+    return -13;
+  }
   // check that no logging is used
 #ifdef USE_DBLOG
   if(dbh->logging.active) {
@@ -1370,6 +1954,9 @@ wg_int wg_get_encoded_type(void* db, wg_int data) {
       case TINYSTRBITS: return WG_STRTYPE;
       case VARBITS: return WG_VARTYPE;
       case ANONCONSTBITS: return WG_ANONCONSTTYPE;
+#ifdef USE_INLINE_DOUBLE
+      case INLINEDOUBLEBITS: return WG_DOUBLETYPE;
+#endif
       default: return -1;
     }
   }
@@ -1549,6 +2136,11 @@ wg_int wg_encode_double(void* db, double data) {
     return WG_ILLEGAL;
   }
 #endif
+#ifdef USE_INLINE_DOUBLE
+  /* No storage is allocated, so logging is skipped like with small ints */
+  offset=wg_encode_inline_double(data);
+  if (offset) return offset;
+#endif
 #ifdef USE_DBLOG
   /* Log before allocating. */
   if(dbmemsegh(db)->logging.active) {
@@ -1589,11 +2181,34 @@ double wg_decode_double(void* db, wg_int data) {
   }
 #endif
   if (isfulldouble(data)) return *((double*)(offsettoptr(db,decode_fulldouble_offset(data))));
+#ifdef USE_INLINE_DOUBLE
+  if (isinlinedouble(data)) {
+    union { double d; gint i; } u;
+    u.i = data & ~INLINEDOUBLEMASK;
+    return u.d;
+  }
+#endif
   show_data_error_nr(db,"data given to wg_decode_double is not an encoded double: ",data);
   return 0;
 }
 
 
+#ifdef USE_INLINE_DOUBLE
+/** Encode a double as an immediate value.
+ *  returns the encoded value if the lowest byte of the double
+ *  is zero, so that it can be replaced by the tag without losing
+ *  precision.
+ *  returns 0 if the value needs to be stored in a doubleword.
+ */
+gint wg_encode_inline_double(double data) {
+  union { double d; gint i; } u;
+  u.d = data;
+  if (u.i & INLINEDOUBLEMASK) return 0;
+  return u.i | INLINEDOUBLEBITS;
+}
+#endif
+
+
 wg_int wg_encode_fixpoint(void* db, double data) {
 
 #ifdef CHECK
@@ -2476,14 +3091,17 @@ Universal funs for string, xmlliteral, uri, blob
 gint wg_encode_unistr(void* db, char* str, char* lang, gint type) {
   gint offset;
   gint len;
-#ifdef USETINYSTR
-  gint res;
-#endif
   char* dptr;
   char* sptr;
   char* dendptr;
 
   len=(gint)(strlen(str));
+#ifdef USETINYSTR
+  /* No storage is allocated, so logging is skipped like with small ints */
+  if (lang==NULL && type==WG_STRTYPE && fits_tinystr(len)) {
+    return wg_encode_tinystr(str,len);
+  }
+#endif
 #ifdef USE_DBLOG
   /* Log before allocating. */
   if(dbmemsegh(db)->logging.active) {
@@ -2492,22 +3110,6 @@ gint wg_encode_unistr(void* db, char* str, char* lang, gint type) {
     if(wg_log_encode(db, type, str, len, lang, extlen))
       return WG_ILLEGAL;
   }
-#endif
-#ifdef USETINYSTR
-/* XXX: add tinystr support to logging */
-#ifdef USE_DBLOG
-#error USE_DBLOG and USETINYSTR are incompatible
-#endif
-  if (lang==NULL && type==WG_STRTYPE && len<(sizeof(gint)-1)) {
-    res=TINYSTRBITS; // first zero the field and set last byte to mask
-    if (LITTLEENDIAN) {
-      dptr=((char*)(&res))+1; // type bits stored in lowest addressed byte
-    } else {
-      dptr=((char*)(&res));  // type bits stored in highest addressed byte
-    }
-    memcpy(dptr,str,len+1);
-    return res;
-  }
 #endif
   if (lang==NULL && type==WG_STRTYPE && len<SHORTSTR_SIZE) {
     // short string, store in a fixlen area
@@ -2564,13 +3166,33 @@ gint wg_encode_unistr(void* db, char* str, char* lang, gint type) {
 gint wg_encode_uniblob(void* db, char* str, char* lang, gint type, gint len) {
   gint offset;
 
+#ifdef USE_DBLOG
+  /* Log before allocating, with the length as the data may contain zeros */
+  if(dbmemsegh(db)->logging.active) {
+    gint extlen = 0;
+    if(lang) extlen = strlen(lang);
+    if(wg_log_encode(db, type, str, len, lang, extlen))
+      return WG_ILLEGAL;
+  }
+#endif
   if (0) {
   } else {
     offset=find_create_longstr(db,str,lang,type,len);
     if (!offset) {
       show_data_error_nr(db,"cannot create a blob of size ",len);
+#ifdef USE_DBLOG
+      if(dbmemsegh(db)->logging.active) {
+        wg_log_encval(db, WG_ILLEGAL);
+      }
+#endif
       return WG_ILLEGAL;
     }
+#ifdef USE_DBLOG
+    if(dbmemsegh(db)->logging.active) {
+      if(wg_log_encval(db, encode_longstr_offset(offset)))
+        return WG_ILLEGAL; /* journal error */
+    }
+#endif
     return encode_longstr_offset(offset);
   }
 }
@@ -2671,13 +3293,8 @@ char* wg_decode_unistr(void* db, gint data, gint type) {
   gint* objptr;
   char* dataptr;
 #ifdef USETINYSTR
-  if (type==WG_STRTYPE && istinystr(data)) {
-    if (LITTLEENDIAN) {
-      dataptr=((char*)(&data))+1; // type bits stored in lowest addressed byte
-    } else {
-      dataptr=((char*)(&data));  // type bits stored in highest addressed byte
-    }
-    return dataptr;
+  if (istinystr(data)) {
+    return tinystr_buffer(data);
   }
 #endif
   if (isshortstr(data)) {
@@ -2701,7 +3318,7 @@ char* wg_decode_unistr_lang(void* db, gint data, gint type) {
   char* res;
 
 #ifdef USETINYSTR
-  if (type==WG_STRTYPE && istinystr(data)) {
+  if (istinystr(data)) {
     return NULL;
   }
 #endif
@@ -2733,13 +3350,9 @@ gint wg_decode_unistr_len(void* db, gint data, gint type) {
   gint strsize;
 
 #ifdef USETINYSTR
-  if (type==WG_STRTYPE && istinystr(data)) {
-    if (LITTLEENDIAN) {
-      dataptr=((char*)(&data))+1; // type bits stored in lowest addressed byte
-    } else {
-      dataptr=((char*)(&data));  // type bits stored in highest addressed byte
-    }
-    strsize=strlen(dataptr);
+  if (istinystr(data)) {
+    char buf[sizeof(gint)+1];
+    strsize=strlen(wg_decode_tinystr(data,buf));
     return strsize;
   }
 #endif
@@ -2775,20 +3388,13 @@ gint wg_decode_unistr_copy(void* db, gint data, char* strbuf, gint buflen, gint
   gint strsize;
 
 #ifdef USETINYSTR
-  if (type==WG_STRTYPE && istinystr(data)) {
-    if (LITTLEENDIAN) {
-      dataptr=((char*)(&data))+1; // type bits stored in lowest addressed byte
-    } else {
-      dataptr=((char*)(&data));  // type bits stored in highest addressed byte
-    }
+  if (istinystr(data)) {
+    char buf[sizeof(gint)+1];
+    dataptr=wg_decode_tinystr(data,buf);
     strsize=strlen(dataptr)+1;
-    if (strsize>=sizeof(gint)) {
-      show_data_error_nr(db,"wrong data stored as tinystr, impossible length:",strsize);
-      return 0;
-    }
     if (buflen<strsize) {
       show_data_error_nr(db,"insufficient buffer length given to wg_decode_unistr_copy:",buflen);
-      return 0;
+      return -1;
     }
     memcpy(strbuf,dataptr,strsize);
     //printf("tinystr was read to strbuf '%s'\n",strbuf);
@@ -2875,6 +3481,46 @@ gint wg_decode_unistr_lang_copy(void* db, gint data, char* strbuf, gint buflen,
   return len;
 }
 
+#ifdef USETINYSTR
+
+/** Encode a string of up to sizeof(gint)-1 bytes as an immediate value.
+ *  The bytes are stored above the tag byte in string order, so
+ *  the encoding does not depend on the byte order of the platform.
+ *  Caller must check the length with fits_tinystr().
+ */
+gint wg_encode_tinystr(char* str, gint len) {
+  size_t res=TINYSTRBITS;
+  gint i;
+  for(i=0; i<len; i++) {
+    res|=((size_t)((unsigned char) str[i]))<<(TINYSTRSHFT*(i+1));
+  }
+  return (gint) res;
+}
+
+/** Decode a tiny string into buf (at least sizeof(gint)+1 bytes).
+ *  returns buf
+ */
+char* wg_decode_tinystr(gint data, char* buf) {
+  size_t bits=((size_t) data)>>TINYSTRSHFT;
+  size_t i;
+  for(i=0; i<sizeof(gint)-1 && (bits&TINYSTRMASK); i++) {
+    buf[i]=(char)(bits&TINYSTRMASK);
+    bits>>=TINYSTRSHFT;
+  }
+  buf[i]=0;
+  return buf;
+}
+
+/** Decode a tiny string into the next rotating buffer.
+ */
+static char *tinystr_buffer(gint data) {
+  char *buf=tinystr_buf[tinystr_next];
+  tinystr_next=(tinystr_next+1)%TINYSTR_BUFFERS;
+  return wg_decode_tinystr(data,buf);
+}
+
+#endif /* USETINYSTR */
+
 
 
 
@@ -3090,74 +3736,83 @@ void *wg_get_rec_owner(void *db, void *rec) {
 
 /*
  We assume records are aligned at minimum each 8 bytes.
- Each possible record offset is assigned one bit in a bitmap.
- Consider
- offsets:   0,8,16,24,32,40,48,56 | 64,72,80,88,...
- addr:            byte 0          |     byte 1 ...
- shft:      0 1  2  3  4  5  6  7 | 0  1   2  3  ...
+ Each possible record offset is assigned one bit in a bitmap
+ made of wg_uint words. With 64-bit words:
+ offsets:   0,8,16,...,504 | 512,520,...
+ word:          word 0     |  word 1 ...
+ bit:       0 1  2 ... 63  |  0   1  ...
 */
 
+#ifdef USE_RECPTR_BITMAP
+
 /** Check both that db and record pointer ptr are correct.
 
  Uses the record pointer bitmap.
-  
+
+ returns 0 if ptr points to a record
+ returns a negative value otherwise
+
 */
 
-#ifdef USE_RECPTR_BITMAP /* currently disabled, as nothing is updating
-                          * the bitmap. Re-enable as needed.
-                          */
 gint wg_recptr_check(void *db,void *ptr) {
-  gint addr;
-  int shft;
-  unsigned char byte;
   db_memsegment_header* dbh = dbmemsegh(db);
   gint offset=ptrtooffset(db,ptr);
-  
+
   if (!dbcheckh(dbh)) return -1; // not a correct db
   if (offset<=0 || offset>=dbh->size) return -2; // ptr out of area
   if (offset%8) return -3; // ptr not correctly aligned
-  addr=offset/64; // divide by alignment
-  shft=(offset%64)/8; // bit position in byte
   if (!(dbh->recptr_bitmap.offset)) return -4; // bitmap not allocated
-  byte=*((char*)(offsettoptr(db,dbh->recptr_bitmap.offset+addr)));
-  if (byte & (1<<shft)) return 0;
+  if (recptr_testbit(db,offset)) return 0;
   else return -5; // no record at this position
 }
 
+/** Quick version of wg_recptr_check() for the internal checks.
+ *  The database pointer is assumed to be checked already.
+ */
+static int recptr_valid(void *db,gint offset) {
+  if ((wg_uint) offset>=(wg_uint) dbmemsegh(db)->size || (offset&7))
+    return 0;
+  return recptr_testbit(db,offset);
+}
+
+static int recptr_testbit(void *db,gint offset) {
+  wg_uint *bitmap=(wg_uint *) offsettoptr(db,dbmemsegh(db)->recptr_bitmap.offset);
+  wg_uint bit=((wg_uint) offset)/8; // divide by alignment
+
+  return (bitmap[bit/RECPTR_WORDBITS] & ((wg_uint) 1 << (bit%RECPTR_WORDBITS))) != 0;
+}
+
 static void recptr_setbit(void *db,void *ptr) {
-  char* byteptr;
-  gint addr;
-  int shft;
-  unsigned char byte;
-  db_memsegment_header* dbh = dbmemsegh(db);
-  gint offset=ptrtooffset(db,ptr);
-  
-  //if (offset<=0 || offset>=dbh->size) return -1; // out of area
-  //if (offset%8) return -2; // not correctly aligned
-  addr=offset/64; // divide by alignment
-  shft=(offset%64)/8; // bit position in byte
-  byteptr=(char*)(offsettoptr(db,dbh->recptr_bitmap.offset+addr));
-  byte=*byteptr;
-  *byteptr=byte | (1<<shft);
+  wg_uint *bitmap=(wg_uint *) offsettoptr(db,dbmemsegh(db)->recptr_bitmap.offset);
+  wg_uint bit=((wg_uint) ptrtooffset(db,ptr))/8;
+
+  bitmap[bit/RECPTR_WORDBITS] |= ((wg_uint) 1 << (bit%RECPTR_WORDBITS));
 }
 
 static void recptr_clearbit(void *db,void *ptr) {
-  char* byteptr;
-  gint addr;
-  int shft;
-  unsigned char byte;
-  db_memsegment_header* dbh = dbmemsegh(db);
-  gint offset=ptrtooffset(db,ptr);
-  
-  //if (offset<=0 || offset>=dbh->size) return -1; // out of area
-  //if (offset%8) return -2; // not correctly aligned
-  addr=offset/64; // divide by alignment
-  shft=(offset%64)/8; // bit position in byte
-  byteptr=(char*)(offsettoptr(db,dbh->recptr_bitmap.offset+addr));
-  byte=*byteptr;
-  *byteptr=byte ^ (1<<shft);
+  wg_uint *bitmap=(wg_uint *) offsettoptr(db,dbmemsegh(db)->recptr_bitmap.offset);
+  wg_uint bit=((wg_uint) ptrtooffset(db,ptr))/8;
+
+  bitmap[bit/RECPTR_WORDBITS] &= ~((wg_uint) 1 << (bit%RECPTR_WORDBITS));
 }
-#endif
+
+/** Find the first record after the object at offset using the bitmap.
+ *
+ *  When records are densely packed, the next one starts right after
+ *  the current object, which is checked first. Otherwise the bitmap
+ *  is scanned, skipping whole words while they are zero, so free
+ *  objects and other areas between the records cost little.
+ *  The search stops at the end of the last datarec subarea.
+ */
+static void *recptr_next_record(void *db, gint offset) {
+  offset+=getusedobjectsize(dbfetch(db,offset));
+  if (recptr_testbit(db,offset)) return offsettoptr(db,offset);
+
+  offset=wg_next_bitmap_offset(db,dbmemsegh(db)->recptr_bitmap.offset,offset);
+  return (offset ? offsettoptr(db,offset) : NULL);
+}
+
+#endif /* USE_RECPTR_BITMAP */
 
 /* ------------ errors ---------------- */
 
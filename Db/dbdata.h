@@ -38,6 +38,11 @@
 #endif
 #include "dballoc.h"
 
+/* Inline doubles need the full 64 bits of a double in the encoded value */
+#if defined(USE_INLINE_DOUBLE) && !defined(HAVE_64BIT_GINT)
+#undef USE_INLINE_DOUBLE
+#endif
+
 // ============= external funs defs ============
 
 #ifndef _WIN32
@@ -82,11 +87,27 @@ extern double round(double);
 typedef ptrdiff_t wg_int;
 typedef size_t wg_uint; // used in time enc
 
+/** Typed value for wg_insert_batch() */
+typedef struct {
+  wg_int type;          /** WG_INTTYPE, WG_STRTYPE etc */
+  union {
+    wg_int i;           /** int, var, date and time values */
+    double d;           /** double and fixpoint values */
+    char c;             /** char value */
+    char *s;            /** str, xmlliteral, uri and blob data */
+    void *rec;          /** record pointer */
+  } v;
+  char *ext;            /** lang, xsdtype, prefix or blob type */
+  wg_int len;           /** length of blob data */
+} wg_batch_value;
+
 
 /* -------- creating and scanning records --------- */
 
 void* wg_create_record(void* db, wg_int length); ///< returns NULL when error, ptr to rec otherwise
 void* wg_create_raw_record(void* db, wg_int length); ///< returns NULL when error, ptr to rec otherwise
+wg_int wg_insert_batch(void* db, wg_int rowcount, wg_int *rowlen,
+  wg_batch_value *values, void **records); ///< returns 0 when ok, negative int on error
 wg_int wg_delete_record(void* db, void *rec);  ///< returns 0 on success, non-0 on error
 
 void* wg_get_first_record(void* db);              ///< returns NULL when error or no recs
@@ -107,6 +128,10 @@ wg_int* wg_get_record_dataarray(void* db, void* record); ///< pointer to record
 wg_int wg_set_field(void* db, void* record, wg_int fieldnr, wg_int data);
 wg_int wg_set_new_field(void* db, void* record, wg_int fieldnr, wg_int data);
 
+wg_int wg_open_record_update(void* db, void* record);
+wg_int wg_close_record_update(void* db, void* record);
+wg_int wg_close_record_updates(void* db, void** records, wg_int count);
+
 wg_int wg_set_int_field(void* db, void* record, wg_int fieldnr, wg_int data);
 wg_int wg_set_double_field(void* db, void* record, wg_int fieldnr, double data);
 wg_int wg_set_str_field(void* db, void* record, wg_int fieldnr, char* data);
@@ -257,19 +282,30 @@ wg_int wg_decode_var(void* db, wg_int data);
 #define RECORD_META_POS 1           /** metainfo, reserved for future use */
 #define RECORD_BACKLINKS_POS 2      /** backlinks structure offset */
 
-#define LITTLEENDIAN 1  ///< (intel is little-endian) difference in encoding tinystr
-//#define USETINYSTR 1    ///< undef to prohibit usage of tinystr
-
 /* Record meta bits. */
 #define RECORD_META_NOTDATA 0x1 /** Record is a "special" record (not data) */
 #define RECORD_META_MATCH 0x2   /** "match" record (needs NOTDATA as well) */
+#define RECORD_META_UPDATE 0x4  /** open for update, not in the indexes */
 #define RECORD_META_DOC 0x10    /** schema bits: top-level document */
 #define RECORD_META_OBJECT 0x20 /** schema bits: object */
 #define RECORD_META_ARRAY 0x40  /** schema bits: array */
+#define RECORD_META_FLAGMASK 0xff /** bits above these hold the table id */
+#define RECORD_META_TABLE_SHFT 8
+#define RECORD_META_TABLE_MASK 0x1f /** table id, after shifting */
+#define RECORD_META_SLOT_SHFT 13    /** column projection slot + 1 */
+#define RECORD_META_SLOTMASK (~(((gint) 1 << RECORD_META_SLOT_SHFT) - 1))
 
 #define is_special_record(r) (*((gint *) r + RECORD_META_POS) &\
                             RECORD_META_NOTDATA)
-#define is_plain_record(r) (*((gint *) r + RECORD_META_POS) == 0)
+#define is_plain_record(r) ((*((gint *) r + RECORD_META_POS) &\
+                            RECORD_META_FLAGMASK) == 0)
+#define meta_table(m) (((m) >> RECORD_META_TABLE_SHFT) &\
+                            RECORD_META_TABLE_MASK)
+#define record_table(r) meta_table(*((gint *) r + RECORD_META_POS))
+#define record_column_slot(r) ((wg_uint) *((gint *) r + RECORD_META_POS) >>\
+                            RECORD_META_SLOT_SHFT)
+#define is_record_updating(r) (*((gint *) r + RECORD_META_POS) &\
+                            RECORD_META_UPDATE)
 #define is_schema_array(r) (*((gint *) r + RECORD_META_POS) &\
                             RECORD_META_ARRAY)
 #define is_schema_object(r) (*((gint *) r + RECORD_META_POS) &\
@@ -297,8 +333,9 @@ Immediate short fixpoints               0000 1111  = is eq
 Immediate chars                         0001 1111  = is eq
 Immediate dates                         0010 1111  = is eq
 Immediate times                         0011 1111  = is eq
-// Immediate tiny strings                  0100 1111  = is eq  // not used yet
+Immediate tiny strings                  0100 1111  = is eq  // USETINYSTR
 Immediate anon constants                0101 1111  = is eq  // not implemented yet
+Immediate doubles                       0110 1111  = is eq  // USE_INLINE_DOUBLE
 */
 
 
@@ -399,6 +436,8 @@ Immediate anon constants                0101 1111  = is eq  // not implemented y
 #define TINYSTRSHFT  8
 #define TINYSTRBITS  0x4f       ///< tiny str ends with 0100 1111
 
+#define fits_tinystr(len)   ((len)<(gint)sizeof(gint))
+
 #define ANONCONSTMASK  0xff
 #define ANONCONSTSHFT  8
 #define ANONCONSTBITS  0x5f       ///< anon const ends with 0101 1111
@@ -406,6 +445,14 @@ Immediate anon constants                0101 1111  = is eq  // not implemented y
 #define encode_anonconst(i) (((i)<<ANONCONSTSHFT)|ANONCONSTBITS)
 #define decode_anonconst(i) ((i)>>ANONCONSTSHFT)
 
+/* Inline doubles keep the IEEE 754 bit pattern of the value, with
+ * the tag in place of the lowest mantissa byte. Values that have
+ * this byte zero (all floats, integers up to 2^45 etc) are stored
+ * exactly, others still use a doubleword.
+ */
+#define INLINEDOUBLEMASK  0xff
+#define INLINEDOUBLEBITS  0x6f       ///< inline double ends with 0110 1111
+
 /* --- recognizing data ---- */
 
 #define NORMALPTRMASK 0x7  ///< all pointers except fullint
@@ -431,6 +478,7 @@ Immediate anon constants                0101 1111  = is eq  // not implemented y
 #define istime(i)   (((i)&TIMEMASK)==TIMEBITS)
 #define istinystr(i)   (((i)&TINYSTRMASK)==TINYSTRBITS)
 #define isanonconst(i)   (((i)&ANONCONSTMASK)==ANONCONSTBITS)
+#define isinlinedouble(i)   (((i)&INLINEDOUBLEMASK)==INLINEDOUBLEBITS)
 
 #define isimmediatedata(i) ((i)==0 || (!isptr(i) && !isfullint(i)))
 
@@ -666,5 +714,12 @@ void *wg_get_rec_owner(void *db, void *rec);
 #ifdef USE_RECPTR_BITMAP
 gint wg_recptr_check(void *db,void *ptr);
 #endif
+#ifdef USE_INLINE_DOUBLE
+gint wg_encode_inline_double(double data);
+#endif
+#ifdef USETINYSTR
+gint wg_encode_tinystr(char* str, gint len);
+char* wg_decode_tinystr(gint data, char* buf);
+#endif
 
 #endif /* DEFINED_DBDATA_H */
@@ -41,6 +41,12 @@
 #define FEATURE_BITS_BACKLINK 0x8
 #define FEATURE_BITS_CHILD_DB 0x10
 #define FEATURE_BITS_INDEX_TMPL 0x20
+#define FEATURE_BITS_STATS 0x40
+#define FEATURE_BITS_LOCKSTATS 0x80
+#define FEATURE_BITS_INLINE_DOUBLE 0x100
+#define FEATURE_BITS_TINYSTR 0x200
+#define FEATURE_BITS_RECPTR_BITMAP 0x400
+#define FEATURE_BITS_TABLES 0x800
 
 /* Construct the bit vector */
 #ifdef HAVE_64BIT_GINT
@@ -79,11 +85,50 @@
   #define FEATURE_BITS_06 0x0
 #endif
 
+#ifdef USE_DBSTATS
+  #define FEATURE_BITS_07 FEATURE_BITS_STATS
+#else
+  #define FEATURE_BITS_07 0x0
+#endif
+
+#ifdef USE_LOCKSTATS
+  #define FEATURE_BITS_08 FEATURE_BITS_LOCKSTATS
+#else
+  #define FEATURE_BITS_08 0x0
+#endif
+
+#if defined(USE_INLINE_DOUBLE) && defined(HAVE_64BIT_GINT)
+  #define FEATURE_BITS_09 FEATURE_BITS_INLINE_DOUBLE
+#else
+  #define FEATURE_BITS_09 0x0
+#endif
+
+#ifdef USETINYSTR
+  #define FEATURE_BITS_10 FEATURE_BITS_TINYSTR
+#else
+  #define FEATURE_BITS_10 0x0
+#endif
+
+#ifdef USE_RECPTR_BITMAP
+  #define FEATURE_BITS_11 FEATURE_BITS_RECPTR_BITMAP
+#else
+  #define FEATURE_BITS_11 0x0
+#endif
+
+/* Always present; marks the segment layout with the table directory */
+#define FEATURE_BITS_12 FEATURE_BITS_TABLES
+
 #define MEMSEGMENT_FEATURES (FEATURE_BITS_01 |\
   FEATURE_BITS_02 |\
   FEATURE_BITS_03 |\
   FEATURE_BITS_04 |\
   FEATURE_BITS_05 |\
-  FEATURE_BITS_06)
+  FEATURE_BITS_06 |\
+  FEATURE_BITS_07 |\
+  FEATURE_BITS_08 |\
+  FEATURE_BITS_09 |\
+  FEATURE_BITS_10 |\
+  FEATURE_BITS_11 |\
+  FEATURE_BITS_12)
 
 #endif /* DEFINED_DBFEATURES_H */
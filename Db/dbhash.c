@@ -297,6 +297,9 @@ gint wg_decode_for_hashing(void *db, gint enc, char **decbytes) {
   double doubledata;
   char *bytedata;
   char *exdata, *buf = NULL, *outbuf;
+#ifdef USETINYSTR
+  char tinybuf[sizeof(gint)+1];
+#endif
 
   type = wg_get_encoded_type(db, enc);
   switch(type) {
@@ -326,6 +329,13 @@ gint wg_decode_for_hashing(void *db, gint enc, char **decbytes) {
       bytedata = (char *) &doubledata;
       break;
     case WG_STRTYPE:
+#ifdef USETINYSTR
+      if(istinystr(enc)) {
+        bytedata = wg_decode_tinystr(enc, tinybuf);
+        len = strlen(bytedata);
+        break;
+      }
+#endif
       len = wg_decode_str_len(db, enc);
       bytedata = wg_decode_str(db, enc);
       break;
@@ -649,6 +659,26 @@ gint wg_ginthash_getkey(void *db, void *tbl, gint key, gint *val) {
   return -1;
 }
 
+/** Remove a key from the hash table.
+ *  Returns 0 if the key was removed.
+ *  Returns -1 if the key was not found.
+ */
+gint wg_ginthash_removekey(void *db, void *tbl, gint key) {
+  size_t dirsize = 1<<((ext_ginthash *)tbl)->level;
+  size_t hash = GINTHASH_SCRAMBLE(key) & (dirsize - 1);
+  ginthash_bucket *bucket = ((ext_ginthash *)tbl)->directory[hash];
+  if(bucket) {
+    int i;
+    for(i=0; i<bucket->fill; i++) {
+      if(bucket->key[i] == key) {
+        remove_from_bucket(bucket, i);
+        return 0;
+      }
+    }
+  }
+  return -1;
+}
+
 /** Release all memory allocated for the hash table.
  *
  */
@@ -64,6 +64,7 @@ gint wg_idxhash_find(void* db, db_hash_area_header *ha,
 void *wg_ginthash_init(void *db);
 gint wg_ginthash_addkey(void *db, void *tbl, gint key, gint val);
 gint wg_ginthash_getkey(void *db, void *tbl, gint key, gint *val);
+gint wg_ginthash_removekey(void *db, void *tbl, gint key);
 void wg_ginthash_free(void *db, void *tbl);
 
 void *wg_dhash_init(void *db, size_t entries);
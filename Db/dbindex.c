@@ -29,6 +29,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdlib.h>
 
 #ifdef __cplusplus
@@ -44,7 +45,11 @@ extern "C" {
 #include "dbdata.h"
 #include "dbindex.h"
 #include "dbcompare.h"
+#include "dbquery.h"
 #include "dbhash.h"
+#include "dbstats.h"
+#include "dbtable.h"
+#include "dbschema.h"
 
 
 /* ====== Private defs =========== */
@@ -54,6 +59,13 @@ extern "C" {
 #define RL_CASE 2
 #define RR_CASE 3
 
+#define SECONDS_PER_DAY 86400
+
+/* Condition of a template column given as arguments. Without the
+ * condition array, all fixed columns are compared for equality.
+ */
+#define TEMPLATE_COND(c, i) ((c) ? (c)[i] : WG_COND_EQUAL)
+
 #ifndef max
 #define max(a,b) (a>b ? a : b)
 #endif
@@ -62,6 +74,11 @@ extern "C" {
 #define HASHIDX_OP_REMOVE 2
 #define HASHIDX_OP_FIND 3
 
+/* A pre-sized hash index array may use at most 1/HASHIDX_SIZE_RATIO
+ * of the free space of the segment.
+ */
+#define HASHIDX_SIZE_RATIO 8
+
 /* ======= Private protos ================ */
 
 #ifndef TTREE_SINGLE_COMPARE
@@ -74,15 +91,26 @@ static int db_rotate_ttree(void *db, gint index_id, struct wg_tnode *root,
 static gint ttree_add_row(void *db, gint index_id, void *rec);
 static gint ttree_remove_row(void *db, gint index_id, void * rec);
 
+static void *first_index_record(void *db, wg_index_header *hdr);
+static void *next_index_record(void *db, wg_index_header *hdr, void *rec);
+static gint collect_index_keys(void *db, wg_index_header *hdr, gint **keys);
+static void sort_index_keys(void *db, gint *keys, gint *tmp, gint count);
+static gint build_ttree(void *db, wg_index_header *hdr, gint *keys,
+  gint count);
+static gint link_ttree_nodes(void *db, gint *nodes, gint lo, gint hi,
+  gint parent);
 static gint create_ttree_index(void *db, gint index_id);
 static gint drop_ttree_index(void *db, gint column);
 
 static gint insert_into_list(void *db, gint *head, gint value);
 static void delete_from_list(void *db, gint *head);
 #ifdef USE_INDEX_TEMPLATE
-static gint add_index_template(void *db, gint *matchrec, gint reclen);
-static gint find_index_template(void *db, gint *matchrec, gint reclen);
+static gint add_index_template(void *db, gint *matchrec, gint *conds,
+  gint reclen);
+static gint find_index_template(void *db, gint *matchrec, gint *conds,
+  gint reclen);
 static gint remove_index_template(void *db, gint template_offset);
+static int check_template_cond(gint cond, gint cmp);
 #endif
 
 static gint hash_add_row(void *db, gint index_id, void *rec);
@@ -92,12 +120,26 @@ static gint hash_recurse(void *db, wg_index_header *hdr, char *prefix,
 static gint hash_extend_prefix(void *db, wg_index_header *hdr, char *prefix,
   gint prefixlen, gint nextval, gint *values, gint count, void *rec, gint op,
   gint expand);
+static void apply_index_key(gint key, char *bytes, gint len);
 
 static gint create_hash_index(void *db, gint index_id);
+static gint create_json_path_index(void *db, gint index_id);
 static gint drop_hash_index(void *db, gint index_id);
-
+static gint json_path_doc_field(void *db, void *doc, gint column, gint op);
+static gint json_path_doc(void *db, void *doc, gint op);
+static gint json_path_recurse(void *db, wg_index_header *hdr, void *doc,
+  char *path, gint enc, gint op, int depth);
+
+static gint create_index(void *db, gint table, gint *columns, gint col_count,
+  gint type, gint key, gint *matchrec, gint *conds, gint reclen);
+static gint find_index_id(void *db, gint table, gint *columns,
+  gint col_count, gint type, gint key, gint *matchrec, gint *conds,
+  gint reclen);
 static gint sort_columns(gint *sorted_cols, gint *columns, gint col_count);
 
+static gint add_index_row(void *db, wg_index_header *hdr, gint index_id,
+  void *rec);
+
 static gint show_index_error(void* db, char* errmsg);
 static gint show_index_error_nr(void* db, char* errmsg, gint nr);
 
@@ -151,12 +193,13 @@ static gint db_find_bounding_tnode(void *db, gint rootoffset, gint key,
   gint *result, struct wg_tnode *rb_node) {
 
   struct wg_tnode * node = (struct wg_tnode *)offsettoptr(db,rootoffset);
+  gint mode = WG_COMPARE_MODE(key);
 
   /* Original tree search algorithm: compares both bounds of
    * the node to determine immediately if the value falls between them.
    */
 
-  if(WG_COMPARE(db, key, node->current_min) == WG_LESSTHAN) {
+  if(WG_COMPARE_FAST(db, mode, key, node->current_min) == WG_LESSTHAN) {
     /* if(key < node->current_max) */
     if(node->left_child_offset != 0)
       return db_find_bounding_tnode(db, node->left_child_offset,
@@ -165,7 +208,7 @@ static gint db_find_bounding_tnode(void *db, gint rootoffset, gint key,
       *result = DEAD_END_LEFT_NOT_BOUNDING;
       return rootoffset;
     }
-  } else if(WG_COMPARE(db, key, node->current_max) != WG_GREATER) {
+  } else if(WG_COMPARE_FAST(db, mode, key, node->current_max) != WG_GREATER) {
     *result = REALLY_BOUNDING_NODE;
     return rootoffset;
   }
@@ -426,11 +469,12 @@ static int db_rotate_ttree(void *db, gint index_id, struct wg_tnode *root, int o
 */
 static gint ttree_add_row(void *db, gint index_id, void *rec) {
   gint rootoffset, column;
-  gint newvalue, boundtype, bnodeoffset, newoffset;
+  gint newvalue, boundtype, bnodeoffset, newoffset, mode;
   struct wg_tnode *node;
   wg_index_header *hdr = (wg_index_header *)offsettoptr(db,index_id);
   db_memsegment_header* dbh = dbmemsegh(db);
 
+  WG_STAT_INC(db, WG_STAT_TTREE_INSERTS);
   rootoffset = TTREE_ROOT_NODE(hdr);
 #ifdef CHECK
   if(rootoffset == 0){
@@ -445,6 +489,7 @@ static gint ttree_add_row(void *db, gint index_id, void *rec) {
 
   //extract real value from the row (rec)
   newvalue = wg_get_field(db, rec, column);
+  mode = WG_COMPARE_MODE(newvalue);
 
   //find bounding node for the value
   bnodeoffset = db_find_bounding_tnode(db, rootoffset, newvalue, &boundtype, NULL);
@@ -468,9 +513,9 @@ static gint ttree_add_row(void *db, gint index_id, void *rec) {
          * since here the compare is more expensive than the slot
          * copying.
          */
-        cr = WG_COMPARE(db, wg_get_field(db,
-          (void *)offsettoptr(db,node->array_of_values[i]), column),
-          newvalue);
+        gint value = wg_get_field(db,
+          (void *)offsettoptr(db,node->array_of_values[i]), column);
+        cr = WG_COMPARE_FAST(db, mode, value, newvalue);
 
         if(cr != WG_LESSTHAN) { /* value >= newvalue */
           /* Push remaining values to the right */
@@ -508,9 +553,9 @@ static gint ttree_add_row(void *db, gint index_id, void *rec) {
        * do this scan (and sort) in reverse order, compared to the case
        * where array had some space left. */
       for(i=WG_TNODE_ARRAY_SIZE-1; i>0; i--) {
-        cr = WG_COMPARE(db, wg_get_field(db,
-          (void *)offsettoptr(db,node->array_of_values[i]), column),
-          newvalue);
+        gint value = wg_get_field(db,
+          (void *)offsettoptr(db,node->array_of_values[i]), column);
+        cr = WG_COMPARE_FAST(db, mode, value, newvalue);
         if(cr != WG_GREATER) { /* value <= newvalue */
           /* Push remaining values to the left */
           for(j=0; j<i; j++)
@@ -762,10 +807,11 @@ static gint ttree_add_row(void *db, gint index_id, void *rec) {
 static gint ttree_remove_row(void *db, gint index_id, void * rec) {
   int i, found;
   gint key, rootoffset, column, boundtype, bnodeoffset;
-  gint rowoffset;
+  gint rowoffset, mode;
   struct wg_tnode *node, *parent;
   wg_index_header *hdr = (wg_index_header *)offsettoptr(db,index_id);
 
+  WG_STAT_INC(db, WG_STAT_TTREE_DELETES);
   rootoffset = TTREE_ROOT_NODE(hdr);
 #ifdef CHECK
   if(rootoffset == 0){
@@ -778,6 +824,7 @@ static gint ttree_remove_row(void *db, gint index_id, void * rec) {
 #endif
   column = hdr->rec_field_index[0]; /* always one column for T-tree */
   key = wg_get_field(db, rec, column);
+  mode = WG_COMPARE_MODE(key);
   rowoffset = ptrtooffset(db, rec);
 
   /* find bounding node for the value. Since non-unique values
@@ -808,7 +855,7 @@ static gint ttree_remove_row(void *db, gint index_id, void * rec) {
     if(!bnodeoffset)
       break; /* no more successors */
     node = (struct wg_tnode *)offsettoptr(db,bnodeoffset);
-    if(WG_COMPARE(db, node->current_min, key) == WG_GREATER)
+    if(WG_COMPARE_FAST(db, mode, node->current_min, key) == WG_GREATER)
       break; /* successor is not a bounding node */
   }
 
@@ -1042,10 +1089,11 @@ found_row:
 gint wg_search_ttree_index(void *db, gint index_id, gint key){
   int i;
   gint rootoffset, bnodetype, bnodeoffset;
-  gint rowoffset, column;
+  gint rowoffset, column, mode;
   struct wg_tnode * node;
   wg_index_header *hdr = (wg_index_header *)offsettoptr(db,index_id);
 
+  WG_STAT_INC(db, WG_STAT_TTREE_SEARCHES);
   rootoffset = TTREE_ROOT_NODE(hdr);
 #ifdef CHECK
   /* XXX: This is a rather weak check but might catch some errors */
@@ -1066,13 +1114,14 @@ gint wg_search_ttree_index(void *db, gint index_id, gint key){
   if(bnodetype != REALLY_BOUNDING_NODE) return 0;
 
   column = hdr->rec_field_index[0]; /* always one column for T-tree */
+  mode = WG_COMPARE_MODE(key);
   /* find the record inside the node. */
   for(;;) {
     for(i=0;i<node->number_of_elements;i++){
+      gint value;
       rowoffset = node->array_of_values[i];
-      if(WG_COMPARE(db,
-        wg_get_field(db, (void *)offsettoptr(db,rowoffset), column),
-        key) == WG_EQUAL) {
+      value = wg_get_field(db, (void *)offsettoptr(db,rowoffset), column);
+      if(WG_COMPARE_FAST(db, mode, value, key) == WG_EQUAL) {
         return rowoffset;
       }
     }
@@ -1083,7 +1132,7 @@ gint wg_search_ttree_index(void *db, gint index_id, gint key){
     if(!bnodeoffset)
       break; /* no more successors */
     node = (struct wg_tnode *)offsettoptr(db,bnodeoffset);
-    if(WG_COMPARE(db, node->current_min, key) == WG_GREATER)
+    if(WG_COMPARE_FAST(db, mode, node->current_min, key) == WG_GREATER)
       break; /* successor is not a bounding node */
   }
 
@@ -1181,6 +1230,7 @@ gint wg_search_ttree_rightmost(void *db, gint rootoffset,
   gint key, gint *result, struct wg_tnode *rb_node) {
 
   struct wg_tnode * node;
+  gint mode = WG_COMPARE_MODE(key);
 
 #ifdef TTREE_SINGLE_COMPARE
   node = (struct wg_tnode *)offsettoptr(db,rootoffset);
@@ -1190,14 +1240,14 @@ gint wg_search_ttree_rightmost(void *db, gint rootoffset,
    * is selected immediately. If the search ends in a dead end, the node where
    * the right branch was taken is examined again.
    */
-  if(WG_COMPARE(db, key, node->current_min) == WG_LESSTHAN) {
+  if(WG_COMPARE_FAST(db, mode, key, node->current_min) == WG_LESSTHAN) {
     /* key < node->current_min */
     if(node->left_child_offset != 0) {
       return wg_search_ttree_rightmost(db, node->left_child_offset, key,
         result, rb_node);
     } else if (rb_node) {
       /* Dead end, but we still have an unexamined node left */
-      if(WG_COMPARE(db, key, rb_node->current_max) != WG_GREATER) {
+      if(WG_COMPARE_FAST(db, mode, key, rb_node->current_max) != WG_GREATER) {
         /* key<=rb_node->current_max */
         *result = REALLY_BOUNDING_NODE;
         return ptrtooffset(db, rb_node);
@@ -1215,7 +1265,7 @@ gint wg_search_ttree_rightmost(void *db, gint rootoffset,
        */
       return wg_search_ttree_rightmost(db, node->right_child_offset, key,
         result, node);
-    } else if(WG_COMPARE(db, key, node->current_max) != WG_GREATER) {
+    } else if(WG_COMPARE_FAST(db, mode, key, node->current_max) != WG_GREATER) {
       /* key<=node->current_max */
       *result = REALLY_BOUNDING_NODE;
       return rootoffset;
@@ -1235,11 +1285,11 @@ gint wg_search_ttree_rightmost(void *db, gint rootoffset,
   /* There is at least one node with the key we're interested in,
    * now make sure we have the rightmost */
   node = offsettoptr(db, bnodeoffset);
-  while(WG_COMPARE(db, node->current_max, key) == WG_EQUAL) {
+  while(WG_COMPARE_FAST(db, mode, node->current_max, key) == WG_EQUAL) {
     gint nextoffset = TNODE_SUCCESSOR(db, node);
     if(nextoffset) {
       struct wg_tnode *next = offsettoptr(db, nextoffset);
-        if(WG_COMPARE(db, next->current_min, key) == WG_GREATER)
+        if(WG_COMPARE_FAST(db, mode, next->current_min, key) == WG_GREATER)
           /* next->current_min > key */
           break; /* overshot */
       node = next;
@@ -1258,19 +1308,20 @@ gint wg_search_ttree_leftmost(void *db, gint rootoffset,
   gint key, gint *result, struct wg_tnode *lb_node) {
 
   struct wg_tnode * node;
+  gint mode = WG_COMPARE_MODE(key);
 
 #ifdef TTREE_SINGLE_COMPARE
   node = (struct wg_tnode *)offsettoptr(db,rootoffset);
 
   /* Rightmost bound search mirrored */
-  if(WG_COMPARE(db, key, node->current_max) == WG_GREATER) {
+  if(WG_COMPARE_FAST(db, mode, key, node->current_max) == WG_GREATER) {
     /* key > node->current_max */
     if(node->right_child_offset != 0) {
       return wg_search_ttree_leftmost(db, node->right_child_offset, key,
         result, lb_node);
     } else if (lb_node) {
       /* Dead end, but we still have an unexamined node left */
-      if(WG_COMPARE(db, key, lb_node->current_min) != WG_LESSTHAN) {
+      if(WG_COMPARE_FAST(db, mode, key, lb_node->current_min) != WG_LESSTHAN) {
         /* key>=lb_node->current_min */
         *result = REALLY_BOUNDING_NODE;
         return ptrtooffset(db, lb_node);
@@ -1283,7 +1334,7 @@ gint wg_search_ttree_leftmost(void *db, gint rootoffset,
     if(node->left_child_offset != 0) {
       return wg_search_ttree_leftmost(db, node->left_child_offset, key,
         result, node);
-    } else if(WG_COMPARE(db, key, node->current_min) != WG_LESSTHAN) {
+    } else if(WG_COMPARE_FAST(db, mode, key, node->current_min) != WG_LESSTHAN) {
       /* key>=node->current_min */
       *result = REALLY_BOUNDING_NODE;
       return rootoffset;
@@ -1301,11 +1352,11 @@ gint wg_search_ttree_leftmost(void *db, gint rootoffset,
   /* One (we don't know which) bounding node found, traverse the
    * tree to the leftmost. */
   node = offsettoptr(db, bnodeoffset);
-  while(WG_COMPARE(db, node->current_min, key) == WG_EQUAL) {
+  while(WG_COMPARE_FAST(db, mode, node->current_min, key) == WG_EQUAL) {
     gint prevoffset = TNODE_PREDECESSOR(db, node);
     if(prevoffset) {
       struct wg_tnode *prev = offsettoptr(db, prevoffset);
-      if(WG_COMPARE(db, prev->current_max, key) == WG_LESSTHAN)
+      if(WG_COMPARE_FAST(db, mode, prev->current_max, key) == WG_LESSTHAN)
         /* prev->current_max < key */
         break; /* overshot */
       node = prev;
@@ -1327,12 +1378,13 @@ gint wg_search_tnode_first(void *db, gint nodeoffset, gint key,
 
   gint i, encoded;
   struct wg_tnode *node = (struct wg_tnode *) offsettoptr(db, nodeoffset);
+  gint mode = WG_COMPARE_MODE(key);
 
   for(i=0; i<node->number_of_elements; i++) {
     /* Naive scan is ok for small values of WG_TNODE_ARRAY_SIZE. */
     encoded = wg_get_field(db,
       (void *)offsettoptr(db,node->array_of_values[i]), column);
-    if(WG_COMPARE(db, encoded, key) != WG_LESSTHAN)
+    if(WG_COMPARE_FAST(db, mode, encoded, key) != WG_LESSTHAN)
       /* encoded >= key */
       return i;
   }
@@ -1350,11 +1402,12 @@ gint wg_search_tnode_last(void *db, gint nodeoffset, gint key,
 
   gint i, encoded;
   struct wg_tnode *node = (struct wg_tnode *) offsettoptr(db, nodeoffset);
+  gint mode = WG_COMPARE_MODE(key);
 
   for(i=node->number_of_elements -1; i>=0; i--) {
     encoded = wg_get_field(db,
       (void *)offsettoptr(db,node->array_of_values[i]), column);
-    if(WG_COMPARE(db, encoded, key) != WG_GREATER)
+    if(WG_COMPARE_FAST(db, mode, encoded, key) != WG_GREATER)
       /* encoded <= key */
       return i;
   }
@@ -1362,16 +1415,201 @@ gint wg_search_tnode_last(void *db, gint nodeoffset, gint key,
   return -1;
 }
 
+/** Get the first record to be added to a new index.
+*  Indexes scoped to a table only scan the records of the table.
+*/
+static void *first_index_record(void *db, wg_index_header *hdr) {
+  if(hdr->table)
+    return wg_get_first_table_record(db, hdr->table);
+  return wg_get_first_record(db);
+}
+
+/** Get the next record to be added to a new index.
+*/
+static void *next_index_record(void *db, wg_index_header *hdr, void *rec) {
+  if(hdr->table)
+    return wg_get_next_table_record(db, hdr->table, rec);
+  return wg_get_next_record(db, rec);
+}
+
+/** Collect the rows to be added to a new index.
+*  Allocates an array of (key, offset) pairs where the key is the
+*  value of the first indexed column. The caller must free it.
+*  returns the number of rows, -1 on error.
+*/
+static gint collect_index_keys(void *db, wg_index_header *hdr, gint **keys) {
+  gint column = hdr->rec_field_index[0];
+  gint lastcol = hdr->rec_field_index[hdr->fields - 1];
+  gint count = 0, size = 1024;
+  void *rec;
+
+  *keys = (gint *) malloc(2 * size * sizeof(gint));
+  if(!*keys) {
+    show_index_error(db, "Memory allocation failed");
+    return -1;
+  }
+
+  for(rec = first_index_record(db, hdr); rec;
+    rec = next_index_record(db, hdr, rec)) {
+    if(lastcol >= wg_get_record_len(db, rec) || !MATCH_TEMPLATE(db, hdr, rec))
+      continue;
+    if((hdr->type == WG_INDEX_TYPE_HASH_JSON ||\
+      hdr->type == WG_INDEX_TYPE_TTREE_JSON) && !is_plain_record(rec)) {
+      /* Ignore array and object records. Their data is indexed
+       * from the rows that point to them.
+       */
+      continue;
+    }
+    if(count == size) {
+      gint *tmp = (gint *) realloc(*keys, 4 * size * sizeof(gint));
+      if(!tmp) {
+        free(*keys);
+        show_index_error(db, "Memory allocation failed");
+        return -1;
+      }
+      *keys = tmp;
+      size *= 2;
+    }
+    (*keys)[2*count] = wg_get_field(db, rec, column);
+    (*keys)[2*count + 1] = ptrtooffset(db, rec);
+    count++;
+  }
+  return count;
+}
+
+/** Sort (key, offset) pairs by key.
+*  Bottom-up merge sort, tmp must have room for count pairs.
+*  The sort is stable, so rows with equal keys stay in the order
+*  they were collected in.
+*/
+static void sort_index_keys(void *db, gint *keys, gint *tmp, gint count) {
+  gint width, *src = keys, *dst = tmp, *swap;
+
+  for(width=1; width<count; width*=2) {
+    gint i;
+    for(i=0; i<count; i+=2*width) {
+      gint l = i, k = i;
+      gint m = (i + width < count ? i + width : count);
+      gint r = (i + 2*width < count ? i + 2*width : count);
+      gint j = m;
+      while(l < m && j < r) {
+        if(WG_COMPARE(db, src[2*j], src[2*l]) == WG_LESSTHAN) {
+          dst[2*k] = src[2*j];
+          dst[2*k + 1] = src[2*j + 1];
+          j++;
+        } else {
+          dst[2*k] = src[2*l];
+          dst[2*k + 1] = src[2*l + 1];
+          l++;
+        }
+        k++;
+      }
+      if(l < m)
+        memcpy(dst + 2*k, src + 2*l, 2 * (m - l) * sizeof(gint));
+      else if(j < r)
+        memcpy(dst + 2*k, src + 2*j, 2 * (r - j) * sizeof(gint));
+    }
+    swap = src;
+    src = dst;
+    dst = swap;
+  }
+  if(src != keys)
+    memcpy(keys, src, 2 * count * sizeof(gint));
+}
+
+/** Build a T-tree from sorted (key, offset) pairs.
+*  The rows are spread evenly over the minimum number of nodes, which
+*  are then linked into a perfectly balanced tree, replacing the
+*  (empty) root node of the index.
+*  returns:
+*  0 - on success
+*  -1 - error (out of T-node space)
+*/
+static gint build_ttree(void *db, wg_index_header *hdr, gint *keys,
+  gint count) {
+  gint i, k, nodecount, root, *nodes;
+  struct wg_tnode *node;
+  db_memsegment_header* dbh = dbmemsegh(db);
+
+  nodecount = (count + WG_TNODE_ARRAY_SIZE - 1) / WG_TNODE_ARRAY_SIZE;
+  nodes = (gint *) malloc(nodecount * sizeof(gint));
+  if(!nodes) {
+    show_index_error(db, "Memory allocation failed");
+    return -1;
+  }
+
+  /* Node k holds the rows [k*count/nodecount, (k+1)*count/nodecount) */
+  nodes[0] = TTREE_ROOT_NODE(hdr);
+  for(k=1; k<nodecount; k++) {
+    nodes[k] = wg_alloc_fixlen_object(db, &dbh->tnode_area_header);
+    if(!nodes[k]) {
+      while(--k > 0)
+        wg_free_fixlen_object(db, &dbh->tnode_area_header, nodes[k]);
+      free(nodes);
+      show_index_error(db, "Failed to allocate T-tree nodes");
+      return -1;
+    }
+  }
+  for(k=0; k<nodecount; k++) {
+    gint first = (gint) (((double) k * count) / nodecount);
+    gint last = (gint) (((double) (k+1) * count) / nodecount);
+    node = (struct wg_tnode *) offsettoptr(db, nodes[k]);
+    node->number_of_elements = (short) (last - first);
+    for(i=first; i<last; i++)
+      node->array_of_values[i - first] = keys[2*i + 1];
+    node->current_min = keys[2*first];
+    node->current_max = keys[2*(last-1)];
+#ifdef TTREE_CHAINED_NODES
+    node->pred_offset = (k > 0 ? nodes[k-1] : 0);
+    node->succ_offset = (k < nodecount-1 ? nodes[k+1] : 0);
+#endif
+  }
+
+  root = (nodecount - 1) / 2;
+  link_ttree_nodes(db, nodes, 0, nodecount, 0);
+  TTREE_ROOT_NODE(hdr) = nodes[root];
+#ifdef TTREE_CHAINED_NODES
+  TTREE_MIN_NODE(hdr) = nodes[0];
+  TTREE_MAX_NODE(hdr) = nodes[nodecount-1];
+#endif
+  free(nodes);
+  return 0;
+}
+
+/** Link the nodes [lo, hi) into a balanced subtree.
+*  The middle node becomes the root of the subtree.
+*  returns the height of the subtree.
+*/
+static gint link_ttree_nodes(void *db, gint *nodes, gint lo, gint hi,
+  gint parent) {
+  gint mid, lh, rh;
+  struct wg_tnode *node;
+
+  if(lo >= hi)
+    return 0;
+  mid = lo + (hi - lo - 1) / 2;
+  node = (struct wg_tnode *) offsettoptr(db, nodes[mid]);
+  node->parent_offset = parent;
+  lh = link_ttree_nodes(db, nodes, lo, mid, nodes[mid]);
+  rh = link_ttree_nodes(db, nodes, mid+1, hi, nodes[mid]);
+  node->left_child_offset = (lo < mid ? nodes[lo + (mid - lo - 1) / 2] : 0);
+  node->right_child_offset = (mid+1 < hi ?\
+    nodes[mid + 1 + (hi - mid - 2) / 2] : 0);
+  node->left_subtree_height = (unsigned char) lh;
+  node->right_subtree_height = (unsigned char) rh;
+  return (lh > rh ? lh : rh) + 1;
+}
+
 /** Create T-tree index on a column
+*  The existing rows are collected and sorted first, then the tree
+*  is built in one pass with build_ttree().
 *  returns:
 *  0 - on success
 *  -1 - error (failed to create the index)
 */
 static gint create_ttree_index(void *db, gint index_id){
-  gint node;
-  unsigned int rowsprocessed;
+  gint node, count, *keys, *tmp;
   struct wg_tnode *nodest;
-  void *rec;
   db_memsegment_header* dbh = dbmemsegh(db);
   wg_index_header *hdr = (wg_index_header *) offsettoptr(db, index_id);
   gint column = hdr->rec_field_index[0];
@@ -1379,6 +1617,8 @@ static gint create_ttree_index(void *db, gint index_id){
   /* allocate (+ init) root node for new index tree and save
    * the offset into index_array */
   node = wg_alloc_fixlen_object(db, &dbh->tnode_area_header);
+  if(!node)
+    return -1;
   nodest =(struct wg_tnode *)offsettoptr(db,node);
   nodest->parent_offset = 0;
   nodest->left_subtree_height = 0;
@@ -1399,25 +1639,30 @@ static gint create_ttree_index(void *db, gint index_id){
   TTREE_MAX_NODE(hdr) = node;
 #endif
 
-  //scan all the data - make entry for every suitable row
-  rec = wg_get_first_record(db);
-  rowsprocessed = 0;
-
-  while(rec != NULL) {
-    if(column >= wg_get_record_len(db, rec)) {
-      rec=wg_get_next_record(db,rec);
-      continue;
+  //collect all the suitable rows, sort them and build the tree
+  count = collect_index_keys(db, hdr, &keys);
+  if(count < 0)
+    return -1;
+  if(count > 0) {
+    tmp = (gint *) malloc(2 * count * sizeof(gint));
+    if(!tmp) {
+      free(keys);
+      show_index_error(db, "Memory allocation failed");
+      return -1;
     }
-    if(MATCH_TEMPLATE(db, hdr, rec)) {
-      ttree_add_row(db, index_id, rec);
-      rowsprocessed++;
+    sort_index_keys(db, keys, tmp, count);
+    free(tmp);
+    if(build_ttree(db, hdr, keys, count)) {
+      free(keys);
+      return -1;
     }
-    rec=wg_get_next_record(db,rec);
   }
+  free(keys);
+  WG_STAT_ADD(db, WG_STAT_TTREE_INSERTS, count);
 #ifdef WG_NO_ERRPRINT
 #else
   fprintf(stderr,"new index created on rec field %d into slot %d and %d data rows inserted\n",
-    (int) column, (int) index_id, rowsprocessed);
+    (int) column, (int) index_id, (int) count);
 #endif
 
   return 0;
@@ -1478,6 +1723,7 @@ static gint hash_add_row(void *db, gint index_id, void *rec) {
   for(i=0; i<hdr->fields; i++) {
     values[i] = wg_get_field(db, rec, hdr->rec_field_index[i]);
   }
+  WG_STAT_INC(db, WG_STAT_HASH_INSERTS);
   return hash_recurse(db, hdr, NULL, 0, values, hdr->fields, rec,
     HASHIDX_OP_STORE, (hdr->type == WG_INDEX_TYPE_HASH_JSON));
 }
@@ -1495,6 +1741,7 @@ static gint hash_remove_row(void *db, gint index_id, void *rec) {
   for(i=0; i<hdr->fields; i++) {
     values[i] = wg_get_field(db, rec, hdr->rec_field_index[i]);
   }
+  WG_STAT_INC(db, WG_STAT_HASH_DELETES);
   return hash_recurse(db, hdr, NULL, 0, values, hdr->fields, rec,
     HASHIDX_OP_REMOVE, (hdr->type == WG_INDEX_TYPE_HASH_JSON));
 }
@@ -1574,6 +1821,8 @@ static gint hash_extend_prefix(void *db, wg_index_header *hdr, char *prefix,
     show_index_error(db,"Failed to decode a field value for hash");
     return -1;
   }
+  if(hdr->key != WG_INDEX_KEY_VALUE)
+    apply_index_key(hdr->key, fldbytes, fldlen);
 
   if(prefix && prefixlen) {
     newlen = prefixlen + fldlen + 1;
@@ -1600,49 +1849,87 @@ static gint hash_extend_prefix(void *db, wg_index_header *hdr, char *prefix,
   return retv;
 }
 
+/*
+ * Helper function to compute the key of a field value in place.
+ * bytes is the output of wg_decode_for_hashing(): the type byte
+ * followed by the value. Values of other types are not modified.
+ */
+static void apply_index_key(gint key, char *bytes, gint len) {
+  gint i;
+
+  switch(key) {
+    case WG_INDEX_KEY_LOWER:
+      if(bytes[0] == WG_STRTYPE) {
+        for(i=1; i<len; i++)
+          bytes[i] = (char) tolower((unsigned char) bytes[i]);
+      }
+      break;
+    case WG_INDEX_KEY_DAY:
+      if(bytes[0] == WG_INTTYPE) {
+        int intdata;
+        memcpy(&intdata, bytes + 1, sizeof(int));
+        i = intdata / SECONDS_PER_DAY;
+        if(i * SECONDS_PER_DAY > intdata)
+          i--; /* round down before the epoch */
+        intdata = (int) (i * SECONDS_PER_DAY);
+        memcpy(bytes + 1, &intdata, sizeof(int));
+      }
+      else if(bytes[0] == WG_DOUBLETYPE) {
+        double doubledata;
+        memcpy(&doubledata, bytes + 1, sizeof(double));
+        i = (gint) (doubledata / SECONDS_PER_DAY);
+        if(i * (double) SECONDS_PER_DAY > doubledata)
+          i--;
+        doubledata = i * (double) SECONDS_PER_DAY;
+        memcpy(bytes + 1, &doubledata, sizeof(double));
+      }
+      break;
+    default:
+      break;
+  }
+}
+
 /*
  * Create hash index.
+ * The rows are collected first, so that the hash table can be sized
+ * by the row count instead of growing long collision chains.
  * Returns 0 on success
  * Returns -1 on failure.
  */
 static gint create_hash_index(void *db, gint index_id){
-  unsigned int rowsprocessed;
-  void *rec;
+  gint count, size, i, *keys;
   wg_index_header *hdr = (wg_index_header *) offsettoptr(db, index_id);
-  gint type = hdr->type;
-  gint firstcol = hdr->rec_field_index[0];
-  gint i;
+  db_memsegment_header* dbh = dbmemsegh(db);
+
+  count = collect_index_keys(db, hdr, &keys);
+  if(count < 0)
+    return -1;
+
+  /* One bucket per row, as long as the array takes only a small
+   * part of the remaining free space of the segment (it cannot
+   * be released later).
+   */
+  size = 0;
+  if(count > DEFAULT_IDXHASH_LENGTH &&\
+    (dbh->size - dbh->free) / HASHIDX_SIZE_RATIO > count * sizeof(gint)) {
+    size = count;
+  }
 
   /* Initialize the hash table (0 - use default size) */
-  if(wg_create_hash(db, HASHIDX_ARRAYP(hdr), 0))
+  if(wg_create_hash(db, HASHIDX_ARRAYP(hdr), size)) {
+    free(keys);
     return -1;
+  }
 
   /* Add existing records */
-  rec = wg_get_first_record(db);
-  rowsprocessed = 0;
-
-  while(rec != NULL) {
-    if(firstcol >= wg_get_record_len(db, rec)) {
-      rec=wg_get_next_record(db,rec);
-      continue;
-    }
-    if(MATCH_TEMPLATE(db, hdr, rec)) {
-      if(type == WG_INDEX_TYPE_HASH_JSON) {
-        /* Ignore array and object records. Their data is indexed
-         * from the rows that point to them.
-         */
-        if(is_plain_record(rec)) {
-          hash_add_row(db, index_id, rec);
-          rowsprocessed++;
-        }
-      } else {
-        /* Add all rows normally */
-        hash_add_row(db, index_id, rec);
-        rowsprocessed++;
-      }
+  for(i=0; i<count; i++) {
+    if(hash_add_row(db, index_id, offsettoptr(db, keys[2*i + 1]))) {
+      free(keys);
+      return -1;
     }
-    rec=wg_get_next_record(db,rec);
   }
+  free(keys);
+
 #ifdef WG_NO_ERRPRINT
 #else
   fprintf(stderr,"new hash index created on (");
@@ -1660,11 +1947,116 @@ static gint create_hash_index(void *db, gint index_id){
 #ifdef WG_NO_ERRPRINT
 #else
   fprintf(stderr,") into slot %d and %d data rows inserted\n",
-    (int) index_id, rowsprocessed);
+    (int) index_id, (int) count);
 #endif
   return 0;
 }
 
+/*
+ * Create a JSON path index.
+ * The index maps (path, value) to the document, where the path is the
+ * list of keys from the document root separated by '.' (arrays do not
+ * add anything to the path). The entries of the existing documents
+ * are added here, later the documents are indexed as their top-level
+ * fields are set.
+ * Returns 0 on success
+ * Returns -1 on failure.
+ */
+static gint create_json_path_index(void *db, gint index_id){
+  gint count = 0, i, reclen;
+  wg_index_header *hdr = (wg_index_header *) offsettoptr(db, index_id);
+  void *rec;
+
+  if(wg_create_hash(db, HASHIDX_ARRAYP(hdr), 0))
+    return -1;
+
+  for(rec = wg_get_first_record(db); rec; rec = wg_get_next_record(db, rec)) {
+    if(!is_schema_document(rec))
+      continue;
+    reclen = wg_get_record_len(db, rec);
+    for(i=0; i<reclen; i++) {
+      if(json_path_recurse(db, hdr, rec, NULL, wg_get_field(db, rec, i),
+        HASHIDX_OP_STORE, WG_JSON_PATH_DEPTH))
+        return -1;
+    }
+    count++;
+  }
+
+#ifdef WG_NO_ERRPRINT
+#else
+  fprintf(stderr,"new JSON path index created into slot %d and "\
+    "%d documents inserted\n", (int) index_id, (int) count);
+#endif
+  return 0;
+}
+
+/*
+ * Add or remove the path index entries of the pairs under a value
+ * in a document.
+ * path - path of the value, NULL at the document root
+ * Returns 0 on success
+ * Returns -1 on failure.
+ */
+static gint json_path_recurse(void *db, wg_index_header *hdr, void *doc,
+  char *path, gint enc, gint op, int depth) {
+  gint i, reclen, key, values[2], retv;
+  char *keystr, *newpath;
+  size_t pathlen;
+  void *rec;
+
+  if(wg_get_encoded_type(db, enc) != WG_RECORDTYPE)
+    return 0; /* literals are entered with the key of their pair */
+  if(depth <= 0) {
+    show_index_error(db, "Document too deep for the JSON path index");
+    return -1;
+  }
+
+  rec = wg_decode_record(db, enc);
+  reclen = wg_get_record_len(db, rec);
+  if(is_schema_array(rec) || is_schema_object(rec)) {
+    for(i=0; i<reclen; i++) {
+      if(json_path_recurse(db, hdr, doc, path, wg_get_field(db, rec, i),
+        op, depth-1))
+        return -1;
+    }
+    return 0;
+  }
+
+  /* Key-value pair */
+  if(reclen <= WG_SCHEMA_VALUE_OFFSET)
+    return 0;
+  key = wg_get_field(db, rec, WG_SCHEMA_KEY_OFFSET);
+  if(wg_get_encoded_type(db, key) != WG_STRTYPE)
+    return 0;
+  keystr = wg_decode_str(db, key);
+  pathlen = (path ? strlen(path) + 1 : 0);
+  newpath = malloc(pathlen + strlen(keystr) + 1);
+  if(!newpath) {
+    show_index_error(db, "Failed to allocate memory");
+    return -1;
+  }
+  if(path) {
+    memcpy(newpath, path, pathlen - 1);
+    newpath[pathlen - 1] = '.';
+  }
+  strcpy(newpath + pathlen, keystr);
+
+  values[0] = wg_encode_query_param_str(db, newpath, NULL);
+  if(values[0] == WG_ILLEGAL) {
+    free(newpath);
+    return -1;
+  }
+  values[1] = wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET);
+  retv = hash_recurse(db, hdr, NULL, 0, values, 2, doc, op, 1);
+  wg_free_query_param(db, values[0]);
+  if(op == HASHIDX_OP_REMOVE)
+    retv = 0; /* the pair may have been modified after it was indexed */
+  if(!retv)
+    retv = json_path_recurse(db, hdr, doc, newpath, values[1], op, depth-1);
+  free(newpath);
+  return retv;
+}
+
 /** Drop a hash index by id
  *  returns:
  *  0 - on success
@@ -1695,13 +2087,15 @@ gint wg_search_hash(void *db, gint index_id, gint *values, gint count) {
   gint type = wg_get_index_type(db, index_id); /* also validates the id */
   if(type < 0)
     return type;
-  if(type != WG_INDEX_TYPE_HASH && type != WG_INDEX_TYPE_HASH_JSON)
+  if(type != WG_INDEX_TYPE_HASH && type != WG_INDEX_TYPE_HASH_JSON &&\
+    type != WG_INDEX_TYPE_HASH_JSON_PATH)
     return show_index_error(db, "wg_search_hash: Not a hash index");
   if(hdr->fields != count) {
     show_index_error(db, "Number of indexed fields does not match");
     return -1;
   }
 #endif
+  WG_STAT_INC(db, WG_STAT_HASH_SEARCHES);
   return hash_recurse(db, hdr, NULL, 0, values, count, NULL,
     HASHIDX_OP_FIND, 0);
 }
@@ -1750,17 +2144,21 @@ static void delete_from_list(void *db, gint *head) {
  * Takes a gint array that represents an template for records
  * that are inserted into an index. Creates a database record
  * from that array and links the record into an ordered list.
+ * If conds is not NULL, it holds the condition that the field
+ * and the template value must satisfy for each fixed column.
+ * The conditions are stored in a second record.
  *
  * Returns offset to the created match record, if successful
  * Returns 0 on error.
  */
-static gint add_index_template(void *db, gint *matchrec, gint reclen) {
+static gint add_index_template(void *db, gint *matchrec, gint *conds,
+  gint reclen) {
   gint *ilist, *meta;
-  void *rec;
+  void *rec, *condrec = NULL;
   db_memsegment_header* dbh = dbmemsegh(db);
   wg_index_template *tmpl;
   gint fixed_columns = 0, template_offset = 0, last_fixed = 0;
-  int i;
+  int i, has_conds = 0;
 
   /* Find the number of fixed columns in the template */
   for(i=0; i<reclen; i++) {
@@ -1774,6 +2172,12 @@ static gint add_index_template(void *db, gint *matchrec, gint reclen) {
       return 0;
     }
     if(type != WG_VARTYPE) {
+      if(check_template_cond(TEMPLATE_COND(conds, i), WG_EQUAL) < 0) {
+        show_index_error(db, "Invalid condition in index template");
+        return 0;
+      }
+      if(TEMPLATE_COND(conds, i) != WG_COND_EQUAL)
+        has_conds = 1;
       fixed_columns++;
       last_fixed = i;
     }
@@ -1807,6 +2211,8 @@ static gint add_index_template(void *db, gint *matchrec, gint reclen) {
           if(WG_COMPARE(db,
             matchrec[i], wg_get_field(db, rec, i)) != WG_EQUAL)
             goto nextelem;
+          if(wg_get_template_cond(db, tmpl, i) != TEMPLATE_COND(conds, i))
+            goto nextelem;
         }
       }
       /* The entire record matched, re-use it */
@@ -1825,18 +2231,36 @@ nextelem:
   rec = wg_create_raw_record(db, reclen);
   if(!rec)
     return 0;
+  /* Mark the record before writing fields so existing indexes skip it */
+  meta = ((gint *) rec + RECORD_META_POS);
+  *meta |= (RECORD_META_NOTDATA | RECORD_META_MATCH);
   for(i=0; i<reclen; i++) {
     if(wg_set_new_field(db, rec, i, matchrec[i]) < 0)
       return 0;
   }
-  meta = ((gint *) rec + RECORD_META_POS);
-  *meta |= (RECORD_META_NOTDATA | RECORD_META_MATCH);
+
+  if(has_conds) {
+    condrec = wg_create_raw_record(db, reclen);
+    if(!condrec)
+      return 0;
+    meta = ((gint *) condrec + RECORD_META_POS);
+    *meta |= (RECORD_META_NOTDATA | RECORD_META_MATCH);
+    for(i=0; i<reclen; i++) {
+      gint cond = WG_COND_EQUAL; /* wildcards have no condition */
+      if(wg_get_encoded_type(db, matchrec[i]) != WG_VARTYPE)
+        cond = conds[i];
+      if(wg_set_new_field(db, condrec, i, wg_encode_int(db, cond)) < 0)
+        return 0;
+    }
+  }
 
   /* Add new template header */
   template_offset = wg_alloc_fixlen_object(db, &dbh->indextmpl_area_header);
   tmpl = (wg_index_template *) offsettoptr(db, template_offset);
   tmpl->offset_matchrec = ptrtooffset(db, rec);
+  tmpl->offset_conds = (condrec ? ptrtooffset(db, condrec) : 0);
   tmpl->fixed_columns = fixed_columns;
+  tmpl->refcount = 0;
 
   /* Insert it into the template list */
   if(!insert_into_list(db, ilist, template_offset))
@@ -1855,7 +2279,8 @@ nextelem:
  * Returns the template offset on success.
  * Returns 0 on error.
  */
-static gint find_index_template(void *db, gint *matchrec, gint reclen) {
+static gint find_index_template(void *db, gint *matchrec, gint *conds,
+  gint reclen) {
   gint *ilist;
   void *rec;
   db_memsegment_header* dbh = dbmemsegh(db);
@@ -1871,6 +2296,10 @@ static gint find_index_template(void *db, gint *matchrec, gint reclen) {
       return 0;
     }
     if(type != WG_VARTYPE) {
+      if(check_template_cond(TEMPLATE_COND(conds, i), WG_EQUAL) < 0) {
+        show_index_error(db, "Invalid condition in index template");
+        return 0;
+      }
       fixed_columns++;
       last_fixed = i;
     }
@@ -1899,6 +2328,8 @@ static gint find_index_template(void *db, gint *matchrec, gint reclen) {
           if(WG_COMPARE(db,
             matchrec[i], wg_get_field(db, rec, i)) != WG_EQUAL)
             goto nextelem;
+          if(wg_get_template_cond(db, tmpl, i) != TEMPLATE_COND(conds, i))
+            goto nextelem;
         }
       }
       /* We have a match. */
@@ -1929,9 +2360,11 @@ static gint remove_index_template(void *db, gint template_offset) {
 
   tmpl = (wg_index_template *) offsettoptr(db, template_offset);
 
-  /* Delete the database record */
+  /* Delete the database records */
   rec = offsettoptr(db, tmpl->offset_matchrec);
   wg_delete_record(db, rec);
+  if(tmpl->offset_conds)
+    wg_delete_record(db, offsettoptr(db, tmpl->offset_conds));
 
   /* Remove from template list */
   ilist = &dbh->index_control_area_header.index_template_list;
@@ -1984,13 +2417,56 @@ gint wg_match_template(void *db, wg_index_template *tmpl, void *rec) {
   for(i=0; i<reclen; i++) {
     gint enc = wg_get_field(db, matchrec, i);
     if(wg_get_encoded_type(db, enc) != WG_VARTYPE) {
-      if(WG_COMPARE(db, enc, wg_get_field(db, rec, i)) != WG_EQUAL)
+      gint cmp = WG_COMPARE(db, wg_get_field(db, rec, i), enc);
+      if(!tmpl->offset_conds) {
+        if(cmp != WG_EQUAL)
+          return 0;
+      }
+      else if(check_template_cond(wg_get_template_cond(db, tmpl, i),
+        cmp) != 1)
         return 0;
     }
   }
   return 1;
 }
 
+/** Return the condition of a template column
+ *
+ * The condition is the WG_COND_* value that the field of the record
+ * and the template value must satisfy, in this order. Templates
+ * created without conditions always return WG_COND_EQUAL.
+ */
+gint wg_get_template_cond(void *db, wg_index_template *tmpl, gint column) {
+  if(tmpl->offset_conds) {
+    void *condrec = offsettoptr(db, tmpl->offset_conds);
+    return wg_decode_int(db, wg_get_field(db, condrec, column));
+  }
+  return WG_COND_EQUAL;
+}
+
+/** Check the result of a comparison against a template condition
+ *  returns 1 if the condition holds, 0 if it does not
+ *  returns -1 if the condition is invalid
+ */
+static int check_template_cond(gint cond, gint cmp) {
+  switch(cond) {
+    case WG_COND_EQUAL:
+      return (cmp == WG_EQUAL);
+    case WG_COND_NOT_EQUAL:
+      return (cmp != WG_EQUAL);
+    case WG_COND_LESSTHAN:
+      return (cmp == WG_LESSTHAN);
+    case WG_COND_GREATER:
+      return (cmp == WG_GREATER);
+    case WG_COND_LTEQUAL:
+      return (cmp != WG_GREATER);
+    case WG_COND_GTEQUAL:
+      return (cmp != WG_LESSTHAN);
+    default:
+      return -1;
+  }
+}
+
 #endif
 
 /* ----------------- General index functions --------------- */
@@ -2046,6 +2522,55 @@ gint wg_create_index(void *db, gint column, gint type,
  */
 gint wg_create_multi_index(void *db, gint *columns, gint col_count, gint type,
   gint *matchrec, gint reclen)
+{
+  return create_index(db, 0, columns, col_count, type,
+    WG_INDEX_KEY_VALUE, matchrec, NULL, reclen);
+}
+
+/** Create an index on the records of a table.
+ *
+ * The arguments are the same as for wg_create_index(). Records that
+ * do not belong to the table are not inserted in the index.
+ */
+gint wg_create_table_index(void *db, gint table, gint column, gint type,
+  gint *matchrec, gint reclen)
+{
+  if(wg_get_table_record_count(db, table) < 0) {
+    show_index_error_nr(db, "Invalid table", table);
+    return -1;
+  }
+  return create_index(db, table, &column, 1, type,
+    WG_INDEX_KEY_VALUE, matchrec, NULL, reclen);
+}
+
+/** Create a partial index or an index on computed keys.
+ *
+ * Generalizes the template of wg_create_multi_index(): conds holds
+ * a WG_COND_* condition for each fixed column of matchrec and a record
+ * is inserted in the index if its field compares to the template value
+ * as given. For example, WG_COND_LESSTHAN with the value 3 selects the
+ * records where the field is less than 3. If conds is NULL, the fixed
+ * columns must be equal, as with wg_create_multi_index().
+ *
+ * key - WG_INDEX_KEY_VALUE - field values are indexed as they are
+ *       WG_INDEX_KEY_LOWER - strings are indexed in lower case
+ *       WG_INDEX_KEY_DAY - int and double timestamps (in seconds) are
+ *          truncated to the start of the day
+ * Computed keys are only supported by hash indexes. The same key
+ * function is applied to the values searched with wg_search_hash().
+ */
+gint wg_create_partial_index(void *db, gint *columns, gint col_count,
+  gint type, gint key, gint *matchrec, gint *conds, gint reclen)
+{
+  return create_index(db, 0, columns, col_count, type, key,
+    matchrec, conds, reclen);
+}
+
+/** Create an index.
+ * table - table of the indexed records, 0 for all records
+ */
+static gint create_index(void *db, gint table, gint *columns, gint col_count,
+  gint type, gint key, gint *matchrec, gint *conds, gint reclen)
 {
   gint index_id, template_offset = 0, i;
   wg_index_header *hdr;
@@ -2091,11 +2616,36 @@ gint wg_create_multi_index(void *db, gint *columns, gint col_count, gint type,
     return -1;
   }
 
+  if(key != WG_INDEX_KEY_VALUE) {
+    if(key != WG_INDEX_KEY_LOWER && key != WG_INDEX_KEY_DAY) {
+      show_index_error_nr(db, "Invalid index key function", key);
+      return -1;
+    } else if(type != WG_INDEX_TYPE_HASH && type != WG_INDEX_TYPE_HASH_JSON &&\
+      type != WG_INDEX_TYPE_HASH_JSON_PATH) {
+      show_index_error(db, "Computed keys are only supported by hash indexes");
+      return -1;
+    }
+  }
+
   if(sort_columns(sorted_cols, columns, col_count) < col_count) {
     show_index_error(db, "Duplicate columns not allowed");
     return -1;
   }
 
+  if(type == WG_INDEX_TYPE_HASH_JSON_PATH) {
+    /* Documents are indexed as a whole, the path index cannot
+     * be restricted to some of the pairs. */
+    if(col_count != 2 || sorted_cols[0] != WG_SCHEMA_KEY_OFFSET ||\
+      sorted_cols[1] != WG_SCHEMA_VALUE_OFFSET) {
+      show_index_error(db, "JSON path index must be on the key and value columns");
+      return -1;
+    }
+    if(matchrec || table) {
+      show_index_error(db, "JSON path index cannot have a template or a table");
+      return -1;
+    }
+  }
+
   for(i=0; i<col_count; i++) {
     if(sorted_cols[i] > MAX_INDEXED_FIELDNR) {
       show_index_error_nr(db, "Max allowed column number",
@@ -2127,7 +2677,7 @@ gint wg_create_multi_index(void *db, gint *columns, gint col_count, gint type,
       }
     }
 
-    template_offset = add_index_template(db, matchrec, reclen);
+    template_offset = add_index_template(db, matchrec, conds, reclen);
     if(!template_offset) {
       show_index_error(db, "Error adding index template");
       return -1;
@@ -2157,7 +2707,7 @@ gint wg_create_multi_index(void *db, gint *columns, gint col_count, gint type,
        * Note that this is simplified by having the column lists sorted.
        */
       if(!i && hdr->type==type && template_offset==hdr->template_offset &&\
-                                        hdr->fields==col_count) {
+        hdr->table==table && hdr->key==key && hdr->fields==col_count) {
         gint j, match = 1;
         /* Compare the field lists */
         for(j=0; j<col_count; j++) {
@@ -2212,10 +2762,13 @@ gint wg_create_multi_index(void *db, gint *columns, gint col_count, gint type,
     hdr->rec_field_index[i] = sorted_cols[i];
   }
   hdr->template_offset = template_offset;
+  hdr->table = table;
+  hdr->key = key;
 
   /* create the actual index */
   switch(hdr->type) {
     case WG_INDEX_TYPE_TTREE:
+    case WG_INDEX_TYPE_TTREE_JSON:
       create_ttree_index(db, index_id);
       break;
     case WG_INDEX_TYPE_HASH:
@@ -2223,8 +2776,10 @@ gint wg_create_multi_index(void *db, gint *columns, gint col_count, gint type,
       if(create_hash_index(db, index_id))
         return -1;
       break;
-    case WG_INDEX_TYPE_TTREE_JSON:
-      /* Return an error, until proper implementation exists */
+    case WG_INDEX_TYPE_HASH_JSON_PATH:
+      if(create_json_path_index(db, index_id))
+        return -1;
+      break;
     default:
       show_index_error(db, "Invalid index type");
       return -1;
@@ -2235,6 +2790,13 @@ gint wg_create_multi_index(void *db, gint *columns, gint col_count, gint type,
      &dbh->index_control_area_header.index_list ,index_id))
     return -1;
 
+  /* Path indexes are also updated when documents change */
+  if(type == WG_INDEX_TYPE_HASH_JSON_PATH) {
+    if(!insert_into_list(db,
+      &dbh->index_control_area_header.path_index_list, index_id))
+      return -1;
+  }
+
 #ifdef USE_INDEX_TEMPLATE
   if(hdr->template_offset) {
     int i;
@@ -2295,6 +2857,18 @@ gint wg_drop_index(void *db, gint index_id){
     return -1;
   }
 
+  if(hdr->type == WG_INDEX_TYPE_HASH_JSON_PATH) {
+    ilist = &dbh->index_control_area_header.path_index_list;
+    while(*ilist) {
+      ilistelem = (gcell *) offsettoptr(db, *ilist);
+      if(ilistelem->car == index_id) {
+        delete_from_list(db, ilist);
+        break;
+      }
+      ilist = &ilistelem->cdr;
+    }
+  }
+
   /* Remove the index from index table */
   for(i=0; i<hdr->fields; i++) {
     int column = hdr->rec_field_index[i];
@@ -2344,6 +2918,7 @@ gint wg_drop_index(void *db, gint index_id){
       break;
     case WG_INDEX_TYPE_HASH:
     case WG_INDEX_TYPE_HASH_JSON:
+    case WG_INDEX_TYPE_HASH_JSON_PATH:
       if(drop_hash_index(db, index_id))
         return -1;
       break;
@@ -2395,6 +2970,40 @@ gint wg_column_to_index_id(void *db, gint column, gint type,
 */
 gint wg_multi_column_to_index_id(void *db, gint *columns, gint col_count,
   gint type, gint *matchrec, gint reclen)
+{
+  return find_index_id(db, 0, columns, col_count, type,
+    WG_INDEX_KEY_VALUE, matchrec, NULL, reclen);
+}
+
+/** Find index id (index header) of a table index by column.
+ *
+ * Only finds the indexes created with wg_create_table_index().
+ */
+gint wg_table_column_to_index_id(void *db, gint table, gint column,
+  gint type, gint *matchrec, gint reclen)
+{
+  return find_index_id(db, table, &column, 1, type,
+    WG_INDEX_KEY_VALUE, matchrec, NULL, reclen);
+}
+
+/** Find index id (index header) of a partial index.
+ *
+ * Finds the indexes created with wg_create_partial_index(). The
+ * key function and the conditions must match those of the index.
+ */
+gint wg_partial_column_to_index_id(void *db, gint *columns, gint col_count,
+  gint type, gint key, gint *matchrec, gint *conds, gint reclen)
+{
+  return find_index_id(db, 0, columns, col_count, type, key,
+    matchrec, conds, reclen);
+}
+
+/** Find index id (index header) by table and column(s)
+ * table - table of the indexed records, 0 for indexes on all records
+ */
+static gint find_index_id(void *db, gint table, gint *columns,
+  gint col_count, gint type, gint key, gint *matchrec, gint *conds,
+  gint reclen)
 {
   int i;
   gint template_offset = 0;
@@ -2417,7 +3026,7 @@ gint wg_multi_column_to_index_id(void *db, gint *columns, gint col_count,
       return -1;
     }
 
-    template_offset = find_index_template(db, matchrec, reclen);
+    template_offset = find_index_template(db, matchrec, conds, reclen);
     if(!template_offset) {
       /* No matching template */
       return -1;
@@ -2460,10 +3069,11 @@ gint wg_multi_column_to_index_id(void *db, gint *columns, gint col_count,
       wg_index_header *hdr = \
         (wg_index_header *) offsettoptr(db, ilistelem->car);
 #ifndef USE_INDEX_TEMPLATE
-      if(!type || type==hdr->type) {
+      if((!type || type==hdr->type) && hdr->table == table &&\
+         hdr->key == key) {
 #else
-      if((!type || type==hdr->type) &&\
-         hdr->template_offset == template_offset) {
+      if((!type || type==hdr->type) && hdr->table == table &&\
+         hdr->key == key && hdr->template_offset == template_offset) {
 #endif
         if(hdr->fields == col_count) {
           for(i=0; i<col_count; i++) {
@@ -2512,6 +3122,70 @@ gint wg_get_index_type(void *db, gint index_id) {
   return hdr->type;
 }
 
+/** Return the table of an index by index id
+*
+*  returns:
+*  -1 if no index found
+*  0 if the index holds records of all tables
+*  table id > 0 if the index was created with wg_create_table_index()
+*/
+gint wg_get_index_table(void *db, gint index_id) {
+  wg_index_header *hdr = NULL;
+  gint *ilist;
+  gcell *ilistelem;
+  db_memsegment_header* dbh = dbmemsegh(db);
+
+  /* Locate the header */
+  ilist = &dbh->index_control_area_header.index_list;
+  while(*ilist) {
+    ilistelem = (gcell *) offsettoptr(db, *ilist);
+    if(ilistelem->car == index_id) {
+      hdr = (wg_index_header *) offsettoptr(db, index_id);
+      break;
+    }
+    ilist = &ilistelem->cdr;
+  }
+
+  if(!hdr) {
+    show_index_error_nr(db, "Invalid index_id", index_id);
+    return -1;
+  }
+
+  return hdr->table;
+}
+
+/** Return the key function of an index by index id
+*
+*  returns:
+*  -1 if no index found
+*  WG_INDEX_KEY_VALUE if the field values are indexed as they are
+*  WG_INDEX_KEY_* if the index was created with a computed key
+*/
+gint wg_get_index_key(void *db, gint index_id) {
+  wg_index_header *hdr = NULL;
+  gint *ilist;
+  gcell *ilistelem;
+  db_memsegment_header* dbh = dbmemsegh(db);
+
+  /* Locate the header */
+  ilist = &dbh->index_control_area_header.index_list;
+  while(*ilist) {
+    ilistelem = (gcell *) offsettoptr(db, *ilist);
+    if(ilistelem->car == index_id) {
+      hdr = (wg_index_header *) offsettoptr(db, index_id);
+      break;
+    }
+    ilist = &ilistelem->cdr;
+  }
+
+  if(!hdr) {
+    show_index_error_nr(db, "Invalid index_id", index_id);
+    return -1;
+  }
+
+  return hdr->key;
+}
+
 /** Return index template by index id
 *
 * Returns a pointer to the gint array used for the index template.
@@ -2612,8 +3286,9 @@ void * wg_get_all_indexes(void *db, gint *count) {
   return res;
 }
 
+/* Indexes scoped to a table only hold the records of that table */
 #define INDEX_ADD_ROW(d, h, i, r) \
-  switch(h->type) { \
+  if(MATCH_TABLE(h, r)) switch(h->type) { \
     case WG_INDEX_TYPE_TTREE: \
       if(ttree_add_row(d, i, r)) \
         return -2; \
@@ -2634,13 +3309,15 @@ void * wg_get_all_indexes(void *db, gint *count) {
           return -2; \
       } \
       break; \
+    case WG_INDEX_TYPE_HASH_JSON_PATH: \
+      break; /* updated through the document */ \
     default: \
       show_index_error(db, "unknown index type, ignoring"); \
       break; \
   }
 
 #define INDEX_REMOVE_ROW(d, h, i, r) \
-  switch(h->type) { \
+  if(MATCH_TABLE(h, r)) switch(h->type) { \
     case WG_INDEX_TYPE_TTREE: \
       if(ttree_remove_row(d, i, r) < -2) \
         return -2; \
@@ -2661,6 +3338,8 @@ void * wg_get_all_indexes(void *db, gint *count) {
           return -2; \
       } \
       break; \
+    case WG_INDEX_TYPE_HASH_JSON_PATH: \
+      break; /* updated through the document */ \
     default: \
       show_index_error(db, "unknown index type, ignoring"); \
       break; \
@@ -2748,6 +3427,11 @@ gint wg_index_add_rec(void *db, void *rec) {
     return -1;
 #endif
 
+  if(is_schema_document(rec)) {
+    if(json_path_doc(db, rec, HASHIDX_OP_STORE))
+      return -2;
+  }
+
   if(reclen > MAX_INDEXED_FIELDNR)
     reclen = MAX_INDEXED_FIELDNR + 1;
 
@@ -2771,6 +3455,8 @@ gint wg_index_add_rec(void *db, void *rec) {
            * For a single-column index, the indexed column is
            * also the last column, therefore the above is valid,
            * altough the check is unnecessary.
+           * Indexes with a template are on this list as well, so
+           * they are also updated here, if the record matches.
            */
           if(MATCH_TEMPLATE(db, hdr, rec)) {
             INDEX_ADD_ROW(db, hdr, ilistelem->car, rec)
@@ -2780,55 +3466,151 @@ gint wg_index_add_rec(void *db, void *rec) {
       ilist = &ilistelem->cdr;
     }
 
-#ifdef USE_INDEX_TEMPLATE
-    ilist = &dbh->index_control_area_header.index_template_table[i];
-    while(*ilist) {
-      ilistelem = (gcell *) offsettoptr(db, *ilist);
-      if(ilistelem->car) {
-        wg_index_header *hdr = \
-          (wg_index_header *) offsettoptr(db, ilistelem->car);
-        wg_index_template *tmpl = \
-          (wg_index_template *) offsettoptr(db, hdr->template_offset);
-        void *matchrec;
-        gint mreclen;
-        int j, firstmatch = -1;
-
-        /* Here the check for a match is slightly more complicated.
-         * If there is a match *but* the current column is not the
-         * first fixed one in the template, the match has
-         * already occurred earlier.
-         */
-        matchrec = offsettoptr(db, tmpl->offset_matchrec);
-        mreclen = wg_get_record_len(db, matchrec);
-        if(mreclen > reclen) {
-          goto nexttmpl1;
-        }
-        for(j=0; j<mreclen; j++) {
-          gint enc = wg_get_field(db, matchrec, j);
-          if(wg_get_encoded_type(db, enc) != WG_VARTYPE) {
-            if(WG_COMPARE(db, enc, wg_get_field(db, rec, j)) != WG_EQUAL)
-              goto nexttmpl1;
-            if(firstmatch < 0)
-              firstmatch = j;
-          }
+  }
+  return 0;
+}
+
+/** Add data of several records to all indexes
+ * Bulk version of wg_index_add_rec(). Each index is updated in turn
+ * with all the records that qualify for it. T-tree indexes receive the
+ * records in key order, so that consecutive inserts land in the same
+ * or neighbouring nodes instead of being scattered over the tree.
+ * returns 0 on success, -2 on error
+ */
+gint wg_index_add_recs(void *db, void **recs, gint count) {
+  gint *ilist, *keys, *tmp;
+  gcell *ilistelem;
+  db_memsegment_header* dbh = dbmemsegh(db);
+
+  if(count <= 0 || !dbh->index_control_area_header.number_of_indexes)
+    return 0;
+
+  if(dbh->index_control_area_header.path_index_list) {
+    gint i;
+    for(i=0; i<count; i++) {
+      if(!is_special_record(recs[i]) && is_schema_document(recs[i])) {
+        if(json_path_doc(db, recs[i], HASHIDX_OP_STORE))
+          return -2;
+      }
+    }
+  }
+
+  /* (key, offset) pairs and the work area for sorting them */
+  keys = (gint *) malloc(4 * count * sizeof(gint));
+  if(!keys) {
+    show_index_error(db, "Memory allocation failed");
+    return -2;
+  }
+  tmp = keys + 2 * count;
+
+  ilist = &dbh->index_control_area_header.index_list;
+  while(*ilist) {
+    ilistelem = (gcell *) offsettoptr(db, *ilist);
+    if(ilistelem->car) {
+      wg_index_header *hdr = \
+        (wg_index_header *) offsettoptr(db, ilistelem->car);
+      gint i, n = 0;
+
+      /* Same conditions as in wg_index_add_rec() */
+      for(i=0; i<count; i++) {
+        if(!is_special_record(recs[i]) &&\
+          wg_get_record_len(db, recs[i]) >\
+            hdr->rec_field_index[hdr->fields - 1] &&\
+          MATCH_TEMPLATE(db, hdr, recs[i])) {
+          keys[2*n] = wg_get_field(db, recs[i], hdr->rec_field_index[0]);
+          keys[2*n + 1] = ptrtooffset(db, recs[i]);
+          n++;
         }
-        if(firstmatch==i &&\
-          reclen > hdr->rec_field_index[hdr->fields - 1]) {
-          /* The record matches AND this is the first time we
-           * see this index. Update it.
-           */
-          INDEX_ADD_ROW(db, hdr, ilistelem->car, rec)
+      }
+
+      if(hdr->type == WG_INDEX_TYPE_TTREE ||\
+        hdr->type == WG_INDEX_TYPE_TTREE_JSON) {
+        sort_index_keys(db, keys, tmp, n);
+      }
+      for(i=0; i<n; i++) {
+        if(add_index_row(db, hdr, ilistelem->car,
+          offsettoptr(db, keys[2*i + 1]))) {
+          free(keys);
+          return -2;
         }
       }
-nexttmpl1:
-      ilist = &ilistelem->cdr;
     }
-#endif
+    ilist = &ilistelem->cdr;
+  }
+
+  free(keys);
+  return 0;
+}
+
+/** Add the pairs under a field of a document to the JSON path indexes.
+ * Called after the field of a top-level document record is set.
+ * returns 0 for success
+ * returns -2 for error (insert failed, index is no longer consistent)
+ */
+gint wg_index_add_doc_field(void *db, void *doc, gint column) {
+  return json_path_doc_field(db, doc, column, HASHIDX_OP_STORE);
+}
 
+/** Remove the pairs under a field of a document from the JSON path
+ * indexes. Called before the field of a top-level document is changed.
+ * returns 0 for success
+ * returns -2 for error
+ */
+gint wg_index_del_doc_field(void *db, void *doc, gint column) {
+  return json_path_doc_field(db, doc, column, HASHIDX_OP_REMOVE);
+}
+
+/** Update all JSON path indexes with the contents of a document.
+ * returns 0 for success, -2 for error
+ */
+static gint json_path_doc(void *db, void *doc, gint op) {
+  gint i, reclen;
+
+  if(!dbmemsegh(db)->index_control_area_header.path_index_list)
+    return 0;
+  reclen = wg_get_record_len(db, doc);
+  for(i=0; i<reclen; i++) {
+    if(json_path_doc_field(db, doc, i, op))
+      return -2;
+  }
+  return 0;
+}
+
+/** Update all JSON path indexes with the contents of a document field.
+ * returns 0 for success, -2 for error
+ */
+static gint json_path_doc_field(void *db, void *doc, gint column, gint op) {
+  gint *ilist;
+  gcell *ilistelem;
+  db_memsegment_header* dbh = dbmemsegh(db);
+  gint enc = wg_get_field(db, doc, column);
+
+  if(wg_get_encoded_type(db, enc) != WG_RECORDTYPE)
+    return 0;
+  ilist = &dbh->index_control_area_header.path_index_list;
+  while(*ilist) {
+    ilistelem = (gcell *) offsettoptr(db, *ilist);
+    if(ilistelem->car) {
+      wg_index_header *hdr = \
+        (wg_index_header *) offsettoptr(db, ilistelem->car);
+      if(json_path_recurse(db, hdr, doc, NULL, enc, op,
+        WG_JSON_PATH_DEPTH))
+        return -2;
+    }
+    ilist = &ilistelem->cdr;
   }
   return 0;
 }
 
+/** Add one record to one index.
+ * returns 0 on success, -2 on error
+ */
+static gint add_index_row(void *db, wg_index_header *hdr, gint index_id,
+  void *rec) {
+  INDEX_ADD_ROW(db, hdr, index_id, rec)
+  return 0;
+}
+
 /** Delete data of one field from all indexes
  * Loops over indexes in one column and removes the references
  * to the record from all of them.
@@ -2910,6 +3692,11 @@ gint wg_index_del_rec(void *db, void *rec) {
     return -1;
 #endif
 
+  if(is_schema_document(rec)) {
+    if(json_path_doc(db, rec, HASHIDX_OP_REMOVE))
+      return -2;
+  }
+
   if(reclen > MAX_INDEXED_FIELDNR)
     reclen = MAX_INDEXED_FIELDNR + 1;
 
@@ -2936,47 +3723,6 @@ gint wg_index_del_rec(void *db, void *rec) {
       ilist = &ilistelem->cdr;
     }
 
-#ifdef USE_INDEX_TEMPLATE
-    ilist = &dbh->index_control_area_header.index_template_table[i];
-    while(*ilist) {
-      ilistelem = (gcell *) offsettoptr(db, *ilist);
-      if(ilistelem->car) {
-        wg_index_header *hdr = \
-          (wg_index_header *) offsettoptr(db, ilistelem->car);
-        wg_index_template *tmpl = \
-          (wg_index_template *) offsettoptr(db, hdr->template_offset);
-        void *matchrec;
-        gint mreclen;
-        int j, firstmatch = -1;
-
-        /* Similar check as in wg_index_add_rec() */
-        matchrec = offsettoptr(db, tmpl->offset_matchrec);
-        mreclen = wg_get_record_len(db, matchrec);
-        if(mreclen > reclen) {
-          goto nexttmpl2; /* no match */
-        }
-        for(j=0; j<mreclen; j++) {
-          gint enc = wg_get_field(db, matchrec, j);
-          if(wg_get_encoded_type(db, enc) != WG_VARTYPE) {
-            if(WG_COMPARE(db, enc, wg_get_field(db, rec, j)) != WG_EQUAL)
-              goto nexttmpl2;
-            if(firstmatch < 0)
-              firstmatch = j;
-          }
-        }
-        if(firstmatch==i &&\
-          reclen > hdr->rec_field_index[hdr->fields - 1]) {
-          /* The record matches AND this is the first time we
-           * see this index. Update it.
-           */
-          INDEX_REMOVE_ROW(db, hdr, ilistelem->car, rec)
-        }
-      }
-nexttmpl2:
-      ilist = &ilistelem->cdr;
-    }
-#endif
-
   }
   return 0;
 }
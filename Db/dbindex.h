@@ -64,10 +64,22 @@
         (wg_index_template *) offsettoptr(d, h->template_offset), r) : 1)
 #endif
 
+/* Check if record belongs to the table of the index */
+#define MATCH_TABLE(h, r) (!h->table || record_table(r) == h->table)
+
 #define WG_INDEX_TYPE_TTREE         50
 #define WG_INDEX_TYPE_TTREE_JSON    51
 #define WG_INDEX_TYPE_HASH          60
 #define WG_INDEX_TYPE_HASH_JSON     61
+#define WG_INDEX_TYPE_HASH_JSON_PATH 62
+
+/* Nesting of records followed in JSON path indexes and queries. Each
+ * level of a JSON document takes two records (object and pair). */
+#define WG_JSON_PATH_DEPTH          200
+
+#define WG_INDEX_KEY_VALUE          0   /** field value as is */
+#define WG_INDEX_KEY_LOWER          1   /** strings in lower case */
+#define WG_INDEX_KEY_DAY            2   /** timestamps truncated to a day */
 
 /* Index header helpers */
 #define TTREE_ROOT_NODE(x) (x->ctl.t.offset_root_node)
@@ -116,6 +128,16 @@ gint wg_multi_column_to_index_id(void *db, gint *columns, gint col_count,
 gint wg_get_index_type(void *db, gint index_id);
 void * wg_get_index_template(void *db, gint index_id, gint *reclen);
 void * wg_get_all_indexes(void *db, gint *count);
+gint wg_create_table_index(void *db, gint table, gint column, gint type,
+  gint *matchrec, gint reclen);
+gint wg_table_column_to_index_id(void *db, gint table, gint column,
+  gint type, gint *matchrec, gint reclen);
+gint wg_get_index_table(void *db, gint index_id);
+gint wg_create_partial_index(void *db, gint *columns, gint col_count,
+  gint type, gint key, gint *matchrec, gint *conds, gint reclen);
+gint wg_partial_column_to_index_id(void *db, gint *columns, gint col_count,
+  gint type, gint key, gint *matchrec, gint *conds, gint reclen);
+gint wg_get_index_key(void *db, gint index_id);
 
 /* WhiteDB internal functions */
 
@@ -140,12 +162,16 @@ gint wg_search_hash(void *db, gint index_id, gint *values, gint count);
 
 #ifdef USE_INDEX_TEMPLATE
 gint wg_match_template(void *db, wg_index_template *tmpl, void *rec);
+gint wg_get_template_cond(void *db, wg_index_template *tmpl, gint column);
 #endif
 
 gint wg_index_add_field(void *db, void *rec, gint column);
 gint wg_index_add_rec(void *db, void *rec);
+gint wg_index_add_recs(void *db, void **recs, gint count);
 gint wg_index_del_field(void *db, void *rec, gint column);
 gint wg_index_del_rec(void *db, void *rec);
+gint wg_index_add_doc_field(void *db, void *doc, gint column);
+gint wg_index_del_doc_field(void *db, void *doc, gint column);
 
 
 #endif /* DEFINED_DBINDEX_H */
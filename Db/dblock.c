@@ -36,6 +36,7 @@
 /* ====== Includes =============== */
 
 #include <stdio.h>
+#include <string.h>
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -55,6 +56,7 @@ extern "C" {
 #endif
 #include "dballoc.h"
 #include "dblock.h"
+#include "dbstats.h"
 
 #if (LOCK_PROTO==TFQUEUE)
 #ifdef __linux__
@@ -146,6 +148,25 @@ typedef int (kernel_cmpxchg_t) (int oldval, int newval, int *ptr);
   ts.tv_sec = t / 1000; \
   ts.tv_nsec = t % 1000;
 
+/* Lock timing: count spin loop iterations and sleeps of the
+ * current lock request.
+ */
+#ifdef USE_LOCKSTATS
+#define LOCKSTAT_SPIN lockstat_spins++;
+#define LOCKSTAT_SLEEP lockstat_sleeps++;
+#else
+#define LOCKSTAT_SPIN
+#define LOCKSTAT_SLEEP
+#endif
+
+#ifdef USE_LOCKSTATS
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+#endif
+
 #define ALLOC_LOCK(d, l) \
   l = alloc_lock(d); \
   if(!l) { \
@@ -166,6 +187,17 @@ typedef int (kernel_cmpxchg_t) (int oldval, int newval, int *ptr);
     dbh->locks.tail = lp->prev; \
   }
 
+/* ====== Data ========================= */
+
+#ifdef USE_LOCKSTATS
+/* State of the lock request/lock held by the current thread */
+static THREAD_LOCAL gint lockstat_tag = 0;
+static THREAD_LOCAL gint lockstat_spins = 0;
+static THREAD_LOCAL gint lockstat_sleeps = 0;
+static THREAD_LOCAL gint lockstat_held_tag = 0;
+static THREAD_LOCAL gint64 lockstat_held_since = 0;
+#endif
+
 /* ======= Private protos ================ */
 
 
@@ -197,6 +229,15 @@ static void futex_wake(volatile gint *addr1, int val1);
 #endif
 #endif
 
+#ifdef USE_LOCKSTATS
+static gint64 lockstat_now(void);
+static int lockstat_bucket(gint64 nsec);
+static void lockstat_add(volatile gint *ptr, gint incr);
+static gint64 lockstat_wait_start(void);
+static void lockstat_acquired(void *db, int mode, gint64 start, gint lock);
+static void lockstat_released(void *db, int mode);
+#endif
+
 static gint show_lock_error(void *db, char *errmsg);
 
 
@@ -471,7 +512,19 @@ gint wg_compare_and_swap(volatile gint *ptr, gint oldv, gint newv) {
  */
 
 gint wg_start_write(void * db) {
-  return db_wlock(db, DEFAULT_LOCK_TIMEOUT);
+  gint lock;
+#ifdef USE_LOCKSTATS
+  gint64 start = lockstat_wait_start();
+#endif
+  lock = db_wlock(db, DEFAULT_LOCK_TIMEOUT);
+#ifdef USE_DBSTATS
+  if(lock)
+    WG_STAT_INC(db, WG_STAT_WRITE_LOCKS);
+#endif
+#ifdef USE_LOCKSTATS
+  lockstat_acquired(db, WG_LOCKSTAT_WRITE, start, lock);
+#endif
+  return lock;
 }
 
 /** End write transaction
@@ -479,6 +532,9 @@ gint wg_start_write(void * db) {
  */
 
 gint wg_end_write(void * db, gint lock) {
+#ifdef USE_LOCKSTATS
+  lockstat_released(db, WG_LOCKSTAT_WRITE);
+#endif
   return db_wulock(db, lock);
 }
 
@@ -487,7 +543,19 @@ gint wg_end_write(void * db, gint lock) {
  */
 
 gint wg_start_read(void * db) {
-  return db_rlock(db, DEFAULT_LOCK_TIMEOUT);
+  gint lock;
+#ifdef USE_LOCKSTATS
+  gint64 start = lockstat_wait_start();
+#endif
+  lock = db_rlock(db, DEFAULT_LOCK_TIMEOUT);
+#ifdef USE_DBSTATS
+  if(lock)
+    WG_STAT_INC(db, WG_STAT_READ_LOCKS);
+#endif
+#ifdef USE_LOCKSTATS
+  lockstat_acquired(db, WG_LOCKSTAT_READ, start, lock);
+#endif
+  return lock;
 }
 
 /** End read transaction
@@ -495,6 +563,9 @@ gint wg_start_read(void * db) {
  */
 
 gint wg_end_read(void * db, gint lock) {
+#ifdef USE_LOCKSTATS
+  lockstat_released(db, WG_LOCKSTAT_READ);
+#endif
   return db_rulock(db, lock);
 }
 
@@ -544,6 +615,7 @@ gint db_rpspin_wlock(void * db) {
   /* First attempt at getting the lock without spinning */
   if(compare_and_swap(gl, 0, WAFLAG))
     return 1;
+  WG_STAT_INC(db, WG_STAT_WRITE_LOCK_WAITS);
 
 #ifdef _WIN32
   ts = SLEEP_MSEC;
@@ -560,6 +632,7 @@ gint db_rpspin_wlock(void * db) {
   for(;;) {
     for(i=0; i<SPIN_COUNT; i++) {
       MM_PAUSE
+      LOCKSTAT_SPIN
       if(!(*gl) && compare_and_swap(gl, 0, WAFLAG))
         return 1;
     }
@@ -569,15 +642,19 @@ gint db_rpspin_wlock(void * db) {
      */
 #ifdef USE_LOCK_TIMEOUT
     UPDATE_SPIN_TIMEOUT(timeout, ts)
-    if(timeout < 0)
+    if(timeout < 0) {
+      WG_STAT_INC(db, WG_STAT_LOCK_TIMEOUTS);
       return 0;
+    }
 #endif
 
     /* Give up the CPU so the lock holder(s) can continue */
 #ifdef _WIN32
+    LOCKSTAT_SLEEP
     Sleep(ts);
     ts += SLEEP_MSEC;
 #else
+    LOCKSTAT_SLEEP
     nanosleep(&ts, NULL);
     ts.tv_nsec += SLEEP_NSEC;
 #endif
@@ -641,6 +718,7 @@ gint db_rpspin_rlock(void * db) {
 
   /* Try getting the lock without pause */
   if(!((*gl) & WAFLAG)) return 1;
+  WG_STAT_INC(db, WG_STAT_READ_LOCK_WAITS);
 
 #ifdef _WIN32
   ts = SLEEP_MSEC;
@@ -657,6 +735,7 @@ gint db_rpspin_rlock(void * db) {
   for(;;) {
     for(i=0; i<SPIN_COUNT; i++) {
       MM_PAUSE
+      LOCKSTAT_SPIN
       if(!((*gl) & WAFLAG)) return 1;
     }
 
@@ -664,6 +743,7 @@ gint db_rpspin_rlock(void * db) {
 #ifdef USE_LOCK_TIMEOUT
     UPDATE_SPIN_TIMEOUT(timeout, ts)
     if(timeout < 0) {
+      WG_STAT_INC(db, WG_STAT_LOCK_TIMEOUTS);
       /* We're no longer waiting, restore the counter */
       fetch_and_add(gl, -RC_INCR);
       return 0;
@@ -671,9 +751,11 @@ gint db_rpspin_rlock(void * db) {
 #endif
 
 #ifdef _WIN32
+    LOCKSTAT_SLEEP
     Sleep(ts);
     ts += SLEEP_MSEC;
 #else
+    LOCKSTAT_SLEEP
     nanosleep(&ts, NULL);
     ts.tv_nsec += SLEEP_NSEC;
 #endif
@@ -739,6 +821,7 @@ gint db_wpspin_wlock(void * db) {
   /* First attempt at getting the lock without spinning */
   if(compare_and_swap(gl, 0, WAFLAG))
     return 1;
+  WG_STAT_INC(db, WG_STAT_WRITE_LOCK_WAITS);
 
 #ifdef _WIN32
   ts = SLEEP_MSEC;
@@ -755,6 +838,7 @@ gint db_wpspin_wlock(void * db) {
   for(;;) {
     for(i=0; i<SPIN_COUNT; i++) {
       MM_PAUSE
+      LOCKSTAT_SPIN
       if(!(*gl) && compare_and_swap(gl, 0, WAFLAG))
         return 1;
     }
@@ -763,6 +847,7 @@ gint db_wpspin_wlock(void * db) {
 #ifdef USE_LOCK_TIMEOUT
     UPDATE_SPIN_TIMEOUT(timeout, ts)
     if(timeout < 0) {
+      WG_STAT_INC(db, WG_STAT_LOCK_TIMEOUTS);
       /* Restore the previous writer count */
       atomic_increment(w, -1);
       return 0;
@@ -771,9 +856,11 @@ gint db_wpspin_wlock(void * db) {
 
     /* Give up the CPU so the lock holder(s) can continue */
 #ifdef _WIN32
+    LOCKSTAT_SLEEP
     Sleep(ts);
     ts += SLEEP_MSEC;
 #else
+    LOCKSTAT_SLEEP
     nanosleep(&ts, NULL);
     ts.tv_nsec += SLEEP_NSEC;
 #endif
@@ -842,6 +929,7 @@ gint db_wpspin_rlock(void * db) {
     if(compare_and_swap(gl, readers, readers + RC_INCR))
       return 1;
   }
+  WG_STAT_INC(db, WG_STAT_READ_LOCK_WAITS);
 
 #ifdef USE_LOCK_TIMEOUT
   INIT_SPIN_TIMEOUT(timeout)
@@ -859,19 +947,24 @@ gint db_wpspin_rlock(void * db) {
     while(*w) {
       for(i=0; i<SPIN_COUNT; i++) {
         MM_PAUSE
+        LOCKSTAT_SPIN
         if(!(*w)) goto no_writers;
       }
 
 #ifdef USE_LOCK_TIMEOUT
       UPDATE_SPIN_TIMEOUT(timeout, ts)
-      if(timeout < 0)
+      if(timeout < 0) {
+        WG_STAT_INC(db, WG_STAT_LOCK_TIMEOUTS);
         return 0;
+      }
 #endif
 
 #ifdef _WIN32
+      LOCKSTAT_SLEEP
       Sleep(ts);
       ts += SLEEP_MSEC;
 #else
+      LOCKSTAT_SLEEP
       nanosleep(&ts, NULL);
       ts.tv_nsec += SLEEP_NSEC;
 #endif
@@ -950,15 +1043,18 @@ static void lock_queue(void * db) {
   for(;;) {
     for(i=0; i<SPIN_COUNT; i++) {
       MM_PAUSE
+      LOCKSTAT_SPIN
       if(!(*gl) && compare_and_swap(gl, 0, 1))
         return;
     }
 
     /* Backoff */
 #ifdef _WIN32
+    LOCKSTAT_SLEEP
     Sleep(ts);
     ts += SLEEP_MSEC;
 #else
+    LOCKSTAT_SLEEP
     nanosleep(&ts, NULL);
     ts.tv_nsec += SLEEP_NSEC;
 #endif
@@ -1025,10 +1121,12 @@ gint db_tfqueue_wlock(void * db) {
   unlock_queue(db);
 
   if(lockp->waiting) {
+    WG_STAT_INC(db, WG_STAT_WRITE_LOCK_WAITS);
 #ifdef __linux__
 #ifdef USE_LOCK_TIMEOUT
     INIT_QLOCK_TIMEOUT(timeout, ts)
     if(futex_trywait(&lockp->waiting, 1, &ts) == ETIMEDOUT) {
+      WG_STAT_INC(db, WG_STAT_LOCK_TIMEOUTS);
       lock_queue(db);
       DEQUEUE_LOCK(db, dbh, lock, lockp)
       free_lock(db, lock);
@@ -1142,10 +1240,12 @@ gint db_tfqueue_rlock(void * db) {
 
   if(lockp->waiting) {
     volatile gint *syn_addr = NULL;
+    WG_STAT_INC(db, WG_STAT_READ_LOCK_WAITS);
 #ifdef __linux__
 #ifdef USE_LOCK_TIMEOUT
     INIT_QLOCK_TIMEOUT(timeout, ts)
     if(futex_trywait(&lockp->waiting, 1, &ts) == ETIMEDOUT) {
+      WG_STAT_INC(db, WG_STAT_LOCK_TIMEOUTS);
       lock_queue(db);
       DEQUEUE_LOCK(db, dbh, lock, lockp)
       free_lock(db, lock);
@@ -1273,6 +1373,203 @@ gint wg_init_locks(void * db) {
   return 0;
 }
 
+/* ------------ lock timing ---------------- */
+
+/*
+ * If compiled with USE_LOCKSTATS, the API lock functions measure
+ * the time spent waiting for the lock and the time the lock is held.
+ * The times are collected into histograms in the shared memory
+ * segment, so that all the processes using the database contribute
+ * to them. Each thread may select a call site tag that the
+ * following lock requests are accounted under.
+ */
+
+#ifdef USE_LOCKSTATS
+
+/** Initialize the lock timing area.
+ *   Called during database initialization.
+ */
+void wg_init_lockstats(void *db) {
+  db_lockstats_area *ls = &(dbmemsegh(db)->lockstats);
+  memset(ls, 0, sizeof(db_lockstats_area));
+  strcpy(ls->tag_name[0], "default");
+  ls->tag_used[0] = 2;
+}
+
+/** Current time in nanoseconds (monotonic clock).
+ */
+static gint64 lockstat_now(void) {
+#ifdef _WIN32
+  LARGE_INTEGER cnt, freq;
+  QueryPerformanceCounter(&cnt);
+  QueryPerformanceFrequency(&freq);
+  return (gint64) (cnt.QuadPart * (1000000000.0 / freq.QuadPart));
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((gint64) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/** Find the log2 histogram bucket for a time value.
+ */
+static int lockstat_bucket(gint64 nsec) {
+  int b = 0;
+  while(nsec > 1 && b < WG_LOCKSTAT_BUCKETS-1) {
+    nsec >>= 1;
+    b++;
+  }
+  return b;
+}
+
+/** Add to a histogram counter. Readers update the counters
+ *  concurrently, so the addition needs to be atomic.
+ */
+static void lockstat_add(volatile gint *ptr, gint incr) {
+  gint old;
+  do {
+    old = *ptr;
+  } while(!compare_and_swap(ptr, old, old + incr));
+}
+
+/** Start timing a lock request.
+ */
+static gint64 lockstat_wait_start(void) {
+  lockstat_spins = 0;
+  lockstat_sleeps = 0;
+  return lockstat_now();
+}
+
+/** Account a completed lock request.
+ *   lock is the value returned by the locking function,
+ *   0 means that the request timed out.
+ */
+static void lockstat_acquired(void *db, int mode, gint64 start, gint lock) {
+  gint64 now = lockstat_now();
+  db_lockstat_hist *h;
+
+#ifdef CHECK
+  if(!dbcheck(db))
+    return;
+#endif
+  h = &(dbmemsegh(db)->lockstats.hist[lockstat_tag][mode]);
+  if(lockstat_spins)
+    lockstat_add(&(h->spins), lockstat_spins);
+  if(lockstat_sleeps)
+    lockstat_add(&(h->sleeps), lockstat_sleeps);
+  if(!lock) {
+    lockstat_add(&(h->timeouts), 1);
+    return;
+  }
+  lockstat_add(&(h->count), 1);
+  lockstat_add(&(h->wait[lockstat_bucket(now - start)]), 1);
+  lockstat_held_tag = lockstat_tag;
+  lockstat_held_since = now;
+}
+
+/** Account the hold time of a lock that is being released.
+ *   Called while the lock is still held.
+ */
+static void lockstat_released(void *db, int mode) {
+  db_lockstat_hist *h;
+
+  if(!lockstat_held_since)
+    return;
+#ifdef CHECK
+  if(!dbcheck(db))
+    return;
+#endif
+  h = &(dbmemsegh(db)->lockstats.hist[lockstat_held_tag][mode]);
+  lockstat_add(&(h->hold[lockstat_bucket(lockstat_now() - \
+    lockstat_held_since)]), 1);
+  lockstat_held_since = 0;
+}
+
+#endif /* USE_LOCKSTATS */
+
+/** Find or register a lock timing call site tag.
+ *   The tag names are stored in the database and shared by all
+ *   processes. Tag 0 ("default") is used for lock requests
+ *   of threads that have not selected a tag.
+ *
+ *   returns the tag id (>= 0)
+ *   returns -1 if the tag table is full or lock timing is not enabled.
+ */
+gint wg_lock_tag(void *db, char *name) {
+#ifdef USE_LOCKSTATS
+  db_lockstats_area *ls;
+  gint i;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_lock_error(db, "Invalid database pointer in wg_lock_tag");
+    return -1;
+  }
+#endif
+  if(!name || !name[0])
+    return -1;
+  ls = &(dbmemsegh(db)->lockstats);
+
+  for(i=0; i<WG_LOCKSTAT_TAGS; i++) {
+    if(ls->tag_used[i] == 2 &&\
+      !strncmp(ls->tag_name[i], name, WG_LOCKSTAT_TAGLEN-1))
+      return i;
+  }
+  /* Claim a free slot. Two processes registering the same name
+   * at the same time may both get a slot; that is harmless. */
+  for(i=0; i<WG_LOCKSTAT_TAGS; i++) {
+    if(!ls->tag_used[i] && compare_and_swap(&(ls->tag_used[i]), 0, 1)) {
+      strncpy(ls->tag_name[i], name, WG_LOCKSTAT_TAGLEN-1);
+      ls->tag_name[i][WG_LOCKSTAT_TAGLEN-1] = '\0';
+      ls->tag_used[i] = 2;
+      return i;
+    }
+  }
+  show_lock_error(db, "Lock timing tag table is full");
+  return -1;
+#else
+  return -1;
+#endif
+}
+
+/** Select the call site tag for lock requests of the current thread.
+ *
+ *   returns the previously selected tag
+ *   returns -1 if the tag is invalid or lock timing is not enabled.
+ */
+gint wg_set_lock_tag(void *db, gint tag) {
+#ifdef USE_LOCKSTATS
+  gint prev = lockstat_tag;
+  if(tag < 0 || tag >= WG_LOCKSTAT_TAGS)
+    return -1;
+  lockstat_tag = tag;
+  return prev;
+#else
+  return -1;
+#endif
+}
+
+/** Clear the lock timing histograms. The registered tags are kept.
+ *
+ *   returns 0 on success
+ *   returns -1 if lock timing is not enabled.
+ */
+gint wg_reset_lockstats(void *db) {
+#ifdef USE_LOCKSTATS
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_lock_error(db, "Invalid database pointer in wg_reset_lockstats");
+    return -1;
+  }
+#endif
+  memset(dbmemsegh(db)->lockstats.hist, 0,
+    sizeof(dbmemsegh(db)->lockstats.hist));
+  return 0;
+#else
+  return -1;
+#endif
+}
+
 #if (LOCK_PROTO==TFQUEUE)
 
 /* ---------- memory management for queued locks ---------- */
@@ -1404,6 +1701,7 @@ static void free_lock(void * db, gint node) {
 #ifndef USE_LOCK_TIMEOUT
 static void futex_wait(volatile gint *addr1, int val1)
 {
+  LOCKSTAT_SLEEP
   syscall(SYS_futex, (void *) addr1, FUTEX_WAIT, val1, NULL);
 }
 #endif
@@ -1411,6 +1709,7 @@ static void futex_wait(volatile gint *addr1, int val1)
 static int futex_trywait(volatile gint *addr1, int val1,
   struct timespec *timeout)
 {
+  LOCKSTAT_SLEEP
   if(syscall(SYS_futex, (void *) addr1, FUTEX_WAIT, val1, timeout) == -1)
     return errno; /* On Linux, this is thread-safe. Caution needed however */
   else
@@ -79,6 +79,15 @@ gint wg_end_read(void * dbase, gint lock);  /* end read transaction */
 
 gint wg_compare_and_swap(volatile gint *ptr, gint oldv, gint newv);
 gint wg_init_locks(void * db); /* (re-) initialize locking subsystem */
+#ifdef USE_LOCKSTATS
+void wg_init_lockstats(void *db);
+#endif
+
+/* Lock timing (copied in dbapi.h) */
+
+gint wg_lock_tag(void *db, char *name);
+gint wg_set_lock_tag(void *db, gint tag);
+gint wg_reset_lockstats(void *db);
 
 #if (LOCK_PROTO==RPSPIN)
 
@@ -34,6 +34,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <string.h>
+#include <time.h>
 
 #ifdef _WIN32
 #include <process.h>
@@ -59,6 +60,9 @@ extern "C" {
 #include "dballoc.h"
 #include "dbdata.h"
 #include "dbhash.h"
+#include "dbstats.h"
+#include "dbindex.h"
+#include "dbtable.h"
 
 /* ====== Private headers and defs ======== */
 
@@ -82,21 +86,11 @@ extern "C" {
   return e;
 #endif
 
-#define GET_LOG_BYTE(d, f, v) \
+/* Running into the end of the file is not an error by itself, as the
+ * writer may not have finished the entry yet. The caller decides. */
+#define GET_LOG_BYTE(f, v) \
   if((v = fgetc(f)) == EOF) { \
-    return show_log_error(d, "Failed to read log entry"); \
-  }
-
-#define GET_LOG_CMD(d, f, v) \
-  if((v = fgetc(f)) == EOF) { \
-    if(feof(f)) break; \
-    else return show_log_error(d, "Failed to read log entry"); \
-  }
-
-/* Does not emit a message as fget_varint() does that already. */
-#define GET_LOG_VARINT(d, f, v, e) \
-  if(fget_varint(d, f, (wg_uint *) &v))  { \
-    return e; \
+    return -1; \
   }
 
 #ifdef HAVE_64BIT_GINT
@@ -107,6 +101,38 @@ extern "C" {
 
 /* ====== data structures ======== */
 
+#ifdef USE_DBLOG
+/** Encode entry remembered by a journal cursor */
+typedef struct journal_encode {
+  gint enc;             /** encoded value, WG_ILLEGAL if unused */
+  gint type;
+  gint intval;          /** int value or length of the string data */
+  double doubleval;
+  char *strval;
+  char *extstr;
+  struct journal_encode *prev, *next; /** list of pending encodes */
+} journal_encode;
+
+/** Journal cursor (change data capture) */
+typedef struct {
+  FILE *f;
+  int live;             /** following the current journal of the database */
+  gint serial;          /** journal serial number (live cursors only) */
+  gint pos;             /** position of the next entry */
+  journal_encode value; /** last encode read or value of the last event */
+  journal_encode *encodes; /** encodes not yet used by a SET entry */
+  void *enctable;       /** encoded value -> pending encode */
+  char tinystr[sizeof(gint)+1]; /** immediate string of the last event */
+} journal_cursor;
+
+/** Replica that applies a journal continuously */
+typedef struct {
+  journal_cursor cur;
+  char *filename;       /** journal of the primary database */
+  void *table;          /** offset translation, kept across batches */
+} journal_replica;
+#endif /* USE_DBLOG */
+
 /* ======= Private protos ================ */
 
 #ifdef USE_DBLOG
@@ -118,10 +144,23 @@ static gint add_tran_offset(void *db, void *table, gint old, gint new);
 static gint add_tran_enc(void *db, void *table, gint old, gint new);
 static gint translate_offset(void *db, void *table, gint offset);
 static gint translate_encoded(void *db, void *table, gint enc);
-static gint recover_encode(void *db, FILE *f, gint type);
-static gint recover_journal(void *db, FILE *f, void *table);
+static gint replay_encode(void *db, wg_journal_event *ev);
+static gint apply_journal_entry(void *db, void *table, wg_journal_event *ev);
+static gint recover_journal(void *db, journal_cursor *cur, void *table);
 
 static gint write_log_buffer(void *db, void *buf, int buflen);
+
+static FILE *open_cursor_journal(void *db, char *filename);
+static void init_cursor(journal_cursor *cur, FILE *f);
+static void clear_encode(journal_encode *encode);
+static void free_cursor_encodes(void *db, journal_cursor *cur);
+static int cursor_encode(void *db, journal_cursor *cur, gint type);
+static gint keep_cursor_encode(void *db, journal_cursor *cur);
+static gint read_journal_entry(void *db, journal_cursor *cur,
+  wg_journal_event *ev);
+static void cursor_value(void *db, journal_cursor *cur,
+  wg_journal_event *ev);
+static int replica_journal_restarted(void *db, journal_replica *rep);
 #endif /* USE_DBLOG */
 
 static gint show_log_error(void *db, char *errmsg);
@@ -395,40 +434,40 @@ static size_t dec_varint(unsigned char *buf, wg_uint *val) {
 
 /** Read varint from a buffered stream
  *  returns 0 on success
- *  returns -1 on error
+ *  returns -1 if the varint is not complete
  */
-static int fget_varint(void *db, FILE *f, wg_uint *val) {
+static int fget_varint(FILE *f, wg_uint *val) {
   register int c;
   wg_uint tmp;
 
-  GET_LOG_BYTE(db, f, c)
+  GET_LOG_BYTE(f, c)
   tmp = c & 0x7f;
   if(c & 0x80) {
-    GET_LOG_BYTE(db, f, c)
+    GET_LOG_BYTE(f, c)
     tmp |= ((c & 0x7f) << 7);
     if(c & 0x80) {
-      GET_LOG_BYTE(db, f, c)
+      GET_LOG_BYTE(f, c)
       tmp |= ((c & 0x7f) << 14);
       if(c & 0x80) {
-        GET_LOG_BYTE(db, f, c)
+        GET_LOG_BYTE(f, c)
         tmp |= ((c & 0x7f) << 21);
         if(c & 0x80) {
-          GET_LOG_BYTE(db, f, c)
+          GET_LOG_BYTE(f, c)
 #ifndef HAVE_64BIT_GINT
           tmp |= (c << 28);
 #else
           tmp |= ((wg_uint) (c & 0x7f) << 28);
           if(c & 0x80) {
-            GET_LOG_BYTE(db, f, c)
+            GET_LOG_BYTE(f, c)
             tmp |= ((wg_uint) (c & 0x7f) << 35);
             if(c & 0x80) {
-              GET_LOG_BYTE(db, f, c)
+              GET_LOG_BYTE(f, c)
               tmp |= ((wg_uint) (c & 0x7f) << 42);
               if(c & 0x80) {
-                GET_LOG_BYTE(db, f, c)
+                GET_LOG_BYTE(f, c)
                 tmp |= ((wg_uint) (c & 0x7f) << 49);
                 if(c & 0x80) {
-                  GET_LOG_BYTE(db, f, c)
+                  GET_LOG_BYTE(f, c)
                   tmp |= ((wg_uint) c << 56);
                 }
               }
@@ -444,10 +483,15 @@ static int fget_varint(void *db, FILE *f, wg_uint *val) {
 }
 
 /** Add a log recovery translation entry
- *  Uses extendible gint hashtable internally.
+ *  Uses extendible gint hashtable internally. An earlier entry for
+ *  the same offset is replaced, since the offset may have been freed
+ *  and allocated again in the logged database.
  */
 static gint add_tran_offset(void *db, void *table, gint old, gint new)
 {
+  wg_ginthash_removekey(db, table, old);
+  if(old == new)
+    return 0;
   return wg_ginthash_addkey(db, table, old, new);
 }
 
@@ -525,156 +569,130 @@ static gint translate_encoded(void *db, void *table, gint enc)
   return enc;
 }
 
-/** Parse an encode entry from the log.
+/** Repeat an encode operation from the log.
  *
  */
-gint recover_encode(void *db, FILE *f, gint type)
+static gint replay_encode(void *db, wg_journal_event *ev)
 {
-  char *strbuf, *extbuf;
-  gint length = 0, extlength = 0, enc;
-  int intval;
-  double doubleval;
-
-  switch(type) {
+  switch(ev->type) {
     case WG_INTTYPE:
-      if(fread((char *) &intval, sizeof(int), 1, f) != 1) {
-        show_log_error(db, "Failed to read log entry");
-        return WG_ILLEGAL;
-      }
-      return wg_encode_int(db, intval);
+      return wg_encode_int(db, ev->intval);
     case WG_DOUBLETYPE:
-      if(fread((char *) &doubleval, sizeof(double), 1, f) != 1) {
-        show_log_error(db, "Failed to read log entry");
-        return WG_ILLEGAL;
-      }
-      return wg_encode_double(db, doubleval);
+      return wg_encode_double(db, ev->doubleval);
     case WG_STRTYPE:
     case WG_URITYPE:
     case WG_XMLLITERALTYPE:
     case WG_ANONCONSTTYPE:
-    case WG_BLOBTYPE: /* XXX: no encode func for this yet */
-      /* strings with extdata */
-      GET_LOG_VARINT(db, f, length, WG_ILLEGAL)
-      GET_LOG_VARINT(db, f, extlength, WG_ILLEGAL)
+      return wg_encode_unistr(db, ev->strval, ev->extstr, ev->type);
+    case WG_BLOBTYPE:
+      return wg_encode_blob(db, ev->strval, ev->extstr, ev->intval);
+    default:
+      break;
+  }
+  show_log_error(db, "Unsupported data type");
+  return WG_ILLEGAL;
+}
 
-      strbuf = (char *) malloc(length + 1);
-      if(!strbuf) {
-        show_log_error(db, "Failed to allocate buffers");
-        return WG_ILLEGAL;
+/** Apply a single journal entry to the database.
+ *  Offsets and encoded values in the entry are translated to the
+ *  ones allocated in this database.
+ */
+static gint apply_journal_entry(void *db, void *table, wg_journal_event *ev)
+{
+  gint newoffset, newenc;
+  void *rec;
+
+  switch(ev->op) {
+    case WG_JOURNAL_ENTRY_CRE:
+      rec = wg_create_record(db, ev->length);
+      if(ev->offset != 0) {
+        /* XXX: should we have even tried if this failed earlier? */
+        if(!rec) {
+          return show_log_error(db, "Failed to create a new record");
+        }
+        newoffset = ptrtooffset(db, rec);
+        if(add_tran_offset(db, table, ev->offset, newoffset)) {
+          return show_log_error(db, "Failed to parse log "\
+            "(out of translation memory)");
+        }
       }
-      if(fread(strbuf, 1, length, f) != length) {
-        show_log_error(db, "Failed to read log entry");
-        free(strbuf);
-        return WG_ILLEGAL;
+      break;
+    case WG_JOURNAL_ENTRY_DEL:
+      newoffset = translate_offset(db, table, ev->offset);
+      rec = offsettoptr(db, newoffset);
+      if(wg_delete_record(db, rec) < -1) {
+        return show_log_error(db, "Failed to delete a record");
       }
-      strbuf[length] = '\0';
-
-      if(extlength) {
-        extbuf = (char *) malloc(extlength + 1);
-        if(!extbuf) {
-          free(strbuf);
-          show_log_error(db, "Failed to allocate buffers");
-          return WG_ILLEGAL;
+      /* The offset may be reused by a new record */
+      wg_ginthash_removekey(db, table, ev->offset);
+      break;
+    case WG_JOURNAL_ENTRY_ENC:
+      newenc = replay_encode(db, ev);
+      if(ev->enc != WG_ILLEGAL) {
+        /* Encode was supposed to succeed */
+        if(newenc == WG_ILLEGAL) {
+          return -1;
         }
-        if(fread(extbuf, 1, extlength, f) != extlength) {
-          show_log_error(db, "Failed to read log entry");
-          free(strbuf);
-          free(extbuf);
-          return WG_ILLEGAL;
+        if(add_tran_enc(db, table, ev->enc, newenc)) {
+          return show_log_error(db, "Failed to parse log "\
+            "(out of translation memory)");
         }
-        extbuf[extlength] = '\0';
-      } else {
-        extbuf = NULL;
       }
-
-      enc = wg_encode_unistr(db, strbuf, extbuf, type);
-      free(strbuf);
-      if(extbuf)
-        free(extbuf);
-      return enc;
-    default:
       break;
+    case WG_JOURNAL_ENTRY_SET:
+      newoffset = translate_offset(db, table, ev->offset);
+      rec = offsettoptr(db, newoffset);
+      newenc = translate_encoded(db, table, ev->enc);
+      if(wg_set_field(db, rec, ev->column, newenc)) {
+        return show_log_error(db, "Failed to set field data");
+      }
+      break;
+    case WG_JOURNAL_ENTRY_META:
+      newoffset = translate_offset(db, table, ev->offset);
+      rec = offsettoptr(db, newoffset);
+      if(meta_table(ev->meta) != record_table(rec)) {
+        /* The record was indexed before it was added to the table.
+         * Index it again, so that the indexes of the table see it. */
+        gint tbl = meta_table(ev->meta);
+        if(wg_recreate_table(db, tbl) ||\
+          wg_index_del_rec(db, rec) < -1 ||\
+          wg_table_add_record(db, rec, tbl) ||\
+          wg_index_add_rec(db, rec) < -1) {
+          return show_log_error(db, "Failed to add a record to a table");
+        }
+      }
+      /* The projection slot is local to this database */
+      *((gint *) rec + RECORD_META_POS) = \
+        (ev->meta & ~RECORD_META_SLOTMASK) |\
+        (*((gint *) rec + RECORD_META_POS) & RECORD_META_SLOTMASK);
+      break;
+    default:
+      return show_log_error(db, "Invalid log entry");
   }
-
-  return show_log_error(db, "Unsupported data type");
+  return 0;
 }
 
 /** Parse the journal file. Used internally only.
  *
  */
-static gint recover_journal(void *db, FILE *f, void *table)
+static gint recover_journal(void *db, journal_cursor *cur, void *table)
 {
-  int c;
-  gint length = 0, offset = 0, newoffset;
-  gint col = 0, enc = 0, newenc, meta = 0;
-  void *rec;
+  wg_journal_event ev;
+  gint err;
 
   for(;;) {
-    GET_LOG_CMD(db, f, c)
-    switch((unsigned char) c & WG_JOURNAL_ENTRY_CMDMASK) {
-      case WG_JOURNAL_ENTRY_CRE:
-        GET_LOG_VARINT(db, f, length, -1)
-        GET_LOG_VARINT(db, f, offset, -1)
-        rec = wg_create_record(db, length);
-        if(offset != 0) {
-          /* XXX: should we have even tried if this failed earlier? */
-          if(!rec) {
-            return show_log_error(db, "Failed to create a new record");
-          }
-          newoffset = ptrtooffset(db, rec);
-          if(newoffset != offset) {
-            if(add_tran_offset(db, table, offset, newoffset)) {
-              return show_log_error(db, "Failed to parse log "\
-                "(out of translation memory)");
-            }
-          }
-        }
-        break;
-      case WG_JOURNAL_ENTRY_DEL:
-        GET_LOG_VARINT(db, f, offset, -1)
-        newoffset = translate_offset(db, table, offset);
-        rec = offsettoptr(db, newoffset);
-        if(wg_delete_record(db, rec) < -1) {
-          return show_log_error(db, "Failed to delete a record");
-        }
-        break;
-      case WG_JOURNAL_ENTRY_ENC:
-        newenc = recover_encode(db, f,
-          (unsigned char) c & WG_JOURNAL_ENTRY_TYPEMASK);
-        GET_LOG_VARINT(db, f, enc, -1)
-        if(enc != WG_ILLEGAL) {
-          /* Encode was supposed to succeed */
-          if(newenc == WG_ILLEGAL) {
-            return -1;
-          }
-          if(newenc != enc) {
-            if(add_tran_enc(db, table, enc, newenc)) {
-              return show_log_error(db, "Failed to parse log "\
-                "(out of translation memory)");
-            }
-          }
-        }
-        break;
-      case WG_JOURNAL_ENTRY_SET:
-        GET_LOG_VARINT(db, f, offset, -1)
-        GET_LOG_VARINT(db, f, col, -1)
-        GET_LOG_VARINT(db, f, enc, -1)
-        newoffset = translate_offset(db, table, offset);
-        rec = offsettoptr(db, newoffset);
-        newenc = translate_encoded(db, table, enc);
-        if(wg_set_field(db, rec, col, newenc)) {
-          return show_log_error(db, "Failed to set field data");
-        }
-        break;
-      case WG_JOURNAL_ENTRY_META:
-        GET_LOG_VARINT(db, f, offset, -1)
-        GET_LOG_VARINT(db, f, meta, -1)
-        newoffset = translate_offset(db, table, offset);
-        rec = offsettoptr(db, newoffset);
-        *((gint *) rec + RECORD_META_POS) = meta;
-        break;
-      default:
-        return show_log_error(db, "Invalid log entry");
+    err = read_journal_entry(db, cur, &ev);
+    if(err < 0) {
+      return -1;
+    } else if(!err) {
+      /* end of the journal, unless the last entry is truncated */
+      if(fgetc(cur->f) != EOF) {
+        return show_log_error(db, "Failed to read log entry");
+      }
+      break;
+    }
+    if(apply_journal_entry(db, table, &ev)) {
+      return -1;
     }
   }
   return 0;
@@ -873,6 +891,7 @@ gint wg_replay_log(void *db, char *filename)
   db_memsegment_header* dbh = dbmemsegh(db);
   gint active, err = 0;
   void *tran_tbl;
+  journal_cursor cur;
   int fd;
   FILE *f;
 
@@ -899,6 +918,7 @@ gint wg_replay_log(void *db, char *filename)
 #else
   f = _fdopen(fd, "rb");
 #endif
+  init_cursor(&cur, f);
   /* XXX: may consider fcntl-locking here */
   /* restore the log contents */
   tran_tbl = wg_ginthash_init(db);
@@ -907,7 +927,7 @@ gint wg_replay_log(void *db, char *filename)
     err = -1;
     goto abort1;
   }
-  if(recover_journal(db, f, tran_tbl)) {
+  if(recover_journal(db, &cur, tran_tbl)) {
     err = -2;
     goto abort0;
   }
@@ -918,6 +938,7 @@ abort0:
   wg_ginthash_free(db, tran_tbl);
 
 abort1:
+  free_cursor_encodes(db, &cur);
   fclose(f);
 
 abort2:
@@ -971,8 +992,10 @@ static gint write_log_buffer(void *db, void *buf, int buflen)
       }
     }
   }
-  if(ld->fd < 0)
+  if(ld->fd < 0) {
+    WG_STAT_INC(db, WG_STAT_JOURNAL_ERRORS);
     return -1;
+  }
 
   /* Always mark log as dirty when writing something */
   dbh->logging.dirty = 1;
@@ -983,9 +1006,12 @@ static gint write_log_buffer(void *db, void *buf, int buflen)
   if(_write(ld->fd, (char *) buf, buflen) != buflen) {
 #endif
     show_log_error(db, "Error writing to log file");
+    WG_STAT_INC(db, WG_STAT_JOURNAL_ERRORS);
     JOURNAL_FAIL(ld->fd, -5)
   }
 
+  WG_STAT_INC(db, WG_STAT_JOURNAL_WRITES);
+  WG_STAT_ADD(db, WG_STAT_JOURNAL_BYTES, buflen);
   return 0;
 }
 #endif /* USE_DBLOG */
@@ -1100,7 +1126,7 @@ gint wg_log_encode(void *db, gint type, void *data, gint length,
     case WG_URITYPE:
     case WG_XMLLITERALTYPE:
     case WG_ANONCONSTTYPE:
-    case WG_BLOBTYPE: /* XXX: no encode func for this yet */
+    case WG_BLOBTYPE:
       /* strings with extdata */
       buflen = 1 + 2*VARINT_SIZE + length + extlength;
       buf = (unsigned char *) malloc(buflen);
@@ -1174,6 +1200,774 @@ gint wg_log_set_meta(void *db, void *rec, gint meta)
 }
 
 
+/* ------------ change data capture ---------------- */
+
+#ifdef USE_DBLOG
+/** Open a journal file for reading and check the magic header.
+ *
+ */
+static FILE *open_cursor_journal(void *db, char *filename)
+{
+  char buf[WG_JOURNAL_MAGIC_BYTES];
+  FILE *f;
+
+#ifndef _WIN32
+  f = fopen(filename, "r");
+#else
+  if(fopen_s(&f, filename, "rb"))
+    f = NULL;
+#endif
+  if(!f) {
+    show_log_error(db, "Error opening log file");
+    return NULL;
+  }
+  if(fread(buf, 1, WG_JOURNAL_MAGIC_BYTES, f) != WG_JOURNAL_MAGIC_BYTES ||\
+    strncmp(buf, WG_JOURNAL_MAGIC, WG_JOURNAL_MAGIC_BYTES)) {
+    show_log_error(db, "Bad log file magic");
+    fclose(f);
+    return NULL;
+  }
+  return f;
+}
+
+/** Set up a cursor on a journal file positioned after the header.
+ *
+ */
+static void init_cursor(journal_cursor *cur, FILE *f)
+{
+  memset(cur, 0, sizeof(journal_cursor));
+  cur->value.enc = WG_ILLEGAL;
+  cur->f = f;
+  cur->pos = WG_JOURNAL_MAGIC_BYTES;
+}
+
+/** Free the data of an encode.
+ *
+ */
+static void clear_encode(journal_encode *encode)
+{
+  if(encode->strval)
+    free(encode->strval);
+  if(encode->extstr)
+    free(encode->extstr);
+  encode->strval = encode->extstr = NULL;
+  encode->enc = WG_ILLEGAL;
+}
+
+/** Free the encodes remembered by the cursor.
+ *
+ */
+static void free_cursor_encodes(void *db, journal_cursor *cur)
+{
+  journal_encode *encode, *next;
+
+  clear_encode(&cur->value);
+  for(encode = cur->encodes; encode; encode = next) {
+    next = encode->next;
+    clear_encode(encode);
+    free(encode);
+  }
+  cur->encodes = NULL;
+  if(cur->enctable) {
+    wg_ginthash_free(db, cur->enctable);
+    cur->enctable = NULL;
+  }
+}
+
+/** Read an encode entry into the value of the cursor.
+ *  returns 0 on success
+ *  returns 1 if the entry is not complete
+ *  returns -1 on error
+ */
+static int cursor_encode(void *db, journal_cursor *cur, gint type)
+{
+  journal_encode *slot = &cur->value;
+  wg_uint length, extlength, enc;
+  int intval;
+
+  clear_encode(slot);
+  slot->type = type;
+
+  switch(type) {
+    case WG_INTTYPE:
+      if(fread((char *) &intval, sizeof(int), 1, cur->f) != 1)
+        return 1;
+      slot->intval = intval;
+      break;
+    case WG_DOUBLETYPE:
+      if(fread((char *) &slot->doubleval, sizeof(double), 1, cur->f) != 1)
+        return 1;
+      break;
+    case WG_STRTYPE:
+    case WG_URITYPE:
+    case WG_XMLLITERALTYPE:
+    case WG_ANONCONSTTYPE:
+    case WG_BLOBTYPE:
+      if(fget_varint(cur->f, &length) || fget_varint(cur->f, &extlength))
+        return 1;
+      slot->strval = (char *) malloc(length + 1);
+      if(!slot->strval) {
+        show_log_error(db, "Failed to allocate buffers");
+        return -1;
+      }
+      if(fread(slot->strval, 1, length, cur->f) != length)
+        return 1;
+      slot->strval[length] = '\0';
+      slot->intval = (gint) length;
+      if(extlength) {
+        slot->extstr = (char *) malloc(extlength + 1);
+        if(!slot->extstr) {
+          show_log_error(db, "Failed to allocate buffers");
+          return -1;
+        }
+        if(fread(slot->extstr, 1, extlength, cur->f) != extlength)
+          return 1;
+        slot->extstr[extlength] = '\0';
+      }
+      break;
+    default:
+      show_log_error(db, "Unsupported data type");
+      return -1;
+  }
+
+  if(fget_varint(cur->f, &enc))
+    return 1;
+  slot->enc = (gint) enc;
+  return 0;
+}
+
+/** Remember the encode that was read last, until a SET entry uses it.
+ *  The data is kept so that the value of the field can be reported
+ *  without looking at the database. An encode that was never used is
+ *  replaced when the same encoded value appears again.
+ *  returns 0 on success
+ *  returns -1 on error
+ */
+static gint keep_cursor_encode(void *db, journal_cursor *cur)
+{
+  journal_encode *encode;
+  gint found;
+
+  if(!cur->enctable && !(cur->enctable = wg_ginthash_init(db)))
+    return -1;
+
+  if(!wg_ginthash_getkey(db, cur->enctable, cur->value.enc, &found)) {
+    encode = (journal_encode *) found;
+    clear_encode(encode);
+  } else {
+    encode = (journal_encode *) malloc(sizeof(journal_encode));
+    if(!encode)
+      return show_log_error(db, "Failed to allocate buffers");
+    if(wg_ginthash_addkey(db, cur->enctable, cur->value.enc,
+      (gint) encode)) {
+      free(encode);
+      return show_log_error(db, "Failed to allocate buffers");
+    }
+    encode->prev = NULL;
+    encode->next = cur->encodes;
+    if(cur->encodes)
+      cur->encodes->prev = encode;
+    cur->encodes = encode;
+  }
+
+  encode->enc = cur->value.enc;
+  encode->type = cur->value.type;
+  encode->intval = cur->value.intval;
+  encode->doubleval = cur->value.doubleval;
+  encode->strval = cur->value.strval;
+  encode->extstr = cur->value.extstr;
+  cur->value.strval = cur->value.extstr = NULL;
+  cur->value.enc = WG_ILLEGAL;
+  return 0;
+}
+
+/** Read the next entry from the journal.
+ *  ENC entries are returned with the data that was encoded, the
+ *  strings remain valid until the next entry is read.
+ *  returns 1 when an entry was read
+ *  returns 0 when the next entry is not complete (or there is none);
+ *    the cursor stays at the start of it
+ *  returns -1 on error
+ */
+static gint read_journal_entry(void *db, journal_cursor *cur,
+  wg_journal_event *ev)
+{
+  journal_encode *slot = &cur->value;
+  wg_uint offset, val, col, enc;
+  int c, err;
+
+  if((c = fgetc(cur->f)) == EOF)
+    goto incomplete;
+
+  ev->pos = cur->pos;
+  ev->op = (unsigned char) c & WG_JOURNAL_ENTRY_CMDMASK;
+  switch(ev->op) {
+    case WG_JOURNAL_ENTRY_CRE:
+      if(fget_varint(cur->f, &val) || fget_varint(cur->f, &offset))
+        goto incomplete;
+      ev->offset = (gint) offset;
+      ev->length = (gint) val;
+      break;
+    case WG_JOURNAL_ENTRY_DEL:
+      if(fget_varint(cur->f, &offset))
+        goto incomplete;
+      ev->offset = (gint) offset;
+      break;
+    case WG_JOURNAL_ENTRY_ENC:
+      err = cursor_encode(db, cur,
+        (unsigned char) c & WG_JOURNAL_ENTRY_TYPEMASK);
+      if(err < 0)
+        return -1;
+      else if(err)
+        goto incomplete;
+      ev->enc = slot->enc;
+      ev->type = slot->type;
+      ev->intval = slot->intval;
+      ev->doubleval = slot->doubleval;
+      ev->strval = slot->strval;
+      ev->extstr = slot->extstr;
+      break;
+    case WG_JOURNAL_ENTRY_SET:
+      if(fget_varint(cur->f, &offset) || fget_varint(cur->f, &col) ||\
+        fget_varint(cur->f, &enc))
+        goto incomplete;
+      ev->offset = (gint) offset;
+      ev->column = (gint) col;
+      ev->enc = (gint) enc;
+      break;
+    case WG_JOURNAL_ENTRY_META:
+      if(fget_varint(cur->f, &offset) || fget_varint(cur->f, &val))
+        goto incomplete;
+      ev->offset = (gint) offset;
+      ev->meta = (gint) val;
+      break;
+    default:
+      return show_log_error(db, "Invalid log entry");
+  }
+  cur->pos = (gint) ftell(cur->f);
+  return 1;
+
+incomplete:
+  /* The rest of the entry has not been written yet. Rewind,
+   * so that the entry is read again when it is complete. */
+  if(ferror(cur->f)) {
+    return show_log_error(db, "Failed to read log entry");
+  }
+  clearerr(cur->f);
+  if(fseek(cur->f, (long) cur->pos, SEEK_SET)) {
+    return show_log_error(db, "Failed to read log entry");
+  }
+  return 0;
+}
+
+/** Decode the value of a SET entry.
+ *  Values that are stored in the database are found among the
+ *  encodes that the cursor has read and that were not used yet.
+ *  The encode is moved to the value of the cursor, so that it
+ *  remains valid until the next entry is read. Immediate values
+ *  are decoded directly, as this does not touch the shared memory.
+ */
+static void cursor_value(void *db, journal_cursor *cur,
+  wg_journal_event *ev)
+{
+  gint enc = ev->enc, found;
+  journal_encode *encode;
+
+  ev->type = 0;
+  ev->intval = 0;
+  ev->doubleval = 0;
+  ev->strval = ev->extstr = NULL;
+
+  if(!enc) {
+    ev->type = WG_NULLTYPE;
+  } else if(isptr(enc)) {
+    if(isdatarec(enc)) {
+      ev->type = WG_RECORDTYPE;
+      ev->intval = enc;
+      return;
+    }
+    if(!cur->enctable ||\
+      wg_ginthash_getkey(db, cur->enctable, enc, &found))
+      return;
+    encode = (journal_encode *) found;
+    wg_ginthash_removekey(db, cur->enctable, enc);
+    if(encode->prev)
+      encode->prev->next = encode->next;
+    else
+      cur->encodes = encode->next;
+    if(encode->next)
+      encode->next->prev = encode->prev;
+
+    clear_encode(&cur->value);
+    cur->value = *encode;
+    free(encode);
+    ev->type = cur->value.type;
+    ev->intval = cur->value.intval;
+    ev->doubleval = cur->value.doubleval;
+    ev->strval = cur->value.strval;
+    ev->extstr = cur->value.extstr;
+  } else {
+    ev->type = wg_get_encoded_type(db, enc);
+    switch(ev->type) {
+      case WG_INTTYPE:
+        ev->intval = wg_decode_int(db, enc);
+        break;
+      case WG_DOUBLETYPE:
+        ev->doubleval = wg_decode_double(db, enc);
+        break;
+      case WG_STRTYPE:
+        /* the decoded string is only valid for a few decoding calls,
+         * keep it with the cursor like the other event data */
+        ev->intval = wg_decode_str_copy(db, enc, cur->tinystr,
+          sizeof(cur->tinystr));
+        ev->strval = cur->tinystr;
+        break;
+      case WG_ANONCONSTTYPE:
+      case -1:
+        ev->type = 0; /* refers to the shared memory or unknown */
+        break;
+      default:
+        /* other immediate types are decoded from ev->enc */
+        break;
+    }
+  }
+}
+#endif /* USE_DBLOG */
+
+/** Open a cursor for reading change events from the journal.
+ *
+ *  If filename is NULL, the cursor follows the current journal of
+ *  the database (also across journal restarts). serial and pos give
+ *  the position in the journal; pos 0 means the start of the journal.
+ *  A position in an earlier journal of the database can't be resumed,
+ *  as the journal has been restarted since.
+ *
+ *  Returns a pointer to the cursor on success
+ *  Returns NULL on failure
+ */
+void *wg_open_journal_cursor(void *db, char *filename, gint serial, gint pos)
+{
+#ifdef USE_DBLOG
+  db_memsegment_header* dbh = dbmemsegh(db);
+  char journal_fn[WG_JOURNAL_FN_BUFSIZE];
+  journal_cursor *cur;
+  long size;
+  FILE *f;
+
+  if(!filename) {
+    if(pos > 0 && serial != dbh->logging.serial) {
+      show_log_error(db, "Journal position refers to an earlier journal");
+      return NULL;
+    }
+    wg_journal_filename(db, journal_fn, WG_JOURNAL_FN_BUFSIZE);
+  }
+
+  f = open_cursor_journal(db, filename ? filename : journal_fn);
+  if(!f) {
+    return NULL;
+  }
+  cur = (journal_cursor *) malloc(sizeof(journal_cursor));
+  if(!cur) {
+    show_log_error(db, "Failed to allocate the journal cursor");
+    fclose(f);
+    return NULL;
+  }
+  init_cursor(cur, f);
+  cur->live = (filename == NULL);
+  cur->serial = dbh->logging.serial;
+
+  if(pos < WG_JOURNAL_MAGIC_BYTES)
+    pos = WG_JOURNAL_MAGIC_BYTES;
+  if(fseek(cur->f, 0, SEEK_END) || (size = ftell(cur->f)) < pos ||\
+    fseek(cur->f, (long) pos, SEEK_SET)) {
+    show_log_error(db, "Journal position is past the end of the journal");
+    fclose(cur->f);
+    free(cur);
+    return NULL;
+  }
+  cur->pos = pos;
+  return cur;
+#else
+  show_log_error(db, "Logging is disabled");
+  return NULL;
+#endif /* USE_DBLOG */
+}
+
+/** Open a cursor at a position saved with wg_save_journal_cursor().
+ *
+ *  Follows the current journal of the database. If the position
+ *  file does not exist yet, reading starts from the beginning
+ *  of the journal.
+ *
+ *  Returns a pointer to the cursor on success
+ *  Returns NULL on failure
+ */
+void *wg_load_journal_cursor(void *db, char *posfile)
+{
+#ifdef USE_DBLOG
+  long serial = 0, pos = 0;
+  FILE *f;
+
+#ifndef _WIN32
+  f = fopen(posfile, "r");
+#else
+  if(fopen_s(&f, posfile, "r"))
+    f = NULL;
+#endif
+  if(f) {
+#ifndef _WIN32
+    if(fscanf(f, "%ld %ld", &serial, &pos) != 2) {
+#else
+    if(fscanf_s(f, "%ld %ld", &serial, &pos) != 2) {
+#endif
+      show_log_error(db, "Invalid journal position file");
+      fclose(f);
+      return NULL;
+    }
+    fclose(f);
+  } else if(errno != ENOENT) {
+    show_log_error(db, "Error opening journal position file");
+    return NULL;
+  }
+  return wg_open_journal_cursor(db, NULL, (gint) serial, (gint) pos);
+#else
+  show_log_error(db, "Logging is disabled");
+  return NULL;
+#endif /* USE_DBLOG */
+}
+
+/** Save the position of the cursor.
+ *
+ *  The position is written into a temporary file that then replaces
+ *  the position file, so that a crash leaves either the old or
+ *  the new position in place.
+ *
+ *  Returns 0 on success
+ *  Returns -1 on failure
+ */
+gint wg_save_journal_cursor(void *db, void *cursor, char *posfile)
+{
+#ifdef USE_DBLOG
+  journal_cursor *cur = (journal_cursor *) cursor;
+  char *tmpfn;
+  size_t len = strlen(posfile) + 5;
+  FILE *f;
+  int err = 0;
+
+  tmpfn = (char *) malloc(len);
+  if(!tmpfn) {
+    return show_log_error(db, "Failed to allocate buffers");
+  }
+  snprintf(tmpfn, len, "%s.tmp", posfile);
+  tmpfn[len-1] = '\0';
+
+#ifndef _WIN32
+  f = fopen(tmpfn, "w");
+#else
+  if(fopen_s(&f, tmpfn, "w"))
+    f = NULL;
+#endif
+  if(!f) {
+    free(tmpfn);
+    return show_log_error(db, "Error opening journal position file");
+  }
+  if(fprintf(f, "%ld %ld\n", (long) cur->serial, (long) cur->pos) < 0)
+    err = -1;
+  if(fclose(f))
+    err = -1;
+  if(!err) {
+#ifdef _WIN32
+    _unlink(posfile);
+#endif
+    err = rename(tmpfn, posfile);
+  }
+  free(tmpfn);
+  if(err)
+    return show_log_error(db, "Error writing journal position file");
+  return 0;
+#else
+  return show_log_error(db, "Logging is disabled");
+#endif /* USE_DBLOG */
+}
+
+/** Fetch the next change event from the journal.
+ *
+ *  Encode entries are not reported, but are used to decode the values
+ *  in the following SET events. The journal does not record the
+ *  previous value of a field. Strings in the event are owned by the
+ *  cursor and remain valid until the next call.
+ *
+ *  When the end of the journal is reached, the cursor stays there
+ *  and later calls return the events written in the meantime. A live
+ *  cursor moves to the new journal file when the journal is restarted.
+ *
+ *  Returns 1 when an event was fetched
+ *  Returns 0 when there are no more events in the journal
+ *  Returns -1 on error
+ */
+gint wg_fetch_journal_event(void *db, void *cursor, wg_journal_event *ev)
+{
+#ifdef USE_DBLOG
+  db_memsegment_header* dbh = dbmemsegh(db);
+  journal_cursor *cur = (journal_cursor *) cursor;
+  gint err;
+
+  for(;;) {
+    err = read_journal_entry(db, cur, ev);
+    if(err < 0) {
+      return -1;
+    } else if(!err) {
+      if(cur->live && cur->serial != dbh->logging.serial) {
+        /* The journal was restarted and the file we have open is a
+         * backup now. Its remaining entries have all been read. */
+        char journal_fn[WG_JOURNAL_FN_BUFSIZE];
+        FILE *f;
+        wg_journal_filename(db, journal_fn, WG_JOURNAL_FN_BUFSIZE);
+        if(!(f = open_cursor_journal(db, journal_fn)))
+          return -1;
+        fclose(cur->f);
+        cur->f = f;
+        cur->serial = dbh->logging.serial;
+        cur->pos = WG_JOURNAL_MAGIC_BYTES;
+        continue;
+      }
+      return 0;
+    }
+
+    if(ev->op == WG_JOURNAL_ENTRY_ENC) {
+      /* only used for decoding the values */
+      if(keep_cursor_encode(db, cur))
+        return -1;
+      continue;
+    }
+    else if(ev->op == WG_JOURNAL_ENTRY_CRE && !ev->offset)
+      continue; /* record was not created */
+    else if(ev->op == WG_JOURNAL_ENTRY_SET)
+      cursor_value(db, cur, ev);
+    return 1;
+  }
+#else
+  return show_log_error(db, "Logging is disabled");
+#endif /* USE_DBLOG */
+}
+
+/** Release the journal cursor.
+ *
+ */
+void wg_free_journal_cursor(void *db, void *cursor)
+{
+#ifdef USE_DBLOG
+  journal_cursor *cur = (journal_cursor *) cursor;
+
+  if(cur) {
+    free_cursor_encodes(db, cur);
+    if(cur->f)
+      fclose(cur->f);
+    free(cur);
+  }
+#endif
+}
+
+
+/* ------------ journal replica ---------------- */
+
+#ifdef USE_DBLOG
+/** Check whether the primary has restarted its journal.
+ *  The file that the replica has open is then a backup and
+ *  a new journal has replaced it under the original name.
+ *  Returns 1 if the new journal can be read
+ *  Returns 0 otherwise
+ */
+static int replica_journal_restarted(void *db, journal_replica *rep)
+{
+#ifndef _WIN32
+  struct stat curr, tmp;
+  if(stat(rep->filename, &tmp) || fstat(fileno(rep->cur.f), &curr))
+    return 0;
+  if(tmp.st_dev == curr.st_dev && tmp.st_ino == curr.st_ino)
+    return 0;
+#else
+  /* Files have no usable identity here, but a journal that is
+   * shorter than what has been applied must be a new one. */
+  struct _stat tmp;
+  if(_stat(rep->filename, &tmp) || tmp.st_size >= rep->cur.pos)
+    return 0;
+#endif
+  /* the new journal can be read once the header is written */
+  return (tmp.st_size >= WG_JOURNAL_MAGIC_BYTES);
+}
+#endif /* USE_DBLOG */
+
+/** Start applying the journal of another database continuously.
+ *
+ *  The database should be empty, or loaded from the dump that was
+ *  created when the journal was started. The replica keeps the journal
+ *  open and the translation of the offsets between the databases, so
+ *  that wg_apply_replica() only applies the entries written since
+ *  the previous call. The journal of a database must not be active in
+ *  the replica, as the changes would diverge from the primary.
+ *
+ *  Returns a pointer to the replica on success
+ *  Returns NULL on failure
+ */
+void *wg_start_replica(void *db, char *filename)
+{
+#ifdef USE_DBLOG
+  db_memsegment_header* dbh = dbmemsegh(db);
+  journal_replica *rep;
+  FILE *f;
+
+  if(dbh->logging.active) {
+    show_log_error(db, "Logging is active in the replica database");
+    return NULL;
+  }
+  if(!(f = open_cursor_journal(db, filename))) {
+    return NULL;
+  }
+  rep = (journal_replica *) malloc(sizeof(journal_replica));
+  if(!rep) {
+    show_log_error(db, "Failed to allocate the replica");
+    fclose(f);
+    return NULL;
+  }
+  init_cursor(&rep->cur, f);
+  rep->filename = (char *) malloc(strlen(filename) + 1);
+  rep->table = wg_ginthash_init(db);
+  if(!rep->filename || !rep->table) {
+    show_log_error(db, "Failed to create log translation table");
+    if(rep->filename)
+      free(rep->filename);
+    if(rep->table)
+      wg_ginthash_free(db, rep->table);
+    fclose(f);
+    free(rep);
+    return NULL;
+  }
+  strcpy(rep->filename, filename);
+
+  dbh->logging.replica = 1;
+  dbh->logging.replica_pos = rep->cur.pos;
+  dbh->logging.replica_lag = 0;
+  dbh->logging.replica_synced = (gint) time(NULL);
+  return rep;
+#else
+  show_log_error(db, "Logging is disabled");
+  return NULL;
+#endif /* USE_DBLOG */
+}
+
+/** Apply the entries written to the journal since the previous call.
+ *
+ *  Requires exclusive access to the replica database. An entry that
+ *  the primary has not finished writing is applied by a later call.
+ *  When the primary restarts the journal (for example, by creating
+ *  a dump), the replica continues with the new journal file. Importing
+ *  a dump or replaying a journal in the primary requires loading
+ *  the replica again.
+ *
+ *  Returns the number of entries applied
+ *  Returns -1 on non-fatal error (the entries up to the error were applied)
+ *  Returns -2 on fatal error (database inconsistent)
+ */
+gint wg_apply_replica(void *db, void *replica)
+{
+#ifdef USE_DBLOG
+  db_memsegment_header* dbh = dbmemsegh(db);
+  journal_replica *rep = (journal_replica *) replica;
+  wg_journal_event ev;
+  gint err, applied = 0;
+  long size;
+
+  /* The backlog that this call catches up with */
+  if(!fseek(rep->cur.f, 0, SEEK_END) && (size = ftell(rep->cur.f)) >= 0) {
+    dbh->logging.replica_lag = (gint) size - rep->cur.pos;
+  }
+  if(fseek(rep->cur.f, (long) rep->cur.pos, SEEK_SET)) {
+    return show_log_error(db, "Failed to read log entry");
+  }
+
+  for(;;) {
+    err = read_journal_entry(db, &rep->cur, &ev);
+    if(err < 0) {
+      return -1;
+    } else if(!err) {
+      if(replica_journal_restarted(db, rep)) {
+        FILE *f = open_cursor_journal(db, rep->filename);
+        if(!f)
+          return -1;
+        fclose(rep->cur.f);
+        rep->cur.f = f;
+        rep->cur.pos = WG_JOURNAL_MAGIC_BYTES;
+        continue;
+      }
+      break;
+    }
+    if(apply_journal_entry(db, rep->table, &ev)) {
+      return -2;
+    }
+    dbh->logging.replica_pos = rep->cur.pos;
+    applied++;
+  }
+
+  dbh->logging.replica_synced = (gint) time(NULL);
+  return applied;
+#else
+  return show_log_error(db, "Logging is disabled");
+#endif /* USE_DBLOG */
+}
+
+/** Return the replication lag of a replica database.
+ *
+ *  bytes is the amount of the journal that was waiting to be applied
+ *  at the start of the latest wg_apply_replica() call. seconds is the
+ *  time since the replica had applied the whole journal. Does not need
+ *  the replica handle, so any process reading the database may call this.
+ *
+ *  Returns 0 on success
+ *  Returns -1 if no journal is being applied to the database
+ */
+gint wg_replica_lag(void *db, gint *bytes, gint *seconds)
+{
+#ifdef USE_DBLOG
+  db_memsegment_header* dbh = dbmemsegh(db);
+  gint now = (gint) time(NULL);
+
+  if(!dbh->logging.replica) {
+    return -1;
+  }
+  if(bytes)
+    *bytes = dbh->logging.replica_lag;
+  if(seconds)
+    *seconds = (now > dbh->logging.replica_synced ?
+      now - dbh->logging.replica_synced : 0);
+  return 0;
+#else
+  return show_log_error(db, "Logging is disabled");
+#endif /* USE_DBLOG */
+}
+
+/** Stop applying the journal and release the replica.
+ *
+ *  The database can then be used as a normal database, for example
+ *  after the primary has failed.
+ */
+void wg_stop_replica(void *db, void *replica)
+{
+#ifdef USE_DBLOG
+  journal_replica *rep = (journal_replica *) replica;
+
+  if(rep) {
+    dbmemsegh(db)->logging.replica = 0;
+    free_cursor_encodes(db, &rep->cur);
+    fclose(rep->cur.f);
+    wg_ginthash_free(db, rep->table);
+    free(rep->filename);
+    free(rep);
+  }
+#endif
+}
+
+
 /* ------------ error handling ---------------- */
 
 static gint show_log_error(void *db, char *errmsg) {
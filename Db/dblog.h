@@ -57,6 +57,23 @@ typedef struct {
   int umask;
 } db_handle_logdata;
 
+/** Change event decoded from the journal, see wg_fetch_journal_event() */
+typedef struct {
+  gint op;          /** WG_JOURNAL_ENTRY_CRE, _DEL, _SET or _META */
+  gint pos;         /** journal position of the entry */
+  gint offset;      /** record offset */
+  gint column;      /** field number (SET) */
+  gint length;      /** record length (CRE) */
+  gint meta;        /** record metadata (META) */
+  gint enc;         /** encoded value as it was written (SET) */
+  gint type;        /** decoded value type (SET), 0 if not known */
+  gint intval;      /** int value, record offset for records,
+                     *  length of str, uri, xmlliteral or blob data */
+  double doubleval; /** double value */
+  char *strval;     /** str, uri, xmlliteral or blob data */
+  char *extstr;     /** lang, xsdtype or prefix */
+} wg_journal_event;
+
 /* ==== Protos ==== */
 
 gint wg_init_handle_logdata(void *db);
@@ -68,6 +85,17 @@ gint wg_start_logging(void *db);
 gint wg_stop_logging(void *db);
 gint wg_replay_log(void *db, char *filename);
 
+void *wg_open_journal_cursor(void *db, char *filename, gint serial, gint pos);
+void *wg_load_journal_cursor(void *db, char *posfile);
+gint wg_save_journal_cursor(void *db, void *cursor, char *posfile);
+gint wg_fetch_journal_event(void *db, void *cursor, wg_journal_event *ev);
+void wg_free_journal_cursor(void *db, void *cursor);
+
+void *wg_start_replica(void *db, char *filename);
+gint wg_apply_replica(void *db, void *replica);
+gint wg_replica_lag(void *db, gint *bytes, gint *seconds);
+void wg_stop_replica(void *db, void *replica);
+
 gint wg_log_create_record(void *db, gint length);
 gint wg_log_delete_record(void *db, gint enc);
 gint wg_log_encval(void *db, gint enc);
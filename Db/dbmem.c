@@ -511,13 +511,25 @@ void wg_print_code_version(void) {
     "  chained nodes in T-tree: %s\n"\
     "  record backlinking: %s\n"\
     "  child databases: %s\n"\
-    "  index templates: %s\n",
+    "  index templates: %s\n"\
+    "  runtime statistics: %s\n"\
+    "  lock timing: %s\n"\
+    "  inline doubles: %s\n"\
+    "  tiny strings: %s\n"\
+    "  record bitmap: %s\n"\
+    "  tables: %s\n",
     (MEMSEGMENT_FEATURES & FEATURE_BITS_64BIT ? "yes" : "no"),
     (MEMSEGMENT_FEATURES & FEATURE_BITS_QUEUED_LOCKS ? "yes" : "no"),
     (MEMSEGMENT_FEATURES & FEATURE_BITS_TTREE_CHAINED ? "yes" : "no"),
     (MEMSEGMENT_FEATURES & FEATURE_BITS_BACKLINK ? "yes" : "no"),
     (MEMSEGMENT_FEATURES & FEATURE_BITS_CHILD_DB ? "yes" : "no"),
-    (MEMSEGMENT_FEATURES & FEATURE_BITS_INDEX_TMPL ? "yes" : "no"));
+    (MEMSEGMENT_FEATURES & FEATURE_BITS_INDEX_TMPL ? "yes" : "no"),
+    (MEMSEGMENT_FEATURES & FEATURE_BITS_STATS ? "yes" : "no"),
+    (MEMSEGMENT_FEATURES & FEATURE_BITS_LOCKSTATS ? "yes" : "no"),
+    (MEMSEGMENT_FEATURES & FEATURE_BITS_INLINE_DOUBLE ? "yes" : "no"),
+    (MEMSEGMENT_FEATURES & FEATURE_BITS_TINYSTR ? "yes" : "no"),
+    (MEMSEGMENT_FEATURES & FEATURE_BITS_RECPTR_BITMAP ? "yes" : "no"),
+    (MEMSEGMENT_FEATURES & FEATURE_BITS_TABLES ? "yes" : "no"));
 }
 
 void wg_print_header_version(db_memsegment_header *dbh, int verbose) {
@@ -558,13 +570,25 @@ void wg_print_header_version(db_memsegment_header *dbh, int verbose) {
       "  chained nodes in T-tree: %s\n"\
       "  record backlinking: %s\n"\
       "  child databases: %s\n"\
-      "  index templates: %s\n",
+      "  index templates: %s\n"\
+      "  runtime statistics: %s\n"\
+      "  lock timing: %s\n"\
+      "  inline doubles: %s\n"\
+      "  tiny strings: %s\n"\
+      "  record bitmap: %s\n"\
+      "  tables: %s\n",
       (features & FEATURE_BITS_64BIT ? "yes" : "no"),
       (features & FEATURE_BITS_QUEUED_LOCKS ? "yes" : "no"),
       (features & FEATURE_BITS_TTREE_CHAINED ? "yes" : "no"),
       (features & FEATURE_BITS_BACKLINK ? "yes" : "no"),
       (features & FEATURE_BITS_CHILD_DB ? "yes" : "no"),
-      (features & FEATURE_BITS_INDEX_TMPL ? "yes" : "no"));
+      (features & FEATURE_BITS_INDEX_TMPL ? "yes" : "no"),
+      (features & FEATURE_BITS_STATS ? "yes" : "no"),
+      (features & FEATURE_BITS_LOCKSTATS ? "yes" : "no"),
+      (features & FEATURE_BITS_INLINE_DOUBLE ? "yes" : "no"),
+      (features & FEATURE_BITS_TINYSTR ? "yes" : "no"),
+      (features & FEATURE_BITS_RECPTR_BITMAP ? "yes" : "no"),
+      (features & FEATURE_BITS_TABLES ? "yes" : "no"));
   } else {
     printf("%d.%d.%d%s\n",
       (version & 0xff), ((version>>8) & 0xff), ((version>>16) & 0xff),
@@ -30,6 +30,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 
 /* ====== Private headers and defs ======== */
 
@@ -42,7 +48,8 @@ extern "C" {
 #include "dbcompare.h"
 #include "dbmpool.h"
 #include "dbschema.h"
-#include "dbhash.h"
+#include "dbstats.h"
+#include "dbtable.h"
 
 /* T-tree based scoring */
 #define TTREE_SCORE_EQUAL 5
@@ -72,33 +79,42 @@ struct __query_result_page {
 
 typedef struct __query_result_page query_result_page;
 
-typedef struct {
-  query_result_page *page;        /** current page of results */
-  gint pidx;                      /** current index on page (reading) */
-} query_result_cursor;
+#define QUERY_RESULTSET_MINSIZE 64  /* initial length of the offset array */
 
 typedef struct {
-  void *mpool;                    /** storage for row offsets */
-  query_result_page *first_page;  /** first page of results, for rewinding */
-  query_result_cursor wcursor;    /** read cursor */
-  query_result_cursor rcursor;    /** write cursor */
+  gint *rows;                     /** row offsets */
+  gint size;                      /** allocated length of rows */
   gint res_count;                 /** number of rows in results */
+  gint rpos;                      /** read position */
 } query_result_set;
 
 /* ======= Private protos ================ */
 
-static gint most_restricting_column(void *db,
+static gint most_restricting_column(void *db, gint table,
   wg_query_arg *arglist, gint argc, gint *index_id);
 static gint check_arglist(void *db, void *rec, wg_query_arg *arglist,
-  gint argc);
+  gint *argmodes, gint argc);
+static gint check_columns(void *db, db_table_projection *proj, gint slot,
+  wg_query_arg *arglist, gint *argpos, gint *argmodes, gint argc);
+static int check_cond(gint cond, gint cmp);
+#ifdef USE_INDEX_TEMPLATE
+static int implies_template_cond(void *db, wg_query_arg *arg, gint cond,
+  gint value);
+#endif
+static gint *projection_argpos(void *db, gint table,
+  wg_query_arg *arglist, gint argc);
 static gint prepare_params(void *db, void *matchrec, gint reclen,
   wg_query_arg *arglist, gint argc,
   wg_query_arg **farglist, gint *fargc);
 static gint find_ttree_bounds(void *db, gint index_id, gint col,
   gint start_bound, gint end_bound, gint start_inclusive, gint end_inclusive,
   gint *curr_offset, gint *curr_slot, gint *end_offset, gint *end_slot);
-static wg_query *internal_build_query(void *db, void *matchrec, gint reclen,
-  wg_query_arg *arglist, gint argc, gint flags, wg_uint rowlimit);
+static wg_query *internal_build_query(void *db, gint table,
+  void *matchrec, gint reclen, wg_query_arg *arglist, gint argc,
+  gint flags, wg_uint rowlimit, wg_query_explain *explain);
+static gint estimate_ttree_rows(void *db, gint curr_offset, gint curr_slot,
+  gint end_offset, gint end_slot);
+static double query_clock(void);
 
 static query_result_set *create_resultset(void *db);
 static void free_resultset(void *db, query_result_set *set);
@@ -107,6 +123,21 @@ static gint append_resultset(void *db, query_result_set *set, gint offset);
 static gint fetch_resultset(void *db, query_result_set *set);
 static query_result_set *intersect_resultset(void *db,
   query_result_set *seta, query_result_set *setb);
+static gint gallop_resultset(gint *rows, gint count, gint pos, gint offset);
+static void unique_resultset(void *db, query_result_set *set);
+static int compare_offsets(const void *a, const void *b);
+static gint resultset_to_pages(void *db, query_result_set *set,
+  wg_query *query);
+static int json_value_matches(void *db, gint enc, wg_json_query_arg *arg);
+static int json_value_holds(void *db, gint enc, gint value, gint cond);
+static int json_path_matches(void *db, gint enc, char *path,
+  wg_json_query_arg *arg, int depth);
+static gint check_and_merge_by_path(void *db, void *doc,
+  wg_json_query_arg *arg, query_result_set *next_set);
+static int json_cond_holds(void *db, gint enc, gint value, gint cond);
+static gint json_other_number(void *db, gint value, gint *other);
+static gint scan_json_hash(void *db, gint index_id,
+  wg_json_query_arg *arg, query_result_set *next_set);
 static gint check_and_merge_by_kv(void *db, void *rec,
   wg_json_query_arg *arg, query_result_set *next_set);
 static gint check_and_merge_by_key(void *db, void *rec,
@@ -115,7 +146,14 @@ static gint check_and_merge_recursively(void *db, void *rec,
   wg_json_query_arg *arg, query_result_set *next_set, int depth);
 static gint prepare_json_arglist(void *db, wg_json_query_arg *arglist,
   wg_json_query_arg **sorted_arglist, gint argc,
-  gint *index_id, gint *vindex_id, gint *kindex_id);
+  gint *index_id, gint *vindex_id, gint *kindex_id, gint *pindex_id);
+static int json_arg_rank(void *db, wg_json_query_arg *arg);
+static gint json_value_index(void *db, gint key, gint vindex_id);
+static gint scan_json_range(void *db, gint index_id,
+  wg_json_query_arg *arg, query_result_set *next_set);
+static gint scan_json_value_index(void *db, gint index_id,
+  wg_json_query_arg *arg, gint bound, int dir, gint type,
+  query_result_set *next_set);
 
 static gint encode_query_param_unistr(void *db, char *data, gint type,
   char *extdata, int length);
@@ -133,8 +171,10 @@ static gint show_query_error(void* db, char* errmsg);
  *  with hash indexes.
  *  XXX: currently only considers the existence of T-tree
  *  index and nothing else.
+ *  If table is non-0, an index on the table is preferred, but
+ *  indexes on all records are usable too.
  */
-static gint most_restricting_column(void *db,
+static gint most_restricting_column(void *db, gint table,
   wg_query_arg *arglist, gint argc, gint *index_id) {
 
   struct column_score {
@@ -208,11 +248,14 @@ static gint most_restricting_column(void *db,
             (wg_index_header *) offsettoptr(db, ilistelem->car);
 
           if(hdr->type == WG_INDEX_TYPE_TTREE) {
+            /* Indexes on other tables are missing some records */
+            if(hdr->table && hdr->table != table)
+              goto nextindex;
 #ifdef USE_INDEX_TEMPLATE
             /* If index templates are available, we can increase the
-             * score of the index if the template has any columns matching
-             * the query parameters. On the other hand, in case of a
-             * mismatch the index is unusable and has to be skipped.
+             * score of the index if the query parameters imply the
+             * condition of each template column. Otherwise the index
+             * may be missing some matching records and has to be skipped.
              * The indexes are sorted in the order of fixed columns in
              * the template, so if there is a match, the search is
              * complete (remaining index are likely to be worse)
@@ -226,23 +269,23 @@ static gint most_restricting_column(void *db,
                 gint enc = wg_get_field(db, matchrec, j);
                 if(wg_get_encoded_type(db, enc) != WG_VARTYPE) {
                   /* defined column in matchrec. The score is increased
-                   * if arglist has a WG_COND_EQUAL column with the same
-                   * value. In any other case the index is not usable.
+                   * if arglist has an argument on this column that
+                   * implies the template condition (for an exact-match
+                   * template, WG_COND_EQUAL with the same value). In any
+                   * other case the index is not usable.
                    */
+                  gint cond = wg_get_template_cond(db, tmpl, j);
                   int match = 0, k;
                   for(k=0; k<argc; k++) {
-                    if(arglist[k].column == j) {
-                      if(arglist[k].cond == WG_COND_EQUAL &&\
-                        WG_COMPARE(db, enc, arglist[k].value) == WG_EQUAL) {
-                        match = 1;
-                      }
-                      else
-                        goto nextindex;
+                    if(arglist[k].column == j &&\
+                      implies_template_cond(db, &arglist[k], cond, enc)) {
+                      match = 1;
+                      break;
                     }
                   }
                   if(match) {
                     sc[i].score += TTREE_SCORE_MASK;
-                    if(!enc)
+                    if(!enc && cond == WG_COND_EQUAL)
                       sc[i].score += TTREE_SCORE_NULL;
                   }
                   else
@@ -251,13 +294,17 @@ static gint most_restricting_column(void *db,
               }
             }
 #endif
-            sc[i].index_id = ilistelem->car;
-            break;
+            if(hdr->table == table) {
+              sc[i].index_id = ilistelem->car;
+              break;
+            }
+            /* Index on all records, keep looking for one
+             * on the table */
+            if(!sc[i].index_id)
+              sc[i].index_id = ilistelem->car;
           }
         }
-#ifdef USE_INDEX_TEMPLATE
 nextindex:
-#endif
         ilist = &ilistelem->cdr;
       }
     }
@@ -279,17 +326,19 @@ nextindex:
 }
 
 /** Check a record against list of conditions
+ *  argmodes holds the comparison mode (see WG_COMPARE_MODE()) of each
+ *  argument value. If it is NULL, the modes are computed here.
  *  returns 1 if the record matches
  *  returns 0 if the record fails at least one condition
  */
 static gint check_arglist(void *db, void *rec, wg_query_arg *arglist,
-  gint argc) {
+  gint *argmodes, gint argc) {
 
   int i, reclen;
 
   reclen = wg_get_record_len(db, rec);
   for(i=0; i<argc; i++) {
-    gint encoded;
+    gint encoded, mode, cmp;
     if(arglist[i].column < reclen)
       encoded = wg_get_field(db, rec, arglist[i].column);
     else
@@ -299,39 +348,145 @@ static gint check_arglist(void *db, void *rec, wg_query_arg *arglist,
                  * concept of comparisons to NULL always failing.
                  */
 
-    switch(arglist[i].cond) {
-      case WG_COND_EQUAL:
-        if(WG_COMPARE(db, encoded, arglist[i].value) != WG_EQUAL)
-          return 0;
-        break;
-      case WG_COND_LESSTHAN:
-        if(WG_COMPARE(db, encoded, arglist[i].value) != WG_LESSTHAN)
-          return 0;
-        break;
-      case WG_COND_GREATER:
-        if(WG_COMPARE(db, encoded, arglist[i].value) != WG_GREATER)
-          return 0;
-        break;
-      case WG_COND_LTEQUAL:
-        if(WG_COMPARE(db, encoded, arglist[i].value) == WG_GREATER)
+    mode = (argmodes ? argmodes[i] : WG_COMPARE_MODE(arglist[i].value));
+    cmp = WG_COMPARE_FAST(db, mode, encoded, arglist[i].value);
+    if(!check_cond(arglist[i].cond, cmp))
+      return 0;
+  }
+
+  return 1;
+}
+
+#ifdef USE_INDEX_TEMPLATE
+/** Check if a query argument implies a template condition
+ *  The template condition holds between the field and value. If every
+ *  field value that satisfies the query argument also satisfies the
+ *  template condition, the rows of the query are all in the index.
+ *  returns 1 if the argument implies the condition, 0 otherwise
+ */
+static int implies_template_cond(void *db, wg_query_arg *arg, gint cond,
+  gint value) {
+  gint cmp = WG_COMPARE(db, arg->value, value);
+
+  switch(cond) {
+    case WG_COND_EQUAL:
+      return (arg->cond == WG_COND_EQUAL && cmp == WG_EQUAL);
+    case WG_COND_NOT_EQUAL:
+      switch(arg->cond) {
+        case WG_COND_EQUAL:
+          return (cmp != WG_EQUAL);
+        case WG_COND_NOT_EQUAL:
+          return (cmp == WG_EQUAL);
+        case WG_COND_LESSTHAN:
+          return (cmp != WG_GREATER);
+        case WG_COND_LTEQUAL:
+          return (cmp == WG_LESSTHAN);
+        case WG_COND_GREATER:
+          return (cmp != WG_LESSTHAN);
+        case WG_COND_GTEQUAL:
+          return (cmp == WG_GREATER);
+        default:
           return 0;
-        break;
-      case WG_COND_GTEQUAL:
-        if(WG_COMPARE(db, encoded, arglist[i].value) == WG_LESSTHAN)
+      }
+    case WG_COND_LESSTHAN:
+      switch(arg->cond) {
+        case WG_COND_EQUAL:
+        case WG_COND_LTEQUAL:
+          return (cmp == WG_LESSTHAN);
+        case WG_COND_LESSTHAN:
+          return (cmp != WG_GREATER);
+        default:
           return 0;
-        break;
-      case WG_COND_NOT_EQUAL:
-        if(WG_COMPARE(db, encoded, arglist[i].value) == WG_EQUAL)
+      }
+    case WG_COND_LTEQUAL:
+      return ((arg->cond == WG_COND_EQUAL || arg->cond == WG_COND_LESSTHAN ||\
+        arg->cond == WG_COND_LTEQUAL) && cmp != WG_GREATER);
+    case WG_COND_GREATER:
+      switch(arg->cond) {
+        case WG_COND_EQUAL:
+        case WG_COND_GTEQUAL:
+          return (cmp == WG_GREATER);
+        case WG_COND_GREATER:
+          return (cmp != WG_LESSTHAN);
+        default:
           return 0;
-        break;
-      default:
-        break;
-    }
+      }
+    case WG_COND_GTEQUAL:
+      return ((arg->cond == WG_COND_EQUAL || arg->cond == WG_COND_GREATER ||\
+        arg->cond == WG_COND_GTEQUAL) && cmp != WG_LESSTHAN);
+    default:
+      return 0;
+  }
+}
+#endif
+
+/** Check a row of a column projection against list of conditions
+ *  argpos holds the position of each argument column in the projection.
+ *  returns 1 if the row matches
+ *  returns 0 if the row fails at least one condition
+ */
+static gint check_columns(void *db, db_table_projection *proj, gint slot,
+  wg_query_arg *arglist, gint *argpos, gint *argmodes, gint argc) {
+
+  int i;
+
+  for(i=0; i<argc; i++) {
+    gint encoded = PROJECTION_VALUES(db, proj, argpos[i])[slot];
+    gint cmp;
+    if(encoded == WG_ILLEGAL)
+      return 0; /* record too short, as in check_arglist() */
+    cmp = WG_COMPARE_FAST(db, argmodes[i], encoded, arglist[i].value);
+    if(!check_cond(arglist[i].cond, cmp))
+      return 0;
   }
 
   return 1;
 }
 
+/** Check the result of a comparison against a condition
+ *  returns 1 if the condition holds, 0 otherwise
+ */
+static int check_cond(gint cond, gint cmp) {
+  switch(cond) {
+    case WG_COND_EQUAL:
+      return (cmp == WG_EQUAL);
+    case WG_COND_LESSTHAN:
+      return (cmp == WG_LESSTHAN);
+    case WG_COND_GREATER:
+      return (cmp == WG_GREATER);
+    case WG_COND_LTEQUAL:
+      return (cmp != WG_GREATER);
+    case WG_COND_GTEQUAL:
+      return (cmp != WG_LESSTHAN);
+    case WG_COND_NOT_EQUAL:
+      return (cmp != WG_EQUAL);
+    default:
+      return 1;
+  }
+}
+
+/** Find the projection columns of the query arguments
+ *  returns a new array with the position of each argument column
+ *  returns NULL if the table has no projection covering all of them
+ */
+static gint *projection_argpos(void *db, gint table,
+  wg_query_arg *arglist, gint argc) {
+
+  gint *argpos;
+  int i;
+
+  for(i=0; i<argc; i++) {
+    if(wg_table_column_pos(db, table, arglist[i].column) < 0)
+      return NULL;
+  }
+  argpos = (gint *) malloc(argc * sizeof(gint));
+  if(argpos) {
+    for(i=0; i<argc; i++)
+      argpos[i] = wg_table_column_pos(db, table, arglist[i].column);
+  }
+  return argpos;
+}
+
 /** Prepare query parameters
  *
  * - Validates matchrec and arglist
@@ -454,6 +609,7 @@ static gint find_ttree_bounds(void *db, gint index_id, gint col,
   wg_index_header *hdr = (wg_index_header *) offsettoptr(db, index_id);
   struct wg_tnode *node;
 
+  WG_STAT_INC(db, WG_STAT_TTREE_SEARCHES);
   if(start_bound==WG_ILLEGAL) {
     /* Find leftmost node in index */
 #ifdef TTREE_CHAINED_NODES
@@ -662,11 +818,17 @@ static gint find_ttree_bounds(void *db, gint index_id, gint col,
  * rowlimit - maximum number of rows fetched. Only has an effect if
  * QUERY_FLAGS_PREFETCH is set.
  *
+ * explain - if not NULL, the chosen plan and the estimated number of
+ * rows are stored here.
+ *
+ * table - if non-0, only records of this table are returned.
+ *
  * returns NULL if constructing the query fails. Otherwise returns a pointer
  * to a wg_query object.
  */
-static wg_query *internal_build_query(void *db, void *matchrec, gint reclen,
-  wg_query_arg *arglist, gint argc, gint flags, wg_uint rowlimit) {
+static wg_query *internal_build_query(void *db, gint table,
+  void *matchrec, gint reclen, wg_query_arg *arglist, gint argc,
+  gint flags, wg_uint rowlimit, wg_query_explain *explain) {
 
   wg_query *query;
   wg_query_arg *full_arglist;
@@ -700,13 +862,17 @@ static wg_query *internal_build_query(void *db, void *matchrec, gint reclen,
     if(full_arglist) free(full_arglist);
     return NULL;
   }
+  query->argmodes = NULL;
+  query->argpos = NULL;
+  query->examined = 0;
+  query->table = table;
 
   if(fargc) {
     /* Find the best (hopefully) index to base the query on.
      * Then initialise the query object to the first row in the
      * query result set.
      * XXX: only considering T-tree indexes now. */
-    col = most_restricting_column(db, full_arglist, fargc, &index_id);
+    col = most_restricting_column(db, table, full_arglist, fargc, &index_id);
   }
   else {
     /* Create a "full scan" query with no arguments. */
@@ -721,6 +887,7 @@ static wg_query *internal_build_query(void *db, void *matchrec, gint reclen,
 
     query->qtype = WG_QTYPE_TTREE;
     query->column = col;
+    WG_STAT_INC(db, WG_STAT_QUERY_TTREE);
     query->curr_offset = 0;
     query->curr_slot = -1;
     query->end_offset = 0;
@@ -812,6 +979,16 @@ static wg_query *internal_build_query(void *db, void *matchrec, gint reclen,
       }
     }
 
+    if(explain) {
+      explain->qtype = WG_QTYPE_TTREE;
+      explain->column = col;
+      explain->index_id = index_id;
+      explain->start_bound = start_bound;
+      explain->start_inclusive = start_inclusive;
+      explain->end_bound = end_bound;
+      explain->end_inclusive = end_inclusive;
+    }
+
     /* Simple sanity check. Is start_bound greater than end_bound? */
     if(start_bound!=WG_ILLEGAL && end_bound!=WG_ILLEGAL &&\
       WG_COMPARE(db, start_bound, end_bound) == WG_GREATER) {
@@ -832,6 +1009,11 @@ static wg_query *internal_build_query(void *db, void *matchrec, gint reclen,
       return NULL;
     }
 
+    if(explain) {
+      explain->estimated = estimate_ttree_rows(db, query->curr_offset,
+        query->curr_slot, query->end_offset, query->end_slot);
+    }
+
     /* XXX: here we can reverse the direction and switch the start and
      * end nodes/slots, if "descending" sort order is needed.
      */
@@ -843,12 +1025,41 @@ static wg_query *internal_build_query(void *db, void *matchrec, gint reclen,
     query->qtype = WG_QTYPE_SCAN;
     query->column = -1; /* no special column, entire argument list
                          * should be checked for each row */
+    WG_STAT_INC(db, WG_STAT_QUERY_SCAN);
+
+    /* If the table has a column projection with all the argument
+     * columns, the conditions are checked on the projection and
+     * only the matching records are read. */
+    if(table && fargc)
+      query->argpos = projection_argpos(db, table, full_arglist, fargc);
+    if(query->argpos) {
+      query->qtype = WG_QTYPE_COLUMNS;
+      query->curr_slot = 0;
+    } else {
+      if(table)
+        rec = wg_get_first_table_record(db, table);
+      else
+        rec = wg_get_first_record(db);
+      if(rec)
+        query->curr_record = ptrtooffset(db, rec);
+      else
+        query->curr_record = 0;
+    }
 
-    rec = wg_get_first_record(db);
-    if(rec)
-      query->curr_record = ptrtooffset(db, rec);
-    else
-      query->curr_record = 0;
+    if(explain) {
+      /* Every record is examined. The datarec area also contains
+       * some internal records, so this is slightly too high. */
+      wg_area_usage usage;
+      explain->qtype = query->qtype;
+      explain->column = -1;
+      explain->index_id = 0;
+      explain->start_bound = explain->end_bound = WG_ILLEGAL;
+      explain->start_inclusive = explain->end_inclusive = 0;
+      if(table)
+        explain->estimated = wg_get_table_record_count(db, table);
+      else if(!wg_get_area_usage(db, WG_AREA_DATAREC, &usage))
+        explain->estimated = usage.used_objects;
+    }
   }
 
   /* Now attach the argument list to the query. If the query is based
@@ -890,6 +1101,24 @@ static wg_query *internal_build_query(void *db, void *matchrec, gint reclen,
                          * the original one */
   }
 
+  /* The type of each argument value is known by now, so the
+   * comparison mode can be chosen once instead of for every row.
+   */
+  if(query->argc) {
+    query->argmodes = (gint *) malloc(query->argc * sizeof(gint));
+    if(!query->argmodes) {
+      show_query_error(db, "Failed to allocate memory");
+      free(query->arglist);
+      if(query->argpos) free(query->argpos);
+      free(query);
+      return NULL;
+    }
+    for(i=0; i<query->argc; i++)
+      query->argmodes[i] = WG_COMPARE_MODE(query->arglist[i].value);
+  }
+  if(explain)
+    explain->argc = query->argc;
+
   /* Now handle any post-processing required.
    */
   if(flags & QUERY_FLAGS_PREFETCH) {
@@ -953,8 +1182,8 @@ static wg_query *internal_build_query(void *db, void *matchrec, gint reclen,
 wg_query *wg_make_query(void *db, void *matchrec, gint reclen,
   wg_query_arg *arglist, gint argc) {
 
-  return internal_build_query(db,
-    matchrec, reclen, arglist, argc, QUERY_FLAGS_PREFETCH, 0);
+  return internal_build_query(db, 0,
+    matchrec, reclen, arglist, argc, QUERY_FLAGS_PREFETCH, 0, NULL);
 }
 
 /** Create a query object and pre-fetch rowlimit number of rows.
@@ -965,8 +1194,93 @@ wg_query *wg_make_query(void *db, void *matchrec, gint reclen,
 wg_query *wg_make_query_rc(void *db, void *matchrec, gint reclen,
   wg_query_arg *arglist, gint argc, wg_uint rowlimit) {
 
-  return internal_build_query(db,
-    matchrec, reclen, arglist, argc, QUERY_FLAGS_PREFETCH, rowlimit);
+  return internal_build_query(db, 0,
+    matchrec, reclen, arglist, argc, QUERY_FLAGS_PREFETCH, rowlimit, NULL);
+}
+
+/** Create a query object on the records of a table.
+ *
+ * Works like wg_make_query(), but only returns the records of
+ * the given table. A query with no conditions scans the table only.
+ *
+ * returns NULL if constructing the query fails. Otherwise returns a pointer
+ * to a wg_query object.
+ */
+wg_query *wg_make_table_query(void *db, gint table, void *matchrec,
+  gint reclen, wg_query_arg *arglist, gint argc) {
+
+  if(wg_get_table_record_count(db, table) < 0) {
+    show_query_error(db, "Invalid table");
+    return NULL;
+  }
+  return internal_build_query(db, table,
+    matchrec, reclen, arglist, argc, QUERY_FLAGS_PREFETCH, 0, NULL);
+}
+
+/** Run a query and report the plan and the execution profile.
+ *
+ * The query is built and all the matching rows are fetched like
+ * wg_make_query() does, then the query is released. The start and end
+ * bounds in the explain structure point to the values in the argument
+ * list (or matchrec), so they are valid as long as those are.
+ *
+ * returns 0 on success
+ * returns -1 if the query could not be created
+ */
+gint wg_explain_query(void *db, void *matchrec, gint reclen,
+  wg_query_arg *arglist, gint argc, wg_query_explain *explain) {
+
+  wg_query *query;
+  double start;
+
+  memset(explain, 0, sizeof(wg_query_explain));
+  start = query_clock();
+  query = internal_build_query(db, 0,
+    matchrec, reclen, arglist, argc, QUERY_FLAGS_PREFETCH, 0, explain);
+  explain->elapsed = query_clock() - start;
+  if(!query)
+    return -1;
+  explain->examined = query->examined;
+  if(query->qtype == WG_QTYPE_PREFETCH)
+    explain->returned = query->res_count; /* else empty range */
+  wg_free_query(db, query);
+  return 0;
+}
+
+/** Estimate the number of rows in a T-tree range by
+ *  counting the elements in the nodes between the bounds.
+ */
+static gint estimate_ttree_rows(void *db, gint curr_offset, gint curr_slot,
+  gint end_offset, gint end_slot) {
+
+  gint rows = 0;
+
+  while(curr_offset) {
+    struct wg_tnode *node = (struct wg_tnode *) offsettoptr(db, curr_offset);
+    if(curr_offset == end_offset) {
+      rows += end_slot - curr_slot + 1;
+      break;
+    }
+    rows += node->number_of_elements - curr_slot;
+    curr_offset = TNODE_SUCCESSOR(db, node);
+    curr_slot = 0;
+  }
+  return (rows > 0 ? rows : 0);
+}
+
+/** Monotonic time in seconds, for measuring query execution.
+ */
+static double query_clock(void) {
+#ifdef _WIN32
+  LARGE_INTEGER cnt, freq;
+  QueryPerformanceCounter(&cnt);
+  QueryPerformanceFrequency(&freq);
+  return (double) cnt.QuadPart / freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
 }
 
 
@@ -1002,7 +1316,10 @@ void *wg_fetch(void *db, wg_query *query) {
       rec = offsettoptr(db, query->curr_record);
 
       /* Pre-fetch the next record */
-      next = wg_get_next_record(db, rec);
+      if(query->table)
+        next = wg_get_next_table_record(db, query->table, rec);
+      else
+        next = wg_get_next_record(db, rec);
       if(next)
         query->curr_record = ptrtooffset(db, next);
       else
@@ -1011,11 +1328,42 @@ void *wg_fetch(void *db, wg_query *query) {
       /* Check the record against all conditions; if it does
        * not match, go to next iteration.
        */
+      WG_STAT_INC(db, WG_STAT_QUERY_EXAMINED);
+      query->examined++;
       if(!query->arglist || \
-        check_arglist(db, rec, query->arglist, query->argc))
+        check_arglist(db, rec, query->arglist, query->argmodes,
+          query->argc)) {
+        WG_STAT_INC(db, WG_STAT_QUERY_RETURNED);
         return rec;
+      }
     }
   }
+  else if(query->qtype == WG_QTYPE_COLUMNS) {
+    db_memsegment_header* dbh = dbmemsegh(db);
+    db_table_projection *proj;
+    gint *rows;
+
+    if(!dbh->tables.columns[query->table])
+      return NULL; /* projection was dropped */
+    proj = (db_table_projection *) \
+      offsettoptr(db, dbh->tables.columns[query->table]);
+    rows = PROJECTION_ROWS(db, proj);
+
+    while(query->curr_slot < proj->used) {
+      gint slot = query->curr_slot++;
+      if(!rows[slot])
+        continue; /* deleted record */
+
+      WG_STAT_INC(db, WG_STAT_QUERY_EXAMINED);
+      query->examined++;
+      if(check_columns(db, proj, slot, query->arglist, query->argpos,
+        query->argmodes, query->argc)) {
+        WG_STAT_INC(db, WG_STAT_QUERY_RETURNED);
+        return offsettoptr(db, rows[slot]);
+      }
+    }
+    return NULL;
+  }
   else if(query->qtype == WG_QTYPE_TTREE) {
     struct wg_tnode *node;
 
@@ -1070,12 +1418,21 @@ void *wg_fetch(void *db, wg_query *query) {
         }
       }
 
+      /* An index on all records may return rows of other tables */
+      if(query->table && record_table(rec) != query->table)
+        continue;
+
       /* If there are no extra conditions or the row satisfies
        * all the conditions, we can return.
        */
+      WG_STAT_INC(db, WG_STAT_QUERY_EXAMINED);
+      query->examined++;
       if(!query->arglist || \
-        check_arglist(db, rec, query->arglist, query->argc))
+        check_arglist(db, rec, query->arglist, query->argmodes,
+          query->argc)) {
+        WG_STAT_INC(db, WG_STAT_QUERY_RETURNED);
         return rec;
+      }
     }
   }
   if(query->qtype == WG_QTYPE_PREFETCH) {
@@ -1108,6 +1465,10 @@ void *wg_fetch(void *db, wg_query *query) {
 void wg_free_query(void *db, wg_query *query) {
   if(query->arglist)
     free(query->arglist);
+  if(query->argmodes)
+    free(query->argmodes);
+  if(query->argpos)
+    free(query->argpos);
   if(query->qtype==WG_QTYPE_PREFETCH && query->mpool)
     wg_free_mpool(db, query->mpool);
   free(query);
@@ -1171,6 +1532,11 @@ gint wg_encode_query_param_int(void *db, gint data) {
 gint wg_encode_query_param_double(void *db, double data) {
   void *dptr;
 
+#ifdef USE_INLINE_DOUBLE
+  gint enc = wg_encode_inline_double(data);
+  if(enc)
+    return enc;
+#endif
   dptr=malloc(2*sizeof(gint));
   if(!dptr) {
     show_query_error(db, "Failed to encode query parameter");
@@ -1218,6 +1584,11 @@ static gint encode_query_param_unistr(void *db, char *data, gint type,
   char *extdata, int length) {
 
   void *dptr;
+#ifdef USETINYSTR
+  if(type == WG_STRTYPE && extdata == NULL && fits_tinystr(length)) {
+    return wg_encode_tinystr(data, length);
+  }
+#endif
   if(type == WG_STRTYPE && extdata == NULL) {
     dptr=malloc(length+1);
     if(!dptr) {
@@ -1333,6 +1704,10 @@ gint wg_free_query_param(void* db, gint data) {
 
 /* XXX: consider converting the main query function to use this as well.
  * Currently only used to support the JSON/document query.
+ *
+ * A result set is an array of row offsets. unique_resultset() sorts
+ * it and removes the duplicates, after that two sets can be intersected
+ * by merging them.
  */
 
 /*
@@ -1346,38 +1721,27 @@ static query_result_set *create_resultset(void *db) {
     return NULL;
   }
 
-  set->rcursor.page = NULL;                 /* initialize as empty */
-  set->rcursor.pidx = 0;
-  set->wcursor.page = NULL;
-  set->wcursor.pidx = QUERY_RESULTSET_PAGESIZE; /* new page needed */
-  set->first_page = NULL;
+  set->rows = NULL;                 /* allocated by the first append */
+  set->size = 0;
   set->res_count = 0;
-
-  set->mpool = wg_create_mpool(db, sizeof(query_result_page));
-  if(!set->mpool) {
-    show_query_error(db, "Failed to allocate result memory pool");
-    free(set);
-    return NULL;
-  }
+  set->rpos = 0;
   return set;
 }
 
 /*
- * Free the resultset and it's memory pool
+ * Free the resultset and it's offset array
  */
 static void free_resultset(void *db, query_result_set *set) {
-  if(set->mpool)
-    wg_free_mpool(db, set->mpool);
+  if(set->rows)
+    free(set->rows);
   free(set);
 }
 
 /*
- * Set the resultset pointers to the beginning of the
- * first results page.
+ * Set the read position to the beginning of the set.
  */
 static void rewind_resultset(void *db, query_result_set *set) {
-  set->rcursor.page = set->first_page;
-  set->rcursor.pidx = 0;
+  set->rpos = 0;
 }
 
 /*
@@ -1386,29 +1750,17 @@ static void rewind_resultset(void *db, query_result_set *set) {
  * returns -1 on error.
  */
 static gint append_resultset(void *db, query_result_set *set, gint offset) {
-  if(set->wcursor.pidx >= QUERY_RESULTSET_PAGESIZE) {
-    query_result_page *newpage = (query_result_page *) \
-        wg_alloc_mpool(db, set->mpool, sizeof(query_result_page));
-    if(!newpage) {
-      return show_query_error(db, "Failed to allocate a resultset page");
-    }
-
-    memset(newpage->rows, 0, sizeof(gint) * QUERY_RESULTSET_PAGESIZE);
-    newpage->next = NULL;
-
-    if(set->wcursor.page) {
-      set->wcursor.page->next = newpage;
-    } else {
-      /* first_page==NULL implied */
-      set->first_page = newpage;
-      set->rcursor.page = newpage;
+  if(set->res_count >= set->size) {
+    gint newsize = (set->size ? 2 * set->size : QUERY_RESULTSET_MINSIZE);
+    gint *tmp = (gint *) realloc(set->rows, newsize * sizeof(gint));
+    if(!tmp) {
+      return show_query_error(db, "Failed to allocate resultset rows");
     }
-    set->wcursor.page = newpage;
-    set->wcursor.pidx = 0;
+    set->rows = tmp;
+    set->size = newsize;
   }
 
-  set->wcursor.page->rows[set->wcursor.pidx++] = offset;
-  set->res_count++;
+  set->rows[set->res_count++] = offset;
   return 0;
 }
 
@@ -1417,172 +1769,146 @@ static gint append_resultset(void *db, query_result_set *set, gint offset) {
  * returns 0 if the set is exhausted.
  */
 static gint fetch_resultset(void *db, query_result_set *set) {
-  if(set->rcursor.page) {
-    gint offset = set->rcursor.page->rows[set->rcursor.pidx++];
-    if(!offset) {
-      /* page not filled completely. Mark set as exhausted. */
-      set->rcursor.page = NULL;
-    } else {
-      if(set->rcursor.pidx >= QUERY_RESULTSET_PAGESIZE) {
-        set->rcursor.page = set->rcursor.page->next;
-        set->rcursor.pidx = 0;
-      }
-    }
-    return offset;
-  }
+  if(set->rpos < set->res_count)
+    return set->rows[set->rpos++];
   return 0;
 }
 
-#define NESTEDLOOP 0
-#define HASHJOIN 1
-
 /*
- * Create an intersection of two result sets.
- * Join strategy:
- *   if the number of inner loops expected is low (i.e. the sets
- *   are small), nested loop join is used. Otherwise, hash join
- *   is used.
+ * Create an intersection of two sorted result sets.
+ * Each offset of the smaller set is searched from the larger set
+ * by galloping forward from the position of the previous match, so
+ * the cost depends mostly on the size of the smaller set. The result
+ * is stored in the smaller set, the other set is freed.
  *
- * Returns a new result set (can be empty).
- * Returns NULL on error.
+ * Returns the result set (can be empty).
  */
 static query_result_set *intersect_resultset(void *db,
   query_result_set *seta, query_result_set *setb)
 {
-  query_result_set *intersection;
-  int strategy = HASHJOIN;
+  gint i, pos = 0, count = 0;
 
-  if(!(intersection = create_resultset(db))) {
-    return NULL;
+  if(seta->res_count > setb->res_count) {
+    query_result_set *tmp = seta;
+    seta = setb;
+    setb = tmp;
   }
-  if(seta->res_count * setb->res_count < 200) {
-    strategy = NESTEDLOOP; /* don't bother with hash table */
+
+  for(i=0; i<seta->res_count && pos<setb->res_count; i++) {
+    gint offset = seta->rows[i];
+    pos = gallop_resultset(setb->rows, setb->res_count, pos, offset);
+    if(pos < setb->res_count && setb->rows[pos] == offset)
+      seta->rows[count++] = offset;
   }
+  seta->res_count = count;
+  seta->rpos = 0;
 
-  if(strategy == HASHJOIN) {
-    void *hasht = NULL;
-    gint offset;
+  free_resultset(db, setb);
+  return seta;
+}
 
-    if(seta->res_count > setb->res_count) {
-      query_result_set *tmp = seta;
-      seta = setb;
-      setb = tmp;
-    }
+/*
+ * Find the first position at or after pos in a sorted array of
+ * offsets where the value is not less than offset. The distance
+ * from pos is doubled until the value is passed, then the last
+ * interval is halved.
+ *
+ * Returns the position, count if all values are smaller.
+ */
+static gint gallop_resultset(gint *rows, gint count, gint pos, gint offset)
+{
+  gint step = 1, lo = pos, hi;
 
-    if(!(hasht = wg_dhash_init(db, seta->res_count))) {
-      free_resultset(db, intersection);
-      return NULL;
-    }
+  while(pos + step < count && rows[pos + step] < offset) {
+    lo = pos + step;
+    step *= 2;
+  }
+  hi = (pos + step < count ? pos + step : count);
+  if(rows[lo] >= offset)
+    return lo;
 
-    rewind_resultset(db, seta);
-    while((offset = fetch_resultset(db, seta))) {
-      if(wg_dhash_addkey(db, hasht, offset)) {
-        free_resultset(db, intersection);
-        wg_dhash_free(db, hasht);
-        return NULL;
-      }
-    }
-    rewind_resultset(db, setb);
-    while((offset = fetch_resultset(db, setb))) {
-      if(wg_dhash_haskey(db, hasht, offset)) {
-        gint err = append_resultset(db, intersection, offset);
-        if(err) {
-          free_resultset(db, intersection);
-          wg_dhash_free(db, hasht);
-          return NULL;
-        }
-      }
-    }
-    wg_dhash_free(db, hasht);
-  }
-  else { /* nested loop strategy */
-    gint offseta;
-    rewind_resultset(db, seta);
-    while((offseta = fetch_resultset(db, seta))) {
-      gint offsetb;
-      rewind_resultset(db, setb);
-      while((offsetb = fetch_resultset(db, setb))) {
-        if(offseta == offsetb) {
-          gint err = append_resultset(db, intersection, offseta);
-          if(err) {
-            free_resultset(db, intersection);
-            return NULL;
-          }
-          break;
-        }
-      }
-    }
+  /* rows[lo] < offset <= rows[hi] (if hi < count) */
+  while(hi - lo > 1) {
+    gint mid = lo + (hi - lo) / 2;
+    if(rows[mid] < offset)
+      lo = mid;
+    else
+      hi = mid;
   }
-  return intersection;
+  return hi;
 }
 
 /*
- * Create a result set that contains only unique rows.
- * Uniqueness test uses similar strategy to the intersect function
- * (hash table for membership test, but revert to nested loop if
- * low number of elements).
- *
- * Returns a new result set (can be empty).
- * Returns NULL on error.
+ * Sort the result set and remove the duplicate rows.
+ * Sets filled by scanning the database or another set are usually
+ * in order already, those are not sorted again.
  */
-static query_result_set *unique_resultset(void *db, query_result_set *set)
+static void unique_resultset(void *db, query_result_set *set)
 {
-  gint offset;
-  query_result_set *unique;
-  int strategy = HASHJOIN;
+  gint i, count;
 
-  if(!(unique = create_resultset(db))) {
-    return NULL;
+  for(i=1; i<set->res_count; i++) {
+    if(set->rows[i] <= set->rows[i-1])
+      break;
   }
-  if(set->res_count < 20) {
-    strategy = NESTEDLOOP; /* don't bother with hash table */
+  if(i >= set->res_count) {
+    set->rpos = 0;
+    return; /* sorted, no duplicates */
   }
 
-  rewind_resultset(db, set);
+  qsort(set->rows, set->res_count, sizeof(gint), compare_offsets);
+  for(i=1, count=1; i<set->res_count; i++) {
+    if(set->rows[i] != set->rows[count-1])
+      set->rows[count++] = set->rows[i];
+  }
+  set->res_count = count;
+  set->rpos = 0;
+}
 
-  if(strategy == HASHJOIN) {
-    void *hasht = NULL;
-    if(!(hasht = wg_dhash_init(db, set->res_count))) {
-      free_resultset(db, unique);
-      return NULL;
-    }
+static int compare_offsets(const void *a, const void *b) {
+  gint oa = *((const gint *) a), ob = *((const gint *) b);
+  return (oa < ob ? -1 : (oa > ob ? 1 : 0));
+}
 
-    while((offset = fetch_resultset(db, set))) {
-      if(!wg_dhash_haskey(db, hasht, offset)) {
-        gint err = append_resultset(db, unique, offset);
-        if(!err) {
-          err = wg_dhash_addkey(db, hasht, offset);
-        }
-        if(err) {
-          free_resultset(db, unique);
-          wg_dhash_free(db, hasht);
-          return NULL;
-        }
-      }
+/*
+ * Copy the result set into the pages of a prefetch query.
+ * returns 0 on success.
+ * returns -1 on error.
+ */
+static gint resultset_to_pages(void *db, query_result_set *set,
+  wg_query *query)
+{
+  query_result_page **prevnext;
+  gint i;
+
+  query->curr_page = NULL;
+  query->curr_pidx = 0;
+  query->res_count = set->res_count;
+  query->mpool = wg_create_mpool(db, sizeof(query_result_page));
+  if(!query->mpool) {
+    return show_query_error(db, "Failed to allocate result memory pool");
+  }
+
+  prevnext = (query_result_page **) &(query->curr_page);
+  for(i=0; i<set->res_count; i+=QUERY_RESULTSET_PAGESIZE) {
+    gint n = set->res_count - i;
+    query_result_page *currpage = (query_result_page *) \
+      wg_alloc_mpool(db, query->mpool, sizeof(query_result_page));
+    if(!currpage) {
+      return show_query_error(db, "Failed to allocate a resultset page");
     }
-    wg_dhash_free(db, hasht);
-  }
-  else { /* nested loop */
-    while((offset = fetch_resultset(db, set))) {
-      gint offsetu, found = 0;
-      rewind_resultset(db, unique);
-      while((offsetu = fetch_resultset(db, unique))) {
-        if(offset == offsetu) {
-          found = 1;
-          break;
-        }
-      }
-      if(!found) {
-        /* We're now at the end of the set and may append normally. */
-        gint err = append_resultset(db, unique, offset);
-        if(err) {
-          free_resultset(db, unique);
-          return NULL;
-        }
-      }
+    if(n >= QUERY_RESULTSET_PAGESIZE) {
+      n = QUERY_RESULTSET_PAGESIZE;
+    } else {
+      memset(currpage->rows + n, 0,
+        sizeof(gint) * (QUERY_RESULTSET_PAGESIZE - n));
     }
+    memcpy(currpage->rows, set->rows + i, sizeof(gint) * n);
+    currpage->next = NULL;
+    *prevnext = currpage;
+    prevnext = &(currpage->next);
   }
-  return unique;
+  return 0;
 }
 
 /* ------------------- (JSON) document query -------------------*/
@@ -1618,25 +1944,254 @@ static query_result_set *unique_resultset(void *db, query_result_set *set)
   if(al) \
     free(al);
 
-#define ADD_DOC_ARRAY_UNWRAP(db, rec, ns, rc, k, v) \
-  void *arec = wg_decode_record(db, k); \
-  if(is_schema_array(arec)) { \
-    gint areclen = wg_get_record_len(db, arec); \
-    int j; \
-    for(j=0; j<areclen; j++) { \
-      if(WG_COMPARE(db, wg_get_field(db, arec, j), v) == WG_EQUAL) { \
-        ADD_DOC_TO_RESULTSET(db, rec, ns, rc) \
-        break; \
-      } \
-    } \
+/* Condition of a query clause, 0 means equality */
+#define JSON_ARG_COND(a) ((a)->cond ? (a)->cond : WG_COND_EQUAL)
+
+/* Conditions that can be served by a range scan */
+#define IS_ORDERING_COND(c) ((c) == WG_COND_LESSTHAN ||\
+  (c) == WG_COND_GREATER || (c) == WG_COND_LTEQUAL || (c) == WG_COND_GTEQUAL)
+
+/*
+ * Check if a value in a document satisfies a query clause. If the
+ * value is an array, each member of the array is checked as well
+ * (this behaviour emulates the JSON hash index, but can be disabled
+ * by #undef-ing JSON_SCAN_UNWRAP_ARRAY). An inequality holds if
+ * neither the value nor any member of the array equals the clause
+ * value.
+ *
+ * returns 1 if the value matches, 0 otherwise
+ */
+static int json_value_matches(void *db, gint enc, wg_json_query_arg *arg)
+{
+  gint cond = JSON_ARG_COND(arg);
+
+  if(cond == WG_COND_NOT_EQUAL)
+    return !json_value_holds(db, enc, arg->value, WG_COND_EQUAL);
+  return json_value_holds(db, enc, arg->value, cond);
+}
+
+/*
+ * Check the condition on a value and, if the value is an array,
+ * on each member of the array.
+ *
+ * returns 1 if the condition holds for any of them, 0 otherwise
+ */
+static int json_value_holds(void *db, gint enc, gint value, gint cond)
+{
+  if(json_cond_holds(db, enc, value, cond))
+    return 1;
+#ifdef JSON_SCAN_UNWRAP_ARRAY
+  if(wg_get_encoded_type(db, enc) == WG_RECORDTYPE) {
+    void *arec = wg_decode_record(db, enc);
+    if(is_schema_array(arec)) {
+      gint areclen = wg_get_record_len(db, arec);
+      int j;
+      for(j=0; j<areclen; j++) {
+        if(json_cond_holds(db, wg_get_field(db, arec, j), value, cond))
+          return 1;
+      }
+    }
   }
+#endif
+  return 0;
+}
+
+/*
+ * Check if a value in a document has a pair at the given path that
+ * matches the query clause. The path is followed by descending into
+ * the objects, arrays on the way are searched member by member.
+ *
+ * returns 1 if there is a matching pair, 0 otherwise
+ */
+static int json_path_matches(void *db, gint enc, char *path,
+  wg_json_query_arg *arg, int depth)
+{
+  void *rec;
+  gint i, reclen;
+
+  if(depth <= 0 || wg_get_encoded_type(db, enc) != WG_RECORDTYPE)
+    return 0;
+  rec = wg_decode_record(db, enc);
+  reclen = wg_get_record_len(db, rec);
+
+  if(is_schema_array(rec)) {
+    for(i=0; i<reclen; i++) {
+      if(json_path_matches(db, wg_get_field(db, rec, i), path, arg, depth-1))
+        return 1;
+    }
+  }
+  else if(is_schema_object(rec)) {
+    char *rest = strchr(path, '.');
+    size_t seglen = (rest ? (size_t) (rest - path) : strlen(path));
+    for(i=0; i<reclen; i++) {
+      gint field = wg_get_field(db, rec, i), key;
+      void *pair;
+      char *keystr;
+      if(wg_get_encoded_type(db, field) != WG_RECORDTYPE)
+        continue;
+      pair = wg_decode_record(db, field);
+      if(wg_get_record_len(db, pair) <= WG_SCHEMA_VALUE_OFFSET)
+        continue;
+      key = wg_get_field(db, pair, WG_SCHEMA_KEY_OFFSET);
+      if(wg_get_encoded_type(db, key) != WG_STRTYPE)
+        continue;
+      keystr = wg_decode_str(db, key);
+      if(strlen(keystr) == seglen && !strncmp(keystr, path, seglen)) {
+        gint value = wg_get_field(db, pair, WG_SCHEMA_VALUE_OFFSET);
+        if(!rest) {
+          if(json_value_matches(db, value, arg))
+            return 1;
+        } else if(json_path_matches(db, value, rest + 1, arg, depth-1)) {
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+/*
+ * Check a single value against the condition of a query clause.
+ * Values of the same type are compared as in the rest of the query
+ * engine. Integers and doubles are compared by their numeric value,
+ * so 3 equals 3.0. Other values of different types are never equal
+ * and the ordering conditions do not hold for them.
+ *
+ * returns 1 if the condition holds, 0 otherwise
+ */
+static int json_cond_holds(void *db, gint enc, gint value, gint cond)
+{
+  gint cmp, typea, typeb;
+
+  typea = wg_get_encoded_type(db, enc);
+  typeb = wg_get_encoded_type(db, value);
+  if(typea == typeb) {
+    cmp = WG_COMPARE(db, enc, value);
+  } else if((typea == WG_INTTYPE || typea == WG_DOUBLETYPE) &&\
+    (typeb == WG_INTTYPE || typeb == WG_DOUBLETYPE)) {
+    double a = (typea == WG_INTTYPE ?
+      (double) wg_decode_int(db, enc) : wg_decode_double(db, enc));
+    double b = (typeb == WG_INTTYPE ?
+      (double) wg_decode_int(db, value) : wg_decode_double(db, value));
+    cmp = (a < b ? WG_LESSTHAN : (a > b ? WG_GREATER : WG_EQUAL));
+  } else {
+    return (cond == WG_COND_NOT_EQUAL);
+  }
+  return check_cond(cond, cmp);
+}
+
+/*
+ * Numbers are stored in the hash indexes with their own type. Find
+ * the value of the other numeric type that equals a clause value,
+ * so that both can be looked up.
+ *
+ * returns 1 if *other is set, the caller frees it with
+ *   wg_free_query_param()
+ * returns 0 if there is no such value
+ * returns -1 on error
+ */
+static gint json_other_number(void *db, gint value, gint *other)
+{
+  gint type = wg_get_encoded_type(db, value);
+
+  if(type == WG_INTTYPE) {
+    *other = wg_encode_query_param_double(db,
+      (double) wg_decode_int(db, value));
+  }
+  else if(type == WG_DOUBLETYPE) {
+    double d = wg_decode_double(db, value);
+    gint i = (gint) d;
+    if((double) i != d)
+      return 0;
+    *other = wg_encode_query_param_int(db, i);
+  }
+  else {
+    return 0;
+  }
+  return (*other == WG_ILLEGAL ? -1 : 1);
+}
+
+/*
+ * Add the documents that have a pair equal to the clause to the
+ * result set, using a hash index. For path clauses the index gives
+ * the candidate documents that are then checked by the path.
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static gint scan_json_hash(void *db, gint index_id,
+  wg_json_query_arg *arg, query_result_set *next_set)
+{
+  gint values[2], other = 0, rc;
+  int j, nvalues;
+
+  nvalues = 1 + json_other_number(db, arg->value, &other);
+  if(!nvalues)
+    return -1;
+
+  values[0] = arg->key;
+  for(j=0, rc=0; j<nvalues && rc>=0; j++) {
+    gint reclist_offset, *nextoffset;
+
+    values[1] = (j ? other : arg->value);
+    reclist_offset = wg_search_hash(db, index_id, values, 2);
+    if(reclist_offset <= 0)
+      continue;
+
+    nextoffset = &reclist_offset;
+    while(*nextoffset && rc>=0) {
+      gcell *rec_cell = (gcell *) offsettoptr(db, *nextoffset);
+      if(arg->path) {
+        rc = check_and_merge_by_path(db,
+          offsettoptr(db, rec_cell->car), arg, next_set);
+      } else {
+        ADD_DOC_TO_RESULTSET(db, offsettoptr(db, rec_cell->car),
+          next_set, rc)
+      }
+      nextoffset = &(rec_cell->cdr);
+    }
+  }
+  if(nvalues > 1)
+    wg_free_query_param(db, other);
+  return (rc < 0 ? -1 : 0);
+}
+
+/*
+ * Check if a document matches a query clause with a path.
+ *
+ * returns 1 if the document matches and is added to the resultset
+ * returns 0 if the document does not match
+ * returns -1 if the document matches, but adding fails
+ */
+static gint check_and_merge_by_path(void *db, void *doc,
+  wg_json_query_arg *arg, query_result_set *next_set)
+{
+  char buf[256], *path, *keystr;
+  size_t len;
+  gint rc = 0;
+
+  /* A short path is decoded into the rotating buffer of tiny strings
+   * that is overwritten when the keys of the document are decoded, so
+   * it is copied first. */
+  keystr = wg_decode_str(db, arg->key);
+  len = strlen(keystr) + 1;
+  path = (len <= sizeof(buf) ? buf : malloc(len));
+  if(!path)
+    return show_query_error(db, "Failed to allocate memory");
+  memcpy(path, keystr, len);
+
+  if(json_path_matches(db, wg_encode_record(db, doc), path, arg,
+    WG_JSON_PATH_DEPTH)) {
+    rc = (append_resultset(db, next_set, ptrtooffset(db, doc)) ? -1 : 1);
+  }
+  if(path != buf)
+    free(path);
+  return rc;
+}
 
 /*
  * Check if a record matches a key-value pair given in a query
- * clause. If the value is an array in the record, each member
- * of the array is compared to the value in the clause.
- * (this behaviour emulates the JSON hash index, but can be disabled
- * by #undef-ing JSON_SCAN_UNWRAP_ARRAY).
+ * clause. The value is checked with json_value_matches().
  *
  * returns 1 if the record matches and is added to the resultset
  * returns 0 if the record does not match
@@ -1649,30 +2204,13 @@ static gint check_and_merge_by_kv(void *db, void *rec,
   gint reclen = wg_get_record_len(db, rec);
   if(reclen > WG_SCHEMA_VALUE_OFFSET) { /* XXX: assume key
                                          * before value */
-#ifndef JSON_SCAN_UNWRAP_ARRAY
     if(WG_COMPARE(db, wg_get_field(db, rec, WG_SCHEMA_KEY_OFFSET),
       arg->key) == WG_EQUAL &&\
-      WG_COMPARE(db, wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET),
-      arg->value) == WG_EQUAL)
+      json_value_matches(db,
+        wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET), arg))
     {
       ADD_DOC_TO_RESULTSET(db, rec, next_set, rc)
     }
-#else
-    if(WG_COMPARE(db, wg_get_field(db, rec, WG_SCHEMA_KEY_OFFSET),
-      arg->key) == WG_EQUAL) {
-      gint k = wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET);
-
-      if(WG_COMPARE(db, k, arg->value) == WG_EQUAL) {
-        /* Direct match. */
-        ADD_DOC_TO_RESULTSET(db, rec, next_set, rc)
-      } else if(wg_get_encoded_type(db, k) == WG_RECORDTYPE) {
-        /* No direct match, but if it is a record AND an array,
-         * scan the array contents.
-         */
-        ADD_DOC_ARRAY_UNWRAP(db, rec, next_set, rc, k, arg->value)
-      }
-    }
-#endif
   }
   return rc;
 }
@@ -1687,21 +2225,11 @@ static gint check_and_merge_by_key(void *db, void *rec,
   gint rc = 0;
   gint reclen = wg_get_record_len(db, rec);
   if(reclen > WG_SCHEMA_VALUE_OFFSET) {
-#ifndef JSON_SCAN_UNWRAP_ARRAY
-    if(WG_COMPARE(db, wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET),
-      arg->value) == WG_EQUAL)
+    if(json_value_matches(db,
+      wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET), arg))
     {
       ADD_DOC_TO_RESULTSET(db, rec, next_set, rc)
     }
-#else
-    gint k = wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET);
-
-    if(WG_COMPARE(db, k, arg->value) == WG_EQUAL) {
-      ADD_DOC_TO_RESULTSET(db, rec, next_set, rc)
-    } else if(wg_get_encoded_type(db, k) == WG_RECORDTYPE) {
-      ADD_DOC_ARRAY_UNWRAP(db, rec, next_set, rc, k, arg->value)
-    }
-#endif
   }
   return rc;
 }
@@ -1754,9 +2282,9 @@ static gint check_and_merge_recursively(void *db, void *rec,
  */
 static gint prepare_json_arglist(void *db, wg_json_query_arg *arglist,
   wg_json_query_arg **sorted_arglist, gint argc,
-  gint *index_id, gint *vindex_id, gint *kindex_id)
+  gint *index_id, gint *vindex_id, gint *kindex_id, gint *pindex_id)
 {
-  gint icols[2], need_ttree = 0;
+  gint icols[2], need_ttree = 0, need_range = 0, need_path = 0, i;
   wg_json_query_arg *tmp = NULL;
 
   /* Get index */
@@ -1764,64 +2292,241 @@ static gint prepare_json_arglist(void *db, wg_json_query_arg *arglist,
   icols[1] = WG_SCHEMA_VALUE_OFFSET;
   *index_id = wg_multi_column_to_index_id(db, icols, 2,
     WG_INDEX_TYPE_HASH_JSON, NULL, 0);
-  *vindex_id = *kindex_id = -1;
+  *vindex_id = *kindex_id = *pindex_id = -1;
+
+  /* Literal values compared for equality can be found in the hash
+   * index. Ranges need a T-tree on the values, everything else is
+   * scanned (we might need T-tree to speed up scanning). Paths
+   * are looked up in the path index or checked on the documents. */
+  for(i=0; i<argc; i++) {
+    int rank = json_arg_rank(db, &arglist[i]);
+    if(arglist[i].path) {
+      if(!rank)
+        need_path = 1;
+      continue;
+    }
+    if(rank == 1)
+      need_range = 1;
+    if(rank > 0)
+      need_ttree = 1;
+  }
+  if(need_path) {
+    *pindex_id = wg_multi_column_to_index_id(db, icols, 2,
+      WG_INDEX_TYPE_HASH_JSON_PATH, NULL, 0);
+  }
 
   if(argc > 1) {
     /* There is something to sort. In the future we can also sort by
      * cardinality here (provided that stats are available). */
-    gint i, j;
+    gint j, rank;
     tmp = malloc(sizeof(wg_json_query_arg) * argc);
     if(!tmp) {
       return show_query_error(db, "Failed to prepare query arguments");
     }
 
-    /* First pass: literal values only */
-    for(i=0, j=0; i<argc; i++) {
-      if(wg_get_encoded_type(db, arglist[i].value) != WG_RECORDTYPE) {
-        tmp[j].key = arglist[i].key;
-        tmp[j++].value = arglist[i].value;
-      }
-    }
-
-    /* Was there something left? In that case, we might need T-tree
-     * to speed up scanning for the remainder of clauses. We also use
-     * T-tree if hash is not available at all.
-     */
-    if(j<i) {
-      need_ttree = 1;
-    }
-
-    /* Second pass: complex structures only */
-    for(i=0; i<argc; i++) {
-      if(wg_get_encoded_type(db, arglist[i].value) == WG_RECORDTYPE) {
-        tmp[j].key = arglist[i].key;
-        tmp[j++].value = arglist[i].value;
+    /* Literal values first, then ranges, complex structures and
+     * other conditions last. */
+    for(rank=0, j=0; rank<3; rank++) {
+      for(i=0; i<argc; i++) {
+        if(json_arg_rank(db, &arglist[i]) == rank)
+          tmp[j++] = arglist[i];
       }
     }
-  } else {
-    /* Complex structures are not present in the hash index */
-    if(wg_get_encoded_type(db, arglist[0].value) == WG_RECORDTYPE) {
-      need_ttree = 1;
-    }
   }
 
-  /* Get T-tree index if needed. Value index is preferred, but
-   * it must be of the type that supports array unwrap. Otherwise
-   * we'll settle for a key index.
+  /* Get T-tree indexes if needed. The value index is used for
+   * ranges, otherwise we'll settle for a key index.
    */
-  if(*index_id == -1 || need_ttree) {
+  if(need_range) {
     *vindex_id = wg_multi_column_to_index_id(db, &icols[1], 1,
       WG_INDEX_TYPE_TTREE_JSON, NULL, 0);
-    if(*vindex_id == -1) {
-      *kindex_id = wg_multi_column_to_index_id(db, &icols[0], 1,
-        WG_INDEX_TYPE_TTREE, NULL, 0);
-    }
+  }
+  if(*index_id == -1 || need_ttree) {
+    *kindex_id = wg_multi_column_to_index_id(db, &icols[0], 1,
+      WG_INDEX_TYPE_TTREE, NULL, 0);
   }
 
   *sorted_arglist = tmp;
   return 0;
 }
 
+/*
+ * Order of query clauses in the sorted argument list:
+ * 0 - literal values compared for equality (hash index)
+ * 1 - ordering conditions (range scan of the value index)
+ * 2 - complex structures and inequality (scanned)
+ */
+static int json_arg_rank(void *db, wg_json_query_arg *arg)
+{
+  gint cond = JSON_ARG_COND(arg);
+  if(cond == WG_COND_EQUAL &&\
+    wg_get_encoded_type(db, arg->value) != WG_RECORDTYPE)
+    return 0;
+  else if(arg->path)
+    return 2; /* no ranges on paths */
+  else if(IS_ORDERING_COND(cond) &&\
+    wg_get_encoded_type(db, arg->value) != WG_RECORDTYPE)
+    return 1;
+  return 2;
+}
+
+/*
+ * Find a T-tree value index for the given key. An index with a
+ * template that only holds the pairs with this key is the most
+ * compact one. Otherwise the value index on all pairs is used.
+ * returns the index id, -1 if there is no value index
+ */
+static gint json_value_index(void *db, gint key, gint vindex_id)
+{
+#ifdef USE_INDEX_TEMPLATE
+  gint matchrec[WG_SCHEMA_KEY_OFFSET + 1], i, index_id;
+
+  for(i=0; i<WG_SCHEMA_KEY_OFFSET; i++)
+    matchrec[i] = wg_encode_var(db, 0);
+  matchrec[WG_SCHEMA_KEY_OFFSET] = key;
+  index_id = wg_column_to_index_id(db, WG_SCHEMA_VALUE_OFFSET,
+    WG_INDEX_TYPE_TTREE_JSON, matchrec, WG_SCHEMA_KEY_OFFSET + 1);
+  if(index_id > 0)
+    return index_id;
+#endif
+  return vindex_id;
+}
+
+/*
+ * Add the documents matching an ordering condition to the result
+ * set, using a range scan of a T-tree value index. Values of each
+ * type are stored contiguously in the index, so a range is scanned
+ * for the type of the clause value and (for numbers) the other
+ * numeric type. Arrays are stored as record values and their members
+ * are checked separately.
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static gint scan_json_range(void *db, gint index_id,
+  wg_json_query_arg *arg, query_result_set *next_set)
+{
+  gint cond = JSON_ARG_COND(arg), type, bound;
+  int dir = ((cond == WG_COND_GREATER || cond == WG_COND_GTEQUAL) ? 1 : -1);
+
+  type = wg_get_encoded_type(db, arg->value);
+  if(scan_json_value_index(db, index_id, arg, arg->value, dir, type,
+    next_set))
+    return -1;
+
+  if(type == WG_INTTYPE) {
+    bound = wg_encode_query_param_double(db,
+      (double) wg_decode_int(db, arg->value));
+    if(bound == WG_ILLEGAL)
+      return -1;
+    if(scan_json_value_index(db, index_id, arg, bound, dir, WG_DOUBLETYPE,
+      next_set)) {
+      wg_free_query_param(db, bound);
+      return -1;
+    }
+    wg_free_query_param(db, bound);
+  }
+  else if(type == WG_DOUBLETYPE) {
+    /* The integer bound is rounded outwards, values outside the
+     * range are filtered by the condition check. */
+    double d = wg_decode_double(db, arg->value);
+    gint i = (gint) d;
+    if(dir > 0 && i > d)
+      i--;
+    else if(dir < 0 && i < d)
+      i++;
+    bound = wg_encode_query_param_int(db, i);
+    if(bound == WG_ILLEGAL)
+      return -1;
+    if(scan_json_value_index(db, index_id, arg, bound, dir, WG_INTTYPE,
+      next_set)) {
+      wg_free_query_param(db, bound);
+      return -1;
+    }
+    wg_free_query_param(db, bound);
+  }
+
+#ifdef JSON_SCAN_UNWRAP_ARRAY
+  if(scan_json_value_index(db, index_id, arg, WG_ILLEGAL, 1, WG_RECORDTYPE,
+    next_set))
+    return -1;
+#endif
+  return 0;
+}
+
+/*
+ * Scan a T-tree value index, starting from the bound and checking
+ * the key-value pairs that have a value of the given type. The scan
+ * stops at the first value of a type that is beyond the given one
+ * in the scan direction.
+ * bound - encoded value, WG_ILLEGAL to start from the smallest value
+ * dir - 1 to scan towards greater values, -1 towards smaller ones
+ *
+ * returns 0 on success
+ * returns -1 on error
+ */
+static gint scan_json_value_index(void *db, gint index_id,
+  wg_json_query_arg *arg, gint bound, int dir, gint type,
+  query_result_set *next_set)
+{
+  gint curr_offset = 0, curr_slot = -1, end_offset = 0, end_slot = -1;
+  gint offset, slot, rc;
+
+  if(dir > 0)
+    rc = find_ttree_bounds(db, index_id, WG_SCHEMA_VALUE_OFFSET,
+      bound, WG_ILLEGAL, 1, 0,
+      &curr_offset, &curr_slot, &end_offset, &end_slot);
+  else
+    rc = find_ttree_bounds(db, index_id, WG_SCHEMA_VALUE_OFFSET,
+      WG_ILLEGAL, bound, 0, 1,
+      &curr_offset, &curr_slot, &end_offset, &end_slot);
+  if(rc)
+    return -1;
+
+  if(dir > 0) {
+    offset = curr_offset;
+    slot = curr_slot;
+  } else {
+    offset = end_offset;
+    slot = end_slot;
+  }
+
+  while(offset) {
+    struct wg_tnode *node = (struct wg_tnode *) offsettoptr(db, offset);
+    void *rec = offsettoptr(db, node->array_of_values[slot]);
+    gint vtype = wg_get_encoded_type(db,
+      wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET));
+
+    if(vtype == type) {
+      rc = check_and_merge_by_kv(db, rec, arg, next_set);
+      if(rc < 0)
+        return -1;
+    } else if((vtype - type) * dir > 0) {
+      break; /* past the values of this type */
+    }
+
+    if(dir > 0) {
+      if(offset == end_offset && slot == end_slot)
+        break;
+      if(++slot >= node->number_of_elements) {
+        offset = TNODE_SUCCESSOR(db, node);
+        slot = 0;
+      }
+    } else {
+      if(offset == curr_offset && slot == curr_slot)
+        break;
+      if(--slot < 0) {
+        offset = TNODE_PREDECESSOR(db, node);
+        if(offset) {
+          node = (struct wg_tnode *) offsettoptr(db, offset);
+          slot = node->number_of_elements - 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
 /*
  * Find a list of documents that contain the key-value pairs.
  * Returns a prefetch query object.
@@ -1831,7 +2536,7 @@ wg_query *wg_make_json_query(void *db, wg_json_query_arg *arglist, gint argc) {
   wg_query *query = NULL;
   query_result_set *curr_res = NULL;
   wg_json_query_arg *sorted_arglist = NULL;
-  gint index_id = -1, vindex_id = -1, kindex_id = -1;
+  gint index_id = -1, vindex_id = -1, kindex_id = -1, pindex_id = -1;
   gint i;
 
 #ifdef CHECK
@@ -1848,11 +2553,25 @@ wg_query *wg_make_json_query(void *db, wg_json_query_arg *arglist, gint argc) {
   }
 #endif
 
+  for(i=0; i<argc; i++) {
+    gint cond = JSON_ARG_COND(&arglist[i]);
+    if(cond != WG_COND_EQUAL && cond != WG_COND_NOT_EQUAL &&\
+      !IS_ORDERING_COND(cond)) {
+      show_query_error(db, "Invalid condition in query");
+      return NULL;
+    }
+    if(arglist[i].path &&\
+      wg_get_encoded_type(db, arglist[i].key) != WG_STRTYPE) {
+      show_query_error(db, "Path in query is not a string");
+      return NULL;
+    }
+  }
+
   /* Sort the argument list. This also checks for usable indexes, so
    * we're calling it even if we have just one argument.
    */
   prepare_json_arglist(db, arglist, &sorted_arglist, argc,
-    &index_id, &vindex_id, &kindex_id);
+    &index_id, &vindex_id, &kindex_id, &pindex_id);
   /* HACK: this way, the following code does not need to care
    * whether we sorted the argument list or not.
    */
@@ -1865,7 +2584,7 @@ wg_query *wg_make_json_query(void *db, wg_json_query_arg *arglist, gint argc) {
    * doing the intersect operation of sets retrieved from index.
    */
   for(i=0; i<argc; i++) {
-    query_result_set *next_set, *tmp_set;
+    query_result_set *next_set;
 
     /* Initialize the set produced by this iteration */
     next_set = create_resultset(db);
@@ -1875,35 +2594,52 @@ wg_query *wg_make_json_query(void *db, wg_json_query_arg *arglist, gint argc) {
       return NULL;
     }
 
-    if(index_id > 0 &&\
-      wg_get_encoded_type(db, arglist[i].value) != WG_RECORDTYPE) {
-      /* Fetch the matching rows from the index, then retrieve the
-       * documents they belong to.
+    if(arglist[i].path) {
+      /* The documents are found from the path index or checked by
+       * following the path from the root of each document.
        */
-      gint values[2];
-      gint reclist_offset;
-
-      values[0] = arglist[i].key;
-      values[1] = arglist[i].value;
-      reclist_offset = wg_search_hash(db, index_id, values, 2);
-
-      if(reclist_offset > 0) {
-        gint *nextoffset = &reclist_offset;
-        while(*nextoffset) {
-          gcell *rec_cell = (gcell *) offsettoptr(db, *nextoffset);
-          gint rc = -1;
-          ADD_DOC_TO_RESULTSET(db, offsettoptr(db, rec_cell->car),
-            next_set, rc)
+      if(pindex_id > 0 && json_arg_rank(db, &arglist[i]) == 0) {
+        gint rc = scan_json_hash(db, pindex_id, &arglist[i], next_set);
+        IF_ERR_CLEAN_UP(db, curr_res, next_set, sorted_arglist, rc)
+      }
+      else if(curr_res) {
+        gint offset;
+        rewind_resultset(db, curr_res);
+        while((offset = fetch_resultset(db, curr_res))) {
+          gint rc = check_and_merge_by_path(db, offsettoptr(db, offset),
+            &arglist[i], next_set);
           IF_ERR_CLEAN_UP(db, curr_res, next_set, sorted_arglist, rc)
-          nextoffset = &(rec_cell->cdr);
+        }
+        /* next_set is a subset of curr_res */
+        free_resultset(db, curr_res);
+        curr_res = NULL;
+      }
+      else {
+        gint *rec = wg_get_first_record(db);
+        while(rec) {
+          if(is_schema_document(rec)) {
+            gint rc = check_and_merge_by_path(db, rec, &arglist[i], next_set);
+            IF_ERR_CLEAN_UP(db, curr_res, next_set, sorted_arglist, rc)
+          }
+          rec = wg_get_next_record(db, rec);
         }
       }
     }
-#if 0
-    else if(vindex_id > 0) {
-      /* XXX: unimplemented: scan T-tree for values */
+    else if(index_id > 0 && json_arg_rank(db, &arglist[i]) == 0) {
+      /* Fetch the matching rows from the index, then retrieve the
+       * documents they belong to.
+       */
+      gint rc = scan_json_hash(db, index_id, &arglist[i], next_set);
+      IF_ERR_CLEAN_UP(db, curr_res, next_set, sorted_arglist, rc)
+    }
+    else if(json_arg_rank(db, &arglist[i]) == 1 &&\
+      json_value_index(db, arglist[i].key, vindex_id) > 0) {
+      /* Range scan over the values, checking the keys */
+      gint rc = scan_json_range(db,
+        json_value_index(db, arglist[i].key, vindex_id),
+        &arglist[i], next_set);
+      IF_ERR_CLEAN_UP(db, curr_res, next_set, sorted_arglist, rc)
     }
-#endif
     else if(kindex_id > 0) {
       /* Hash index not usable, do a scan but leverage an index on the
        * key field to reduce the number of records visited.
@@ -1978,29 +2714,12 @@ wg_query *wg_make_json_query(void *db, wg_json_query_arg *arglist, gint argc) {
     }
 
     /* Delete duplicate documents */
-    tmp_set = unique_resultset(db, next_set);
-    free_resultset(db, next_set);
-    if(!tmp_set) {
-      if(curr_res)
-        free_resultset(db, curr_res);
-      ARGLIST_CLEANUP(sorted_arglist)
-      return NULL;
-    } else {
-      next_set = tmp_set;
-    }
+    unique_resultset(db, next_set);
 
     /* Update the query result */
     if(curr_res) {
       /* Working resultset exists, create an intersection */
-      tmp_set = intersect_resultset(db, curr_res, next_set);
-      free_resultset(db, curr_res);
-      free_resultset(db, next_set);
-      if(!tmp_set) {
-        ARGLIST_CLEANUP(sorted_arglist)
-        return NULL;
-      } else {
-        curr_res = tmp_set;
-      }
+      curr_res = intersect_resultset(db, curr_res, next_set);
     } else {
       /* This set becomes the working resultset */
       curr_res = next_set;
@@ -2015,17 +2734,23 @@ wg_query *wg_make_json_query(void *db, wg_json_query_arg *arglist, gint argc) {
     show_query_error(db, "Failed to allocate memory");
     return NULL;
   }
+  WG_STAT_INC(db, WG_STAT_QUERY_JSON);
   query->qtype = WG_QTYPE_PREFETCH;
   query->arglist = NULL;
+  query->argmodes = NULL;
+  query->argpos = NULL;
   query->argc = 0;
   query->column = -1;
+  query->table = 0;
+  query->examined = 0;
 
   /* Copy the result. */
-  query->curr_page = curr_res->first_page;
-  query->curr_pidx = 0;
-  query->res_count = curr_res->res_count;
-  query->mpool = curr_res->mpool;
-  free(curr_res); /* contents were inherited, dispose of the struct */
+  if(resultset_to_pages(db, curr_res, query)) {
+    free_resultset(db, curr_res);
+    wg_free_query(db, query);
+    return NULL;
+  }
+  free_resultset(db, curr_res);
 
   return query;
 }
@@ -2129,7 +2854,7 @@ void *wg_find_record(void *db, gint fieldnr, gint cond, gint data,
     arg.value = data;
 
     while(rec) {
-      if(check_arglist(db, rec, &arg, 1)) {
+      if(check_arglist(db, rec, &arg, NULL, 1)) {
         return rec;
       }
       rec = wg_get_next_record(db, rec);
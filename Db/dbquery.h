@@ -48,6 +48,7 @@
 #define WG_QTYPE_TTREE      0x01
 #define WG_QTYPE_HASH       0x02
 #define WG_QTYPE_SCAN       0x04
+#define WG_QTYPE_COLUMNS    0x08
 #define WG_QTYPE_PREFETCH   0x80
 
 /* ====== data structures ======== */
@@ -62,6 +63,8 @@ typedef struct {
 typedef struct {
   gint key;         /** encoded key */
   gint value;       /** encoded value */
+  gint cond;        /** condition, 0 is the same as WG_COND_EQUAL */
+  gint path;        /** non-0 if key is a path from the root, "a.b.c" */
 } wg_json_query_arg;
 
 /** Query object */
@@ -70,7 +73,10 @@ typedef struct {
   /* Argument list based query is the only one supported at the moment. */
   wg_query_arg *arglist;    /** check each row in result set against these */
   gint argc;                /** number of elements in arglist */
+  gint *argmodes;           /** comparison mode of each element in arglist */
+  gint *argpos;             /** projection column of each element, if used */
   gint column;              /** index on this column used */
+  gint table;               /** only return records of this table, if non-0 */
   /* Fields for T-tree query (XXX: some may be re-usable for
    * other types as well) */
   gint curr_offset;
@@ -85,8 +91,25 @@ typedef struct {
   void *curr_page;          /** current page of results */
   gint curr_pidx;           /** current index on page */
   wg_uint res_count;          /** number of rows in results */
+  gint examined;            /** rows checked against the argument list */
 } wg_query;
 
+/** Query plan and execution profile, see wg_explain_query() */
+typedef struct {
+  gint qtype;           /** WG_QTYPE_TTREE, WG_QTYPE_SCAN or WG_QTYPE_COLUMNS */
+  gint column;          /** indexed column, -1 for full scan */
+  gint index_id;        /** index used, 0 for full scan */
+  gint start_bound;     /** encoded start of the index range, WG_ILLEGAL if open */
+  gint start_inclusive;
+  gint end_bound;       /** encoded end of the index range, WG_ILLEGAL if open */
+  gint end_inclusive;
+  gint argc;            /** conditions checked for each row examined */
+  gint estimated;       /** estimated number of rows examined */
+  gint examined;        /** rows checked against the conditions */
+  gint returned;        /** rows in the result set */
+  double elapsed;       /** time spent executing the query, in seconds */
+} wg_query_explain;
+
 /* ==== Protos ==== */
 
 wg_query *wg_make_query(void *db, void *matchrec, gint reclen,
@@ -94,6 +117,10 @@ wg_query *wg_make_query(void *db, void *matchrec, gint reclen,
 #define wg_make_prefetch_query wg_make_query
 wg_query *wg_make_query_rc(void *db, void *matchrec, gint reclen,
   wg_query_arg *arglist, gint argc, wg_uint rowlimit);
+wg_query *wg_make_table_query(void *db, gint table, void *matchrec,
+  gint reclen, wg_query_arg *arglist, gint argc);
+gint wg_explain_query(void *db, void *matchrec, gint reclen,
+  wg_query_arg *arglist, gint argc, wg_query_explain *explain);
 wg_query *wg_make_json_query(void *db, wg_json_query_arg *arglist, gint argc);
 void *wg_fetch(void *db, wg_query *query);
 void wg_free_query(void *db, wg_query *query);
@@ -0,0 +1,219 @@
+/*
+* $Id:  $
+* $Version: $
+*
+* Copyright (c) agent 2026
+*
+* This file is part of WhiteDB
+*
+* WhiteDB is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* WhiteDB is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with WhiteDB.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+ /** @file dbstats.c
+ * Runtime statistics counters.
+ */
+
+/* ====== Includes =============== */
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+/* ====== Private headers and defs ======== */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef _WIN32
+#include "../config-w32.h"
+#else
+#include "../config.h"
+#endif
+
+#include "dballoc.h"
+#include "dbstats.h"
+
+#ifdef USE_DBSTATS
+
+/* How often the current CPU is re-checked (in counter updates).
+ * Querying it on every update would cost more than the update itself.
+ */
+#define STRIPE_RECHECK 256
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#ifdef HAVE_SCHED_GETCPU
+/* declared here, as sched.h only provides it with _GNU_SOURCE */
+extern int sched_getcpu(void);
+#endif
+
+#endif /* USE_DBSTATS */
+
+/* ======== Data ========================= */
+
+static char *stat_names[WG_STAT_COUNT] = {
+  "read_locks",
+  "write_locks",
+  "read_lock_waits",
+  "write_lock_waits",
+  "lock_timeouts",
+  "alloc_fixlen",
+  "alloc_exact",
+  "alloc_split",
+  "alloc_dv",
+  "alloc_extend",
+  "free_fixlen",
+  "free_varlen",
+  "ttree_inserts",
+  "ttree_deletes",
+  "ttree_searches",
+  "hash_inserts",
+  "hash_deletes",
+  "hash_searches",
+  "query_scan",
+  "query_ttree",
+  "query_json",
+  "query_examined",
+  "query_returned",
+  "journal_writes",
+  "journal_bytes",
+  "journal_errors",
+  "records_created",
+  "records_deleted"
+};
+
+#ifdef USE_DBSTATS
+static THREAD_LOCAL int stripe_cache = -1;
+static THREAD_LOCAL int stripe_uses = 0;
+#endif
+
+/* ======= Private protos ================ */
+
+#ifdef USE_DBSTATS
+static int current_stripe(void);
+#endif
+
+/* ====== Functions ============== */
+
+#ifdef USE_DBSTATS
+
+/** Find the stripe for the current CPU.
+ *  If the CPU number is not available, the process/thread is
+ *  used instead, which still separates concurrent writers well.
+ */
+static int current_stripe(void) {
+  int cpu = -1;
+#if defined(HAVE_SCHED_GETCPU)
+  cpu = sched_getcpu();
+#elif defined(_WIN32)
+  cpu = (int) GetCurrentProcessorNumber();
+#endif
+  if(cpu < 0) {
+#ifdef _WIN32
+    cpu = (int) GetCurrentThreadId();
+#else
+    cpu = (int) getpid() + (int) (((size_t) &stripe_cache) >> 12);
+#endif
+  }
+  return (cpu & 0x7fffffff) % WG_STATS_STRIPES;
+}
+
+/** Return the counter stripe to update.
+ *  Used by the WG_STAT_ADD() macro.
+ */
+int wg_stats_stripe(void) {
+  if(stripe_cache < 0 || ++stripe_uses >= STRIPE_RECHECK) {
+    stripe_cache = current_stripe();
+    stripe_uses = 0;
+  }
+  return stripe_cache;
+}
+
+/** Clear the statistics area. Called during database initialization.
+ */
+void wg_init_stats(void *db) {
+  memset(&(dbmemsegh(db)->stats), 0, sizeof(db_stats_area));
+}
+
+#endif /* USE_DBSTATS */
+
+/** Read the statistics counters.
+ *  Sums the stripes of up to count counters into the counters array.
+ *  The counters argument may be NULL to only query the number
+ *  of counters available.
+ *
+ *  returns the number of counters available (WG_STAT_COUNT)
+ *  returns -1 if statistics are not enabled.
+ */
+gint wg_get_stats(void *db, gint *counters, gint count) {
+#ifdef USE_DBSTATS
+  db_stats_area *stats = &(dbmemsegh(db)->stats);
+  gint i;
+  int j;
+
+  if(counters) {
+    if(count > WG_STAT_COUNT)
+      count = WG_STAT_COUNT;
+    for(i=0; i<count; i++) {
+      gint sum = 0;
+      for(j=0; j<WG_STATS_STRIPES; j++)
+        sum += stats->stripe[j][i];
+      counters[i] = sum;
+    }
+  }
+  return WG_STAT_COUNT;
+#else
+  return -1;
+#endif
+}
+
+/** Return the name of a statistics counter.
+ *  returns NULL if the counter does not exist.
+ */
+char *wg_get_stat_name(gint id) {
+  if(id < 0 || id >= WG_STAT_COUNT)
+    return NULL;
+  return stat_names[id];
+}
+
+/** Reset all statistics counters to zero.
+ *  Updates that happen concurrently may be lost.
+ *
+ *  returns 0 on success
+ *  returns -1 if statistics are not enabled.
+ */
+gint wg_reset_stats(void *db) {
+#ifdef USE_DBSTATS
+  wg_init_stats(db);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
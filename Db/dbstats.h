@@ -0,0 +1,99 @@
+/*
+* $Id:  $
+* $Version: $
+*
+* Copyright (c) agent 2026
+*
+* This file is part of WhiteDB
+*
+* WhiteDB is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* WhiteDB is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with WhiteDB.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+ /** @file dbstats.h
+ * Public headers for the runtime statistics.
+ */
+
+#ifndef DEFINED_DBSTATS_H
+#define DEFINED_DBSTATS_H
+
+#ifdef _WIN32
+#include "../config-w32.h"
+#else
+#include "../config.h"
+#endif
+
+#include "dballoc.h"
+
+/* ==== Public macros ==== */
+
+/* Counter identifiers. The names are listed in dbstats.c and
+ * the total must not exceed WG_STATS_CAPACITY.
+ */
+#define WG_STAT_READ_LOCKS 0       /** shared locks acquired */
+#define WG_STAT_WRITE_LOCKS 1      /** exclusive locks acquired */
+#define WG_STAT_READ_LOCK_WAITS 2  /** shared lock requests that had to wait */
+#define WG_STAT_WRITE_LOCK_WAITS 3 /** exclusive lock requests that had to wait */
+#define WG_STAT_LOCK_TIMEOUTS 4    /** lock requests that timed out */
+#define WG_STAT_ALLOC_FIXLEN 5     /** fixed length objects allocated */
+#define WG_STAT_ALLOC_EXACT 6      /** varlen allocs from exact size bucket */
+#define WG_STAT_ALLOC_SPLIT 7      /** varlen allocs split from larger object */
+#define WG_STAT_ALLOC_DV 8         /** varlen allocs from designated victim */
+#define WG_STAT_ALLOC_EXTEND 9     /** new subareas allocated */
+#define WG_STAT_FREE_FIXLEN 10     /** fixed length objects freed */
+#define WG_STAT_FREE_VARLEN 11     /** varlen objects freed */
+#define WG_STAT_TTREE_INSERTS 12
+#define WG_STAT_TTREE_DELETES 13
+#define WG_STAT_TTREE_SEARCHES 14
+#define WG_STAT_HASH_INSERTS 15
+#define WG_STAT_HASH_DELETES 16
+#define WG_STAT_HASH_SEARCHES 17
+#define WG_STAT_QUERY_SCAN 18      /** queries using full scan */
+#define WG_STAT_QUERY_TTREE 19     /** queries using a T-tree index */
+#define WG_STAT_QUERY_JSON 20      /** JSON queries */
+#define WG_STAT_QUERY_EXAMINED 21  /** rows checked against query arguments */
+#define WG_STAT_QUERY_RETURNED 22  /** rows matching the query arguments */
+#define WG_STAT_JOURNAL_WRITES 23
+#define WG_STAT_JOURNAL_BYTES 24
+#define WG_STAT_JOURNAL_ERRORS 25
+#define WG_STAT_RECORDS_CREATED 26
+#define WG_STAT_RECORDS_DELETED 27
+
+#define WG_STAT_COUNT 28
+
+/* Counter updates are plain (non-atomic) additions into the stripe
+ * of the current CPU. Updates may occasionally be lost if threads
+ * are migrated between CPUs, so the values should be considered
+ * approximate.
+ */
+#ifdef USE_DBSTATS
+#define WG_STAT_ADD(d, c, n) \
+  (dbmemsegh(d)->stats.stripe[wg_stats_stripe()][c] += (n))
+#else
+#define WG_STAT_ADD(d, c, n)
+#endif
+#define WG_STAT_INC(d, c) WG_STAT_ADD(d, c, 1)
+
+/* ==== Protos ==== */
+
+#ifdef USE_DBSTATS
+int wg_stats_stripe(void);
+void wg_init_stats(void *db);
+#endif
+
+gint wg_get_stats(void *db, gint *counters, gint count);
+char *wg_get_stat_name(gint id);
+gint wg_reset_stats(void *db);
+
+#endif /* DEFINED_DBSTATS_H */
@@ -0,0 +1,688 @@
+/*
+* $Id:  $
+* $Version: $
+*
+* Copyright (c) agent 2026
+*
+* This file is part of WhiteDB
+*
+* WhiteDB is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* WhiteDB is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with WhiteDB.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+ /** @file dbtable.c
+ * Record tables.
+ */
+
+/* ====== Includes =============== */
+
+#include <stdio.h>
+#include <string.h>
+
+/* ====== Private headers and defs ======== */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef _WIN32
+#include "../config-w32.h"
+#else
+#include "../config.h"
+#endif
+
+#include "dballoc.h"
+#include "dbdata.h"
+#include "dbindex.h"
+#include "dblog.h"
+#include "dbtable.h"
+
+/* Check that the table id is valid and the table exists */
+#define TABLE_IN_USE(dbh, t) ((t) > 0 && (t) < WG_MAX_TABLES &&\
+                            (dbh)->tables.records[t] >= 0)
+
+/* The table bitmaps are handled in words of this many bits */
+#define TABLE_WORDBITS (sizeof(wg_uint)*8)
+
+/* Initial number of slots in a column projection */
+#define PROJECTION_MIN_SLOTS 64
+
+/* Largest slot number that fits in the record meta bits */
+#define PROJECTION_MAX_SLOTS \
+  ((gint) (((wg_uint) -1 >> RECORD_META_SLOT_SHFT) - 1))
+
+#define projection_ptr(db, t) \
+  ((db_table_projection *) offsettoptr(db, dbmemsegh(db)->tables.columns[t]))
+
+/* ======= Private protos ================ */
+
+static gint activate_table(void *db, gint table);
+static void table_setbit(void *db, gint bitmap, gint offset);
+static void table_clearbit(void *db, gint bitmap, gint offset);
+static gint projection_add_record(void *db, gint table, void *rec);
+static gint resize_projection(void *db, gint table, gint capacity);
+static void free_projection(void *db, gint table);
+
+static gint show_table_error(void* db, char* errmsg);
+static gint show_table_error_nr(void* db, char* errmsg, gint nr);
+
+/* ====== Functions ============== */
+
+/*
+ * Tables:
+ * - the table id of a record is kept in the meta bits of the record
+ *   header, above the flag bits. Table 0 means no table.
+ * - each table has a bitmap with one bit for each possible record
+ *   offset, in the same format as the record pointer bitmap. Scanning
+ *   a table only reads the bitmap words and the records of the table.
+ * - the bitmaps take 1/64 of the segment size each and are allocated
+ *   from the free space at the end of the segment. They cannot be
+ *   released, a dropped table leaves its bitmap to the next table.
+ * - creating and dropping a table is not journaled. Journal replay
+ *   recreates the tables that the records refer to.
+ *
+ * Column projections:
+ * - a table may keep copies of some of its columns in arrays that
+ *   are indexed by a row slot. Reading a column reads the array
+ *   sequentially instead of one cache line per record.
+ * - the slot of a record is kept in the meta bits above the table id.
+ *   Slots are handed out in the order the records are added. When
+ *   the arrays are full, they are reallocated, dropping the slots of
+ *   deleted records and doubling the size if needed.
+ * - the records remain the source of truth. The projection is updated
+ *   when the fields are written and is not journaled.
+ */
+
+/** Create a new table.
+ *  returns the table id (> 0)
+ *  returns -1 if all table ids are in use
+ *  returns -2 if there is no space for the record bitmap
+ */
+gint wg_create_table(void *db) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  gint table;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_create_table");
+    return -1;
+  }
+#endif
+
+  for(table=1; table<WG_MAX_TABLES; table++) {
+    if(dbh->tables.records[table] < 0)
+      return activate_table(db, table);
+  }
+  show_table_error_nr(db, "Max allowed tables", WG_MAX_TABLES-1);
+  return -1;
+}
+
+/** Drop an empty table.
+ *  The table id may be reused by wg_create_table() later, so
+ *  indexes created on the table need to be dropped first.
+ *  returns 0 on success
+ *  returns -1 if the table does not exist
+ *  returns -2 if the table has records or indexes
+ */
+gint wg_drop_table(void *db, gint table) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  gint *ilist;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_drop_table");
+    return -1;
+  }
+#endif
+  if(!TABLE_IN_USE(dbh, table)) {
+    show_table_error_nr(db, "Invalid table", table);
+    return -1;
+  }
+  if(dbh->tables.records[table]) {
+    show_table_error(db, "Cannot drop a table that has records");
+    return -2;
+  }
+
+  ilist = &dbh->index_control_area_header.index_list;
+  while(*ilist) {
+    gcell *ilistelem = (gcell *) offsettoptr(db, *ilist);
+    wg_index_header *hdr = \
+      (wg_index_header *) offsettoptr(db, ilistelem->car);
+    if(hdr->table == table) {
+      show_table_error(db, "Cannot drop a table that has indexes");
+      return -2;
+    }
+    ilist = &ilistelem->cdr;
+  }
+
+  if(dbh->tables.columns[table])
+    free_projection(db, table);
+  dbh->tables.records[table] = -1;
+  return 0;
+}
+
+/** Create a record in a table.
+ *  Like wg_create_record(), the NULL fields are indexed.
+ *  returns NULL when error, ptr to rec otherwise
+ */
+void *wg_create_table_record(void *db, gint table, gint length) {
+  void *rec;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_create_table_record");
+    return NULL;
+  }
+#endif
+  if(!TABLE_IN_USE(dbmemsegh(db), table)) {
+    show_table_error_nr(db, "Invalid table", table);
+    return NULL;
+  }
+
+  rec = wg_create_raw_record(db, length);
+  if(rec) {
+    /* The table id is needed to match the indexes of the table,
+     * so it is set before the fields are indexed. */
+    if(wg_table_add_record(db, rec, table))
+      return NULL;
+    if(wg_index_add_rec(db, rec) < -1)
+      return NULL; /* index error */
+  }
+  return rec;
+}
+
+/** Return the table of a record.
+ *  returns the table id, 0 if the record does not belong to a table.
+ */
+gint wg_get_record_table(void *db, void *rec) {
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_get_record_table");
+    return -1;
+  }
+#endif
+  return record_table(rec);
+}
+
+/** Return the number of records in a table.
+ *  returns -1 if the table does not exist.
+ */
+gint wg_get_table_record_count(void *db, gint table) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_get_table_record_count");
+    return -1;
+  }
+#endif
+  if(!TABLE_IN_USE(dbh, table))
+    return -1;
+  return dbh->tables.records[table];
+}
+
+/** Get the first record of a table.
+ *  The records are returned in the order of their location in
+ *  the database, like wg_get_first_record() does.
+ *  returns NULL when error or no recs
+ */
+void *wg_get_first_table_record(void *db, gint table) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  gint offset;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_get_first_table_record");
+    return NULL;
+  }
+#endif
+  if(!TABLE_IN_USE(dbh, table)) {
+    show_table_error_nr(db, "Invalid table", table);
+    return NULL;
+  }
+
+  offset = dbh->datarec_area_header.subarea_array[0].alignedoffset;
+  offset = wg_next_bitmap_offset(db, dbh->tables.bitmap[table], offset);
+  return (offset ? offsettoptr(db, offset) : NULL);
+}
+
+/** Get the next record of a table.
+ *  returns NULL when error or no more recs
+ */
+void *wg_get_next_table_record(void *db, gint table, void *rec) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  gint offset;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_get_next_table_record");
+    return NULL;
+  }
+#endif
+  if(!TABLE_IN_USE(dbh, table)) {
+    show_table_error_nr(db, "Invalid table", table);
+    return NULL;
+  }
+
+  /* Records are aligned at 8 bytes, so the next one can start
+   * at offset+8 at the earliest. The header of the current record
+   * is not read, allowing it to be deleted during the scan. */
+  offset = ptrtooffset(db, rec) + 8;
+  offset = wg_next_bitmap_offset(db, dbh->tables.bitmap[table], offset);
+  return (offset ? offsettoptr(db, offset) : NULL);
+}
+
+/** Create a column projection for a table.
+ *  The columns array lists the field numbers to keep in the projection.
+ *  The records already in the table are added to it.
+ *  returns 0 on success
+ *  returns -1 on invalid arguments or if the table already has a projection
+ *  returns -2 if there is no space for the projection
+ */
+gint wg_create_table_columns(void *db, gint table, gint *columns, gint count) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  db_table_projection *proj;
+  gint offset, capacity, i;
+  void *rec;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_create_table_columns");
+    return -1;
+  }
+#endif
+  if(!TABLE_IN_USE(dbh, table)) {
+    show_table_error_nr(db, "Invalid table", table);
+    return -1;
+  }
+  if(dbh->tables.columns[table]) {
+    show_table_error(db, "Table already has a column projection");
+    return -1;
+  }
+  if(count < 1 || count > WG_MAX_TABLE_COLUMNS) {
+    show_table_error_nr(db, "Invalid number of columns", count);
+    return -1;
+  }
+  for(i=0; i<count; i++) {
+    if(columns[i] < 0) {
+      show_table_error_nr(db, "Invalid column", columns[i]);
+      return -1;
+    }
+  }
+
+  offset = wg_alloc_gints(db, &(dbh->indexhash_area_header),
+    sizeof(db_table_projection) / sizeof(gint));
+  if(!offset) {
+    show_table_error(db, "No space for the column projection");
+    return -2;
+  }
+  proj = (db_table_projection *) offsettoptr(db, offset);
+  memset(proj, 0, sizeof(db_table_projection));
+  proj->count = count;
+  for(i=0; i<count; i++)
+    proj->column[i] = columns[i];
+  dbh->tables.columns[table] = offset;
+
+  capacity = dbh->tables.records[table] * 2;
+  if(capacity < PROJECTION_MIN_SLOTS)
+    capacity = PROJECTION_MIN_SLOTS;
+  if(resize_projection(db, table, capacity)) {
+    free_projection(db, table);
+    return -2;
+  }
+
+  rec = wg_get_first_table_record(db, table);
+  while(rec) {
+    if(projection_add_record(db, table, rec)) {
+      free_projection(db, table);
+      return -2;
+    }
+    rec = wg_get_next_table_record(db, table, rec);
+  }
+  return 0;
+}
+
+/** Drop the column projection of a table.
+ *  returns 0 on success
+ *  returns -1 if the table has no projection
+ */
+gint wg_drop_table_columns(void *db, gint table) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_drop_table_columns");
+    return -1;
+  }
+#endif
+  if(!TABLE_IN_USE(dbh, table) || !dbh->tables.columns[table]) {
+    show_table_error_nr(db, "No column projection for table", table);
+    return -1;
+  }
+  free_projection(db, table);
+  return 0;
+}
+
+/** Get a column of the projection of a table.
+ *  Returns a pointer to the encoded values of the column, one
+ *  per slot, and stores the number of slots in *count. Slots of
+ *  deleted records contain WG_ILLEGAL, as do the slots of records
+ *  that are too short to have the column. The array may move when
+ *  records are added to the table.
+ *  returns NULL if the column is not in the projection
+ */
+gint *wg_get_table_column(void *db, gint table, gint column, gint *count) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  db_table_projection *proj;
+  gint pos;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_get_table_column");
+    return NULL;
+  }
+#endif
+  if(!TABLE_IN_USE(dbh, table) || !dbh->tables.columns[table])
+    return NULL;
+  pos = wg_table_column_pos(db, table, column);
+  if(pos < 0)
+    return NULL;
+  proj = projection_ptr(db, table);
+  *count = proj->used;
+  return PROJECTION_VALUES(db, proj, pos);
+}
+
+/** Get the record in a slot of the projection of a table.
+ *  returns NULL if the slot is not in use
+ */
+void *wg_get_table_column_record(void *db, gint table, gint slot) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  db_table_projection *proj;
+  gint offset;
+
+#ifdef CHECK
+  if (!dbcheck(db)) {
+    show_table_error(db, "Invalid database pointer in wg_get_table_column_record");
+    return NULL;
+  }
+#endif
+  if(!TABLE_IN_USE(dbh, table) || !dbh->tables.columns[table])
+    return NULL;
+  proj = projection_ptr(db, table);
+  if(slot < 0 || slot >= proj->used)
+    return NULL;
+  offset = PROJECTION_ROWS(db, proj)[slot];
+  return (offset ? offsettoptr(db, offset) : NULL);
+}
+
+/* ------------ internal functions ---------------- */
+
+/** Add a record to a table.
+ *  The record may not belong to a table already. The caller is
+ *  responsible for updating the indexes scoped to the table.
+ *  returns 0 on success
+ *  returns -1 on error
+ */
+gint wg_table_add_record(void *db, void *rec, gint table) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  gint *metap = (gint *) rec + RECORD_META_POS;
+  gint meta;
+
+  if(!TABLE_IN_USE(dbh, table)) {
+    show_table_error_nr(db, "Invalid table", table);
+    return -1;
+  }
+  if(record_table(rec)) {
+    show_table_error(db, "Record already belongs to a table");
+    return -1;
+  }
+
+  meta = *metap | (table << RECORD_META_TABLE_SHFT);
+#ifdef USE_DBLOG
+  if(dbh->logging.active) {
+    if(wg_log_set_meta(db, rec, meta))
+      return -1;
+  }
+#endif
+  *metap = meta;
+  if(dbh->tables.columns[table] &&\
+    projection_add_record(db, table, rec)) {
+    *metap = meta & ~(RECORD_META_TABLE_MASK << RECORD_META_TABLE_SHFT);
+    return -1;
+  }
+  table_setbit(db, dbh->tables.bitmap[table], ptrtooffset(db, rec));
+  dbh->tables.records[table]++;
+  return 0;
+}
+
+/** Remove a deleted record from its table.
+ *  Called from wg_delete_record().
+ */
+void wg_table_remove_record(void *db, void *rec) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  gint table = record_table(rec);
+
+  if(TABLE_IN_USE(dbh, table)) {
+    gint slot = record_column_slot(rec);
+    if(slot) {
+      db_table_projection *proj = projection_ptr(db, table);
+      gint i;
+      PROJECTION_ROWS(db, proj)[slot-1] = 0;
+      for(i=0; i<proj->count; i++)
+        PROJECTION_VALUES(db, proj, i)[slot-1] = WG_ILLEGAL;
+    }
+    table_clearbit(db, dbh->tables.bitmap[table], ptrtooffset(db, rec));
+    dbh->tables.records[table]--;
+  }
+}
+
+/** Find the position of a column in the projection of a table.
+ *  returns the position, -1 if the column is not projected
+ */
+gint wg_table_column_pos(void *db, gint table, gint column) {
+  db_table_projection *proj;
+  gint i;
+
+  if(!dbmemsegh(db)->tables.columns[table])
+    return -1;
+  proj = projection_ptr(db, table);
+  for(i=0; i<proj->count; i++) {
+    if(proj->column[i] == column)
+      return i;
+  }
+  return -1;
+}
+
+/** Update the projection after a field of a record has been written.
+ *  Called from the field setting functions for records that have
+ *  a projection slot.
+ */
+void wg_table_set_column(void *db, void *rec, gint column, gint enc) {
+  gint table = record_table(rec);
+  gint pos = wg_table_column_pos(db, table, column);
+
+  if(pos >= 0) {
+    db_table_projection *proj = projection_ptr(db, table);
+    PROJECTION_VALUES(db, proj, pos)[record_column_slot(rec)-1] = enc;
+  }
+}
+
+/** Make sure a table exists, creating it with the given id if needed.
+ *  Used when replaying the journal.
+ *  returns 0 on success
+ *  returns -1 on error
+ */
+gint wg_recreate_table(void *db, gint table) {
+  if(table <= 0 || table >= WG_MAX_TABLES) {
+    show_table_error_nr(db, "Invalid table", table);
+    return -1;
+  }
+  if(dbmemsegh(db)->tables.records[table] >= 0)
+    return 0;
+  return (activate_table(db, table) < 0 ? -1 : 0);
+}
+
+/** Mark a table id as in use, allocating the bitmap if needed.
+ *  returns the table id on success
+ *  returns -2 if there is no space for the bitmap
+ */
+static gint activate_table(void *db, gint table) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+
+  if(!dbh->tables.bitmap[table]) {
+    dbh->tables.bitmap[table] = wg_alloc_offset_bitmap(db);
+    if(!dbh->tables.bitmap[table]) {
+      show_table_error(db, "No space for the table record bitmap");
+      return -2;
+    }
+  }
+  dbh->tables.records[table] = 0;
+  return table;
+}
+
+/** Give a record of the table the next slot in the projection.
+ *  returns 0 on success
+ *  returns -1 if the projection could not be extended
+ */
+static gint projection_add_record(void *db, gint table, void *rec) {
+  db_table_projection *proj = projection_ptr(db, table);
+  gint *metap = (gint *) rec + RECORD_META_POS;
+  gint reclen, slot, i;
+
+  if(proj->used >= proj->capacity) {
+    /* Compact if at least half of the slots belong to deleted
+     * records, otherwise double the size. */
+    gint live = dbmemsegh(db)->tables.records[table];
+    gint capacity = proj->capacity;
+    if(live*2 > capacity)
+      capacity *= 2;
+    if(capacity > PROJECTION_MAX_SLOTS + 1)
+      capacity = PROJECTION_MAX_SLOTS + 1;
+    if(live >= capacity || resize_projection(db, table, capacity)) {
+      show_table_error(db, "Failed to extend the column projection");
+      return -1;
+    }
+    proj = projection_ptr(db, table);
+  }
+
+  slot = proj->used++;
+  PROJECTION_ROWS(db, proj)[slot] = ptrtooffset(db, rec);
+  reclen = wg_get_record_len(db, rec);
+  for(i=0; i<proj->count; i++) {
+    PROJECTION_VALUES(db, proj, i)[slot] = (proj->column[i] < reclen ?\
+      wg_get_field(db, rec, proj->column[i]) : WG_ILLEGAL);
+  }
+  *metap = (*metap & ~RECORD_META_SLOTMASK) |\
+    (gint) ((wg_uint) (slot+1) << RECORD_META_SLOT_SHFT);
+  return 0;
+}
+
+/** Move the projection to a new data block of the given size.
+ *  The slots of deleted records are dropped and the slots of the
+ *  remaining records renumbered, keeping their order.
+ *  returns 0 on success
+ *  returns -1 if there is no space for the new block
+ */
+static gint resize_projection(void *db, gint table, gint capacity) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  db_table_projection *proj = projection_ptr(db, table);
+  gint data, *rows, *newrows;
+  gint slot, used = 0, i;
+
+  data = wg_alloc_gints(db, &(dbh->indexhash_area_header),
+    capacity * (proj->count + 1));
+  if(!data)
+    return -1;
+  newrows = (gint *) offsettoptr(db, data);
+
+  if(proj->data) {
+    rows = PROJECTION_ROWS(db, proj);
+    for(slot=0; slot<proj->used; slot++) {
+      if(rows[slot]) {
+        gint *metap = (gint *) offsettoptr(db, rows[slot]) + RECORD_META_POS;
+        newrows[used] = rows[slot];
+        for(i=0; i<proj->count; i++) {
+          newrows[(i+1)*capacity + used] = \
+            PROJECTION_VALUES(db, proj, i)[slot];
+        }
+        used++;
+        *metap = (*metap & ~RECORD_META_SLOTMASK) |\
+          (gint) ((wg_uint) used << RECORD_META_SLOT_SHFT);
+      }
+    }
+    wg_free_object(db, &(dbh->indexhash_area_header), proj->data);
+  }
+  proj->data = data;
+  proj->capacity = capacity;
+  proj->used = used;
+  return 0;
+}
+
+/** Release the projection of a table and clear the record slots.
+ */
+static void free_projection(void *db, gint table) {
+  db_memsegment_header* dbh = dbmemsegh(db);
+  db_table_projection *proj = projection_ptr(db, table);
+  gint slot;
+
+  if(proj->data) {
+    gint *rows = PROJECTION_ROWS(db, proj);
+    for(slot=0; slot<proj->used; slot++) {
+      if(rows[slot]) {
+        gint *metap = (gint *) offsettoptr(db, rows[slot]) + RECORD_META_POS;
+        *metap &= ~RECORD_META_SLOTMASK;
+      }
+    }
+    wg_free_object(db, &(dbh->indexhash_area_header), proj->data);
+  }
+  wg_free_object(db, &(dbh->indexhash_area_header),
+    dbh->tables.columns[table]);
+  dbh->tables.columns[table] = 0;
+}
+
+static void table_setbit(void *db, gint bitmap, gint offset) {
+  wg_uint *words = (wg_uint *) offsettoptr(db, bitmap);
+  wg_uint bit = ((wg_uint) offset)/8;
+
+  words[bit/TABLE_WORDBITS] |= ((wg_uint) 1 << (bit%TABLE_WORDBITS));
+}
+
+static void table_clearbit(void *db, gint bitmap, gint offset) {
+  wg_uint *words = (wg_uint *) offsettoptr(db, bitmap);
+  wg_uint bit = ((wg_uint) offset)/8;
+
+  words[bit/TABLE_WORDBITS] &= ~((wg_uint) 1 << (bit%TABLE_WORDBITS));
+}
+
+/* ------------ error handling ---------------- */
+
+static gint show_table_error(void* db, char* errmsg) {
+#ifdef WG_NO_ERRPRINT
+#else
+  fprintf(stderr,"wg table error: %s.\n", errmsg);
+#endif
+  return -1;
+}
+
+static gint show_table_error_nr(void* db, char* errmsg, gint nr) {
+#ifdef WG_NO_ERRPRINT
+#else
+  fprintf(stderr,"wg table error: %s %d.\n", errmsg, (int) nr);
+#endif
+  return -1;
+}
+
+#ifdef __cplusplus
+}
+#endif
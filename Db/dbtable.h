@@ -0,0 +1,70 @@
+/*
+* $Id:  $
+* $Version: $
+*
+* Copyright (c) agent 2026
+*
+* This file is part of WhiteDB
+*
+* WhiteDB is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* WhiteDB is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with WhiteDB.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+ /** @file dbtable.h
+ * Public headers for record tables.
+ */
+
+#ifndef DEFINED_DBTABLE_H
+#define DEFINED_DBTABLE_H
+
+#ifdef _WIN32
+#include "../config-w32.h"
+#else
+#include "../config.h"
+#endif
+
+#include "dballoc.h"
+
+/* ==== Public macros ==== */
+
+/* Arrays in the data block of a column projection */
+#define PROJECTION_ROWS(db, p) ((gint *) offsettoptr(db, (p)->data))
+#define PROJECTION_VALUES(db, p, i) \
+  (PROJECTION_ROWS(db, p) + ((i)+1)*(p)->capacity)
+
+/* ==== Protos ==== */
+
+/* API functions (copied in dbapi.h) */
+
+gint wg_create_table(void *db);
+gint wg_drop_table(void *db, gint table);
+void *wg_create_table_record(void *db, gint table, gint length);
+gint wg_get_record_table(void *db, void *rec);
+gint wg_get_table_record_count(void *db, gint table);
+void *wg_get_first_table_record(void *db, gint table);
+void *wg_get_next_table_record(void *db, gint table, void *rec);
+gint wg_create_table_columns(void *db, gint table, gint *columns, gint count);
+gint wg_drop_table_columns(void *db, gint table);
+gint *wg_get_table_column(void *db, gint table, gint column, gint *count);
+void *wg_get_table_column_record(void *db, gint table, gint slot);
+
+/* WhiteDB internal functions */
+
+gint wg_table_add_record(void *db, void *rec, gint table);
+void wg_table_remove_record(void *db, void *rec);
+gint wg_recreate_table(void *db, gint table);
+gint wg_table_column_pos(void *db, gint table, gint column);
+void wg_table_set_column(void *db, void *rec, gint column, gint enc);
+
+#endif /* DEFINED_DBTABLE_H */
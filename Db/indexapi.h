@@ -37,6 +37,11 @@
 #define WG_INDEX_TYPE_TTREE_JSON    51
 #define WG_INDEX_TYPE_HASH          60
 #define WG_INDEX_TYPE_HASH_JSON     61
+#define WG_INDEX_TYPE_HASH_JSON_PATH 62
+
+#define WG_INDEX_KEY_VALUE          0
+#define WG_INDEX_KEY_LOWER          1
+#define WG_INDEX_KEY_DAY            2
 
 /* Public protos */
 
@@ -52,5 +57,16 @@ wg_int wg_multi_column_to_index_id(void *db, wg_int *columns,
 wg_int wg_get_index_type(void *db, wg_int index_id);
 void * wg_get_index_template(void *db, wg_int index_id, wg_int *reclen);
 void * wg_get_all_indexes(void *db, wg_int *count);
+wg_int wg_create_table_index(void *db, wg_int table, wg_int column,
+  wg_int type, wg_int *matchrec, wg_int reclen);
+wg_int wg_table_column_to_index_id(void *db, wg_int table, wg_int column,
+  wg_int type, wg_int *matchrec, wg_int reclen);
+wg_int wg_get_index_table(void *db, wg_int index_id);
+wg_int wg_create_partial_index(void *db, wg_int *columns, wg_int col_count,
+  wg_int type, wg_int key, wg_int *matchrec, wg_int *conds, wg_int reclen);
+wg_int wg_partial_column_to_index_id(void *db, wg_int *columns,
+  wg_int col_count, wg_int type, wg_int key, wg_int *matchrec,
+  wg_int *conds, wg_int reclen);
+wg_int wg_get_index_key(void *db, wg_int index_id);
 
 #endif /* DEFINED_INDEXAPI_H */
@@ -142,7 +142,8 @@ int main(int argc, char **argv) {
       hdr = get_index_by_id(db, index_id);
       if(hdr) {
         if(hdr->type != WG_INDEX_TYPE_HASH && \
-          hdr->type != WG_INDEX_TYPE_HASH_JSON) {
+          hdr->type != WG_INDEX_TYPE_HASH_JSON && \
+          hdr->type != WG_INDEX_TYPE_HASH_JSON_PATH) {
           fprintf(stderr, "Index type not supported.\n");
           return 0;
         }
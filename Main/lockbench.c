@@ -0,0 +1,659 @@
+/*
+* $Id:  $
+* $Version: $
+*
+* Copyright (c) agent 2026
+*
+* This file is part of WhiteDB
+*
+* WhiteDB is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* WhiteDB is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with WhiteDB.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+ /** @file lockbench.c
+ *  Multi-process lock contention benchmark.
+ *  Forks a number of processes that attach the same shared memory
+ *  database and run read and write transactions against it. Measures
+ *  throughput, latency and fairness of the configured locking protocol
+ *  and of a process-shared pthread_rwlock for reference.
+ */
+
+/* ====== Includes =============== */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include "../config-w32.h"
+#else
+#include "../config.h"
+#endif
+
+#ifndef _WIN32
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../Db/dballoc.h"
+#include "../Db/dbmem.h"
+#include "../Db/dbdata.h"
+#include "../Db/dblock.h"
+
+
+/* ====== Private defs =========== */
+
+#define DEFAULT_SHMNAME "7131"
+#define DEFAULT_DBSIZE 10000000
+#define DEFAULT_RECORDS 1000
+#define DEFAULT_DURATION 2
+#define DEFAULT_WRITE_PCT 20
+#define DEFAULT_CS_LEN 10
+#define REC_SIZE 5
+#define MAX_PROC_COUNTS 16
+
+/* Latency histogram: values below HIST_SUB are exact, above that
+ * each power of two is split into HIST_SUB linear sub-buckets
+ * (about 6% resolution). Up to 2^40 ns is covered.
+ */
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1<<HIST_SUB_BITS)
+#define HIST_MAX_EXP 40
+#define HIST_BUCKETS (HIST_SUB + (HIST_MAX_EXP - HIST_SUB_BITS) * HIST_SUB)
+
+#define LOCK_DB 0     /** locks from dblock.c */
+#define LOCK_RWLOCK 1 /** pthread_rwlock reference */
+
+/** Per-process results, kept in memory shared with the parent */
+typedef struct {
+  gint reads;
+  gint writes;
+  gint failed;
+  volatile int ready;         /** waiting to start */
+  gint rhist[HIST_BUCKETS];   /** read transaction latency */
+  gint whist[HIST_BUCKETS];   /** write transaction latency */
+} proc_stats;
+
+/** Shared control area */
+typedef struct {
+  volatile int start;
+  volatile int stop;
+#ifdef HAVE_PTHREAD
+  pthread_rwlock_t rwlock;
+#endif
+  proc_stats stats[1];        /** actually procs elements */
+} shared_area;
+
+typedef struct {
+  char *shmname;
+  gint dbsize;
+  gint records;
+  int duration;               /** seconds */
+  int write_pct;
+  int cs_len;                 /** fields accessed inside the lock */
+  int think;                  /** fields accessed outside the lock */
+  int split;                  /** dedicated reader and writer processes */
+  int procs[MAX_PROC_COUNTS];
+  int proc_count;
+  int baseline;               /** also run the pthread_rwlock reference */
+  int keep;                   /** keep the database for inspection */
+} bench_params;
+
+typedef struct {
+  char *lock;
+  int procs;
+  double opsps;
+  gint reads, writes, failed;
+  double rp50, rp99, rp999, wp50, wp99, wp999, max;  /** microseconds */
+  double fairness;            /** Jain's index of per-process throughput */
+  double minmax;              /** slowest / fastest process */
+} bench_result;
+
+/* ======= Private protos ================ */
+
+static char *lock_name(int lock);
+static double now_ns(void);
+static int hist_bucket(gint ns);
+static gint hist_value(int bucket);
+static double hist_percentile(gint *hist, gint count, double pct);
+static int prepare_data(void *db, gint records);
+static int run_bench(bench_params *p, void *db, int lock, int procs,
+  bench_result *res);
+static void worker(bench_params *p, void *db, shared_area *sh,
+  int lock, int id, int procs);
+static void print_results(FILE *f, bench_result *res, int count);
+static void write_csv(FILE *f, bench_params *p, bench_result *res,
+  int count);
+static void usage(char *prog);
+
+
+/* ====== Functions ============== */
+
+#ifdef _WIN32
+
+int main(int argc, char **argv) {
+  fprintf(stderr, "%s: not supported on this platform.\n", argv[0]);
+  exit(1);
+}
+
+#else
+
+int main(int argc, char **argv) {
+  bench_params p;
+  bench_result *results;
+  void *db;
+  char *csvfile = NULL;
+  int i, rcount = 0, err = 0;
+
+  memset(&p, 0, sizeof(bench_params));
+  p.shmname = DEFAULT_SHMNAME;
+  p.dbsize = DEFAULT_DBSIZE;
+  p.records = DEFAULT_RECORDS;
+  p.duration = DEFAULT_DURATION;
+  p.write_pct = DEFAULT_WRITE_PCT;
+  p.cs_len = DEFAULT_CS_LEN;
+
+  for(i=1; i<argc; i++) {
+    char opt;
+    if(argv[i][0] != '-' || !argv[i][1] || argv[i][2]) {
+      usage(argv[0]);
+      exit(1);
+    }
+    opt = argv[i][1];
+    if(opt == 'h') {
+      usage(argv[0]);
+      exit(0);
+    } else if(opt == 'b') {
+      p.baseline = 1;
+      continue;
+    } else if(opt == 'S') {
+      p.split = 1;
+      continue;
+    } else if(opt == 'K') {
+      p.keep = 1;
+      continue;
+    }
+    if(i+1 >= argc) {
+      usage(argv[0]);
+      exit(1);
+    }
+    switch(opt) {
+      case 'k': p.shmname = argv[++i]; break;
+      case 's': p.dbsize = atol(argv[++i]); break;
+      case 'n': p.records = atol(argv[++i]); break;
+      case 'd': p.duration = atoi(argv[++i]); break;
+      case 'W': p.write_pct = atoi(argv[++i]); break;
+      case 'l': p.cs_len = atoi(argv[++i]); break;
+      case 'o': p.think = atoi(argv[++i]); break;
+      case 'c': csvfile = argv[++i]; break;
+      case 'p': {
+          char *s = argv[++i];
+          p.proc_count = 0;
+          while(*s && p.proc_count < MAX_PROC_COUNTS) {
+            p.procs[p.proc_count++] = atoi(s);
+            while(*s && *s != ',') s++;
+            if(*s) s++;
+          }
+        }
+        break;
+      default:
+        usage(argv[0]);
+        exit(1);
+    }
+  }
+
+  if(p.records < 1 || p.duration < 1 || p.write_pct < 0 ||\
+    p.write_pct > 100 || p.cs_len < 0 || p.think < 0) {
+    fprintf(stderr, "Invalid parameters.\n");
+    exit(1);
+  }
+  if(!p.proc_count) {
+    p.procs[0] = 1;
+    p.procs[1] = 2;
+    p.procs[2] = 4;
+    p.procs[3] = 8;
+    p.proc_count = 4;
+  }
+  for(i=0; i<p.proc_count; i++) {
+    if(p.procs[i] < 1) {
+      fprintf(stderr, "Invalid process count.\n");
+      exit(1);
+    }
+  }
+#ifndef HAVE_PTHREAD
+  if(p.baseline) {
+    fprintf(stderr, "No pthread support, baseline disabled.\n");
+    p.baseline = 0;
+  }
+#endif
+
+  db = wg_attach_database(p.shmname, p.dbsize);
+  if(!db) {
+    fprintf(stderr, "Failed to attach to database.\n");
+    exit(1);
+  }
+  if(prepare_data(db, p.records)) {
+    fprintf(stderr, "Failed to create test data.\n");
+    wg_delete_database(p.shmname);
+    exit(2);
+  }
+
+  results = (bench_result *) malloc(sizeof(bench_result) *\
+    p.proc_count * 2);
+  if(!results) {
+    fprintf(stderr, "Failed to allocate memory.\n");
+    wg_delete_database(p.shmname);
+    exit(2);
+  }
+
+  for(i=0; i<p.proc_count; i++) {
+    if(run_bench(&p, db, LOCK_DB, p.procs[i], &results[rcount]))
+      err = 1;
+    else
+      rcount++;
+    if(p.baseline) {
+      if(run_bench(&p, db, LOCK_RWLOCK, p.procs[i], &results[rcount]))
+        err = 1;
+      else
+        rcount++;
+    }
+  }
+
+  print_results(stdout, results, rcount);
+
+  if(csvfile) {
+    /* Append, so that results from builds with different
+     * locking protocols can be collected into one file. */
+    FILE *f = fopen(csvfile, "a");
+    if(f) {
+      write_csv(f, &p, results, rcount);
+      fclose(f);
+    } else {
+      fprintf(stderr, "Failed to open %s\n", csvfile);
+      err = 1;
+    }
+  }
+
+  free(results);
+  if(p.keep)
+    wg_detach_database(db);
+  else
+    wg_delete_database(p.shmname);
+  exit(err);
+}
+
+static void usage(char *prog) {
+  printf("usage: %s [options]\n"\
+    "Options:\n"\
+    "  -k <shmname>  shared memory key (default %s)\n"\
+    "  -s <bytes>    database size (default %d)\n"\
+    "  -n <records>  records in the database (default %d)\n"\
+    "  -p <n,n,..>   process counts (default 1,2,4,8)\n"\
+    "  -d <seconds>  duration of each run (default %d)\n"\
+    "  -W <pct>      percentage of write transactions (default %d)\n"\
+    "  -S            dedicated reader and writer processes, split by -W\n"\
+    "  -l <fields>   fields accessed inside the lock (default %d)\n"\
+    "  -o <fields>   fields accessed between transactions (default 0)\n"\
+    "  -b            also run with pthread_rwlock for reference\n"\
+    "  -c <file>     append results in CSV format\n"\
+    "  -K            keep the database after the run (to inspect the lock\n"\
+    "                timing histograms with 'wgdb <shmname> lockstats')\n",
+    prog, DEFAULT_SHMNAME, DEFAULT_DBSIZE, DEFAULT_RECORDS,
+    DEFAULT_DURATION, DEFAULT_WRITE_PCT, DEFAULT_CS_LEN);
+}
+
+static char *lock_name(int lock) {
+  if(lock == LOCK_RWLOCK)
+    return "rwlock";
+#if (LOCK_PROTO==RPSPIN)
+  return "rpspin";
+#elif (LOCK_PROTO==WPSPIN)
+  return "wpspin";
+#elif (LOCK_PROTO==TFQUEUE)
+  return "tfqueue";
+#else
+  return "none";
+#endif
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1000000000.0 + (double) ts.tv_nsec;
+}
+
+static int hist_bucket(gint ns) {
+  int e = 0;
+  gint v;
+  if(ns < HIST_SUB)
+    return (ns < 0 ? 0 : (int) ns);
+  for(v = ns; v >= 2*HIST_SUB; v >>= 1)
+    e++;
+  if(e >= HIST_MAX_EXP - HIST_SUB_BITS)
+    return HIST_BUCKETS - 1;
+  return HIST_SUB + e * HIST_SUB + (int) (v - HIST_SUB);
+}
+
+/** Lower bound of the values in a bucket
+ */
+static gint hist_value(int bucket) {
+  int e;
+  if(bucket < HIST_SUB)
+    return bucket;
+  e = (bucket - HIST_SUB) / HIST_SUB;
+  return ((gint) (HIST_SUB + (bucket - HIST_SUB) % HIST_SUB)) << e;
+}
+
+/** Percentile (in microseconds) from a histogram
+ */
+static double hist_percentile(gint *hist, gint count, double pct) {
+  gint rank = (gint) (pct / 100.0 * count + 0.5), sum = 0;
+  int i;
+  if(!count)
+    return 0;
+  if(rank < 1) rank = 1;
+  for(i=0; i<HIST_BUCKETS; i++) {
+    sum += hist[i];
+    if(sum >= rank)
+      break;
+  }
+  if(i == HIST_BUCKETS) i--;
+  return hist_value(i) / 1000.0;
+}
+
+static int prepare_data(void *db, gint records) {
+  gint i, j;
+  for(i=0; i<records; i++) {
+    void *rec = wg_create_raw_record(db, REC_SIZE);
+    if(!rec)
+      return -1;
+    for(j=0; j<REC_SIZE; j++) {
+      if(wg_set_new_field(db, rec, j, wg_encode_int(db, i)))
+        return -1;
+    }
+  }
+  return 0;
+}
+
+/** Run one configuration.
+ *  returns 0 on success, -1 on failure.
+ */
+static int run_bench(bench_params *p, void *db, int lock, int procs,
+  bench_result *res) {
+  shared_area *sh;
+  size_t shsize = sizeof(shared_area) + sizeof(proc_stats) * (procs - 1);
+  pid_t *pids;
+  gint *rhist, *whist;
+  double sum = 0, sumsq = 0, minops = -1, maxops = 0, start, elapsed;
+  int i, j, err = 0;
+
+  sh = (shared_area *) mmap(NULL, shsize, PROT_READ|PROT_WRITE,
+    MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+  if(sh == MAP_FAILED) {
+    fprintf(stderr, "Failed to map shared memory.\n");
+    return -1;
+  }
+  memset(sh, 0, shsize);
+  if(lock == LOCK_DB) {
+    /* Register the lock timing tag of this run before forking, so
+     * the workers all find the same one (no-op if not enabled). */
+    char tag[32];
+    snprintf(tag, 32, "lockbench-p%d", procs);
+    wg_lock_tag(db, tag);
+  }
+#ifdef HAVE_PTHREAD
+  if(lock == LOCK_RWLOCK) {
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_rwlock_init(&sh->rwlock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+  }
+#endif
+
+  pids = (pid_t *) malloc(sizeof(pid_t) * procs);
+  if(!pids) {
+    munmap(sh, shsize);
+    return -1;
+  }
+
+  for(i=0; i<procs; i++) {
+    pids[i] = fork();
+    if(pids[i] == 0) {
+      worker(p, db, sh, lock, i, procs);
+      _exit(0);
+    } else if(pids[i] < 0) {
+      fprintf(stderr, "Failed to fork.\n");
+      procs = i;
+      err = -1;
+      break;
+    }
+  }
+
+  /* Start all workers at once, stop after the duration */
+  for(i=0; !err && i<procs; i++) {
+    while(!sh->stats[i].ready)
+      usleep(1000);
+  }
+  start = now_ns();
+  sh->start = 1;
+  if(!err)
+    sleep(p->duration);
+  sh->stop = 1;
+  for(i=0; i<procs; i++) {
+    int status;
+    waitpid(pids[i], &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status))
+      err = -1;
+  }
+  elapsed = (now_ns() - start) / 1000000000.0;
+
+  if(!err) {
+    memset(res, 0, sizeof(bench_result));
+    rhist = sh->stats[0].rhist;
+    whist = sh->stats[0].whist;
+    for(i=0; i<procs; i++) {
+      proc_stats *st = &sh->stats[i];
+      double ops = (double) (st->reads + st->writes);
+      res->reads += st->reads;
+      res->writes += st->writes;
+      res->failed += st->failed;
+      sum += ops;
+      sumsq += ops * ops;
+      if(minops < 0 || ops < minops) minops = ops;
+      if(ops > maxops) maxops = ops;
+      if(i) {
+        for(j=0; j<HIST_BUCKETS; j++) {
+          rhist[j] += st->rhist[j];
+          whist[j] += st->whist[j];
+        }
+      }
+    }
+    res->lock = lock_name(lock);
+    res->procs = procs;
+    res->opsps = sum / elapsed;
+    res->rp50 = hist_percentile(rhist, res->reads, 50.0);
+    res->rp99 = hist_percentile(rhist, res->reads, 99.0);
+    res->rp999 = hist_percentile(rhist, res->reads, 99.9);
+    res->wp50 = hist_percentile(whist, res->writes, 50.0);
+    res->wp99 = hist_percentile(whist, res->writes, 99.0);
+    res->wp999 = hist_percentile(whist, res->writes, 99.9);
+    res->max = hist_percentile(rhist, res->reads, 100.0);
+    if(hist_percentile(whist, res->writes, 100.0) > res->max)
+      res->max = hist_percentile(whist, res->writes, 100.0);
+    res->fairness = (sumsq > 0 ? sum * sum / (procs * sumsq) : 0);
+    res->minmax = (maxops > 0 ? minops / maxops : 0);
+  }
+
+#ifdef HAVE_PTHREAD
+  if(lock == LOCK_RWLOCK)
+    pthread_rwlock_destroy(&sh->rwlock);
+#endif
+  free(pids);
+  munmap(sh, shsize);
+  return err;
+}
+
+/** Worker process.
+ *  Each transaction accesses cs_len fields of random records while
+ *  holding the lock; think fields are read outside the lock.
+ */
+static void worker(bench_params *p, void *db, shared_area *sh,
+  int lock, int id, int procs) {
+  proc_stats *st = &sh->stats[id];
+  unsigned int seed = 12345 + id * 7919;
+  void **recs;
+  gint i, sink = 0;
+  int role = -1; /* -1 mixed, 0 reader, 1 writer */
+
+  recs = (void **) malloc(sizeof(void *) * p->records);
+  if(!recs)
+    _exit(1);
+  recs[0] = wg_get_first_record(db);
+  for(i=1; i<p->records; i++)
+    recs[i] = wg_get_next_record(db, recs[i-1]);
+
+  if(p->split)
+    role = (id < (procs * p->write_pct + 50) / 100 ? 1 : 0);
+
+  if(lock == LOCK_DB) {
+    /* Account lock timing of each run separately */
+    char tag[32];
+    snprintf(tag, 32, "lockbench-p%d", procs);
+    wg_set_lock_tag(db, wg_lock_tag(db, tag));
+  }
+
+  st->ready = 1;
+  while(!sh->start);
+
+  while(!sh->stop) {
+    int write;
+    wg_int lock_id = 1;
+    double t;
+
+    seed = seed * 1103515245 + 12345;
+    if(role >= 0)
+      write = role;
+    else
+      write = ((seed >> 16) % 100 < (unsigned int) p->write_pct);
+
+    t = now_ns();
+    if(lock == LOCK_DB) {
+      lock_id = (write ? wg_start_write(db) : wg_start_read(db));
+    }
+#ifdef HAVE_PTHREAD
+    else if(write) {
+      pthread_rwlock_wrlock(&sh->rwlock);
+    } else {
+      pthread_rwlock_rdlock(&sh->rwlock);
+    }
+#endif
+    if(!lock_id) {
+      st->failed++;
+      continue;
+    }
+
+    for(i=0; i<p->cs_len; i++) {
+      void *rec;
+      seed = seed * 1103515245 + 12345;
+      rec = recs[(seed >> 8) % p->records];
+      if(write)
+        wg_set_field(db, rec, i % REC_SIZE, wg_encode_int(db, id));
+      else
+        sink += wg_decode_int(db, wg_get_field(db, rec, i % REC_SIZE));
+    }
+
+    if(lock == LOCK_DB) {
+      if(write)
+        wg_end_write(db, lock_id);
+      else
+        wg_end_read(db, lock_id);
+    }
+#ifdef HAVE_PTHREAD
+    else {
+      pthread_rwlock_unlock(&sh->rwlock);
+    }
+#endif
+    t = now_ns() - t;
+
+    if(write) {
+      st->writes++;
+      st->whist[hist_bucket((gint) t)]++;
+    } else {
+      st->reads++;
+      st->rhist[hist_bucket((gint) t)]++;
+    }
+
+    for(i=0; i<p->think; i++) {
+      seed = seed * 1103515245 + 12345;
+      sink += wg_decode_int(db,
+        wg_get_field(db, recs[(seed >> 8) % p->records], i % REC_SIZE));
+    }
+  }
+
+  free(recs);
+  if(sink == 1)
+    st->failed += 0; /* keep the reads from being optimized away */
+}
+
+static void print_results(FILE *f, bench_result *res, int count) {
+  int i;
+  fprintf(f, "%-8s %5s %11s %9s %9s %9s %9s %10s %6s %6s\n",
+    "lock", "procs", "ops/s", "r p50 us", "r p99 us", "w p50 us",
+    "w p99 us", "max us", "jain", "minmax");
+  for(i=0; i<count; i++) {
+    fprintf(f, "%-8s %5d %11.0f %9.2f %9.2f %9.2f %9.2f %10.1f %6.3f %6.3f\n",
+      res[i].lock, res[i].procs, res[i].opsps, res[i].rp50, res[i].rp99,
+      res[i].wp50, res[i].wp99, res[i].max, res[i].fairness, res[i].minmax);
+  }
+}
+
+static void write_csv(FILE *f, bench_params *p, bench_result *res,
+  int count) {
+  int i;
+  fseek(f, 0, SEEK_END);
+  if(ftell(f) == 0) {
+    fprintf(f, "lock,procs,write_pct,split,cs_len,think,duration_s,"\
+      "reads,writes,failed,ops_per_s,read_p50_us,read_p99_us,"\
+      "read_p999_us,write_p50_us,write_p99_us,write_p999_us,max_us,"\
+      "fairness,minmax\n");
+  }
+  for(i=0; i<count; i++) {
+    fprintf(f, "%s,%d,%d,%d,%d,%d,%d,%ld,%ld,%ld,%.1f,%.3f,%.3f,%.3f,"\
+      "%.3f,%.3f,%.3f,%.3f,%.4f,%.4f\n",
+      res[i].lock, res[i].procs, p->write_pct, p->split, p->cs_len,
+      p->think, p->duration, (long) res[i].reads, (long) res[i].writes,
+      (long) res[i].failed, res[i].opsps, res[i].rp50, res[i].rp99,
+      res[i].rp999, res[i].wp50, res[i].wp99, res[i].wp999, res[i].max,
+      res[i].fairness, res[i].minmax);
+  }
+}
+
+#endif /* _WIN32 */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,1158 @@
+/*
+* $Id:  $
+* $Version: $
+*
+* Copyright (c) agent 2026
+*
+* This file is part of WhiteDB
+*
+* WhiteDB is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* WhiteDB is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with WhiteDB.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+
+ /** @file wgbench.c
+ *  Benchmark driver: runs a set of timed scenarios in local memory
+ *  databases and reports throughput and latency percentiles.
+ */
+
+/* ====== Includes =============== */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#include "../config-w32.h"
+#else
+#include "../config.h"
+#endif
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../Db/dballoc.h"
+#include "../Db/dbmem.h"
+#include "../Db/dbdata.h"
+#include "../Db/dblock.h"
+#include "../Db/dbindex.h"
+#include "../Db/dbquery.h"
+#include "../Db/dbdump.h"
+#include "../Db/dblog.h"
+#include "../Db/dbjson.h"
+#include "../Db/dbtable.h"
+#include "../Db/indexapi.h"
+
+
+/* ====== Private defs =========== */
+
+#define DEFAULT_RECORDS 100000
+#define DEFAULT_FIELDS 5
+#define DEFAULT_REPEAT 3
+#define DEFAULT_BATCH 100
+#define DEFAULT_RANGE 100
+#define DEFAULT_WRITE_PCT 20
+#define MAX_THREAD_COUNTS 16
+#define STR_LEN 30
+
+#ifndef _WIN32
+#define DUMP_FILENAME "/tmp/wgbench.dump"
+#else
+#define DUMP_FILENAME "wgbench.dump"
+#endif
+
+/** Benchmark parameters */
+typedef struct {
+  gint records;         /** records in database / operations per run */
+  gint fields;          /** fields per record */
+  gint dbsize;          /** database size, 0 to estimate */
+  gint warmup;          /** untimed operations before measuring */
+  int repeat;           /** repetitions of each scenario */
+  gint batch;           /** rows per wg_insert_batch() call */
+  gint range;           /** width of the range query */
+  int write_pct;        /** percentage of write transactions */
+  int threads[MAX_THREAD_COUNTS];
+  int thread_count;
+  int quiet;
+} bench_params;
+
+/** Per-run state passed to the scenario callbacks */
+typedef struct {
+  bench_params *p;
+  void *db;
+  void *db2;            /** import target */
+  void **recs;          /** records created in setup */
+  gint index_id;
+  gint table;           /** table of every tenth record, if non-0 */
+  gint counter;         /** used to check scans are not optimized away */
+  char *strbuf;
+  wg_batch_value *batch;
+  gint *batchlen;
+} bench_ctx;
+
+/** Benchmark scenario */
+typedef struct {
+  char *name;
+  char *descr;
+  int (*setup)(bench_ctx *ctx);     /** prepare the database (untimed) */
+  int (*op)(bench_ctx *ctx, gint i); /** single timed operation */
+  void (*teardown)(bench_ctx *ctx);
+  gint opdiv;           /** operations per run = records / opdiv */
+  gint fixed;           /** if nonzero, fixed number of operations */
+  int threaded;         /** runs with each of the thread counts */
+} bench_scenario;
+
+/** Results of one scenario (and thread count) */
+typedef struct {
+  char *name;
+  int threads;
+  gint ops;             /** timed operations per repetition */
+  double elapsed;       /** median elapsed time of a repetition (s) */
+  double opsps;         /** median throughput (ops/s) */
+  double p50, p90, p99, p999, max;  /** latency in microseconds */
+} bench_result;
+
+#if defined(_WIN32)
+typedef DWORD worker_t;
+#else
+typedef void * worker_t;
+#endif
+
+/** Lock contention worker data */
+typedef struct {
+  bench_ctx *ctx;
+  int threadid;
+  gint ops;
+  double *lat;
+#ifdef HAVE_PTHREAD
+  pthread_t pth;
+#endif
+} worker_data;
+
+/* ======= Private protos ================ */
+
+static double now_us(void);
+static gint estimate_dbsize(bench_params *p);
+static int populate(bench_ctx *ctx, gint n, int index_type);
+static int cmp_double(const void *a, const void *b);
+static double percentile(double *sorted, gint count, double pct);
+static int run_scenario(bench_params *p, bench_scenario *sc, int threads,
+  bench_result *res);
+static int run_threads(bench_ctx *ctx, int threads, double *lat,
+  double *elapsed);
+static worker_t lock_worker(void *arg);
+static void print_results(FILE *f, bench_result *res, int count);
+static void write_csv(FILE *f, bench_params *p, bench_result *res, int count);
+static void write_json(FILE *f, bench_params *p, bench_result *res,
+  int count);
+static void usage(char *prog);
+
+static int setup_empty(bench_ctx *ctx);
+static int setup_filled(bench_ctx *ctx);
+static int setup_delete(bench_ctx *ctx);
+static int setup_sparse(bench_ctx *ctx);
+static int setup_table(bench_ctx *ctx);
+static int setup_columns(bench_ctx *ctx);
+static int setup_batch(bench_ctx *ctx);
+static int setup_chain(bench_ctx *ctx);
+static int setup_ttree(bench_ctx *ctx);
+static int setup_hash(bench_ctx *ctx);
+static int setup_update(bench_ctx *ctx);
+static int setup_logged(bench_ctx *ctx);
+static int setup_import(bench_ctx *ctx);
+static void teardown_logged(bench_ctx *ctx);
+static void teardown_dump(bench_ctx *ctx);
+
+static int op_insert(bench_ctx *ctx, gint i);
+static int op_rawinsert(bench_ctx *ctx, gint i);
+static int op_strinsert(bench_ctx *ctx, gint i);
+static int op_dblinsert(bench_ctx *ctx, gint i);
+static int op_delete(bench_ctx *ctx, gint i);
+static int op_update(bench_ctx *ctx, gint i);
+static int op_openupdate(bench_ctx *ctx, gint i);
+static int op_bulkupdate(bench_ctx *ctx, gint i);
+static int op_batch(bench_ctx *ctx, gint i);
+static int op_scan(bench_ctx *ctx, gint i);
+static int op_tablescan(bench_ctx *ctx, gint i);
+static int op_colscan(bench_ctx *ctx, gint i);
+static int op_filter(bench_ctx *ctx, gint i);
+static int op_chain(bench_ctx *ctx, gint i);
+static int op_ttree(bench_ctx *ctx, gint i);
+static int op_hash(bench_ctx *ctx, gint i);
+static int op_range(bench_ctx *ctx, gint i);
+static int op_mkindex(bench_ctx *ctx, gint i);
+static int op_json(bench_ctx *ctx, gint i);
+static int op_dump(bench_ctx *ctx, gint i);
+static int op_import(bench_ctx *ctx, gint i);
+
+
+/* ====== Global vars ======== */
+
+static bench_scenario scenarios[] = {
+  { "insert", "create record, set int fields",
+    setup_empty, op_insert, NULL, 1, 0, 0 },
+  { "rawinsert", "create raw record, set new int fields",
+    setup_empty, op_rawinsert, NULL, 1, 0, 0 },
+  { "strinsert", "create record, set string fields",
+    setup_empty, op_strinsert, NULL, 1, 0, 0 },
+  { "dblinsert", "create record, set double fields",
+    setup_empty, op_dblinsert, NULL, 1, 0, 0 },
+  { "delete", "delete record",
+    setup_delete, op_delete, NULL, 1, 0, 0 },
+  { "batch", "wg_insert_batch() of -b records",
+    setup_batch, op_batch, NULL, DEFAULT_BATCH, 0, 0 },
+  { "update", "set all fields of an indexed record",
+    setup_update, op_update, NULL, 1, 0, 0 },
+  { "openupdate", "update with wg_open_record_update()",
+    setup_update, op_openupdate, NULL, 1, 0, 0 },
+  { "bulkupdate", "openupdate of -b records, closed together",
+    setup_update, op_bulkupdate, NULL, DEFAULT_BATCH, 0, 0 },
+  { "scan", "full scan reading one field",
+    setup_filled, op_scan, NULL, 1, 10, 0 },
+  { "filter", "full scan query with two conditions",
+    setup_filled, op_filter, NULL, 1, 10, 0 },
+  { "sparsescan", "full scan after deleting 9 of 10 records",
+    setup_sparse, op_scan, NULL, 1, 10, 0 },
+  { "tablescan", "scan a table holding every tenth record",
+    setup_table, op_tablescan, NULL, 1, 10, 0 },
+  { "colscan", "tablescan reading the column projection",
+    setup_columns, op_colscan, NULL, 1, 10, 0 },
+  { "chain", "traverse list of record pointers",
+    setup_chain, op_chain, NULL, 1, 10, 0 },
+  { "ttree", "T-tree index lookup",
+    setup_ttree, op_ttree, NULL, 1, 0, 0 },
+  { "hash", "hash index lookup",
+    setup_hash, op_hash, NULL, 1, 0, 0 },
+  { "range", "range query with T-tree index",
+    setup_ttree, op_range, NULL, DEFAULT_RANGE, 0, 0 },
+  { "mkindex", "create and drop T-tree index",
+    setup_filled, op_mkindex, NULL, 1, 3, 0 },
+  { "json", "parse and store JSON document",
+    setup_empty, op_json, NULL, 1, 0, 0 },
+  { "logged", "insert with journal logging",
+    setup_logged, op_insert, teardown_logged, 1, 0, 0 },
+  { "dump", "dump database to file",
+    setup_filled, op_dump, teardown_dump, 1, 3, 0 },
+  { "import", "import database from file",
+    setup_import, op_import, teardown_dump, 1, 3, 0 },
+  { "lock", "read/write transactions from threads",
+    setup_filled, NULL, NULL, 1, 0, 1 },
+  { NULL, NULL, NULL, NULL, NULL, 0, 0, 0 }
+};
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t start_mutex;
+static pthread_cond_t start_cv;
+static volatile int start_cnt;
+#endif
+
+
+/* ====== Functions ============== */
+
+int main(int argc, char **argv) {
+  bench_params p;
+  bench_result *results;
+  int i, j, k, rcount = 0, selected = 0, err = 0;
+  char *csvfile = NULL, *jsonfile = NULL;
+  char *sel[64];
+
+  memset(&p, 0, sizeof(bench_params));
+  p.records = DEFAULT_RECORDS;
+  p.fields = DEFAULT_FIELDS;
+  p.repeat = DEFAULT_REPEAT;
+  p.batch = DEFAULT_BATCH;
+  p.range = DEFAULT_RANGE;
+  p.write_pct = DEFAULT_WRITE_PCT;
+  p.warmup = -1;
+
+  for(i=1; i<argc; i++) {
+    if(argv[i][0] == '-' && argv[i][1] && !argv[i][2]) {
+      char opt = argv[i][1];
+      if(opt == 'h') {
+        usage(argv[0]);
+        exit(0);
+      } else if(opt == 'q') {
+        p.quiet = 1;
+        continue;
+      }
+      if(i+1 >= argc) {
+        usage(argv[0]);
+        exit(1);
+      }
+      switch(opt) {
+        case 'n': p.records = atol(argv[++i]); break;
+        case 'f': p.fields = atol(argv[++i]); break;
+        case 's': p.dbsize = atol(argv[++i]); break;
+        case 'w': p.warmup = atol(argv[++i]); break;
+        case 'r': p.repeat = atoi(argv[++i]); break;
+        case 'b': p.batch = atol(argv[++i]); break;
+        case 'R': p.range = atol(argv[++i]); break;
+        case 'W': p.write_pct = atoi(argv[++i]); break;
+        case 'c': csvfile = argv[++i]; break;
+        case 'j': jsonfile = argv[++i]; break;
+        case 't': {
+            char *s = argv[++i];
+            p.thread_count = 0;
+            while(*s && p.thread_count < MAX_THREAD_COUNTS) {
+              p.threads[p.thread_count++] = atoi(s);
+              while(*s && *s != ',') s++;
+              if(*s) s++;
+            }
+          }
+          break;
+        default:
+          usage(argv[0]);
+          exit(1);
+      }
+    } else if(selected < 64) {
+      sel[selected++] = argv[i];
+    }
+  }
+
+  if(p.records < 1 || p.fields < 2 || p.repeat < 1 || p.batch < 1 ||\
+    p.range < 1 || p.write_pct < 0 || p.write_pct > 100) {
+    fprintf(stderr, "Invalid parameters.\n");
+    exit(1);
+  }
+  if(!p.thread_count) {
+    p.threads[0] = 1;
+    p.threads[1] = 2;
+    p.threads[2] = 4;
+    p.thread_count = 3;
+  }
+  for(i=0; i<p.thread_count; i++) {
+    if(p.threads[i] < 1) {
+      fprintf(stderr, "Invalid thread count.\n");
+      exit(1);
+    }
+  }
+  if(p.warmup < 0)
+    p.warmup = (p.records > 100000 ? 10000 : p.records / 10);
+  if(!p.dbsize)
+    p.dbsize = estimate_dbsize(&p);
+
+  /* Scenarios that divide the record count use the parameters */
+  for(i=0; scenarios[i].name; i++) {
+    if(scenarios[i].op == op_batch || scenarios[i].op == op_bulkupdate)
+      scenarios[i].opdiv = p.batch;
+    else if(scenarios[i].op == op_range)
+      scenarios[i].opdiv = p.range;
+  }
+
+  for(j=0; j<selected; j++) {
+    for(i=0; scenarios[i].name; i++) {
+      if(!strcmp(sel[j], scenarios[i].name))
+        break;
+    }
+    if(!scenarios[i].name) {
+      fprintf(stderr, "Unknown scenario: %s\n", sel[j]);
+      exit(1);
+    }
+  }
+
+  results = (bench_result *) malloc(sizeof(bench_result) *\
+    (sizeof(scenarios)/sizeof(bench_scenario)) * MAX_THREAD_COUNTS);
+  if(!results) {
+    fprintf(stderr, "Failed to allocate memory.\n");
+    exit(2);
+  }
+
+  for(i=0; scenarios[i].name; i++) {
+    if(selected) {
+      for(j=0; j<selected; j++) {
+        if(!strcmp(sel[j], scenarios[i].name))
+          break;
+      }
+      if(j == selected)
+        continue;
+    }
+    for(k=0; k<(scenarios[i].threaded ? p.thread_count : 1); k++) {
+      int threads = (scenarios[i].threaded ? p.threads[k] : 1);
+      if(!p.quiet) {
+        fprintf(stderr, "running %s (%s), %d thread(s)\n",
+          scenarios[i].name, scenarios[i].descr, threads);
+      }
+      if(run_scenario(&p, &scenarios[i], threads, &results[rcount])) {
+        fprintf(stderr, "Scenario %s failed or is not available.\n",
+          scenarios[i].name);
+        err = 1;
+        continue;
+      }
+      rcount++;
+    }
+  }
+
+  print_results(stdout, results, rcount);
+
+  if(csvfile) {
+    FILE *f = fopen(csvfile, "w");
+    if(f) {
+      write_csv(f, &p, results, rcount);
+      fclose(f);
+    } else {
+      fprintf(stderr, "Failed to open %s\n", csvfile);
+      err = 1;
+    }
+  }
+  if(jsonfile) {
+    FILE *f = fopen(jsonfile, "w");
+    if(f) {
+      write_json(f, &p, results, rcount);
+      fclose(f);
+    } else {
+      fprintf(stderr, "Failed to open %s\n", jsonfile);
+      err = 1;
+    }
+  }
+
+  free(results);
+  exit(err);
+}
+
+static void usage(char *prog) {
+  int i;
+  printf("usage: %s [options] [scenario ...]\n"\
+    "Options:\n"\
+    "  -n <records>  records in the database/operations per run "\
+    "(default %d)\n"\
+    "  -f <fields>   fields per record (default %d)\n"\
+    "  -s <bytes>    database size (default: estimated)\n"\
+    "  -w <ops>      untimed warmup operations (default: records/10, "\
+    "max 10000)\n"\
+    "  -r <count>    repetitions of each scenario (default %d)\n"\
+    "  -t <n,n,..>   thread counts for threaded scenarios (default 1,2,4)\n"\
+    "  -W <pct>      percentage of write transactions (default %d)\n"\
+    "  -b <rows>     rows per batch insert or bulk update (default %d)\n"\
+    "  -R <width>    width of the range query (default %d)\n"\
+    "  -c <file>     write results in CSV format\n"\
+    "  -j <file>     write results in JSON format\n"\
+    "  -q            do not print progress\n"\
+    "Scenarios (default: all):\n",
+    prog, DEFAULT_RECORDS, DEFAULT_FIELDS, DEFAULT_REPEAT,
+    DEFAULT_WRITE_PCT, DEFAULT_BATCH, DEFAULT_RANGE);
+  for(i=0; scenarios[i].name; i++) {
+    printf("  %-10s %s\n", scenarios[i].name, scenarios[i].descr);
+  }
+}
+
+/** Monotonic time in microseconds
+ */
+static double now_us(void) {
+#ifdef _WIN32
+  LARGE_INTEGER cnt, freq;
+  QueryPerformanceCounter(&cnt);
+  QueryPerformanceFrequency(&freq);
+  return (double) cnt.QuadPart * 1000000.0 / (double) freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1000000.0 + (double) ts.tv_nsec / 1000.0;
+#endif
+}
+
+/** Estimate the database size needed by the scenarios.
+ *  Generous, as strings and indexes need extra space.
+ */
+static gint estimate_dbsize(bench_params *p) {
+  gint recsize = (p->fields + RECORD_HEADER_GINTS) * sizeof(gint);
+  gint strsize = p->fields * (STR_LEN + 2*sizeof(gint));
+  return 2 * (p->records + p->warmup + p->batch) * (recsize + strsize) +\
+    20000000;
+}
+
+/** Run one scenario.
+ *  Each repetition creates a new local database.
+ *  returns 0 on success, -1 on failure.
+ */
+static int run_scenario(bench_params *p, bench_scenario *sc, int threads,
+  bench_result *res) {
+  gint ops, warmup, i;
+  int r, err = 0;
+  double *lat, *elapsed;
+  gint total = 0;
+
+  if(sc->fixed) {
+    ops = sc->fixed;
+    warmup = 0;
+  } else {
+    ops = p->records / sc->opdiv;
+    warmup = p->warmup / sc->opdiv;
+    if(ops < 1) ops = 1;
+  }
+
+  lat = (double *) malloc(sizeof(double) * ops * p->repeat);
+  elapsed = (double *) malloc(sizeof(double) * p->repeat);
+  if(!lat || !elapsed) {
+    fprintf(stderr, "Failed to allocate memory.\n");
+    if(lat) free(lat);
+    if(elapsed) free(elapsed);
+    return -1;
+  }
+
+  for(r=0; r<p->repeat && !err; r++) {
+    bench_ctx ctx;
+    double start;
+
+    memset(&ctx, 0, sizeof(bench_ctx));
+    ctx.p = p;
+    ctx.db = wg_attach_local_database(p->dbsize);
+    if(!ctx.db) {
+      err = -1;
+      break;
+    }
+    if(sc->setup(&ctx)) {
+      err = -1;
+    }
+    else if(sc->threaded) {
+      if(run_threads(&ctx, threads, lat + total, &elapsed[r]))
+        err = -1;
+      else
+        total += ops;
+    }
+    else {
+      for(i=0; i<warmup; i++) {
+        if(sc->op(&ctx, i)) {
+          err = -1;
+          break;
+        }
+      }
+      start = now_us();
+      for(i=warmup; i<warmup+ops && !err; i++) {
+        double t = now_us();
+        if(sc->op(&ctx, i))
+          err = -1;
+        lat[total++] = now_us() - t;
+      }
+      elapsed[r] = (now_us() - start) / 1000000.0;
+    }
+
+    if(sc->teardown)
+      sc->teardown(&ctx);
+    if(ctx.db2)
+      wg_delete_local_database(ctx.db2);
+    if(ctx.recs) free(ctx.recs);
+    if(ctx.strbuf) free(ctx.strbuf);
+    if(ctx.batch) free(ctx.batch);
+    if(ctx.batchlen) free(ctx.batchlen);
+    wg_delete_local_database(ctx.db);
+  }
+
+  if(!err) {
+    qsort(elapsed, p->repeat, sizeof(double), cmp_double);
+    qsort(lat, total, sizeof(double), cmp_double);
+    res->name = sc->name;
+    res->threads = threads;
+    res->ops = ops;
+    res->elapsed = elapsed[p->repeat/2];
+    res->opsps = (res->elapsed > 0 ? ops / res->elapsed : 0);
+    res->p50 = percentile(lat, total, 50.0);
+    res->p90 = percentile(lat, total, 90.0);
+    res->p99 = percentile(lat, total, 99.0);
+    res->p999 = percentile(lat, total, 99.9);
+    res->max = lat[total-1];
+  }
+
+  free(lat);
+  free(elapsed);
+  return err;
+}
+
+static int cmp_double(const void *a, const void *b) {
+  double da = *((double *) a), db = *((double *) b);
+  return (da > db) - (da < db);
+}
+
+/** Nearest-rank percentile of a sorted array
+ */
+static double percentile(double *sorted, gint count, double pct) {
+  gint idx = (gint) (pct / 100.0 * count + 0.5);
+  if(idx < 1) idx = 1;
+  if(idx > count) idx = count;
+  return sorted[idx-1];
+}
+
+/* ----------- scenario setup ------------- */
+
+static int setup_empty(bench_ctx *ctx) {
+  ctx->strbuf = (char *) malloc(STR_LEN + 30);
+  return (ctx->strbuf ? 0 : -1);
+}
+
+/** Fill the database with records. The first field holds the
+ *  record number, the rest contain small integers.
+ */
+static int populate(bench_ctx *ctx, gint n, int index_type) {
+  gint i, j;
+
+  ctx->recs = (void **) malloc(sizeof(void *) * n);
+  if(!ctx->recs)
+    return -1;
+  for(i=0; i<n; i++) {
+    void *rec;
+    if(ctx->table && !(i%10))
+      rec = wg_create_table_record(ctx->db, ctx->table, ctx->p->fields);
+    else
+      rec = wg_create_raw_record(ctx->db, ctx->p->fields);
+    if(!rec)
+      return -1;
+    for(j=0; j<ctx->p->fields; j++) {
+      if(wg_set_new_field(ctx->db, rec, j,
+        wg_encode_int(ctx->db, (j ? (i+j)%1000 : i))))
+        return -1;
+    }
+    ctx->recs[i] = rec;
+  }
+
+  if(index_type == WG_INDEX_TYPE_TTREE) {
+    if(wg_create_index(ctx->db, 0, WG_INDEX_TYPE_TTREE, NULL, 0))
+      return -1;
+    ctx->index_id = wg_column_to_index_id(ctx->db, 0,
+      WG_INDEX_TYPE_TTREE, NULL, 0);
+  } else if(index_type == WG_INDEX_TYPE_HASH) {
+    gint col = 0;
+    if(wg_create_multi_index(ctx->db, &col, 1, WG_INDEX_TYPE_HASH, NULL, 0))
+      return -1;
+    ctx->index_id = wg_multi_column_to_index_id(ctx->db, &col, 1,
+      WG_INDEX_TYPE_HASH, NULL, 0);
+  }
+  return (ctx->index_id < 0 ? -1 : 0);
+}
+
+static int setup_filled(bench_ctx *ctx) {
+  return populate(ctx, ctx->p->records, 0);
+}
+
+/** Warmup deletes records as well, so extra ones are needed
+ */
+static int setup_delete(bench_ctx *ctx) {
+  return populate(ctx, ctx->p->records + ctx->p->warmup, 0);
+}
+
+/** Only every tenth record remains, the rest is free space
+ */
+static int setup_sparse(bench_ctx *ctx) {
+  gint i;
+  if(populate(ctx, ctx->p->records, 0))
+    return -1;
+  for(i=0; i<ctx->p->records; i++) {
+    if(i%10 && wg_delete_record(ctx->db, ctx->recs[i]))
+      return -1;
+  }
+  return 0;
+}
+
+/** Every tenth record belongs to a table, the rest are
+ *  plain records in between
+ */
+static int setup_table(bench_ctx *ctx) {
+  ctx->table = wg_create_table(ctx->db);
+  if(ctx->table < 1)
+    return -1;
+  return populate(ctx, ctx->p->records, 0);
+}
+
+/** The table of setup_table() with a projection of the scanned column
+ */
+static int setup_columns(bench_ctx *ctx) {
+  gint col = 1;
+  if(setup_table(ctx))
+    return -1;
+  return (wg_create_table_columns(ctx->db, ctx->table, &col, 1) ? -1 : 0);
+}
+
+static int setup_ttree(bench_ctx *ctx) {
+  return populate(ctx, ctx->p->records, WG_INDEX_TYPE_TTREE);
+}
+
+static int setup_hash(bench_ctx *ctx) {
+  return populate(ctx, ctx->p->records, WG_INDEX_TYPE_HASH);
+}
+
+/** T-tree index on the first column and a hash index on the
+ *  first three columns. Warmup updates records, too.
+ */
+static int setup_update(bench_ctx *ctx) {
+  gint cols[3] = { 0, 1, 2 };
+  if(ctx->p->fields < 3)
+    return -1;
+  if(populate(ctx, ctx->p->records + ctx->p->warmup, WG_INDEX_TYPE_TTREE))
+    return -1;
+  return (wg_create_multi_index(ctx->db, cols, 3, WG_INDEX_TYPE_HASH,
+    NULL, 0) ? -1 : 0);
+}
+
+static int setup_batch(bench_ctx *ctx) {
+  gint i, j, b = ctx->p->batch, f = ctx->p->fields;
+  ctx->batch = (wg_batch_value *) malloc(sizeof(wg_batch_value) * b * f);
+  ctx->batchlen = (gint *) malloc(sizeof(gint) * b);
+  if(!ctx->batch || !ctx->batchlen)
+    return -1;
+  memset(ctx->batch, 0, sizeof(wg_batch_value) * b * f);
+  for(i=0; i<b; i++) {
+    ctx->batchlen[i] = f;
+    for(j=0; j<f; j++)
+      ctx->batch[i*f + j].type = WG_INTTYPE;
+  }
+  return 0;
+}
+
+/** Each record links to the previous one in the second field
+ */
+static int setup_chain(bench_ctx *ctx) {
+  gint i;
+  if(populate(ctx, ctx->p->records, 0))
+    return -1;
+  for(i=1; i<ctx->p->records; i++) {
+    if(wg_set_field(ctx->db, ctx->recs[i], 1,
+      wg_encode_record(ctx->db, ctx->recs[i-1])))
+      return -1;
+  }
+  return 0;
+}
+
+static int setup_logged(bench_ctx *ctx) {
+  if(setup_empty(ctx))
+    return -1;
+  return (wg_start_logging(ctx->db) ? -1 : 0);
+}
+
+static void teardown_logged(bench_ctx *ctx) {
+#ifdef USE_DBLOG
+  char fn[WG_JOURNAL_FN_BUFSIZE];
+  wg_journal_filename(ctx->db, fn, WG_JOURNAL_FN_BUFSIZE);
+  wg_stop_logging(ctx->db);
+  remove(fn);
+#endif
+}
+
+static int setup_import(bench_ctx *ctx) {
+  if(populate(ctx, ctx->p->records, 0))
+    return -1;
+  if(wg_dump(ctx->db, DUMP_FILENAME))
+    return -1;
+  ctx->db2 = wg_attach_local_database(ctx->p->dbsize);
+  return (ctx->db2 ? 0 : -1);
+}
+
+static void teardown_dump(bench_ctx *ctx) {
+  remove(DUMP_FILENAME);
+}
+
+/* ----------- timed operations ------------- */
+
+static int op_insert(bench_ctx *ctx, gint i) {
+  gint j;
+  void *rec = wg_create_record(ctx->db, ctx->p->fields);
+  if(!rec)
+    return -1;
+  for(j=0; j<ctx->p->fields; j++) {
+    if(wg_set_field(ctx->db, rec, j, wg_encode_int(ctx->db, i+j)))
+      return -1;
+  }
+  return 0;
+}
+
+static int op_rawinsert(bench_ctx *ctx, gint i) {
+  gint j;
+  void *rec = wg_create_raw_record(ctx->db, ctx->p->fields);
+  if(!rec)
+    return -1;
+  for(j=0; j<ctx->p->fields; j++) {
+    if(wg_set_new_field(ctx->db, rec, j, wg_encode_int(ctx->db, i+j)))
+      return -1;
+  }
+  return 0;
+}
+
+static int op_strinsert(bench_ctx *ctx, gint i) {
+  gint j;
+  void *rec = wg_create_record(ctx->db, ctx->p->fields);
+  if(!rec)
+    return -1;
+  for(j=0; j<ctx->p->fields; j++) {
+    snprintf(ctx->strbuf, STR_LEN + 1, "%0*ld", STR_LEN, (long) (i+j));
+    if(wg_set_field(ctx->db, rec, j,
+      wg_encode_str(ctx->db, ctx->strbuf, NULL)))
+      return -1;
+  }
+  return 0;
+}
+
+static int op_dblinsert(bench_ctx *ctx, gint i) {
+  gint j;
+  void *rec = wg_create_record(ctx->db, ctx->p->fields);
+  if(!rec)
+    return -1;
+  for(j=0; j<ctx->p->fields; j++) {
+    if(wg_set_field(ctx->db, rec, j,
+      wg_encode_double(ctx->db, (double) (i+j) / 3.0)))
+      return -1;
+  }
+  return 0;
+}
+
+static int op_delete(bench_ctx *ctx, gint i) {
+  return (wg_delete_record(ctx->db, ctx->recs[i]) ? -1 : 0);
+}
+
+static int op_update(bench_ctx *ctx, gint i) {
+  gint j;
+  for(j=0; j<ctx->p->fields; j++) {
+    if(wg_set_field(ctx->db, ctx->recs[i], j,
+      wg_encode_int(ctx->db, -(i+j))))
+      return -1;
+  }
+  return 0;
+}
+
+static int op_openupdate(bench_ctx *ctx, gint i) {
+  if(wg_open_record_update(ctx->db, ctx->recs[i]))
+    return -1;
+  if(op_update(ctx, i))
+    return -1;
+  return (wg_close_record_update(ctx->db, ctx->recs[i]) ? -1 : 0);
+}
+
+static int op_bulkupdate(bench_ctx *ctx, gint i) {
+  gint j, b = ctx->p->batch;
+  void **recs = ctx->recs + i*b;
+  for(j=0; j<b; j++) {
+    if(wg_open_record_update(ctx->db, recs[j]))
+      return -1;
+    if(op_update(ctx, i*b + j))
+      return -1;
+  }
+  return (wg_close_record_updates(ctx->db, recs, b) ? -1 : 0);
+}
+
+static int op_batch(bench_ctx *ctx, gint i) {
+  gint j, cnt = ctx->p->batch * ctx->p->fields;
+  for(j=0; j<cnt; j++)
+    ctx->batch[j].v.i = i + j;
+  return (wg_insert_batch(ctx->db, ctx->p->batch, ctx->batchlen,
+    ctx->batch, NULL) ? -1 : 0);
+}
+
+static int op_scan(bench_ctx *ctx, gint i) {
+  void *rec = wg_get_first_record(ctx->db);
+  while(rec) {
+    if(wg_decode_int(ctx->db, wg_get_field(ctx->db, rec, 1)) == 123)
+      ctx->counter++;
+    rec = wg_get_next_record(ctx->db, rec);
+  }
+  return 0;
+}
+
+static int op_tablescan(bench_ctx *ctx, gint i) {
+  void *rec = wg_get_first_table_record(ctx->db, ctx->table);
+  while(rec) {
+    if(wg_decode_int(ctx->db, wg_get_field(ctx->db, rec, 1)) == 123)
+      ctx->counter++;
+    rec = wg_get_next_table_record(ctx->db, ctx->table, rec);
+  }
+  return 0;
+}
+
+static int op_colscan(bench_ctx *ctx, gint i) {
+  gint count, slot;
+  gint *values = wg_get_table_column(ctx->db, ctx->table, 1, &count);
+  if(!values)
+    return -1;
+  for(slot=0; slot<count; slot++) {
+    if(values[slot] != WG_ILLEGAL &&\
+      wg_decode_int(ctx->db, values[slot]) == 123)
+      ctx->counter++;
+  }
+  return 0;
+}
+
+static int op_filter(bench_ctx *ctx, gint i) {
+  wg_query_arg arglist[2];
+  wg_query *query;
+  gint cnt = 0;
+
+  arglist[0].column = 1;
+  arglist[0].cond = WG_COND_GTEQUAL;
+  arglist[0].value = wg_encode_query_param_int(ctx->db, 100);
+  arglist[1].column = 2;
+  arglist[1].cond = WG_COND_LESSTHAN;
+  arglist[1].value = wg_encode_query_param_int(ctx->db, 500);
+  query = wg_make_query(ctx->db, NULL, 0, arglist, 2);
+  if(query) {
+    while(wg_fetch(ctx->db, query))
+      cnt++;
+    wg_free_query(ctx->db, query);
+  }
+  ctx->counter += cnt;
+  return (query ? 0 : -1);
+}
+
+static int op_chain(bench_ctx *ctx, gint i) {
+  void *rec = ctx->recs[ctx->p->records - 1];
+  gint cnt = 0;
+  for(;;) {
+    gint enc = wg_get_field(ctx->db, rec, 1);
+    cnt++;
+    if(wg_get_encoded_type(ctx->db, enc) != WG_RECORDTYPE)
+      break;
+    rec = wg_decode_record(ctx->db, enc);
+  }
+  return (cnt == ctx->p->records ? 0 : -1);
+}
+
+/** Keys are visited in a scattered order to avoid measuring
+ *  only cache hits.
+ */
+#define LOOKUP_KEY(ctx, i) (((i) * 7919) % (ctx)->p->records)
+
+static int op_ttree(bench_ctx *ctx, gint i) {
+  gint key = LOOKUP_KEY(ctx, i);
+  void *rec = wg_find_record_int(ctx->db, 0, WG_COND_EQUAL, key, NULL);
+  return (rec ? 0 : -1);
+}
+
+static int op_hash(bench_ctx *ctx, gint i) {
+  gint key = wg_encode_int(ctx->db, LOOKUP_KEY(ctx, i));
+  return (wg_search_hash(ctx->db, ctx->index_id, &key, 1) > 0 ? 0 : -1);
+}
+
+static int op_range(bench_ctx *ctx, gint i) {
+  wg_query_arg arglist[2];
+  wg_query *query;
+  gint start = LOOKUP_KEY(ctx, i);
+  void *rec;
+  gint cnt = 0;
+
+  arglist[0].column = 0;
+  arglist[0].cond = WG_COND_GTEQUAL;
+  arglist[0].value = wg_encode_query_param_int(ctx->db, start);
+  arglist[1].column = 0;
+  arglist[1].cond = WG_COND_LESSTHAN;
+  arglist[1].value = wg_encode_query_param_int(ctx->db,
+    start + ctx->p->range);
+  query = wg_make_query(ctx->db, NULL, 0, arglist, 2);
+  if(query) {
+    while((rec = wg_fetch(ctx->db, query)))
+      cnt++;
+    wg_free_query(ctx->db, query);
+  }
+  wg_free_query_param(ctx->db, arglist[0].value);
+  wg_free_query_param(ctx->db, arglist[1].value);
+  ctx->counter += cnt;
+  return (query ? 0 : -1);
+}
+
+/** The indexed column has 1000 distinct values, not in order
+ */
+static int op_mkindex(bench_ctx *ctx, gint i) {
+  gint index_id;
+  if(wg_create_index(ctx->db, 1, WG_INDEX_TYPE_TTREE, NULL, 0))
+    return -1;
+  index_id = wg_column_to_index_id(ctx->db, 1, WG_INDEX_TYPE_TTREE, NULL, 0);
+  return (wg_drop_index(ctx->db, index_id) ? -1 : 0);
+}
+
+static int op_json(bench_ctx *ctx, gint i) {
+  char buf[200];
+  void *doc;
+  snprintf(buf, 200, "{\"id\": %ld, \"name\": \"item %ld\", "\
+    "\"tags\": [\"a\", \"b\", %ld], \"value\": %f}",
+    (long) i, (long) i, (long) (i % 100), i * 0.5);
+  return (wg_parse_json_document(ctx->db, buf, &doc) ? -1 : 0);
+}
+
+static int op_dump(bench_ctx *ctx, gint i) {
+  return (wg_dump(ctx->db, DUMP_FILENAME) ? -1 : 0);
+}
+
+static int op_import(bench_ctx *ctx, gint i) {
+  return (wg_import_dump(ctx->db2, DUMP_FILENAME) ? -1 : 0);
+}
+
+/* ----------- lock contention ------------- */
+
+/** Run the lock contention workers.
+ *  Operations are divided evenly between the threads.
+ *  returns 0 on success, -1 on failure.
+ */
+static int run_threads(bench_ctx *ctx, int threads, double *lat,
+  double *elapsed) {
+#ifdef HAVE_PTHREAD
+  worker_data *wd;
+  gint per_thread = ctx->p->records / threads, i;
+  int err = 0;
+  double start;
+
+  wd = (worker_data *) malloc(sizeof(worker_data) * threads);
+  if(!wd)
+    return -1;
+
+  pthread_mutex_init(&start_mutex, NULL);
+  pthread_cond_init(&start_cv, NULL);
+  start_cnt = 0;
+
+  for(i=0; i<threads; i++) {
+    wd[i].ctx = ctx;
+    wd[i].threadid = i;
+    /* the first thread picks up the remainder */
+    wd[i].ops = per_thread + (i ? 0 : ctx->p->records % threads);
+    wd[i].lat = lat;
+    lat += wd[i].ops;
+    if(pthread_create(&wd[i].pth, NULL, lock_worker, &wd[i])) {
+      fprintf(stderr, "Failed to create thread.\n");
+      threads = i;
+      err = -1;
+      break;
+    }
+  }
+
+  /* Wait until all threads are ready, then release them */
+  for(;;) {
+    pthread_mutex_lock(&start_mutex);
+    if(start_cnt >= threads) break;
+    pthread_mutex_unlock(&start_mutex);
+  }
+  start = now_us();
+  pthread_cond_broadcast(&start_cv);
+  pthread_mutex_unlock(&start_mutex);
+
+  for(i=0; i<threads; i++) {
+    pthread_join(wd[i].pth, NULL);
+  }
+  *elapsed = (now_us() - start) / 1000000.0;
+
+  pthread_mutex_destroy(&start_mutex);
+  pthread_cond_destroy(&start_cv);
+  free(wd);
+  return err;
+#else
+  fprintf(stderr, "No thread support.\n");
+  return -1;
+#endif
+}
+
+/** Lock contention worker.
+ *  Runs short read and write transactions, measuring the time
+ *  from requesting the lock to releasing it.
+ */
+static worker_t lock_worker(void *arg) {
+#ifdef HAVE_PTHREAD
+  worker_data *wd = (worker_data *) arg;
+  void *db = wd->ctx->db;
+  gint records = wd->ctx->p->records, i;
+  int write_pct = wd->ctx->p->write_pct;
+
+  pthread_mutex_lock(&start_mutex);
+  start_cnt++;
+  pthread_cond_wait(&start_cv, &start_mutex);
+  pthread_mutex_unlock(&start_mutex);
+
+  for(i=0; i<wd->ops; i++) {
+    void *rec = wd->ctx->recs[(i * 7919 + wd->threadid) % records];
+    wg_int lock_id;
+    double t = now_us();
+
+    if(((i * 37 + wd->threadid * 11) % 100) < write_pct) {
+      lock_id = wg_start_write(db);
+      if(!lock_id)
+        break;
+      wg_set_field(db, rec, 1, wg_encode_int(db, i % 1000));
+      wg_end_write(db, lock_id);
+    } else {
+      lock_id = wg_start_read(db);
+      if(!lock_id)
+        break;
+      wg_decode_int(db, wg_get_field(db, rec, 1));
+      wg_end_read(db, lock_id);
+    }
+    wd->lat[i] = now_us() - t;
+  }
+  /* Unfinished operations are counted as free */
+  for(; i<wd->ops; i++)
+    wd->lat[i] = 0;
+#endif
+  return 0;
+}
+
+/* ----------- output ------------- */
+
+static void print_results(FILE *f, bench_result *res, int count) {
+  int i;
+  fprintf(f, "%-10s %7s %10s %12s %10s %10s %10s %10s %10s\n",
+    "scenario", "threads", "ops", "ops/s", "p50 us", "p90 us",
+    "p99 us", "p99.9 us", "max us");
+  for(i=0; i<count; i++) {
+    fprintf(f, "%-10s %7d %10ld %12.0f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+      res[i].name, res[i].threads, (long) res[i].ops, res[i].opsps,
+      res[i].p50, res[i].p90, res[i].p99, res[i].p999, res[i].max);
+  }
+}
+
+static void write_csv(FILE *f, bench_params *p, bench_result *res,
+  int count) {
+  int i;
+  fprintf(f, "scenario,threads,records,fields,repeat,ops,elapsed_s,"\
+    "ops_per_s,p50_us,p90_us,p99_us,p999_us,max_us\n");
+  for(i=0; i<count; i++) {
+    fprintf(f, "%s,%d,%ld,%ld,%d,%ld,%.6f,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+      res[i].name, res[i].threads, (long) p->records, (long) p->fields,
+      p->repeat, (long) res[i].ops, res[i].elapsed, res[i].opsps,
+      res[i].p50, res[i].p90, res[i].p99, res[i].p999, res[i].max);
+  }
+}
+
+static void write_json(FILE *f, bench_params *p, bench_result *res,
+  int count) {
+  int i;
+  fprintf(f, "{\n  \"version\": \"%d.%d.%d\",\n",
+    VERSION_MAJOR, VERSION_MINOR, VERSION_REV);
+#ifdef LOCK_PROTO
+  fprintf(f, "  \"lock_proto\": %d,\n", LOCK_PROTO);
+#endif
+#ifdef USE_DBLOG
+  fprintf(f, "  \"logging\": true,\n");
+#else
+  fprintf(f, "  \"logging\": false,\n");
+#endif
+  fprintf(f, "  \"records\": %ld,\n  \"fields\": %ld,\n"\
+    "  \"warmup\": %ld,\n  \"repeat\": %d,\n  \"write_pct\": %d,\n",
+    (long) p->records, (long) p->fields, (long) p->warmup, p->repeat,
+    p->write_pct);
+  fprintf(f, "  \"results\": [\n");
+  for(i=0; i<count; i++) {
+    fprintf(f, "    {\"scenario\": \"%s\", \"threads\": %d, \"ops\": %ld, "\
+      "\"elapsed_s\": %.6f, \"ops_per_s\": %.1f, \"p50_us\": %.3f, "\
+      "\"p90_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f, "\
+      "\"max_us\": %.3f}%s\n",
+      res[i].name, res[i].threads, (long) res[i].ops, res[i].elapsed,
+      res[i].opsps, res[i].p50, res[i].p90, res[i].p99, res[i].p999,
+      res[i].max, (i < count-1 ? "," : ""));
+  }
+  fprintf(f, "  ]\n}\n");
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -46,6 +46,9 @@
 
 #ifdef _WIN32
 #include <conio.h> // for _getch
+#include <windows.h> // for Sleep
+#else
+#include <unistd.h>
 #endif
 
 #ifdef __cplusplus
@@ -67,6 +70,7 @@ extern "C" {
 #include "../Db/dblock.h"
 #include "../Db/dbjson.h"
 #include "../Db/dbschema.h"
+#include "../Db/dbstats.h"
 #ifdef USE_REASONER
 #include "../Parser/dbparse.h"
 #endif
@@ -113,6 +117,7 @@ int parse_memmode(char *arg);
 wg_query_arg *make_arglist(void *db, char **argv, int argc, int *sz);
 void free_arglist(void *db, wg_query_arg *arglist, int sz);
 void query(void *db, char **argv, int argc);
+void explain(void *db, char **argv, int argc);
 void del(void *db, char **argv, int argc);
 void selectdata(void *db, int howmany, int startingat);
 int add_row(void *db, char **argv, int argc);
@@ -120,7 +125,11 @@ wg_json_query_arg *make_json_arglist(void *db, char *json, int *sz,
  void **doc);
 void findjson(void *db, char *json);
 void segment_stats(void *db);
+void print_stats(void *db, FILE *f);
+void print_lockstats(void *db, FILE *f, int verbose, int csv);
+void print_memstat(void *db, FILE *f, int csv);
 void print_indexes(void *db, FILE *f);
+void print_journal_event(void *db, FILE *f, wg_journal_event *ev);
 
 
 /* ====== Functions ============== */
@@ -163,12 +172,24 @@ void usage(char *prog) {
     "    importrdf <pref> <suff> <filename> - import data from a RDF file.\n");
 #endif
 #ifdef USE_DBLOG
-  printf("    replay <filename> - replay a journal file.\n");
+  printf("    replay <filename> - replay a journal file.\n"\
+    "    cdc [-f] [posfile] - print the changes in the journal as JSON "\
+    "lines (-f: keep following the journal, posfile: resume from and save "\
+    "the position in this file).\n"\
+    "    replicate <filename> - apply the journal file of another database "\
+    "continuously, as it grows (read replica).\n");
 #endif
   printf("    info - print information about the memory database.\n"\
+    "    stats [-r] - print runtime statistics counters (-r: reset the "\
+    "counters after printing).\n"\
+    "    lockstats [-v|-c] [-r] - print lock wait and hold time histograms "\
+    "(-v: full histograms, -c: CSV output, -r: reset after printing).\n"\
+    "    memstat [-c] - print memory usage and fragmentation of the "\
+    "allocation areas (-c: CSV output).\n"\
     "    add <value1> .. - store data row (only int or str recognized)\n"\
     "    select <number of rows> [start from] - print db contents.\n"\
-    "    query <col> \"<cond>\" <value> .. - basic query.\n"\
+    "    query [-e] <col> \"<cond>\" <value> .. - basic query (-e: print "\
+    "the query plan and profile instead of the rows).\n"\
     "    del <col> \"<cond>\" <value> .. - like query. Matching rows "\
     "are deleted from database.\n"\
     "    addjson [filename] - store a json document.\n"\
@@ -395,6 +416,96 @@ int main(int argc, char **argv) {
         fprintf(stderr, "Failed to import log (database unmodified).\n");
       break;
     }
+    else if(!strcmp(argv[i],"cdc")){
+      wg_journal_event ev;
+      void *cursor;
+      char *posfile = NULL;
+      int follow = 0;
+      gint err;
+
+      if(argc>(i+1) && !strcmp(argv[i+1], "-f")) {
+        follow = 1;
+        i++;
+      }
+      if(argc>(i+1))
+        posfile = argv[i+1];
+
+      shmptr=wg_attach_existing_database(shmname);
+      if(!shmptr) {
+        fprintf(stderr, "Failed to attach to database.\n");
+        exit(1);
+      }
+
+      /* The journal is read from the file, no locking is needed */
+      if(posfile)
+        cursor = wg_load_journal_cursor(shmptr, posfile);
+      else
+        cursor = wg_open_journal_cursor(shmptr, NULL, 0, 0);
+      if(!cursor) {
+        fprintf(stderr, "Failed to open the journal.\n");
+        break;
+      }
+      for(;;) {
+        while((err = wg_fetch_journal_event(shmptr, cursor, &ev)) > 0)
+          print_journal_event(shmptr, stdout, &ev);
+        fflush(stdout);
+        if(posfile && wg_save_journal_cursor(shmptr, cursor, posfile))
+          err = -1;
+        if(err || !follow)
+          break;
+#ifndef _WIN32
+        sleep(1);
+#else
+        Sleep(1000);
+#endif
+      }
+      if(err)
+        fprintf(stderr, "Failed to read the journal.\n");
+      wg_free_journal_cursor(shmptr, cursor);
+      break;
+    }
+    else if(argc>(i+1) && !strcmp(argv[i],"replicate")){
+      void *replica;
+      wg_int err;
+
+      shmptr=wg_attach_database(shmname, shmsize);
+      if(!shmptr) {
+        fprintf(stderr, "Failed to attach to database.\n");
+        exit(1);
+      }
+
+      replica = wg_start_replica(shmptr, argv[i+1]);
+      if(!replica) {
+        fprintf(stderr, "Failed to start the replica.\n");
+        break;
+      }
+      /* Runs until interrupted. Each batch is applied under the
+       * write lock, readers may use the database in between. */
+      for(;;) {
+        wlock = wg_start_write(shmptr);
+        if(!wlock) {
+          fprintf(stderr, "Failed to get database lock\n");
+          err = -1;
+          break;
+        }
+        err = wg_apply_replica(shmptr, replica);
+        WULOCK(shmptr, wlock);
+        if(err < 0)
+          break;
+#ifndef _WIN32
+        usleep(100000);
+#else
+        Sleep(100);
+#endif
+      }
+      if(err<-1)
+        fprintf(stderr, "Fatal error when applying the journal, database "\
+          "may have become corrupt\n");
+      else
+        fprintf(stderr, "Failed to apply the journal.\n");
+      wg_stop_replica(shmptr, replica);
+      break;
+    }
 #endif
     else if(argc>(i+1) && !strcmp(argv[i],"exportcsv")){
       shmptr=wg_attach_existing_database(shmname);
@@ -544,6 +655,54 @@ int main(int argc, char **argv) {
       RULOCK(shmptr, rlock);
       break;
     }
+    else if(!strcmp(argv[i], "stats")) {
+      shmptr=wg_attach_existing_database(shmname);
+      if(!shmptr) {
+        fprintf(stderr, "Failed to attach to database.\n");
+        exit(1);
+      }
+      /* The counters are read without locking, so that
+       * the locking statistics are not disturbed. */
+      print_stats(shmptr, stdout);
+      if(argc>(i+1) && !strcmp(argv[i+1], "-r")) {
+        wg_reset_stats(shmptr);
+      }
+      break;
+    }
+    else if(!strcmp(argv[i], "lockstats")) {
+      int verbose = 0, csv = 0, reset = 0;
+      while(argc>(i+1) && argv[i+1][0] == '-') {
+        i++;
+        if(!strcmp(argv[i], "-v")) verbose = 1;
+        else if(!strcmp(argv[i], "-c")) csv = 1;
+        else if(!strcmp(argv[i], "-r")) reset = 1;
+      }
+      shmptr=wg_attach_existing_database(shmname);
+      if(!shmptr) {
+        fprintf(stderr, "Failed to attach to database.\n");
+        exit(1);
+      }
+      print_lockstats(shmptr, stdout, verbose, csv);
+      if(reset) {
+        wg_reset_lockstats(shmptr);
+      }
+      break;
+    }
+    else if(!strcmp(argv[i], "memstat")) {
+      int csv = 0;
+      if(argc>(i+1) && !strcmp(argv[i+1], "-c")) {
+        csv = 1;
+      }
+      shmptr=wg_attach_existing_database(shmname);
+      if(!shmptr) {
+        fprintf(stderr, "Failed to attach to database.\n");
+        exit(1);
+      }
+      RLOCK(shmptr, rlock);
+      print_memstat(shmptr, stdout, csv);
+      RULOCK(shmptr, rlock);
+      break;
+    }
 #ifdef _WIN32
     else if(!strcmp(argv[i],"server")) {
       int flags = 0;
@@ -645,7 +804,10 @@ int main(int argc, char **argv) {
         exit(1);
       }
       /* Query handles it's own locking */
-      query(shmptr, argv+i+1, argc-i-1);
+      if(!strcmp(argv[i+1], "-e"))
+        explain(shmptr, argv+i+2, argc-i-2);
+      else
+        query(shmptr, argv+i+1, argc-i-1);
       break;
     }
     else if(argc>i && !strcmp(argv[i],"addjson")){
@@ -869,6 +1031,57 @@ abrt1:
   free_arglist(db, arglist, qargc);
 }
 
+/** Print the query plan and execution profile
+ *  Takes the same arguments as query().
+ */
+void explain(void *db, char **argv, int argc) {
+  int qargc;
+  wg_query_explain ex;
+  wg_query_arg *arglist;
+  gint lock_id;
+  char buf[80];
+
+  arglist = make_arglist(db, argv, argc, &qargc);
+  if(!arglist)
+    return;
+
+  if(!(lock_id = wg_start_read(db))) {
+    fprintf(stderr, "failed to get lock on database\n");
+    goto abrt1;
+  }
+
+  if(wg_explain_query(db, NULL, 0, arglist, qargc, &ex))
+    goto abrt2;
+
+  if(ex.qtype == WG_QTYPE_TTREE) {
+    printf("plan: T-tree index %d on column %d\n",
+      (int) ex.index_id, (int) ex.column);
+    printf("range: ");
+    if(ex.start_bound != WG_ILLEGAL) {
+      wg_snprint_value(db, ex.start_bound, buf, 79);
+      printf("%s %s ", buf, (ex.start_inclusive ? "<=" : "<"));
+    }
+    printf("col%d", (int) ex.column);
+    if(ex.end_bound != WG_ILLEGAL) {
+      wg_snprint_value(db, ex.end_bound, buf, 79);
+      printf(" %s %s", (ex.end_inclusive ? "<=" : "<"), buf);
+    }
+    printf("\n");
+  } else {
+    printf("plan: full scan\n");
+  }
+  printf("conditions checked per row: %d\n", (int) ex.argc);
+  printf("rows estimated: %ld\n", (long) ex.estimated);
+  printf("rows examined: %ld\n", (long) ex.examined);
+  printf("rows returned: %ld\n", (long) ex.returned);
+  printf("elapsed: %.3f ms\n", ex.elapsed * 1000);
+
+abrt2:
+  wg_end_read(db, lock_id);
+abrt1:
+  free_arglist(db, arglist, qargc);
+}
+
 /** Delete rows
  *  Like query(), except the selected rows are deleted.
  */
@@ -998,6 +1211,8 @@ wg_json_query_arg *make_json_arglist(void *db, char *json, int *sz,
     }
     arglist[i].key = key;
     arglist[i].value = value;
+    arglist[i].cond = WG_COND_EQUAL;
+    arglist[i].path = 0;
   }
 
   *sz = reclen;
@@ -1070,6 +1285,12 @@ void segment_stats(void *db) {
   } else {
     printf("logging is not active\n");
   }
+  if(dbh->logging.replica) {
+    gint bytes, seconds;
+    wg_replica_lag(db, &bytes, &seconds);
+    printf("database is a replica, lag: %ld bytes, %ld seconds\n",
+      (long) bytes, (long) seconds);
+  }
 #endif
   printf("database has ");
   switch(dbh->index_control_area_header.number_of_indexes) {
@@ -1086,6 +1307,178 @@ void segment_stats(void *db) {
   }
 }
 
+/** Print the runtime statistics counters.
+ */
+void print_stats(void *db, FILE *f) {
+  gint counters[WG_STAT_COUNT];
+  gint i, cnt;
+
+  cnt = wg_get_stats(db, counters, WG_STAT_COUNT);
+  if(cnt < 0) {
+    fprintf(f, "Runtime statistics are not enabled "\
+      "(configure with --enable-stats).\n");
+    return;
+  }
+  for(i=0; i<cnt; i++) {
+    fprintf(f, "%-20s %ld\n", wg_get_stat_name(i), (long) counters[i]);
+  }
+}
+
+/** Print the memory usage of the allocation areas.
+ *  Fragmentation is the share of free space that is not in
+ *  the largest free block.
+ */
+void print_memstat(void *db, FILE *f, int csv) {
+  db_memsegment_header *dbh = dbmemsegh(db);
+  wg_area_usage u;
+  gint i, areasize = 0;
+  char *name;
+
+  if(csv)
+    fprintf(f, "area,subareas,size,used_objects,used_bytes,"\
+      "free_objects,free_bytes,exact_bytes,var_bytes,dv_bytes,"\
+      "largest_free,fragmentation\n");
+  else
+    fprintf(f, "%-11s %4s %11s %10s %11s %11s %11s %11s %11s %10s %5s\n",
+      "area", "sub", "size", "objects", "used", "free", "exact",
+      "var", "dv", "largest", "frag");
+
+  for(i=0; (name = wg_get_area_name(i)) != NULL; i++) {
+    double frag;
+    if(wg_get_area_usage(db, i, &u)) {
+      fprintf(stderr, "Area %s is inconsistent, skipping.\n", name);
+      continue;
+    }
+    if(!u.subareas)
+      continue;
+    areasize += u.size;
+    if(!u.fixedlength && u.free_bytes)
+      frag = 1.0 - (double) u.largest_free / u.free_bytes;
+    else
+      frag = 0; /* any free fixed length object is usable */
+    if(csv)
+      fprintf(f, "%s,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%.4f\n",
+        name, (long) u.subareas, (long) u.size, (long) u.used_objects,
+        (long) u.used_bytes, (long) u.free_objects, (long) u.free_bytes,
+        (long) u.exact_bytes, (long) u.var_bytes, (long) u.dv_bytes,
+        (long) u.largest_free, frag);
+    else
+      fprintf(f, "%-11s %4ld %11ld %10ld %11ld %11ld %11ld %11ld %11ld "\
+        "%10ld %4.0f%%\n",
+        name, (long) u.subareas, (long) u.size, (long) u.used_objects,
+        (long) u.used_bytes, (long) u.free_bytes, (long) u.exact_bytes,
+        (long) u.var_bytes, (long) u.dv_bytes, (long) u.largest_free,
+        frag * 100);
+  }
+
+  if(!csv) {
+    fprintf(f, "\nsegment size: %ld\n", (long) dbh->size);
+    fprintf(f, "allocated to areas: %ld\n", (long) areasize);
+    fprintf(f, "unallocated: %ld\n", (long) (dbh->size - dbh->free));
+  }
+}
+
+#ifdef USE_LOCKSTATS
+/** Format a time value given in nanoseconds.
+ */
+static char *format_nsec(double nsec, char *buf, int buflen) {
+  if(nsec < 1000)
+    snprintf(buf, buflen, "%.0fns", nsec);
+  else if(nsec < 1000000)
+    snprintf(buf, buflen, "%.3gus", nsec/1000);
+  else if(nsec < 1000000000)
+    snprintf(buf, buflen, "%.3gms", nsec/1000000);
+  else
+    snprintf(buf, buflen, "%.3gs", nsec/1000000000);
+  return buf;
+}
+
+/** Find the upper bound (in nanoseconds) of the histogram bucket
+ *  that contains the given fraction of the values.
+ */
+static double hist_percentile(gint *hist, gint total, double frac) {
+  gint cum = 0;
+  int i;
+  for(i=0; i<WG_LOCKSTAT_BUCKETS; i++) {
+    cum += hist[i];
+    if(cum && cum >= total * frac)
+      return (double) ((gint64) 1 << (i+1));
+  }
+  return 0;
+}
+#endif
+
+/** Print the lock wait and hold time histograms.
+ */
+void print_lockstats(void *db, FILE *f, int verbose, int csv) {
+#ifdef USE_LOCKSTATS
+  db_lockstats_area *ls = &(dbmemsegh(db)->lockstats);
+  char *modes[2] = { "read", "write" };
+  char b[6][32];
+  int i, j, k;
+
+  if(csv) {
+    fprintf(f, "tag,mode,count,timeouts,spins,sleeps,bucket_ns,wait,hold\n");
+  } else {
+    fprintf(f, "%-16s %-5s %10s %8s %10s %8s  %-26s %s\n",
+      "tag", "mode", "count", "timeouts", "spins", "sleeps",
+      "wait p50/p99/max", "hold p50/p99/max");
+  }
+  for(i=0; i<WG_LOCKSTAT_TAGS; i++) {
+    if(ls->tag_used[i] != 2)
+      continue;
+    for(j=0; j<2; j++) {
+      db_lockstat_hist *h = &(ls->hist[i][j]);
+      gint holds = 0;
+      if(!h->count && !h->timeouts)
+        continue;
+      for(k=0; k<WG_LOCKSTAT_BUCKETS; k++)
+        holds += h->hold[k];
+
+      if(csv) {
+        for(k=0; k<WG_LOCKSTAT_BUCKETS; k++) {
+          if(!h->wait[k] && !h->hold[k])
+            continue;
+          fprintf(f, "%s,%s,%ld,%ld,%ld,%ld,%ld,%ld,%ld\n",
+            ls->tag_name[i], modes[j], (long) h->count, (long) h->timeouts,
+            (long) h->spins, (long) h->sleeps, (long) ((gint64) 1 << k),
+            (long) h->wait[k], (long) h->hold[k]);
+        }
+        continue;
+      }
+
+      fprintf(f, "%-16s %-5s %10ld %8ld %10ld %8ld  ",
+        ls->tag_name[i], modes[j], (long) h->count, (long) h->timeouts,
+        (long) h->spins, (long) h->sleeps);
+      snprintf(b[3], 32, "%s/%s/%s",
+        format_nsec(hist_percentile(h->wait, h->count, 0.5), b[0], 32),
+        format_nsec(hist_percentile(h->wait, h->count, 0.99), b[1], 32),
+        format_nsec(hist_percentile(h->wait, h->count, 1.0), b[2], 32));
+      fprintf(f, "%-26s ", b[3]);
+      snprintf(b[3], 32, "%s/%s/%s",
+        format_nsec(hist_percentile(h->hold, holds, 0.5), b[0], 32),
+        format_nsec(hist_percentile(h->hold, holds, 0.99), b[1], 32),
+        format_nsec(hist_percentile(h->hold, holds, 1.0), b[2], 32));
+      fprintf(f, "%s\n", b[3]);
+
+      if(verbose) {
+        for(k=0; k<WG_LOCKSTAT_BUCKETS; k++) {
+          if(!h->wait[k] && !h->hold[k])
+            continue;
+          fprintf(f, "    %8s .. %-8s wait %10ld hold %10ld\n",
+            format_nsec((double) ((gint64) 1 << k), b[4], 32),
+            format_nsec((double) ((gint64) 1 << (k+1)), b[5], 32),
+            (long) h->wait[k], (long) h->hold[k]);
+        }
+      }
+    }
+  }
+#else
+  fprintf(f, "Lock timing is not enabled "\
+    "(configure with --enable-lockstats).\n");
+#endif
+}
+
 void print_indexes(void *db, FILE *f) {
   int column;
   db_memsegment_header* dbh = dbmemsegh(db);
@@ -1125,6 +1518,10 @@ void print_indexes(void *db, FILE *f) {
             typestr[0] = '#';
             typestr[1] = 'J';
             break;
+          case WG_INDEX_TYPE_HASH_JSON_PATH:
+            typestr[0] = '#';
+            typestr[1] = 'P';
+            break;
           default:
             break;
         }
@@ -1145,6 +1542,132 @@ void print_indexes(void *db, FILE *f) {
 }
 
 
+/** Print a JSON string, escaping the characters as needed.
+ *
+ */
+static void print_json_string(FILE *f, char *str) {
+  unsigned char *c = (unsigned char *) str;
+  fputc('"', f);
+  for(; *c; c++) {
+    switch(*c) {
+      case '"':
+        fputs("\\\"", f);
+        break;
+      case '\\':
+        fputs("\\\\", f);
+        break;
+      case '\n':
+        fputs("\\n", f);
+        break;
+      case '\r':
+        fputs("\\r", f);
+        break;
+      case '\t':
+        fputs("\\t", f);
+        break;
+      default:
+        if(*c < 0x20)
+          fprintf(f, "\\u%04x", *c);
+        else
+          fputc(*c, f);
+        break;
+    }
+  }
+  fputc('"', f);
+}
+
+/** Print blob data as a JSON string.
+ *  The length is given, as the data may contain any bytes. Control
+ *  characters, non-ASCII bytes and the characters that need escaping
+ *  in JSON are url-encoded (%xx), like in the other JSON output.
+ */
+static void print_json_blob(FILE *f, char *data, gint len) {
+  unsigned char *c = (unsigned char *) data;
+  gint i;
+  fputc('"', f);
+  for(i=0; i<len; i++, c++) {
+    if(*c < 0x20 || *c > 0x7e || *c == '%' || *c == '"' || *c == '\\')
+      fprintf(f, "%%%02x", *c);
+    else
+      fputc(*c, f);
+  }
+  fputc('"', f);
+}
+
+/** Print a journal change event as a line of JSON.
+ *  Values that the journal cursor could not decode are printed
+ *  as the encoded value only.
+ */
+void print_journal_event(void *db, FILE *f, wg_journal_event *ev) {
+  char buf[256];
+
+  switch(ev->op) {
+    case WG_JOURNAL_ENTRY_CRE:
+      fprintf(f, "{\"pos\":%ld,\"op\":\"create\",\"rec\":%ld,"\
+        "\"len\":%ld}\n", (long) ev->pos, (long) ev->offset,
+        (long) ev->length);
+      return;
+    case WG_JOURNAL_ENTRY_DEL:
+      fprintf(f, "{\"pos\":%ld,\"op\":\"delete\",\"rec\":%ld}\n",
+        (long) ev->pos, (long) ev->offset);
+      return;
+    case WG_JOURNAL_ENTRY_META:
+      fprintf(f, "{\"pos\":%ld,\"op\":\"meta\",\"rec\":%ld,"\
+        "\"meta\":%ld}\n", (long) ev->pos, (long) ev->offset,
+        (long) ev->meta);
+      return;
+    default:
+      break;
+  }
+
+  fprintf(f, "{\"pos\":%ld,\"op\":\"set\",\"rec\":%ld,\"col\":%ld,"\
+    "\"enc\":%ld", (long) ev->pos, (long) ev->offset, (long) ev->column,
+    (long) ev->enc);
+  switch(ev->type) {
+    case 0:
+      break;
+    case WG_NULLTYPE:
+      fprintf(f, ",\"value\":null");
+      break;
+    case WG_RECORDTYPE:
+      fprintf(f, ",\"value\":{\"rec\":%ld}", (long) ev->intval);
+      break;
+    case WG_INTTYPE:
+      fprintf(f, ",\"value\":%ld", (long) ev->intval);
+      break;
+    case WG_DOUBLETYPE:
+      /* NaN and infinities have no JSON representation */
+      if(ev->doubleval - ev->doubleval != 0)
+        fprintf(f, ",\"value\":null");
+      else
+        fprintf(f, ",\"value\":%.15g", ev->doubleval);
+      break;
+    case WG_STRTYPE:
+    case WG_URITYPE:
+    case WG_XMLLITERALTYPE:
+    case WG_BLOBTYPE:
+      fprintf(f, ",\"value\":");
+      if(ev->type == WG_BLOBTYPE)
+        print_json_blob(f, ev->strval, ev->intval);
+      else
+        print_json_string(f, ev->strval);
+      if(ev->extstr) {
+        fprintf(f, ",\"ext\":");
+        print_json_string(f, ev->extstr);
+      }
+      break;
+    default:
+      /* immediate values, safe to decode */
+      wg_snprint_value(db, ev->enc, buf, 255);
+      buf[255] = '\0';
+      fprintf(f, ",\"value\":");
+      print_json_string(f, buf);
+      break;
+  }
+  fprintf(f, "}\n");
+}
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,10 @@ import wgdb
 import whitedb
 
 import datetime
+import os
+import tempfile
+import threading
+import time
 
 MINDBSIZE=8000000 # should cover 64-bit databases that need more memory
 
@@ -196,6 +200,30 @@ class RecordTests(LowLevelTest):
         self.assertEqual(val[0], 2)
         self.assertEqual(val[1], wgdb.VARTYPE)
 
+    def test_insert_batch(self):
+        """Tests creating several records at once."""
+
+        rec = wgdb.create_record(self.d, 1)
+        recs = wgdb.insert_batch(self.d, [
+            [1, "abc", 0.5],
+            [None, ("#x", wgdb.URITYPE, "http://unittest/")],
+            [rec, datetime.date(2014, 4, 1)]])
+        self.assertEqual(len(recs), 3)
+        self.assertEqual(wgdb.get_record_len(self.d, recs[0]), 3)
+        self.assertEqual(wgdb.get_field(self.d, recs[0], 1), "abc")
+        self.assertEqual(wgdb.get_field(self.d, recs[0], 2), 0.5)
+        self.assertEqual(wgdb.get_field(self.d, recs[1], 0), None)
+        self.assertEqual(wgdb.get_field(self.d, recs[1], 1),
+            "http://unittest/#x")
+        self.assertEqual(wgdb.get_field(self.d, recs[2], 1),
+            datetime.date(2014, 4, 1))
+        self.assertEqual(wgdb.get_record_len(self.d,
+            wgdb.get_field(self.d, recs[2], 0)), 1)
+
+        with self.assertRaises(TypeError):
+            wgdb.insert_batch(self.d, [[object()]])
+        self.assertEqual(wgdb.insert_batch(self.d, []), [])
+
 class LowLevelQueryTest(LowLevelTest):
     """Helper functions for query testing"""
 
@@ -510,6 +538,112 @@ class QueryParamTests(LowLevelQueryTest):
         self.assertEqual(wgdb.get_field(self.d, rec, 0), marker)
         self.assertIsNone(self.fetch(query))
 
+class ColumnTests(LowLevelQueryTest):
+    """Test bulk column extraction"""
+
+    def make_testdata(self):
+        for i in range(100):
+            rec = wgdb.create_record(self.d, 3)
+            wgdb.set_field(self.d, rec, 0, i)
+            wgdb.set_field(self.d, rec, 1, i * 0.5)
+            wgdb.set_field(self.d, rec, 2, datetime.date(2000, 1, 1 + i % 28))
+        rec = wgdb.create_record(self.d, 1)
+        wgdb.set_field(self.d, rec, 0, "text")
+
+    def test_fetch_columns(self):
+        """Tests extracting columns of the whole database
+        and of a query result."""
+        self.make_testdata()
+
+        cols = wgdb.fetch_columns(self.d, [0, 1, 2],
+            [wgdb.INTTYPE, wgdb.DOUBLETYPE, wgdb.DATETYPE])
+        self.assertEqual(len(cols), 3)
+        for c in cols:
+            self.assertEqual(len(c), 101)
+
+        ints = memoryview(cols[0])
+        self.assertEqual(ints.format, "q")
+        self.assertEqual(ints.tolist()[:100], list(range(100)))
+        self.assertEqual(ints[100], 0)
+        doubles = memoryview(cols[1]).tolist()
+        self.assertEqual(doubles[99], 49.5)
+        self.assertTrue(doubles[100] != doubles[100]) # NaN
+        dates = memoryview(cols[2])
+        self.assertEqual(dates.format, "i")
+        self.assertEqual(dates[100], -1)
+
+        # int column as doubles, restricted by query
+        query = wgdb.make_query(self.d,
+            arglist = [(0, wgdb.COND_LESSTHAN, 10)])
+        cols = wgdb.fetch_columns(self.d, [0], [wgdb.DOUBLETYPE], query)
+        self.assertEqual(memoryview(cols[0]).tolist(),
+            [float(i) for i in range(10)])
+        self.assertEqual(self.fetch(query), None)
+
+        with self.assertRaises(TypeError):
+            wgdb.fetch_columns(self.d, [0], [wgdb.STRTYPE])
+
+class DumpTests(LowLevelTest):
+    """Test dumping and importing"""
+
+    def test_dump(self):
+        """Tests that a dumped database is restored by import."""
+        rec = wgdb.create_record(self.d, 2)
+        wgdb.set_field(self.d, rec, 0, "hello")
+        wgdb.set_field(self.d, rec, 1, 12345)
+
+        fname = tempfile.mktemp()
+        try:
+            wgdb.dump(self.d, fname)
+            d2 = wgdb.attach_database(size=MINDBSIZE, local=1)
+            try:
+                wgdb.import_dump(d2, fname)
+                rec = wgdb.get_first_record(d2)
+                self.assertEqual(wgdb.get_field(d2, rec, 0), "hello")
+                self.assertEqual(wgdb.get_field(d2, rec, 1), 12345)
+            finally:
+                wgdb.detach_database(d2)
+        finally:
+            os.remove(fname)
+
+        with self.assertRaises(wgdb.error):
+            wgdb.import_dump(self.d, fname)
+
+class ThreadTests(LowLevelTest):
+    """Test sharing a database between Python threads"""
+
+    def test_locking(self):
+        """Tests that threads blocked on the database lock
+        do not block each other in the interpreter."""
+        lock_id = wgdb.start_write(self.d)
+        done = []
+
+        def writer():
+            l = wgdb.start_write(self.d)
+            rec = wgdb.create_record(self.d, 1)
+            wgdb.set_field(self.d, rec, 0, len(done))
+            done.append(1)
+            wgdb.end_write(self.d, l)
+
+        threads = [threading.Thread(target=writer) for i in range(4)]
+        for t in threads:
+            t.start()
+
+        # the other threads are waiting for the lock now, this
+        # thread still needs to be able to run.
+        time.sleep(0.1)
+        self.assertEqual(len(done), 0)
+        with self.assertRaises(wgdb.error):
+            wgdb.detach_database(self.d)
+        wgdb.end_write(self.d, lock_id)
+
+        for t in threads:
+            t.join()
+        self.assertEqual(len(done), 4)
+
+        query = wgdb.make_query(self.d)
+        self.assertEqual(query.res_count, 4)
+
 class WhiteDBTest(unittest.TestCase):
     """Provide setUp()/tearDown() for test cases that
     use the WhiteDB module API."""
@@ -548,9 +682,19 @@ class WhiteDBConnection(WhiteDBTest):
         rec = self.d.insert([0, 0, 0])
         self.assertTrue(isinstance(rec, whitedb.Record))
 
+        recs = self.d.insert_many([[1, 2], [rec, ("x", wgdb.CHARTYPE)]])
+        self.assertEqual(len(recs), 2)
+        self.assertTrue(isinstance(recs[1], whitedb.Record))
+        self.assertEqual(self.d.get_field(recs[0], 1), 2)
+        self.assertTrue(isinstance(self.d.get_field(recs[1], 0),
+            whitedb.Record))
+
         with self.assertRaises(whitedb.DataError):
             self.d.insert([])
 
+        with self.assertRaises(whitedb.DataError):
+            self.d.insert_many([[1], []])
+
         with self.assertRaises(whitedb.DataError):
             self.d.create_record(-3)
 
@@ -56,6 +56,7 @@ typedef struct {
   PyObject_HEAD
   void *db;
   int local;
+  int busy;       /** number of calls running without the GIL */
 } wg_database;
 
 typedef struct {
@@ -71,8 +72,32 @@ typedef struct {
   int argc;
   void *matchrec;
   int reclen;
+  int busy;       /** set while wg_fetch() runs without the GIL */
 } wg_query_ob;  /* append _ob to avoid name clash with dbapi.h */
 
+typedef struct {
+  PyObject_HEAD
+  char *data;         /** contiguous array of values */
+  Py_ssize_t len;     /** number of values */
+  Py_ssize_t cap;     /** number of values allocated */
+  Py_ssize_t itemsize;
+  char *format;       /** struct module style format of a single value */
+  wg_int wgtype;      /** wgdb type the column was extracted as */
+} wg_column;
+
+/* Thread safety model:
+ * Calls that may block on the database lock or run for a long time
+ * (lock acquisition, query construction, fetching, dump/import and
+ * journal replay) release the GIL. A wg_database object may be shared
+ * between Python threads; concurrency between them is controlled with
+ * start_read()/start_write() as usual. The busy counter, which is only
+ * modified while holding the GIL, prevents detaching the database while
+ * another thread is still inside such a call. A query object may only
+ * be fetched from one thread at a time.
+ */
+#define BEGIN_DB_CALL(dbob) (dbob)->busy++; Py_BEGIN_ALLOW_THREADS
+#define END_DB_CALL(dbob) Py_END_ALLOW_THREADS (dbob)->busy--;
+
 
 /* ======= Private protos ================ */
 
@@ -120,6 +145,10 @@ static PyObject *wgdb_set_field(PyObject *self, PyObject *args,
                                         PyObject *kwds);
 static PyObject *wgdb_set_new_field(PyObject *self, PyObject *args,
                                         PyObject *kwds);
+static char *batch_string(PyObject *data, PyObject *keep);
+static int pyobject_to_batch_value(wg_database *db, PyObject *obj,
+  wg_batch_value *val, PyObject *keep);
+static PyObject *wgdb_insert_batch(PyObject *self, PyObject *args);
 static PyObject *wgdb_get_field(PyObject *self, PyObject *args);
 
 static PyObject *wgdb_start_write(PyObject *self, PyObject *args);
@@ -127,6 +156,10 @@ static PyObject *wgdb_end_write(PyObject *self, PyObject *args);
 static PyObject *wgdb_start_read(PyObject *self, PyObject *args);
 static PyObject *wgdb_end_read(PyObject *self, PyObject *args);
 
+static PyObject *wgdb_dump(PyObject *self, PyObject *args);
+static PyObject *wgdb_import_dump(PyObject *self, PyObject *args);
+static PyObject *wgdb_replay_log(PyObject *self, PyObject *args);
+
 static int parse_query_params(PyObject *self, PyObject *args,
                                     PyObject *kwds, wg_query_ob *query);
 static PyObject * wgdb_make_query(PyObject *self, PyObject *args,
@@ -135,11 +168,21 @@ static PyObject * wgdb_fetch(PyObject *self, PyObject *args);
 static PyObject * wgdb_free_query(PyObject *self, PyObject *args);
 static void free_query(wg_query_ob *obj);
 
+static PyObject * wgdb_fetch_columns(PyObject *self, PyObject *args,
+                                        PyObject *kwds);
+static int init_column(wg_column *col, wg_int wgtype, Py_ssize_t cap);
+static int grow_column(wg_column *col, Py_ssize_t cap);
+static void store_column_value(void *db, wg_column *col, wg_int enc);
+
 static void wg_database_dealloc(wg_database *obj);
 static void wg_query_dealloc(wg_query_ob *obj);
+static void wg_column_dealloc(wg_column *obj);
+static Py_ssize_t wg_column_length(wg_column *obj);
+static int wg_column_getbuffer(wg_column *obj, Py_buffer *view, int flags);
 static PyObject *wg_database_repr(wg_database *obj);
 static PyObject *wg_record_repr(wg_record *obj);
 static PyObject *wg_query_repr(wg_query_ob *obj);
+static PyObject *wg_column_repr(wg_column *obj);
 static PyObject *wg_query_get_res_count(wg_query_ob *obj, void *closure);
 static int wg_query_set_res_count(wg_query_ob *obj,
                                       PyObject *value, void *closure);
@@ -261,6 +304,58 @@ static PyTypeObject wg_query_type = {
   wg_query_getset,              /* tp_getset */
 };
 
+/** Sequence methods of the Column type. Only length is supported,
+ *  the contents are accessed through the buffer interface. */
+static PySequenceMethods wg_column_as_sequence = {
+  (lenfunc) wg_column_length,   /* sq_length */
+};
+
+/** Buffer interface of the Column type */
+static PyBufferProcs wg_column_as_buffer = {
+#ifndef PYTHON3
+  0,                            /* bf_getreadbuffer */
+  0,                            /* bf_getwritebuffer */
+  0,                            /* bf_getsegcount */
+  0,                            /* bf_getcharbuffer */
+#endif
+  (getbufferproc) wg_column_getbuffer, /* bf_getbuffer */
+  0,                            /* bf_releasebuffer */
+};
+
+/** Column object type */
+static PyTypeObject wg_column_type = {
+#ifndef PYTHON3
+  PyObject_HEAD_INIT(NULL)
+  0,                            /*ob_size*/
+#else
+  PyVarObject_HEAD_INIT(NULL, 0)
+#endif
+  "wgdb.Column",                /*tp_name*/
+  sizeof(wg_column),            /*tp_basicsize*/
+  0,                            /*tp_itemsize*/
+  (destructor) wg_column_dealloc, /*tp_dealloc*/
+  0,                            /*tp_print*/
+  0,                            /*tp_getattr*/
+  0,                            /*tp_setattr*/
+  0,                            /*tp_compare*/
+  (reprfunc) wg_column_repr,    /*tp_repr*/
+  0,                            /*tp_as_number*/
+  &wg_column_as_sequence,       /*tp_as_sequence*/
+  0,                            /*tp_as_mapping*/
+  0,                            /*tp_hash */
+  0,                            /*tp_call*/
+  (reprfunc) wg_column_repr,    /*tp_str*/
+  0,                            /*tp_getattro*/
+  0,                            /*tp_setattro*/
+  &wg_column_as_buffer,         /*tp_as_buffer*/
+#ifndef PYTHON3
+  Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /*tp_flags*/
+#else
+  Py_TPFLAGS_DEFAULT,           /*tp_flags*/
+#endif
+  "WhiteDB column data",        /* tp_doc */
+};
+
 /** Method table */
 static PyMethodDef wgdb_methods[] = {
   {"attach_database",  (PyCFunction) wgdb_attach_database,
@@ -295,6 +390,8 @@ static PyMethodDef wgdb_methods[] = {
   {"set_new_field",  (PyCFunction) wgdb_set_new_field,
    METH_VARARGS | METH_KEYWORDS,
    "Set field value (assumes no previous content)."},
+  {"insert_batch",  wgdb_insert_batch, METH_VARARGS,
+   "Create several records from a sequence of rows."},
   {"get_field",  wgdb_get_field, METH_VARARGS,
    "Get field data decoded to corresponding Python type."},
   {"start_write",  wgdb_start_write, METH_VARARGS,
@@ -305,6 +402,12 @@ static PyMethodDef wgdb_methods[] = {
    "Start reading transaction."},
   {"end_read",  wgdb_end_read, METH_VARARGS,
    "Finish reading transaction."},
+  {"dump",  wgdb_dump, METH_VARARGS,
+   "Dump the database to a file."},
+  {"import_dump",  wgdb_import_dump, METH_VARARGS,
+   "Import the database from a dump file."},
+  {"replay_log",  wgdb_replay_log, METH_VARARGS,
+   "Restore the database from a journal file."},
   {"make_query",  (PyCFunction) wgdb_make_query,
    METH_VARARGS | METH_KEYWORDS,
    "Create a query object."},
@@ -312,6 +415,9 @@ static PyMethodDef wgdb_methods[] = {
    "Fetch next record from a query."},
   {"free_query",  wgdb_free_query, METH_VARARGS,
    "Unallocates the memory (local and shared) used by the query."},
+  {"fetch_columns",  (PyCFunction) wgdb_fetch_columns,
+   METH_VARARGS | METH_KEYWORDS,
+   "Extract columns of all rows (or query results) into typed arrays."},
   {NULL, NULL, 0, NULL} /* terminator */
 };
 
@@ -440,6 +546,11 @@ static PyObject * wgdb_detach_database(PyObject *self, PyObject *args) {
   if(!PyArg_ParseTuple(args, "O!", &wg_database_type, &db))
     return NULL;
 
+  if(((wg_database *) db)->busy) {
+    wgdb_error_setstring(self, "Database is in use by another thread.");
+    return NULL;
+  }
+
   /* Only try detaching if we have a valid pointer. */
   if(((wg_database *) db)->db) {
     if(((wg_database *) db)->local) {
@@ -1185,6 +1296,241 @@ static PyObject *wgdb_set_new_field(PyObject *self, PyObject *args,
   return Py_None;
 }
 
+/** Convert a Python string to a C string for insert_batch().
+ *  In Python 3, the encoded bytes object is appended to keep, so
+ *  that the string stays valid until the batch is written.
+ *  returns NULL on failure (Python error is set)
+ */
+static char *batch_string(PyObject *data, PyObject *keep) {
+#ifndef PYTHON3
+  return PyString_AsString(data);
+#else
+  PyObject *bytes;
+#ifdef HAVE_LOCALEENC
+  bytes = PyUnicode_EncodeLocale(data, ENCODEERR);
+#else
+  bytes = PyUnicode_AsEncodedString(data, NULL, ENCODEERR);
+#endif
+  if(!bytes)
+    return NULL;
+  if(PyList_Append(keep, bytes)) {
+    Py_DECREF(bytes);
+    return NULL;
+  }
+  Py_DECREF(bytes); /* keep holds the reference */
+  return PyBytes_AsString(bytes);
+#endif
+}
+
+/** Convert Python object to a typed value for wg_insert_batch().
+ *  Accepts the same immediate values and (value, ftype, ext_str)
+ *  tuples as encode_pyobject_ext().
+ *  returns 0 on success, -1 on failure (Python error is set)
+ */
+static int pyobject_to_batch_value(wg_database *db, PyObject *obj,
+  wg_batch_value *val, PyObject *keep) {
+  PyObject *data;
+  wg_int ftype = 0;
+  char *s;
+
+  memset(val, 0, sizeof(wg_batch_value));
+  if(PyTuple_Check(obj)) {
+    int extargs = PyTuple_Size(obj);
+    if(extargs<1 || extargs>3) {
+      PyErr_SetString(PyExc_ValueError,
+        "Values with extended type info must be 2/3-tuples.");
+      return -1;
+    }
+    data = PyTuple_GetItem(obj, 0);
+    if(extargs > 1) {
+#ifndef PYTHON3
+      ftype = (wg_int) PyInt_AsLong(PyTuple_GetItem(obj, 1));
+#else
+      ftype = (wg_int) PyLong_AsLong(PyTuple_GetItem(obj, 1));
+#endif
+      if(ftype<0) {
+        PyErr_SetString(PyExc_ValueError,
+          "Invalid field type for value.");
+        return -1;
+      }
+    }
+    if(extargs > 2) {
+      val->ext = batch_string(PyTuple_GetItem(obj, 2), keep);
+      if(!val->ext)
+        return -1;
+    }
+  } else {
+    data = obj;
+  }
+
+  ftype = pytype_to_wgtype(data, ftype);
+  if(ftype == -1) {
+    PyErr_SetString(PyExc_TypeError,
+      "Requested encoding is not supported.");
+    return -1;
+  }
+  else if(ftype == -2) {
+    PyErr_SetString(PyExc_TypeError,
+      "Value is of unsupported type.");
+    return -1;
+  }
+  val->type = ftype;
+
+  switch(ftype) {
+    case WG_NULLTYPE:
+      break;
+    case WG_RECORDTYPE:
+      val->v.rec = ((wg_record *) data)->rec;
+      break;
+    case WG_INTTYPE:
+    case WG_VARTYPE:
+#ifndef PYTHON3
+      val->v.i = (wg_int) PyInt_AsLong(data);
+#else
+      val->v.i = (wg_int) PyLong_AsLong(data);
+#endif
+      break;
+    case WG_DOUBLETYPE:
+    case WG_FIXPOINTTYPE:
+      val->v.d = (double) PyFloat_AsDouble(data);
+      break;
+    case WG_STRTYPE:
+    case WG_URITYPE:
+    case WG_XMLLITERALTYPE:
+      val->v.s = batch_string(data, keep);
+      if(!val->v.s)
+        return -1;
+      break;
+    case WG_CHARTYPE:
+      s = batch_string(data, keep);
+      if(!s)
+        return -1;
+      val->v.c = s[0];
+      break;
+    case WG_DATETYPE:
+      val->v.i = wg_ymd_to_date(db->db,
+        PyDateTime_GET_YEAR(data),
+        PyDateTime_GET_MONTH(data),
+        PyDateTime_GET_DAY(data));
+      if(val->v.i <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Invalid date value.");
+        return -1;
+      }
+      break;
+    case WG_TIMETYPE:
+      val->v.i = wg_hms_to_time(db->db,
+        PyDateTime_TIME_GET_HOUR(data),
+        PyDateTime_TIME_GET_MINUTE(data),
+        PyDateTime_TIME_GET_SECOND(data),
+        PyDateTime_TIME_GET_MICROSECOND(data)/10000);
+      if(val->v.i < 0) {
+        PyErr_SetString(PyExc_ValueError, "Invalid time value.");
+        return -1;
+      }
+      break;
+    default:
+      break;
+  }
+  return 0;
+}
+
+/** Insert several records at once.
+ *  Python wrapper to wg_insert_batch(). rows is a sequence of
+ *  sequences of field values. Values are either immediate Python
+ *  values or (value, ftype, ext_str) tuples, as with query arguments.
+ *  Returns a list of the created records. The caller should hold
+ *  the write lock.
+ */
+static PyObject *wgdb_insert_batch(PyObject *self, PyObject *args) {
+  PyObject *db = NULL, *rows = NULL, *rowseq = NULL, *keep = NULL;
+  PyObject **rowitems = NULL, *result = NULL;
+  Py_ssize_t rowcount = 0, total = 0, i, j;
+  wg_int *rowlen = NULL, err;
+  wg_batch_value *values = NULL, *val;
+  void **recs = NULL;
+
+  if(!PyArg_ParseTuple(args, "O!O", &wg_database_type, &db, &rows))
+    return NULL;
+
+  rowseq = PySequence_Fast(rows, "rows must be a sequence");
+  if(!rowseq)
+    return NULL;
+  rowcount = PySequence_Fast_GET_SIZE(rowseq);
+
+  keep = PyList_New(0);
+  rowitems = (PyObject **) calloc(rowcount ? rowcount : 1,
+    sizeof(PyObject *));
+  rowlen = (wg_int *) malloc((rowcount ? rowcount : 1) * sizeof(wg_int));
+  recs = (void **) malloc((rowcount ? rowcount : 1) * sizeof(void *));
+  if(!keep || !rowitems || !rowlen || !recs) {
+    PyErr_NoMemory();
+    goto done;
+  }
+
+  /* First pass: count the values */
+  for(i=0; i<rowcount; i++) {
+    rowitems[i] = PySequence_Fast(PySequence_Fast_GET_ITEM(rowseq, i),
+      "each row must be a sequence");
+    if(!rowitems[i])
+      goto done;
+    rowlen[i] = PySequence_Fast_GET_SIZE(rowitems[i]);
+    total += rowlen[i];
+  }
+
+  values = (wg_batch_value *) malloc((total ? total : 1) *\
+    sizeof(wg_batch_value));
+  if(!values) {
+    PyErr_NoMemory();
+    goto done;
+  }
+
+  /* Second pass: convert the values */
+  val = values;
+  for(i=0; i<rowcount; i++) {
+    for(j=0; j<rowlen[i]; j++, val++) {
+      if(pyobject_to_batch_value((wg_database *) db,
+        PySequence_Fast_GET_ITEM(rowitems[i], j), val, keep))
+        goto done;
+    }
+  }
+
+  BEGIN_DB_CALL((wg_database *) db)
+  err = wg_insert_batch(((wg_database *) db)->db, rowcount, rowlen,
+    values, recs);
+  END_DB_CALL((wg_database *) db)
+  if(err < 0) {
+    wgdb_error_setstring(self, "Failed to insert records.");
+    goto done;
+  }
+
+  result = PyList_New(rowcount);
+  if(!result)
+    goto done;
+  for(i=0; i<rowcount; i++) {
+    wg_record *rec = (wg_record *) wg_record_type.tp_alloc(&wg_record_type, 0);
+    if(!rec) {
+      Py_DECREF(result);
+      result = NULL;
+      goto done;
+    }
+    rec->rec = recs[i];
+    PyList_SET_ITEM(result, i, (PyObject *) rec);
+  }
+
+done:
+  if(rowitems) {
+    for(i=0; i<rowcount; i++)
+      Py_XDECREF(rowitems[i]);
+    free(rowitems);
+  }
+  if(rowlen) free(rowlen);
+  if(values) free(values);
+  if(recs) free(recs);
+  Py_XDECREF(keep);
+  Py_DECREF(rowseq);
+  return result;
+}
+
 /** Get decoded field value.
  *  Currently supported types:
  *   NULL - Python None
@@ -1339,7 +1685,10 @@ static PyObject * wgdb_start_write(PyObject *self, PyObject *args) {
   if(!PyArg_ParseTuple(args, "O!", &wg_database_type, &db))
     return NULL;
 
+  /* Waiting for the lock should not stall other Python threads */
+  BEGIN_DB_CALL((wg_database *) db)
   lock_id = wg_start_write(((wg_database *) db)->db);
+  END_DB_CALL((wg_database *) db)
   if(!lock_id) {
     wgdb_error_setstring(self, "Failed to acquire write lock.");
     return NULL;
@@ -1381,7 +1730,10 @@ static PyObject * wgdb_start_read(PyObject *self, PyObject *args) {
   if(!PyArg_ParseTuple(args, "O!", &wg_database_type, &db))
     return NULL;
 
+  /* Waiting for the lock should not stall other Python threads */
+  BEGIN_DB_CALL((wg_database *) db)
   lock_id = wg_start_read(((wg_database *) db)->db);
+  END_DB_CALL((wg_database *) db)
   if(!lock_id) {
     wgdb_error_setstring(self, "Failed to acquire read lock.");
     return NULL;
@@ -1411,6 +1763,104 @@ static PyObject * wgdb_end_read(PyObject *self, PyObject *args) {
   return Py_None;
 }
 
+/* Functions for dumping, importing and journal replay. These may
+ * take a long time with large databases, so they run without the GIL.
+ */
+
+/** Dump the database to a file.
+ *  Python wrapper to wg_dump()
+ *  Locking is handled internally by wg_dump().
+ */
+
+static PyObject * wgdb_dump(PyObject *self, PyObject *args) {
+  PyObject *db = NULL;
+  char *filename = NULL;
+  wg_int err = 0;
+
+  if(!PyArg_ParseTuple(args, "O!s", &wg_database_type, &db, &filename))
+    return NULL;
+
+  BEGIN_DB_CALL((wg_database *) db)
+  err = wg_dump(((wg_database *) db)->db, filename);
+  END_DB_CALL((wg_database *) db)
+  if(err) {
+    wgdb_error_setstring(self, "Failed to dump the database.");
+    return NULL;
+  }
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+/** Import the database from a dump file.
+ *  Python wrapper to wg_import_dump()
+ *  Locking is handled internally by wg_import_dump(). The existing
+ *  contents of the database are replaced.
+ */
+
+static PyObject * wgdb_import_dump(PyObject *self, PyObject *args) {
+  PyObject *db = NULL;
+  char *filename = NULL;
+  wg_int err = 0;
+
+  if(!PyArg_ParseTuple(args, "O!s", &wg_database_type, &db, &filename))
+    return NULL;
+
+  BEGIN_DB_CALL((wg_database *) db)
+  err = wg_import_dump(((wg_database *) db)->db, filename);
+  END_DB_CALL((wg_database *) db)
+  if(err < -1) {
+    wgdb_error_setstring(self,
+      "Fatal error when importing, database may have become corrupt.");
+    return NULL;
+  }
+  else if(err) {
+    wgdb_error_setstring(self, "Failed to import the database.");
+    return NULL;
+  }
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
+/** Restore the database from a journal file.
+ *  Python wrapper to wg_replay_log()
+ *  The write lock is held for the duration of the replay.
+ */
+
+static PyObject * wgdb_replay_log(PyObject *self, PyObject *args) {
+  PyObject *db = NULL;
+  char *filename = NULL;
+  wg_int lock_id = 0, err = 0;
+
+  if(!PyArg_ParseTuple(args, "O!s", &wg_database_type, &db, &filename))
+    return NULL;
+
+  BEGIN_DB_CALL((wg_database *) db)
+  lock_id = wg_start_write(((wg_database *) db)->db);
+  if(lock_id) {
+    err = wg_replay_log(((wg_database *) db)->db, filename);
+    wg_end_write(((wg_database *) db)->db, lock_id);
+  }
+  END_DB_CALL((wg_database *) db)
+  if(!lock_id) {
+    wgdb_error_setstring(self, "Failed to acquire write lock.");
+    return NULL;
+  }
+  else if(err < -1) {
+    wgdb_error_setstring(self,
+      "Fatal error when replaying, database may have become corrupt.");
+    return NULL;
+  }
+  else if(err) {
+    wgdb_error_setstring(self, "Failed to replay the journal.");
+    return NULL;
+  }
+
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
 /* Functions to create and fetch data from queries.
  * The query object defined on wgdb module level stores both
  * the pointer to the query and all the encoded parameters -
@@ -1578,6 +2028,7 @@ static PyObject * wgdb_make_query(PyObject *self, PyObject *args,
   query->argc = 0;
   query->matchrec = NULL;
   query->reclen = 0;
+  query->busy = 0;
 
   /* Create the arglist and matchrec from parameters. */
   if(!parse_query_params(self, args, kwds, query)) {
@@ -1585,8 +2036,11 @@ static PyObject * wgdb_make_query(PyObject *self, PyObject *args,
     return NULL;
   }
 
+  /* Building the query may scan the whole database. */
+  BEGIN_DB_CALL(query->db)
   query->query = wg_make_query(query->db->db, query->matchrec, query->reclen,
     query->arglist, query->argc);
+  END_DB_CALL(query->db)
 
   if(!query->query) {
     wgdb_error_setstring(self, "Failed to create the query.");
@@ -1609,12 +2063,22 @@ static PyObject * wgdb_fetch(PyObject *self, PyObject *args) {
       &wg_query_type, &query))
     return NULL;
 
+  if(((wg_query_ob *) query)->busy) {
+    wgdb_error_setstring(self, "Query is in use by another thread.");
+    return NULL;
+  }
+
   /* Build a new record object */
   rec = (wg_record *) wg_record_type.tp_alloc(&wg_record_type, 0);
   if(!rec) return NULL;
 
+  /* Scanning for the next matching row may take a while. */
+  ((wg_query_ob *) query)->busy = 1;
+  BEGIN_DB_CALL((wg_database *) db)
   rec->rec = wg_fetch(((wg_database *) db)->db,
     ((wg_query_ob *) query)->query);
+  END_DB_CALL((wg_database *) db)
+  ((wg_query_ob *) query)->busy = 0;
   if(!rec->rec) {
     wgdb_error_setstring(self, "Failed to fetch a record.");
     wg_record_type.tp_free(rec);
@@ -1643,6 +2107,10 @@ static PyObject * wgdb_free_query(PyObject *self, PyObject *args) {
    * for consistency between the API-s and possible future
    * extensions).
    */
+  if(((wg_query_ob *) query)->busy) {
+    wgdb_error_setstring(self, "Query is in use by another thread.");
+    return NULL;
+  }
   free_query((wg_query_ob *) query);
   Py_INCREF(Py_None);
   return Py_None;
@@ -1689,6 +2157,246 @@ static void free_query(wg_query_ob *obj) {
   }
 }
 
+/* Bulk extraction of column data. The values are decoded in
+ * a single C loop into contiguous arrays that are made available
+ * to Python through the buffer interface (for example, NumPy
+ * can use them directly with numpy.frombuffer()).
+ */
+
+/** Extract columns into typed arrays.
+ *  columns is a sequence of column numbers, types a sequence of
+ *  wgdb types of the same length. Supported types:
+ *   INTTYPE - 64-bit integers, non-integer fields become 0
+ *   DOUBLETYPE - doubles, int and fixpoint fields are converted,
+ *     other fields become NaN
+ *   DATETYPE, TIMETYPE - 32-bit integers, other fields become -1
+ *  If a query is given, the remaining rows are fetched from it,
+ *  otherwise all records in the database are scanned.
+ *  Returns a tuple of Column objects.
+ */
+
+static PyObject * wgdb_fetch_columns(PyObject *self, PyObject *args,
+                                        PyObject *kwds) {
+  PyObject *db = NULL, *columns = NULL, *types = NULL, *query = NULL;
+  PyObject *res = NULL;
+  wg_column **cols = NULL;
+  wg_int *colnr = NULL;
+  Py_ssize_t i, ncols, cap = 1024;
+  void *rec;
+  int err = 0;
+  static char *kwlist[] = {"db", "columns", "types", "query", NULL};
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O!OO|O", kwlist,
+      &wg_database_type, &db, &columns, &types, &query))
+    return NULL;
+
+  if(query == Py_None)
+    query = NULL;
+  if(query && !PyObject_TypeCheck(query, &wg_query_type)) {
+    PyErr_SetString(PyExc_TypeError, "query must be a wgdb.Query");
+    return NULL;
+  }
+  if(!PySequence_Check(columns) || !PySequence_Check(types)) {
+    PyErr_SetString(PyExc_TypeError,
+      "columns and types must be sequences.");
+    return NULL;
+  }
+  ncols = PySequence_Size(columns);
+  if(ncols < 1 || PySequence_Size(types) != ncols) {
+    PyErr_SetString(PyExc_ValueError,
+      "columns and types must be non-empty and of equal length.");
+    return NULL;
+  }
+  if(query) {
+    wg_query_ob *q = (wg_query_ob *) query;
+    if(!q->query) {
+      PyErr_SetString(PyExc_ValueError, "Invalid query object");
+      return NULL;
+    }
+    if(q->busy) {
+      wgdb_error_setstring(self, "Query is in use by another thread.");
+      return NULL;
+    }
+    if(q->query->qtype == WG_QTYPE_PREFETCH && q->query->res_count > 0)
+      cap = (Py_ssize_t) q->query->res_count;
+  }
+
+  res = PyTuple_New(ncols);
+  colnr = (wg_int *) malloc(ncols * sizeof(wg_int));
+  cols = (wg_column **) malloc(ncols * sizeof(wg_column *));
+  if(!res || !colnr || !cols) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+
+  for(i=0; i<ncols; i++) {
+    PyObject *c = PySequence_GetItem(columns, i);
+    PyObject *t = PySequence_GetItem(types, i);
+    wg_int wgtype;
+    if(!c || !t) {
+      Py_XDECREF(c);
+      Py_XDECREF(t);
+      goto fail;
+    }
+#ifndef PYTHON3
+    colnr[i] = (wg_int) PyInt_AsLong(c);
+    wgtype = (wg_int) PyInt_AsLong(t);
+#else
+    colnr[i] = (wg_int) PyLong_AsLong(c);
+    wgtype = (wg_int) PyLong_AsLong(t);
+#endif
+    Py_DECREF(c);
+    Py_DECREF(t);
+    if(PyErr_Occurred())
+      goto fail;
+    if(colnr[i] < 0) {
+      PyErr_SetString(PyExc_ValueError, "Invalid column number.");
+      goto fail;
+    }
+
+    cols[i] = (wg_column *) wg_column_type.tp_alloc(&wg_column_type, 0);
+    if(!cols[i])
+      goto fail;
+    PyTuple_SET_ITEM(res, i, (PyObject *) cols[i]); /* steals reference */
+    if(init_column(cols[i], wgtype, cap))
+      goto fail;
+  }
+
+  /* The main loop runs without the GIL. Only C memory is touched
+   * here, Python errors are raised after the loop. */
+  if(query)
+    ((wg_query_ob *) query)->busy = 1;
+  BEGIN_DB_CALL((wg_database *) db)
+  if(query)
+    rec = wg_fetch(((wg_database *) db)->db, ((wg_query_ob *) query)->query);
+  else
+    rec = wg_get_first_record(((wg_database *) db)->db);
+  while(rec) {
+    wg_int reclen = wg_get_record_len(((wg_database *) db)->db, rec);
+    for(i=0; i<ncols; i++) {
+      wg_column *col = cols[i];
+      wg_int enc = 0;
+      if(col->len == col->cap && grow_column(col, 2*col->cap)) {
+        err = 1;
+        break;
+      }
+      if(colnr[i] < reclen)
+        enc = wg_get_field(((wg_database *) db)->db, rec, colnr[i]);
+      store_column_value(((wg_database *) db)->db, col, enc);
+    }
+    if(err)
+      break;
+    if(query)
+      rec = wg_fetch(((wg_database *) db)->db,
+        ((wg_query_ob *) query)->query);
+    else
+      rec = wg_get_next_record(((wg_database *) db)->db, rec);
+  }
+  END_DB_CALL((wg_database *) db)
+  if(query)
+    ((wg_query_ob *) query)->busy = 0;
+
+  if(err) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+
+  free(colnr);
+  free(cols);
+  return res;
+
+fail:
+  Py_XDECREF(res); /* also frees the columns */
+  if(colnr) free(colnr);
+  if(cols) free(cols);
+  return NULL;
+}
+
+/** Set up the column storage for a given wgdb type.
+ *  returns 0 on success.
+ *  returns -1 and sets a Python exception on failure.
+ */
+static int init_column(wg_column *col, wg_int wgtype, Py_ssize_t cap) {
+  switch(wgtype) {
+    case WG_INTTYPE:
+      col->itemsize = sizeof(PY_LONG_LONG);
+      col->format = "q";
+      break;
+    case WG_DOUBLETYPE:
+      col->itemsize = sizeof(double);
+      col->format = "d";
+      break;
+    case WG_DATETYPE:
+    case WG_TIMETYPE:
+      col->itemsize = sizeof(int);
+      col->format = "i";
+      break;
+    default:
+      PyErr_SetString(PyExc_TypeError,
+        "Column type must be one of INTTYPE, DOUBLETYPE, DATETYPE, TIMETYPE.");
+      return -1;
+  }
+  col->wgtype = wgtype;
+  col->len = 0;
+  col->cap = 0;
+  col->data = NULL;
+  if(grow_column(col, cap)) {
+    PyErr_NoMemory();
+    return -1;
+  }
+  return 0;
+}
+
+/** Resize the column storage.
+ *  Does not use the Python API, so this is safe to call without the GIL.
+ *  returns 0 on success, -1 on failure.
+ */
+static int grow_column(wg_column *col, Py_ssize_t cap) {
+  char *tmp = (char *) realloc(col->data, cap * col->itemsize);
+  if(!tmp)
+    return -1;
+  col->data = tmp;
+  col->cap = cap;
+  return 0;
+}
+
+/** Decode a value and append it to the column.
+ *  Does not use the Python API, so this is safe to call without the GIL.
+ *  The caller guarantees that there is room for one more value.
+ */
+static void store_column_value(void *db, wg_column *col, wg_int enc) {
+  wg_int enctype = (enc ? wg_get_encoded_type(db, enc) : WG_NULLTYPE);
+  char *dest = col->data + col->len * col->itemsize;
+
+  switch(col->wgtype) {
+    case WG_INTTYPE:
+      *((PY_LONG_LONG *) dest) = (enctype == WG_INTTYPE ?
+        (PY_LONG_LONG) wg_decode_int(db, enc) : 0);
+      break;
+    case WG_DOUBLETYPE:
+      if(enctype == WG_DOUBLETYPE)
+        *((double *) dest) = wg_decode_double(db, enc);
+      else if(enctype == WG_INTTYPE)
+        *((double *) dest) = (double) wg_decode_int(db, enc);
+      else if(enctype == WG_FIXPOINTTYPE)
+        *((double *) dest) = wg_decode_fixpoint(db, enc);
+      else
+        *((double *) dest) = Py_NAN;
+      break;
+    case WG_DATETYPE:
+      *((int *) dest) = (enctype == WG_DATETYPE ?
+        wg_decode_date(db, enc) : -1);
+      break;
+    case WG_TIMETYPE:
+      *((int *) dest) = (enctype == WG_TIMETYPE ?
+        wg_decode_time(db, enc) : -1);
+      break;
+    default:
+      break;
+  }
+  col->len++;
+}
+
 /* Methods for data types defined by this module.
  */
 
@@ -1721,6 +2429,43 @@ static void wg_query_dealloc(wg_query_ob *obj) {
 #endif
 }
 
+/** Column object desctructor.
+ * Frees the local array.
+ */
+static void wg_column_dealloc(wg_column *obj) {
+  if(obj->data)
+    free(obj->data);
+#ifndef PYTHON3
+  obj->ob_type->tp_free((PyObject *) obj);
+#else
+  Py_TYPE(obj)->tp_free((PyObject *) obj);
+#endif
+}
+
+/** Number of values in the column.
+ */
+static Py_ssize_t wg_column_length(wg_column *obj) {
+  return obj->len;
+}
+
+/** Expose the column as a read-only one-dimensional buffer.
+ */
+static int wg_column_getbuffer(wg_column *obj, Py_buffer *view, int flags) {
+  if(PyBuffer_FillInfo(view, (PyObject *) obj, obj->data,
+      obj->len * obj->itemsize, 1, flags))
+    return -1;
+  view->itemsize = obj->itemsize;
+  if(flags & PyBUF_FORMAT)
+    view->format = obj->format;
+  if(flags & PyBUF_ND) {
+    view->ndim = 1;
+    view->shape = &obj->len;
+  }
+  if(flags & PyBUF_STRIDES)
+    view->strides = &obj->itemsize;
+  return 0;
+}
+
 /** String representation of database object. This is used for both
  * repr() and str()
  */
@@ -1765,6 +2510,18 @@ static PyObject *wg_query_repr(wg_query_ob *obj) {
 #endif
 }
 
+/** String representation of column object. Used for both repr() and str()
+ */
+static PyObject *wg_column_repr(wg_column *obj) {
+#ifndef PYTHON3
+  return PyString_FromFormat("<WhiteDB column of %d '%s' values>",
+    (int) obj->len, obj->format);
+#else
+  return PyUnicode_FromFormat("<WhiteDB column of %zd '%s' values>",
+    obj->len, obj->format);
+#endif
+}
+
 /** Get the number of rows in a query result
  */
 static PyObject *wg_query_get_res_count(wg_query_ob *obj, void *closure) {
@@ -1832,6 +2589,9 @@ PyMODINIT_FUNC PyInit_wgdb(void)
   if (PyType_Ready(&wg_query_type) < 0)
     INITERROR
 
+  if (PyType_Ready(&wg_column_type) < 0)
+    INITERROR
+
 #ifndef PYTHON3
   m = Py_InitModule3("wgdb", wgdb_methods, "WhiteDB database adapter");
 #else
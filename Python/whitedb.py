@@ -256,6 +256,32 @@ and record accessing functions."""
         """Insert a record into database"""
         return self.atomic_create_record(fields)
 
+    def insert_many(self, rows):
+        """Insert several records into database in one transaction"""
+        tupletype = type(())
+        batch = []
+        for fields in rows:
+            if not fields:
+                raise DataError("Cannot create an empty record")
+            row = []
+            for f in fields:
+                if type(f) == tupletype:
+                    if isinstance(f[0], Record):
+                        f = (f[0].get__rec(),) + f[1:]
+                elif isinstance(f, Record):
+                    f = f.get__rec()
+                row.append(f)
+            batch.append(row)
+
+        if self.locking:
+            self.start_write()
+        try:
+            r = wgdb.insert_batch(self._db, batch)
+        finally:
+            if self.locking:
+                self.end_write()
+        return [self._new_record(x) for x in r]
+
     # Field operations. Expect Record instances as argument
     #
     def get_field(self, rec, fieldnr):
@@ -321,6 +347,18 @@ and record accessing functions."""
             return None
         return self._new_record(r)
         
+    def fetch_columns(self, columns, types, query=None):
+        """Extract columns from query results (or all records)
+into typed arrays that support the buffer protocol."""
+        if self.locking:
+            self.start_read()
+        try:
+            r = wgdb.fetch_columns(self._db, columns, types, query)
+        finally:
+            if self.locking:
+                self.end_read()
+        return r
+
     def free_query(self, cur):
         """Free query belonging to a cursor."""
         if not self._db: # plausible enough to warrant special handling
@@ -368,6 +406,13 @@ records or argument lists. Does not currently support SQL."""
             result.append(r)
         return result
 
+    def fetchcolumns(self, columns, types):
+        """Fetch the given columns of all (remaining) records
+as typed arrays"""
+        if not self._query:
+            raise ProgrammingError("No results to fetch.")
+        return self._conn.fetch_columns(columns, types, self._query)
+
     # includes sql parameter for future extension. Current
     # wgdb queries should use arglist and matchrec keyword parameters.
     def execute(self, sql="", matchrec=None, arglist=None):
@@ -104,6 +104,8 @@ static char* create(thread_data_p tdata, char* inparams[], char* invalues[],
   int incount);
 static char* drop(thread_data_p tdata, char* inparams[], char* invalues[], 
   int incount);
+static char* stats(thread_data_p tdata, char* inparams[], char* invalues[], 
+  int incount);
 
 static int op_print_record(thread_data_p tdata,void* rec,int gcount);
 static int op_delete_record(thread_data_p tdata,void* rec);
@@ -114,6 +116,7 @@ static char* handle_fld_param(thread_data_p tdata,char* key,char* value,
               char** sfields, char** svalues, char** stypes, int sfcount, char* errbuf);                                  
 static int op_print_data_start(thread_data_p tdata, int listflag);
 static int op_print_data_end(thread_data_p tdata, int listflag);
+static int op_print_explain(thread_data_p tdata, void* db, wg_query_explain* ex);
 static int op_update_record(thread_data_p tdata,void* db, void* rec, wg_int fld, wg_int value);
 static void* op_create_database(thread_data_p tdata,char* database,long size);
 
@@ -513,6 +516,14 @@ char* process_query(char* inquery, thread_data_p tdata) {
         found=1;
         res=drop(tdata,params,values,pcount);
         break;       
+      } else if (!strncmp(values[i],"explain",MAXQUERYLEN)) {
+        found=1;
+        res=search(tdata,params,values,pcount,EXPLAIN_CODE);
+        break;
+      } else if (!strncmp(values[i],"stats",MAXQUERYLEN)) {
+        found=1;
+        res=stats(tdata,params,values,pcount);
+        break;
       } else {
         return errhalt(UNKNOWN_OP_ERR,tdata);
       }        
@@ -576,6 +587,7 @@ static char* search(thread_data_p tdata, char* inparams[], char* invalues[],
   char* res;
   wg_query *wgquery;  // query datastructure built later
   wg_query_arg wgargs[MAXPARAMS]; 
+  wg_query_explain wgexplain;
   wg_int lock_id=0;  // non-0 iff lock set
   int searchtype=0; // 0: full scan, 1: record ids, 2: by fields             
   char errbuf[ERRBUF_LEN]; // used for building variable-content input param error strings only               
@@ -657,6 +669,8 @@ static char* search(thread_data_p tdata, char* inparams[], char* invalues[],
     // search by fields
     searchtype=2;
   }    
+  // only the search by fields goes through the query planner
+  if (opcode==EXPLAIN_CODE && searchtype!=2) return errhalt(EXPLAIN_FIELDS_ERR,tdata);
   // attach to database
   db=op_attach_database(tdata,database,READ_LEVEL);
   if (!db) return errhalt(DB_ATTACH_ERR,tdata);   
@@ -765,34 +779,44 @@ static char* search(thread_data_p tdata, char* inparams[], char* invalues[],
       if (wgargs[i].value==WG_ILLEGAL) return err_clear_detach_halt(INTYPE_ERR,tdata);
     }   
     
-    // make the query structure       
-    wgquery = wg_make_query(db, NULL, 0, wgargs, i);
-    if (!wgquery) return err_clear_detach_halt(QUERY_ERR,tdata);
+    if (opcode==EXPLAIN_CODE) {
+      // run the query and print the plan and profile instead of the rows
+      // (the bounds point to the arguments, so these are freed last)
+      itmp=wg_explain_query(db, NULL, 0, wgargs, i, &wgexplain);
+      if (!itmp && !op_print_explain(tdata,db,&wgexplain)) itmp=1;
+      for(i=0;i<fcount;i++) wg_free_query_param(db, wgargs[i].value);
+      if (itmp<0) return err_clear_detach_halt(QUERY_ERR,tdata);
+      if (itmp) return err_clear_detach_halt(MALLOC_ERR,tdata);
+    } else {
+      // make the query structure       
+      wgquery = wg_make_query(db, NULL, 0, wgargs, i);
+      if (!wgquery) return err_clear_detach_halt(QUERY_ERR,tdata);
     
-    // actually perform the query           
-    if (tdata->maxdepth>MAX_DEPTH_HARD) tdata->maxdepth=MAX_DEPTH_HARD;
-    while((rec = wg_fetch(db, wgquery))) {
-      if (rcount>=from) {
-        gcount++;                           
-        if (opcode==COUNT_CODE) handlecount++;
-        else if (opcode==SEARCH_CODE) {
-          itmp=op_print_record(tdata,rec,gcount);
-          if (!itmp) return err_clear_detach_halt(MALLOC_ERR,tdata);
-        } else if (opcode==UPDATE_CODE) {
-          itmp=op_update_record(tdata,db,rec,0,0);
-          if (!itmp) handlecount++;          
-        } else if (opcode==DELETE_CODE) {
-          itmp=op_delete_record(tdata,rec);
-          if (!itmp) handlecount++;
-          //else return err_clear_detach_halt(DELETE_ERR,tdata);  
-        }
-      }  
-      rcount++;
-      if (gcount>=count) break;    
-    }   
-    // free query datastructure, 
-    for(i=0;i<fcount;i++) wg_free_query_param(db, wgargs[i].value);
-    wg_free_query(db,wgquery); 
+      // actually perform the query           
+      if (tdata->maxdepth>MAX_DEPTH_HARD) tdata->maxdepth=MAX_DEPTH_HARD;
+      while((rec = wg_fetch(db, wgquery))) {
+        if (rcount>=from) {
+          gcount++;                           
+          if (opcode==COUNT_CODE) handlecount++;
+          else if (opcode==SEARCH_CODE) {
+            itmp=op_print_record(tdata,rec,gcount);
+            if (!itmp) return err_clear_detach_halt(MALLOC_ERR,tdata);
+          } else if (opcode==UPDATE_CODE) {
+            itmp=op_update_record(tdata,db,rec,0,0);
+            if (!itmp) handlecount++;          
+          } else if (opcode==DELETE_CODE) {
+            itmp=op_delete_record(tdata,rec);
+            if (!itmp) handlecount++;
+            //else return err_clear_detach_halt(DELETE_ERR,tdata);  
+          }
+        }  
+        rcount++;
+        if (gcount>=count) break;    
+      }   
+      // free query datastructure, 
+      for(i=0;i<fcount;i++) wg_free_query_param(db, wgargs[i].value);
+      wg_free_query(db,wgquery); 
+    }
   }
   // ----- cases  handled  ------
   // print a single number for count and delete
@@ -1102,6 +1126,92 @@ static char* drop(thread_data_p tdata, char* inparams[], char* invalues[], int i
   return tdata->buf;
 }
 
+// show runtime statistics counters of a database
+  
+static char* stats(thread_data_p tdata, char* inparams[], char* invalues[], int incount) {
+  char* database=tdata->database;
+  char *token=NULL;
+  int i,itmp;
+  void* db=NULL; // actual database pointer
+  char *res;
+  wg_int *counters;
+  wg_int count;
+  char errbuf[ERRBUF_LEN];  
+  
+  // find and check parameters
+  for(i=0;i<incount;i++) {
+    if (strncmp(inparams[i],"db",MAXQUERYLEN)==0) {
+      database=invalues[i];
+      if(database==NULL || strlen(database)<1 || atoi(database)<=0) {
+        return errhalt(DB_NAME_ERR,tdata);
+      }
+    } else {  
+      // handle generic parameters for all queries: at end of param check
+      res=handle_generic_param(tdata,inparams[i],invalues[i],&token,errbuf);      
+      if (res!=NULL) return res;  // return error string
+    }    
+  }  
+  // authorization
+  if (!authorize(READ_LEVEL,tdata,database,token)) {
+    return errhalt(NOT_AUTHORIZED_ERR,tdata);
+  }  
+  // attach to database
+  db=op_attach_database(tdata,database,READ_LEVEL);
+  if (!db) return errhalt(DB_ATTACH_ERR,tdata);
+  tdata->db=db;
+  // counters are read without a lock to leave the lock statistics intact
+  tdata->lock_id=0;
+  count=wg_get_stats(db,NULL,0);
+  if (count<0) return err_clear_detach_halt(STATS_DISABLED_ERR,tdata);
+  counters=malloc(sizeof(wg_int)*count);
+  if (counters==NULL) return err_clear_detach_halt(MALLOC_ERR,tdata);
+  wg_get_stats(db,counters,count);
+  // create output string buffer (may be reallocated later)
+  tdata->buf=str_new(INITIAL_MALLOC);
+  if (tdata->buf==NULL) { 
+    free(counters);
+    return err_clear_detach_halt(MALLOC_ERR,tdata);
+  }  
+  tdata->bufsize=INITIAL_MALLOC;
+  tdata->bufptr=tdata->buf;
+  op_print_data_start(tdata,0);
+  if (tdata->format!=0) {
+    if(!str_guarantee_space(tdata,MIN_STRLEN)) {
+      free(counters);
+      return err_clear_detach_halt(MALLOC_ERR,tdata);
+    }  
+    *(tdata->bufptr)++='{';
+  }  
+  for(i=0;i<count;i++) {
+    if(!str_guarantee_space(tdata,MIN_STRLEN)) {
+      free(counters);
+      return err_clear_detach_halt(MALLOC_ERR,tdata);
+    }  
+    if (tdata->format!=0) {
+      // json
+      itmp=snprintf(tdata->bufptr,MIN_STRLEN,"%s\"%s\":%ld",(i ? "," : ""),
+                    wg_get_stat_name(i),(long)counters[i]);
+    } else {
+      // csv
+      itmp=snprintf(tdata->bufptr,MIN_STRLEN,"%s,%ld\n",
+                    wg_get_stat_name(i),(long)counters[i]);
+    }  
+    tdata->bufptr+=itmp;
+  }  
+  free(counters);
+  if (tdata->format!=0) {
+    if(!str_guarantee_space(tdata,MIN_STRLEN)) 
+      return err_clear_detach_halt(MALLOC_ERR,tdata);
+    *(tdata->bufptr)++='}';
+    *(tdata->bufptr)=0;
+  }  
+  // end activity
+  op_detach_database(tdata,db);
+  if(!op_print_data_end(tdata,0))
+    return err_clear_detach_halt(MALLOC_ERR,tdata);    
+  return tdata->buf;
+}
+
 /* ***** print, delete, update utilities ****** */
 
 // print a single record to output string buffer of tdata
@@ -1249,6 +1359,64 @@ static int op_print_data_end(thread_data_p tdata, int listflag) {
 } 
 
 
+// print a query plan and profile as a json object or csv name,value lines
+// return 1 if ok, 0 if fails
+
+static int op_print_explain(thread_data_p tdata, void* db, wg_query_explain* ex) {
+  int i,itmp,limit=2*MIN_STRLEN;
+  char *tmp;
+  char *names[2]={"start","end"};
+  wg_int bounds[2];
+  wg_int inclusive[2];
+  int json=(tdata->format!=0);
+
+  bounds[0]=ex->start_bound; inclusive[0]=ex->start_inclusive;
+  bounds[1]=ex->end_bound; inclusive[1]=ex->end_inclusive;
+  if(!str_guarantee_space(tdata,limit)) return 0;
+  if (json) {
+    itmp=snprintf(tdata->bufptr,limit,
+      "{\"plan\":\"%s\",\"index_id\":%ld,\"column\":%ld",
+      (ex->qtype==WG_QTYPE_TTREE ? "ttree" : "scan"),
+      (long)ex->index_id,(long)ex->column);
+  } else {
+    itmp=snprintf(tdata->bufptr,limit,"plan,%s\nindex_id,%ld\ncolumn,%ld\n",
+      (ex->qtype==WG_QTYPE_TTREE ? "ttree" : "scan"),
+      (long)ex->index_id,(long)ex->column);
+  }
+  tdata->bufptr+=itmp;
+  for(i=0;i<2;i++) {
+    if (bounds[i]==WG_ILLEGAL) continue;
+    if(!str_guarantee_space(tdata,limit)) return 0;
+    itmp=snprintf(tdata->bufptr,limit,(json ? ",\"%s\":" : "%s,"),names[i]);
+    tdata->bufptr+=itmp;
+    tmp=sprint_value(db,bounds[i],tdata);
+    if (tmp==NULL) return 0;
+    tdata->bufptr=tmp;
+    if(!str_guarantee_space(tdata,limit)) return 0;
+    itmp=snprintf(tdata->bufptr,limit,
+      (json ? ",\"%s_inclusive\":%d" : "\n%s_inclusive,%d\n"),
+      names[i],(int)inclusive[i]);
+    tdata->bufptr+=itmp;
+  }
+  if(!str_guarantee_space(tdata,limit)) return 0;
+  if (json) {
+    itmp=snprintf(tdata->bufptr,limit,
+      ",\"conditions\":%ld,\"estimated\":%ld,\"examined\":%ld,"
+      "\"returned\":%ld,\"elapsed_ms\":%.3f}",
+      (long)ex->argc,(long)ex->estimated,(long)ex->examined,
+      (long)ex->returned,ex->elapsed*1000);
+  } else {
+    itmp=snprintf(tdata->bufptr,limit,
+      "conditions,%ld\nestimated,%ld\nexamined,%ld\nreturned,%ld\n"
+      "elapsed_ms,%.3f\n",
+      (long)ex->argc,(long)ex->estimated,(long)ex->examined,
+      (long)ex->returned,ex->elapsed*1000);
+  }
+  tdata->bufptr+=itmp;
+  return 1;
+}
+
+
 // update a record
 
 static int op_update_record(thread_data_p tdata,void* db, void* rec, wg_int fld, wg_int value) {
@@ -176,6 +176,8 @@ Content-Type: text/plain\r\n\r\n"
 #define DB_DROP_ERR "database dropping failed"
 #define DB_NAME_ERR "incorrect or missing database name"
 #define DB_AUTHORIZE_ERR "access to database not authorized"
+#define STATS_DISABLED_ERR "runtime statistics not enabled in the database"
+#define EXPLAIN_FIELDS_ERR "explain needs search fields"
 
 #define HTTP_METHOD_ERR "method given in http not implemented: use GET"
 #define HTTP_REQUEST_ERR "incorrect http request"
@@ -264,6 +266,7 @@ Content-Type: text/plain\r\n\r\n"
 #define SEARCH_CODE 1 // passed as last arg to generic search
 #define DELETE_CODE 2 // passed as last arg to generic search
 #define UPDATE_CODE 3 // passed as last arg to generic search
+#define EXPLAIN_CODE 4 // passed as last arg to generic search
 
 #define BAD_WG_VALUE  WG_ILLEGAL // 0xff used for returning encoding failures
 
@@ -68,6 +68,9 @@ extern "C" {
 #include "../Db/dblog.h"
 #include "../Db/dbschema.h"
 #include "../Db/dbjson.h"
+#include "../Db/dblock.h"
+#include "../Db/dbstats.h"
+#include "../Db/dbtable.h"
 #include "dbtest.h"
 
 /* ====== Private headers and defs ======== */
@@ -92,10 +95,25 @@ static gint wg_check_query_param(void* db, int printlevel);
 static gint wg_check_strhash(void* db, int printlevel);
 static gint wg_test_index1(void *db, int magnitude, int printlevel);
 static gint wg_test_index2(void *db, int printlevel);
+static gint wg_check_index_build(void *db, int printlevel);
+static gint wg_check_partial_index(void *db, int printlevel);
+static gint wg_check_insert_batch(void *db, int printlevel);
+static gint wg_check_record_update(void *db, int printlevel);
+static gint wg_check_stats(void *db, int printlevel);
+static gint wg_check_lockstats(void *db, int printlevel);
+static gint wg_check_area_usage(void *db, int printlevel);
+static gint wg_check_recptr_bitmap(void *db, int printlevel);
+static gint wg_check_explain(void *db, int printlevel);
+static gint wg_check_tables(void *db, int printlevel);
+static gint wg_check_table_columns(void *db, int printlevel);
 static gint wg_test_index3(void *db, int magnitude, int printlevel);
 static gint wg_check_childdb(void* db, int printlevel);
 static gint wg_check_schema(void* db, int printlevel);
 static gint wg_check_json_parsing(void* db, int printlevel);
+#ifdef USE_BACKLINKING
+static gint wg_check_json_query(void* db, int printlevel);
+#endif
+static gint wg_check_json_path(void* db, int printlevel);
 static gint wg_check_idxhash(void* db, int printlevel);
 static gint wg_test_query(void *db, int magnitude, int printlevel);
 static gint wg_check_log(void* db, int printlevel);
@@ -128,6 +146,11 @@ static int childdb_dropindex(void *db, int cnt);
 #endif
 static gint longstr_in_hash(void* db, char* data, char* extrastr, gint type, gint length);
 static int is_offset_in_list(void *db, gint reclist_offset, gint offset);
+static int count_hash_rows(void *db, gint reclist_offset);
+static int count_json_query(void *db, wg_json_query_arg *arglist, int argc);
+#ifdef USE_INDEX_TEMPLATE
+static int count_ttree_rows(void *db, gint index_id);
+#endif
 static int check_matching_rows(void *db, int col, int cond,
  void *val, gint type, int expected, int printlevel);
 static int check_db_rows(void *db, int expected, int printlevel);
@@ -162,6 +185,12 @@ int wg_run_tests(int tests, int printlevel) {
     if (OK_TO_CONTINUE(tmp)) tmp=wg_check_db(db);
     if (OK_TO_CONTINUE(tmp)) tmp=wg_check_strhash(db,printlevel);
     if (OK_TO_CONTINUE(tmp)) tmp=wg_test_index2(db,printlevel);
+    if (OK_TO_CONTINUE(tmp)) tmp=wg_check_insert_batch(db,printlevel);
+    if (OK_TO_CONTINUE(tmp)) tmp=wg_check_record_update(db,printlevel);
+    if (OK_TO_CONTINUE(tmp)) tmp=wg_check_stats(db,printlevel);
+    if (OK_TO_CONTINUE(tmp)) tmp=wg_check_lockstats(db,printlevel);
+    if (OK_TO_CONTINUE(tmp)) tmp=wg_check_area_usage(db,printlevel);
+    if (OK_TO_CONTINUE(tmp)) tmp=wg_check_recptr_bitmap(db,printlevel);
     if (OK_TO_CONTINUE(tmp)) tmp=wg_check_childdb(db,printlevel);
     wg_delete_local_database(db);
 
@@ -174,6 +203,52 @@ int wg_run_tests(int tests, int printlevel) {
       wg_delete_local_database(db);
     }
 
+#ifdef USE_BACKLINKING
+    /* key queries find the documents through backlinks */
+    if (OK_TO_CONTINUE(tmp)) {
+      db = wg_attach_local_database(800000);
+      tmp=wg_check_json_query(db,printlevel);
+      wg_delete_local_database(db);
+    }
+#endif
+
+    if (OK_TO_CONTINUE(tmp)) {
+      db = wg_attach_local_database(800000);
+      tmp=wg_check_json_path(db,printlevel);
+      wg_delete_local_database(db);
+    }
+
+    if (OK_TO_CONTINUE(tmp)) {
+      /* empty database, so that the row counts are known */
+      db = wg_attach_local_database(800000);
+      tmp=wg_check_explain(db,printlevel);
+      wg_delete_local_database(db);
+    }
+
+    if (OK_TO_CONTINUE(tmp)) {
+      db = wg_attach_local_database(800000);
+      tmp=wg_check_tables(db,printlevel);
+      wg_delete_local_database(db);
+    }
+
+    if (OK_TO_CONTINUE(tmp)) {
+      db = wg_attach_local_database(800000);
+      tmp=wg_check_table_columns(db,printlevel);
+      wg_delete_local_database(db);
+    }
+
+    if (OK_TO_CONTINUE(tmp)) {
+      db = wg_attach_local_database(800000);
+      tmp=wg_check_index_build(db,printlevel);
+      wg_delete_local_database(db);
+    }
+
+    if (OK_TO_CONTINUE(tmp)) {
+      db = wg_attach_local_database(800000);
+      tmp=wg_check_partial_index(db,printlevel);
+      wg_delete_local_database(db);
+    }
+
     if (OK_TO_CONTINUE(tmp)) {
       printf("\n***** Quick tests passed ******\n");
     } else {
@@ -1132,11 +1207,14 @@ static int bufguarded_strcmp(char* a, char* b) {
 
 /* ------------------------ test record linking ------------------------------*/
 
+#define BACKLINK_TEST_PARENTS 100
+
 static gint wg_check_backlinking(void* db, int printlevel) {
 #ifdef USE_BACKLINKING
-  int p;
+  int p, i, j, count;
   int tmp;
   gint *rec, *rec2, *rec3, *parent;
+  gint *parents[BACKLINK_TEST_PARENTS];
 
   p = printlevel;
 
@@ -1249,6 +1327,75 @@ static gint wg_check_backlinking(void* db, int printlevel) {
       0, (int) tmp);
     return 1;
   }
+
+  /* a record with many parents, some referencing it more than once */
+  rec=(gint *) wg_create_record(db,1);
+  if (rec==NULL) {
+    if (p) printf("unexpected error: rec creation failed\n");
+    return 1;
+  }
+  for(i=0; i<BACKLINK_TEST_PARENTS; i++) {
+    parents[i]=(gint *) wg_create_record(db,2);
+    if (parents[i]==NULL) {
+      if (p) printf("unexpected error: rec creation failed\n");
+      return 1;
+    }
+    wg_set_field(db, parents[i], 0, wg_encode_record(db, rec));
+    if(i%3 == 0)
+      wg_set_field(db, parents[i], 1, wg_encode_record(db, rec));
+  }
+
+  /* each parent should be returned exactly once */
+  count=0;
+  for(parent = wg_get_first_parent(db, rec); parent;
+    parent = wg_get_next_parent(db, rec, parent)) {
+    for(j=0; j<BACKLINK_TEST_PARENTS; j++) {
+      if(parents[j]==parent)
+        break;
+    }
+    if(j==BACKLINK_TEST_PARENTS) {
+      if (p) printf("check_backlinking: record had an invalid parent\n");
+      return 1;
+    }
+    if(++count > BACKLINK_TEST_PARENTS) {
+      if (p) printf("check_backlinking: record had too many parents\n");
+      return 1;
+    }
+  }
+  if(count != BACKLINK_TEST_PARENTS) {
+    if (p) printf("check_backlinking: expected %d parents, found %d\n",
+      BACKLINK_TEST_PARENTS, count);
+    return 1;
+  }
+
+  /* dropping one of two references keeps the parent */
+  wg_set_field(db, parents[0], 1, 0);
+  for(parent = wg_get_first_parent(db, rec); parent;
+    parent = wg_get_next_parent(db, rec, parent)) {
+    if(parent==parents[0])
+      break;
+  }
+  if(parent==NULL) {
+    if (p) printf("check_backlinking: parent lost after removing duplicate reference\n");
+    return 1;
+  }
+
+  for(i=0; i<BACKLINK_TEST_PARENTS; i++) {
+    if(wg_delete_record(db, parents[i])) {
+      if (p) printf("check_backlinking: failed to delete parent record\n");
+      return 1;
+    }
+  }
+  if(wg_get_first_parent(db, rec) != NULL) {
+    if (p) printf("check_backlinking: non-referenced record had a parent\n");
+    return 1;
+  }
+  tmp = wg_delete_record(db, rec);
+  if(tmp != 0) {
+    if (p) printf("check_backlinking: deleting record, expected %d, received %d\n",
+      0, (int) tmp);
+    return 1;
+  }
   if (p>1) printf("********* check_backlinking: no errors ************\n");
 #else
   printf("check_backlinking: disabled, skipping checks\n");
@@ -1595,6 +1742,85 @@ static gint wg_check_compare(void* db, int printlevel) {
     }
   }
 
+  /* The specialized comparison must agree with the generic one,
+   * whichever operand the mode was chosen from. */
+  for(i=0; i<26; i++) {
+    for(j=0; j<26; j++) {
+      gint mode = WG_COMPARE_MODE(testdata[j]);
+      if(WG_COMPARE_FAST(db, mode, testdata[i], testdata[j]) !=\
+        WG_COMPARE(db, testdata[i], testdata[j])) {
+        if(printlevel) {
+          printf("value1: ");
+          wg_debug_print_value(db, testdata[i]);
+          printf(" value2: ");
+          wg_debug_print_value(db, testdata[j]);
+          printf("\nfast comparison in mode %d gave a wrong result\n",
+            (int) mode);
+        }
+        return 1;
+      }
+    }
+  }
+
+#ifdef USE_INLINE_DOUBLE
+  /* Immediate and stored doubles must be ordered by value */
+  {
+    gint encd[4];
+    encd[0] = wg_encode_double(db, -2.5);   /* inline */
+    encd[1] = wg_encode_double(db, 0.1);    /* doubleword */
+    encd[2] = wg_encode_double(db, 0.5);    /* inline */
+    encd[3] = wg_encode_double(db, 1000.1); /* doubleword */
+    if(!isinlinedouble(encd[0]) || !isfulldouble(encd[1]) ||\
+      !isinlinedouble(encd[2]) || !isfulldouble(encd[3])) {
+      if(printlevel)
+        printf("check_compare: doubles had unexpected encoding\n");
+      return 1;
+    }
+    for(i=0; i<3; i++) {
+      if(WG_COMPARE(db, encd[i], encd[i+1]) != WG_LESSTHAN ||\
+        WG_COMPARE(db, encd[i+1], encd[i]) != WG_GREATER) {
+        if(printlevel)
+          printf("check_compare: inline doubles ordered incorrectly\n");
+        return 1;
+      }
+    }
+  }
+#endif
+
+#ifdef USETINYSTR
+  /* Tiny strings must decode and order like the allocated ones */
+  {
+    char *strs[4] = { "abc", "abcdefg", "abcdefgh", "b" };
+    gint encs[4], enc;
+    for(i=0; i<4; i++) {
+      encs[i] = wg_encode_str(db, strs[i], NULL);
+      if(istinystr(encs[i]) != fits_tinystr((gint) strlen(strs[i])) ||\
+        strcmp(wg_decode_str(db, encs[i]), strs[i]) ||\
+        wg_decode_str_len(db, encs[i]) != (gint) strlen(strs[i])) {
+        if(printlevel)
+          printf("check_compare: tiny string \"%s\" encoded incorrectly\n",
+            strs[i]);
+        return 1;
+      }
+    }
+    for(i=0; i<3; i++) {
+      if(WG_COMPARE(db, encs[i], encs[i+1]) != WG_LESSTHAN ||\
+        WG_COMPARE(db, encs[i+1], encs[i]) != WG_GREATER) {
+        if(printlevel)
+          printf("check_compare: tiny strings ordered incorrectly\n");
+        return 1;
+      }
+    }
+    /* the prefix is stored as a tiny string */
+    enc = wg_encode_uri(db, "www.example.com", "http://");
+    if(strcmp(wg_decode_uri_prefix(db, enc), "http://")) {
+      if(printlevel)
+        printf("check_compare: uri prefix decoded incorrectly\n");
+      return 1;
+    }
+  }
+#endif
+
   if(printlevel>1)
     printf("********* check_compare: no errors ************\n");
   return 0;
@@ -1842,7 +2068,7 @@ static gint wg_check_query_param(void* db, int printlevel) {
       return 1;
     }
     tmp = decode_shortstr_offset(encp);
-    if(tmp > 0 && tmp < dbmemsegh(db)->free) {
+    if(isshortstr(encp) && tmp > 0 && tmp < dbmemsegh(db)->free) {
       if(printlevel) {
         printf("check_query_param: encoded empty string parameter (%d) "\
           "had an invalid offset\n",
@@ -2990,746 +3216,1944 @@ static gint wg_test_index2(void *db, int printlevel) {
   return 0;
 }
 
-/** Test data inserting with multi-column hash indexes
- *
+/** Test building indexes on existing data
+ *  The T-tree is built from sorted rows in one pass. Check that
+ *  it is balanced and remains valid when it is modified afterwards.
  */
-static gint wg_test_index3(void *db, int magnitude, int printlevel) {
-  const int dbsize = 10*magnitude, rand_updates = magnitude;
-  int i, j, k;
-  void *start = NULL, *rec = NULL;
-  long int newv, rnddata;
-  gint index1, index2;
-  gint columns[2];
+static gint wg_check_index_build(void *db, int printlevel) {
+  const int dbsize = 1000;
+  int i;
+  gint index_id, col = 0, values[1];
+  void *rec, *start = NULL;
+
+  if (printlevel>1)
+    printf("********* testing index build ********** \n");
 
 #ifdef _WIN32
-  srand(102435356);
+  srand(20141001);
 #else
-  srandom(102435356); /* fixed seed for repeatable sequences */
+  srandom(20141001);
 #endif
 
-  /* index the typical key/value columns */
-  columns[0] = 1;
-  columns[1] = 2;
-
-  if(printlevel > 1) {
-    printf("------- hash index test: inserting data --------\n");
-  }
-
-  /* 1st loop: insert data */
+  /* Random values with many duplicates */
   for(i=0; i<dbsize; i++) {
-    gint enc;
-    rec = wg_create_record(db, 3);
+    rec = wg_create_record(db, 2);
+    if(!rec) {
+      if(printlevel)
+        printf("record creation failed.\n");
+      return 1;
+    }
     if(!i)
       start = rec;
-    for(j=0; j<2; j++) {
 #ifdef _WIN32
-      rnddata = rand();
+    wg_set_field(db, rec, 0, wg_encode_int(db, rand() % 100));
 #else
-      rnddata = random();
+    wg_set_field(db, rec, 0, wg_encode_int(db, random() % 100));
 #endif
-      newv = rnddata>>4;
+    wg_set_field(db, rec, 1, wg_encode_int(db, i));
+  }
 
-      if(rnddata & 1) {
-        enc = wg_encode_int(db, newv);
-      } else {
-        char buf[30];
-        snprintf(buf, 29, "%ld", newv);
-        buf[29] = '\0';
-        enc = wg_encode_str(db, buf, NULL);
-      }
+  if(wg_create_index(db, 0, WG_INDEX_TYPE_TTREE, NULL, 0) ||\
+    wg_create_multi_index(db, &col, 1, WG_INDEX_TYPE_HASH, NULL, 0)) {
+    if(printlevel)
+      printf("index creation failed.\n");
+    return 1;
+  }
+  if(validate_index(db, start, dbsize, 0, printlevel)) {
+    if(printlevel)
+      printf("index validation failed after build.\n");
+    return 1;
+  }
 
-      if(wg_set_field(db, rec, columns[j], enc)) {
-        if(printlevel)
-          fprintf(stderr, "insert error, aborting.\n");
-        return -1;
-      }
+  /* Each value of column 0 is found through the hash index */
+  index_id = wg_multi_column_to_index_id(db, &col, 1,
+    WG_INDEX_TYPE_HASH, NULL, 0);
+  for(rec = start; rec; rec = wg_get_next_record(db, rec)) {
+    values[0] = wg_get_field(db, rec, 0);
+    if(wg_search_hash(db, index_id, values, 1) < 1) {
+      if(printlevel)
+        printf("value not found in the hash index.\n");
+      return 1;
     }
   }
 
-  if(printlevel > 1) {
-    printf("------- hash index test: creating indexes --------\n");
+  /* Insert into and delete from the built tree */
+  for(i=0; i<dbsize; i+=3) {
+    rec = wg_create_record(db, 1);
+#ifdef _WIN32
+    if(!rec || wg_set_field(db, rec, 0, wg_encode_int(db, rand() % 150))) {
+#else
+    if(!rec || wg_set_field(db, rec, 0, wg_encode_int(db, random() % 150))) {
+#endif
+      if(printlevel)
+        printf("insert after index build failed.\n");
+      return 1;
+    }
   }
-
-  /* Create indexes with data in db */
-  if(wg_create_multi_index(db, columns, 2, WG_INDEX_TYPE_HASH, NULL, 0)) {
-    if(printlevel)
-      fprintf(stderr, "index creation failed, aborting.\n");
-    return -3;
+  rec = wg_get_next_record(db, start);
+  for(i=0; rec; i++) {
+    void *next = wg_get_next_record(db, rec);
+    if(i%2 && wg_delete_record(db, rec)) {
+      if(printlevel)
+        printf("delete after index build failed.\n");
+      return 1;
+    }
+    rec = next;
   }
-  if((index1 = wg_multi_column_to_index_id(db,
-    columns, 2, WG_INDEX_TYPE_HASH, NULL, 0)) == -1) {
+  if(validate_index(db, start, dbsize, 0, printlevel)) {
     if(printlevel)
-      fprintf(stderr, "index not found after creation.\n");
-    return -3;
+      printf("index validation failed after modifying the built tree.\n");
+    return 1;
   }
 
-  /* Create indexes with data in db */
-  if(wg_create_multi_index(db, columns, 2, WG_INDEX_TYPE_HASH_JSON, NULL, 0)) {
+  if (printlevel>1)
+    printf("********* index build test successful ********** \n");
+  return 0;
+}
+
+/** Test partial indexes and computed keys
+ *  An index with a range condition in the template must hold exactly
+ *  the matching records while they are updated, and the planner may
+ *  only use it when the query implies the condition. Hash indexes on
+ *  computed keys are searched with the same key function.
+ */
+static gint wg_check_partial_index(void *db, int printlevel) {
+  const int dbsize = 200;
+  char buf[20];
+  gint columns[1], values[1], index_id;
+  void *rec, *start = NULL;
+  int i, expected;
+#ifdef USE_INDEX_TEMPLATE
+  wg_query_explain ex;
+  wg_query_arg arglist[2];
+  gint matchrec[3], conds[3];
+#endif
+
+  if (printlevel>1)
+    printf("********* testing partial indexes ********** \n");
+
+  for(i=0; i<dbsize; i++) {
+    rec = wg_create_record(db, 3);
+    if(!rec) {
+      if(printlevel)
+        printf("record creation failed.\n");
+      return 1;
+    }
+    if(!i)
+      start = rec;
+    snprintf(buf, 20, "%s%d", (i%2 ? "ABC" : "abc"), i%10);
+    wg_set_field(db, rec, 0, wg_encode_int(db, i));
+    wg_set_field(db, rec, 1, wg_encode_int(db, i%5));
+    wg_set_field(db, rec, 2, wg_encode_str(db, buf, NULL));
+  }
+
+#ifdef USE_INDEX_TEMPLATE
+  /* T-tree on col0 of the records where col1 < 3 */
+  columns[0] = 0;
+  matchrec[0] = wg_encode_var(db, 0);
+  matchrec[1] = wg_encode_int(db, 3);
+  conds[0] = WG_COND_EQUAL;
+  conds[1] = WG_COND_LESSTHAN;
+  if(wg_create_partial_index(db, columns, 1, WG_INDEX_TYPE_TTREE,
+    WG_INDEX_KEY_VALUE, matchrec, conds, 2)) {
     if(printlevel)
-      fprintf(stderr, "index creation failed, aborting.\n");
-    return -3;
+      printf("partial index creation failed.\n");
+    return 1;
   }
-  if((index2 = wg_multi_column_to_index_id(db,
-    columns, 2, WG_INDEX_TYPE_HASH_JSON, NULL, 0)) == -1) {
+  index_id = wg_partial_column_to_index_id(db, columns, 1,
+    WG_INDEX_TYPE_TTREE, WG_INDEX_KEY_VALUE, matchrec, conds, 2);
+  if(index_id < 1 ||\
+    wg_column_to_index_id(db, 0, WG_INDEX_TYPE_TTREE, matchrec, 2) != -1) {
     if(printlevel)
-      fprintf(stderr, "index not found after creation.\n");
-    return -3;
+      printf("partial index not found or mistaken for a template.\n");
+    return 1;
+  }
+  if(count_ttree_rows(db, index_id) != dbsize*3/5) {
+    if(printlevel)
+      printf("wrong number of rows in the partial index.\n");
+    return 1;
   }
 
-  if(printlevel > 1) {
-    printf("------- hash index test: validating indexes --------\n");
+  /* Move records in and out of the index, delete some */
+  for(rec = start; rec; ) {
+    void *next = wg_get_next_record(db, rec);
+    i = wg_decode_int(db, wg_get_field(db, rec, 0));
+    if(i < 50)
+      wg_set_field(db, rec, 1, wg_encode_int(db, 4));
+    else if(i < 100)
+      wg_set_field(db, rec, 1, wg_encode_int(db, 0));
+    else if(!(i%7) && wg_delete_record(db, rec)) {
+      if(printlevel)
+        printf("record delete failed.\n");
+      return 1;
+    }
+    rec = next;
+  }
+  expected = 0;
+  for(rec = start; rec; rec = wg_get_next_record(db, rec)) {
+    if(wg_decode_int(db, wg_get_field(db, rec, 1)) < 3)
+      expected++;
+  }
+  if(count_ttree_rows(db, index_id) != expected) {
+    if(printlevel)
+      printf("partial index not updated correctly.\n");
+    return 1;
   }
 
-  if(validate_mc_index(db, start, dbsize, index1, columns, 2, printlevel)) {
+  /* col1 < 2 and col0 >= 100 implies col1 < 3, col1 <= 3 does not */
+  arglist[0].column = 1;
+  arglist[0].cond = WG_COND_LESSTHAN;
+  arglist[0].value = wg_encode_query_param_int(db, 2);
+  arglist[1].column = 0;
+  arglist[1].cond = WG_COND_GTEQUAL;
+  arglist[1].value = wg_encode_query_param_int(db, 100);
+  expected = 0;
+  for(rec = start; rec; rec = wg_get_next_record(db, rec)) {
+    if(wg_decode_int(db, wg_get_field(db, rec, 1)) < 2 &&\
+      wg_decode_int(db, wg_get_field(db, rec, 0)) >= 100)
+      expected++;
+  }
+  if(wg_explain_query(db, NULL, 0, arglist, 2, &ex) ||\
+    ex.index_id != index_id || ex.returned != expected) {
     if(printlevel)
-      fprintf(stderr, "index1 validation failed after insert.\n");
-    return -2;
+      printf("partial index not used for an implied condition.\n");
+    return 1;
+  }
+  wg_free_query_param(db, arglist[0].value);
+  arglist[0].cond = WG_COND_LTEQUAL;
+  arglist[0].value = wg_encode_query_param_int(db, 3);
+  expected = 0;
+  for(rec = start; rec; rec = wg_get_next_record(db, rec)) {
+    if(wg_decode_int(db, wg_get_field(db, rec, 1)) <= 3 &&\
+      wg_decode_int(db, wg_get_field(db, rec, 0)) >= 100)
+      expected++;
+  }
+  if(wg_explain_query(db, NULL, 0, arglist, 2, &ex) ||\
+    ex.index_id == index_id || ex.returned != expected) {
+    if(printlevel)
+      printf("partial index used for a wider condition.\n");
+    return 1;
   }
+  for(i=0; i<2; i++)
+    wg_free_query_param(db, arglist[i].value);
 
-  if(validate_mc_index(db, start, dbsize, index2, columns, 2, printlevel)) {
+  /* A new record is indexed once when it matches the template */
+  matchrec[1] = wg_encode_var(db, 0);
+  matchrec[2] = wg_encode_null(db, 0);
+  if(wg_create_index(db, 0, WG_INDEX_TYPE_TTREE, matchrec, 3)) {
     if(printlevel)
-      fprintf(stderr, "index2 validation failed after insert.\n");
-    return -2;
+      printf("index creation failed.\n");
+    return 1;
+  }
+  index_id = wg_column_to_index_id(db, 0, WG_INDEX_TYPE_TTREE, matchrec, 3);
+  rec = wg_create_record(db, 3);
+  if(!rec || count_ttree_rows(db, index_id) != 1 ||\
+    wg_set_field(db, rec, 2, wg_encode_str(db, "abc3", NULL)) ||\
+    count_ttree_rows(db, index_id) != 0) {
+    if(printlevel)
+      printf("template index holds a wrong number of rows.\n");
+    return 1;
   }
+  wg_set_field(db, rec, 0, wg_encode_int(db, 3));
 
-  if(printlevel > 1) {
-    printf("------- hash index test: updating data --------\n");
+  /* Template records of a new partial index stay out of older indexes */
+  if(wg_create_index(db, 0, WG_INDEX_TYPE_TTREE, NULL, 0)) {
+    if(printlevel)
+      printf("index creation failed.\n");
+    return 1;
+  }
+  index_id = wg_column_to_index_id(db, 0, WG_INDEX_TYPE_TTREE, NULL, 0);
+  matchrec[1] = wg_encode_int(db, 30);
+  conds[0] = 0;
+  conds[1] = WG_COND_LESSTHAN;
+  if(wg_create_partial_index(db, columns, 1, WG_INDEX_TYPE_TTREE,
+    WG_INDEX_KEY_VALUE, matchrec, conds, 2)) {
+    if(printlevel)
+      printf("partial index creation failed.\n");
+    return 1;
+  }
+  expected = 0;
+  for(rec = start; rec; rec = wg_get_next_record(db, rec))
+    expected++;
+  if(count_ttree_rows(db, index_id) != expected) {
+    if(printlevel)
+      printf("partial index template was added to a plain index.\n");
+    return 1;
+  }
+  expected = 0;
+  for(rec = start; rec; rec = wg_get_next_record(db, rec)) {
+    if(wg_get_field_type(db, rec, 0) == WG_INTTYPE &&\
+      wg_decode_int(db, wg_get_field(db, rec, 0)) < 5)
+      expected++;
+  }
+  values[0] = 5;
+  if(check_matching_rows(db, 0, WG_COND_LESSTHAN, &values[0], WG_INTTYPE,
+    expected, printlevel)) {
+    if(printlevel)
+      printf("query returned partial index template records.\n");
+    return 1;
   }
+#endif
 
-  /* 2nd loop: keep updating with random data */
-  for(k=0; k<rand_updates; k++) {
-    for(i=0; i<dbsize; i++) {
-      gint enc, oldenc;
-      if(!i)
-        rec = start;
-      else
-        rec = wg_get_next_record(db, rec);
+  /* Hash index on lowercased col2 */
+  columns[0] = 2;
+  if(wg_create_partial_index(db, columns, 1, WG_INDEX_TYPE_HASH,
+    WG_INDEX_KEY_LOWER, NULL, NULL, 0)) {
+    if(printlevel)
+      printf("hash index creation failed.\n");
+    return 1;
+  }
+  index_id = wg_partial_column_to_index_id(db, columns, 1,
+    WG_INDEX_TYPE_HASH, WG_INDEX_KEY_LOWER, NULL, NULL, 0);
+  if(index_id < 1 || wg_get_index_key(db, index_id) != WG_INDEX_KEY_LOWER) {
+    if(printlevel)
+      printf("hash index on computed key not found.\n");
+    return 1;
+  }
+  expected = 0;
+  for(rec = start; rec; rec = wg_get_next_record(db, rec)) {
+    if(wg_decode_int(db, wg_get_field(db, rec, 0)) % 10 == 3)
+      expected++;
+  }
+  values[0] = wg_encode_str(db, "aBc3", NULL);
+  if(count_hash_rows(db, wg_search_hash(db, index_id, values, 1)) !=\
+    expected) {
+    if(printlevel)
+      printf("wrong number of rows found by lowercased key.\n");
+    return 1;
+  }
 
-      for(j=0; j<2; j++) {
-#ifdef _WIN32
-        rnddata = rand();
-#else
-        rnddata = random();
-#endif
-        newv = rnddata>>4;
+  /* Hash index on col0 truncated to a day: all values are in day 0 */
+  columns[0] = 0;
+  if(wg_create_partial_index(db, columns, 1, WG_INDEX_TYPE_HASH,
+    WG_INDEX_KEY_DAY, NULL, NULL, 0)) {
+    if(printlevel)
+      printf("hash index creation failed.\n");
+    return 1;
+  }
+  index_id = wg_partial_column_to_index_id(db, columns, 1,
+    WG_INDEX_TYPE_HASH, WG_INDEX_KEY_DAY, NULL, NULL, 0);
+  expected = 0;
+  for(rec = start; rec; rec = wg_get_next_record(db, rec))
+    expected++;
+  values[0] = wg_encode_int(db, 86399);
+  if(count_hash_rows(db, wg_search_hash(db, index_id, values, 1)) !=\
+    expected) {
+    if(printlevel)
+      printf("wrong number of rows found by day key.\n");
+    return 1;
+  }
 
-        if(rnddata & 1) {
-          enc = wg_encode_int(db, newv);
-        } else {
-          char buf[30];
-          snprintf(buf, 29, "%ld", newv);
-          buf[29] = '\0';
-          enc = wg_encode_str(db, buf, NULL);
-        }
+  /* Computed keys are not allowed in T-trees */
+  if(!wg_create_partial_index(db, columns, 1, WG_INDEX_TYPE_TTREE,
+    WG_INDEX_KEY_LOWER, NULL, NULL, 0)) {
+    if(printlevel)
+      printf("T-tree index on computed key was created.\n");
+    return 1;
+  }
 
-        oldenc = wg_get_field(db, rec, columns[j]);
-        if(wg_set_field(db, rec, columns[j], enc)) {
-          if(printlevel) {
-            printf("loop: %d row: %d old (encoded): %d new (encoded): %d\n",
-              k, i, (int) oldenc, (int) enc);
-            fprintf(stderr, "insert error, aborting.\n");
-          }
-          return -1;
-        }
-      }
+  if (printlevel>1)
+    printf("********* partial index test successful ********** \n");
+  return 0;
+}
 
-      if(validate_mc_index(db,
-        start, dbsize, index1, columns, 2, printlevel)) {
-        if(printlevel) {
-          printf("loop: %d row: %d\n", k, i);
-          fprintf(stderr, "index1 validation failed after update.\n");
-        }
-        return -2;
-      }
-      if(validate_mc_index(db,
-        start, dbsize, index2, columns, 2, printlevel)) {
-        if(printlevel) {
-          printf("loop: %d row: %d\n", k, i);
-          fprintf(stderr, "index2 validation failed after update.\n");
-        }
-        return -2;
-      }
+/** Test creating records with wg_insert_batch()
+ *  Expects the T-tree indexes created by wg_test_index2() to
+ *  exist, so that the index updates can be validated.
+ */
+static gint wg_check_insert_batch(void *db, int printlevel) {
+  wg_batch_value values[9];
+  wg_int rowlen[3] = { 3, 2, 4 };
+  void *recs[3];
+  void *rec, *start;
+  int i, dbsize;
+
+  if (printlevel>1)
+    printf("********* testing batch insert ********** \n");
+
+  memset(values, 0, sizeof(values));
+  values[0].type = WG_INTTYPE;
+  values[0].v.i = 77;
+  values[1].type = WG_STRTYPE;
+  values[1].v.s = "batch string value that is not short";
+  values[2].type = WG_DOUBLETYPE;
+  values[2].v.d = 2.5;
+  values[3].type = WG_NULLTYPE;
+  values[4].type = WG_URITYPE;
+  values[4].v.s = "batch";
+  values[4].ext = "http://example.com/";
+  values[5].type = WG_CHARTYPE;
+  values[5].v.c = 'x';
+  values[6].type = WG_DATETYPE;
+  values[6].v.i = wg_ymd_to_date(db, 2014, 4, 1);
+  values[7].type = WG_TIMETYPE;
+  values[7].v.i = wg_hms_to_time(db, 12, 30, 0, 0);
+  values[8].type = WG_RECORDTYPE;
+  values[8].v.rec = wg_get_first_record(db);
+
+  if(wg_insert_batch(db, 3, rowlen, values, recs)) {
+    if(printlevel)
+      printf("wg_insert_batch failed.\n");
+    return 1;
+  }
+
+  for(i=0; i<3; i++) {
+    if(wg_get_record_len(db, recs[i]) != rowlen[i]) {
+      if(printlevel)
+        printf("wrong length for batch record %d.\n", i);
+      return 1;
     }
   }
+  if(wg_decode_int(db, wg_get_field(db, recs[0], 0)) != 77 ||\
+    strcmp(wg_decode_str(db, wg_get_field(db, recs[0], 1)),
+      "batch string value that is not short") ||\
+    wg_decode_double(db, wg_get_field(db, recs[0], 2)) != 2.5 ||\
+    wg_get_field_type(db, recs[1], 0) != WG_NULLTYPE ||\
+    strcmp(wg_decode_uri_prefix(db, wg_get_field(db, recs[1], 1)),
+      "http://example.com/") ||\
+    wg_decode_char(db, wg_get_field(db, recs[2], 0)) != 'x' ||\
+    wg_decode_date(db, wg_get_field(db, recs[2], 1)) != values[6].v.i ||\
+    wg_decode_time(db, wg_get_field(db, recs[2], 2)) != values[7].v.i ||\
+    wg_decode_record(db, wg_get_field(db, recs[2], 3)) != values[8].v.rec) {
+    if(printlevel)
+      printf("batch record contents do not match.\n");
+    return 1;
+  }
 
-  if(printlevel > 1) {
-    printf("------- hash index test: no errors found --------\n");
+  /* Invalid values are rejected */
+  values[0].type = WG_ILLEGAL;
+  if(wg_insert_batch(db, 1, rowlen, values, NULL) != -3) {
+    if(printlevel)
+      printf("wg_insert_batch accepted an invalid value.\n");
+    return 1;
+  }
+
+  /* Check that the records were indexed */
+  start = rec = wg_get_first_record(db);
+  dbsize = 0;
+  while(rec) {
+    dbsize++;
+    rec = wg_get_next_record(db, rec);
+  }
+  for(i=0; i<4; i++) {
+    if(validate_index(db, start, dbsize, i, printlevel)) {
+      if (printlevel)
+        printf("index validation failed after batch insert.\n");
+      return 1;
+    }
   }
 
+  if (printlevel>1)
+    printf("********* batch insert test successful ********** \n");
   return 0;
 }
 
-
-/** Validate a T-tree index
- *  1. validates a set of rows starting from *rec.
- *  2. checks tree balance
- *  3. checks tree min/max values
- *  returns 0 if no errors found
- *  returns -1 if value was not indexed
- *  returns -2 if there was another error
+/** Test deferred index updates with wg_open_record_update()
+ *  Uses the T-tree indexes created by wg_test_index2().
  */
-static int validate_index(void *db, void *rec, int rows, int column,
-  int printlevel) {
-  gint index_id = wg_column_to_index_id(db, column,
-    WG_INDEX_TYPE_TTREE, NULL, 0);
-  gint tnode_offset;
-  wg_index_header *hdr;
+#define UPDATE_TEST_RECORDS 30
 
-  if(index_id == -1)
-    return -2;
+static gint wg_check_record_update(void *db, int printlevel) {
+  void *recs[UPDATE_TEST_RECORDS];
+  void *parent, *rec, *start;
+  gint val;
+  int i, j, dbsize;
 
-  /* Check if all values are indexed */
-  while(rec && rows) {
-    if(wg_get_record_len(db, rec) > column) {
-      gint val = wg_get_field(db, rec, column);
-      if(wg_search_ttree_index(db, index_id, val) < 1) {
-        if(printlevel) {
-          printf("missing: %d\n", (int) val);
-        }
-        return -1;
-      }
+  if (printlevel>1)
+    printf("********* testing deferred index updates ********** \n");
+
+  for(i=0; i<UPDATE_TEST_RECORDS; i++) {
+    recs[i] = wg_create_record(db, 4);
+    if(!recs[i]) {
+      if(printlevel)
+        printf("record creation failed.\n");
+      return 1;
     }
-    rec = wg_get_next_record(db, rec);
-    rows--;
   }
 
-  hdr = (wg_index_header *) offsettoptr(db, index_id);
-
-  if(((struct wg_tnode *)(offsettoptr(db,
-    TTREE_ROOT_NODE(hdr))))->parent_offset != 0) {
+  /* Fill the records in reverse order of the keys */
+  for(i=0; i<UPDATE_TEST_RECORDS; i++) {
+    if(wg_open_record_update(db, recs[i])) {
+      if(printlevel)
+        printf("wg_open_record_update failed.\n");
+      return 1;
+    }
+    for(j=0; j<4; j++) {
+      if(wg_set_field(db, recs[i], j,
+        wg_encode_int(db, 900000 - 10*i - j))) {
+        if(printlevel)
+          printf("wg_set_field failed on an open record.\n");
+        return 1;
+      }
+    }
+  }
+  if(wg_open_record_update(db, recs[0]) != -2) {
     if(printlevel)
-      printf("root node parent offset is not 0\n");
-    return -2;
+      printf("a record was opened twice.\n");
+    return 1;
   }
-#ifdef TTREE_CHAINED_NODES
-  if(TTREE_MIN_NODE(hdr) == 0) {
+
+  if(wg_close_record_update(db, recs[0]) ||\
+    wg_close_record_updates(db, recs + 1, UPDATE_TEST_RECORDS - 1)) {
     if(printlevel)
-      printf("min node offset is 0\n");
-    return -2;
+      printf("closing the records failed.\n");
+    return 1;
   }
-  if(TTREE_MAX_NODE(hdr) == 0) {
+  if(wg_close_record_update(db, recs[0]) != -2) {
     if(printlevel)
-      printf("max node offset is 0\n");
-    return -2;
+      printf("a record was closed twice.\n");
+    return 1;
   }
-#endif
 
-#ifdef TTREE_CHAINED_NODES
-  tnode_offset = TTREE_MIN_NODE(hdr);
-#else
-  tnode_offset = wg_ttree_find_lub_node(db, TTREE_ROOT_NODE(hdr));
-#endif
-  while(tnode_offset) {
-    int diff;
-    gint minval, maxval;
-    struct wg_tnode *node = (struct wg_tnode *) offsettoptr(db, tnode_offset);
-
-    /* Check index tree balance */
-    diff = node->left_subtree_height - node->right_subtree_height;
-    if(diff < -1 || diff > 1)
-      return -2;
-
-    /* Check min/max values */
-    minval = wg_get_field(db,
-      offsettoptr(db, node->array_of_values[0]), column);
-    maxval = wg_get_field(db,
-      offsettoptr(db, node->array_of_values[node->number_of_elements - 1]),
-      column);
-    if(minval != node->current_min) {
-      if(printlevel) {
-        printf("current_min invalid: %d is: %d should be: %d\n",
-          (int) tnode_offset, (int) node->current_min,
-          (int) minval);
+  /* Each record should be indexed exactly once */
+  for(i=0; i<UPDATE_TEST_RECORDS; i++) {
+    for(j=0; j<4; j++) {
+      val = 900000 - 10*i - j;
+      if(check_matching_rows(db, j, WG_COND_EQUAL, &val,
+        WG_INTTYPE, 1, printlevel)) {
+        if(printlevel)
+          printf("record %d not found by index on column %d.\n", i, j);
+        return 1;
       }
-      return -2;
     }
-    if(maxval != node->current_max) {
-      if(printlevel) {
-        printf("current_max invalid: %d is: %d should be: %d\n",
-          (int) tnode_offset, (int) node->current_max,
-          (int) maxval);
-      }
-      return -2;
+  }
+
+  /* Updating a referenced record also updates the referring record */
+  parent = wg_create_record(db, 1);
+  if(!parent || wg_set_field(db, parent, 0, wg_encode_record(db, recs[0]))) {
+    if(printlevel)
+      printf("failed to create referring record.\n");
+    return 1;
+  }
+  if(wg_open_record_update(db, recs[0]) ||\
+    wg_set_field(db, recs[0], 1, wg_encode_int(db, 12345)) ||\
+    wg_set_field(db, recs[0], 2, wg_encode_int(db, 12346)) ||\
+    wg_close_record_update(db, recs[0])) {
+    if(printlevel)
+      printf("updating a referenced record failed.\n");
+    return 1;
+  }
+
+  start = rec = wg_get_first_record(db);
+  dbsize = 0;
+  while(rec) {
+    dbsize++;
+    rec = wg_get_next_record(db, rec);
+  }
+  for(i=0; i<4; i++) {
+    if(validate_index(db, start, dbsize, i, printlevel)) {
+      if (printlevel)
+        printf("index validation failed after deferred update.\n");
+      return 1;
     }
+  }
 
-    tnode_offset = TNODE_SUCCESSOR(db, node);
+  if(wg_delete_record(db, parent)) {
+    if(printlevel)
+      printf("failed to delete referring record.\n");
+    return 1;
+  }
+  for(i=0; i<UPDATE_TEST_RECORDS; i++) {
+    if(wg_delete_record(db, recs[i])) {
+      if(printlevel)
+        printf("failed to delete updated record.\n");
+      return 1;
+    }
   }
 
+  if (printlevel>1)
+    printf("********* deferred index update test successful ********** \n");
   return 0;
 }
 
-/** Validate a multi-column index
- *  validates a set of rows starting from *rec.
- *  uses the index_id provided (to facilitate separate testing of
- *   multiple indexes on the same column set).
+/** Test runtime statistics counters
  *
- *  returns 0 if no errors found
- *  returns -1 if value was not indexed or was indexed and shouldn't have been
- *  returns -2 if there was another error
  */
-static int validate_mc_index(void *db, void *rec, size_t rows, gint index_id,
-  gint *columns, size_t col_count, int printlevel) {
-  wg_index_header *hdr = (wg_index_header *) offsettoptr(db, index_id);
-  gint max_col = -1;
-  size_t i;
+static gint wg_check_stats(void *db, int printlevel) {
+  gint counters[WG_STAT_COUNT];
+  void *recs[10];
+  gint lock;
+  int i;
 
-  for(i=0; i<col_count; i++) {
-    if(columns[i] > max_col) {
-      max_col = columns[i];
+  if (printlevel>1)
+    printf("********* testing runtime statistics ********** \n");
+
+  for(i=0; i<WG_STAT_COUNT; i++) {
+    if(!wg_get_stat_name(i)) {
+      if(printlevel)
+        printf("missing name for statistics counter %d.\n", i);
+      return 1;
     }
   }
-
-  if(hdr->type != WG_INDEX_TYPE_HASH_JSON &&
-    hdr->type != WG_INDEX_TYPE_HASH) {
+  if(wg_get_stat_name(WG_STAT_COUNT)) {
+    if(printlevel)
+      printf("wg_get_stat_name accepted an invalid counter.\n");
+    return 1;
   }
 
-  /* Check if all values are indexed */
-  while(rec && rows) {
-    if(wg_get_record_len(db, rec) > max_col) {
-      gint values[MAX_INDEX_FIELDS];
-      gint reclist_offset;
-      int found = 0;
-      for(i=0; i<col_count; i++) {
-        values[i] = wg_get_field(db, rec, columns[i]);
-      }
-
-      reclist_offset = wg_search_hash(db, index_id, values, col_count);
-      /* Check that our original record was among the matched.
-       * also check that the other records have correct values.
-       */
-      if(reclist_offset > 0) {
-        gint *nextoffset = &reclist_offset;
-        while(*nextoffset) {
-          gcell *rec_cell = (gcell *) offsettoptr(db, *nextoffset);
-          void *match = offsettoptr(db, rec_cell->car);
-          if(match == rec) {
-            found = 1;
-          } else {
-            for(i=0; i<col_count; i++) {
-              if(wg_get_field(db, match, columns[i]) != values[i]) {
-                if(printlevel) {
-                  printf("invalid value in matched record: %p col %d\n",
-                    match, (int) columns[i]);
-                }
-                return -1;
-              }
-            }
-          }
-
-          if(hdr->type == WG_INDEX_TYPE_HASH_JSON && \
-            !is_plain_record(match)) {
-            if(printlevel) {
-              printf("record %p shouldn't be indexed\n", rec);
-            }
-            return -1;
-          }
-          nextoffset = &(rec_cell->cdr);
-        }
-      }
-
-      /* check if the record was supposed to have been indexed */
-      if(hdr->type == WG_INDEX_TYPE_HASH || is_plain_record(rec)) {
-        if(!found) {
-          if(printlevel) {
-            printf("missing: record %p\n", rec);
-          }
-          return -1;
-        }
-      }
+#ifdef USE_DBSTATS
+  if(wg_reset_stats(db)) {
+    if(printlevel)
+      printf("wg_reset_stats failed.\n");
+    return 1;
+  }
+  for(i=0; i<10; i++) {
+    recs[i] = wg_create_record(db, 2);
+    if(!recs[i]) {
+      if(printlevel)
+        printf("failed to create a record.\n");
+      return 1;
     }
-    rec = wg_get_next_record(db, rec);
-    rows--;
   }
+  for(i=0; i<3; i++) {
+    if(wg_delete_record(db, recs[i])) {
+      if(printlevel)
+        printf("failed to delete a record.\n");
+      return 1;
+    }
+  }
+  lock = wg_start_read(db);
+  wg_end_read(db, lock);
+
+  if(wg_get_stats(db, counters, WG_STAT_COUNT) != WG_STAT_COUNT) {
+    if(printlevel)
+      printf("wg_get_stats returned wrong counter count.\n");
+    return 1;
+  }
+  if(counters[WG_STAT_RECORDS_CREATED] != 10 ||\
+    counters[WG_STAT_RECORDS_DELETED] != 3 ||\
+    counters[WG_STAT_READ_LOCKS] != 1 ||\
+    counters[WG_STAT_ALLOC_FIXLEN] + counters[WG_STAT_ALLOC_EXACT] +\
+      counters[WG_STAT_ALLOC_SPLIT] + counters[WG_STAT_ALLOC_DV] < 10 ||\
+    counters[WG_STAT_FREE_VARLEN] < 3) {
+    if(printlevel)
+      printf("statistics counters have unexpected values.\n");
+    return 1;
+  }
+  for(i=3; i<10; i++)
+    wg_delete_record(db, recs[i]);
+#else
+  (void) recs;
+  (void) lock;
+  if(wg_get_stats(db, counters, WG_STAT_COUNT) != -1 ||\
+    wg_reset_stats(db) != -1) {
+    if(printlevel)
+      printf("statistics reported as available when not enabled.\n");
+    return 1;
+  }
+#endif
 
+  if (printlevel>1)
+    printf("********* runtime statistics test successful ********** \n");
   return 0;
 }
 
+/** Test lock timing histograms
+ *
+ */
+static gint wg_check_lockstats(void *db, int printlevel) {
+#ifdef USE_LOCKSTATS
+  db_lockstats_area *ls = &(dbmemsegh(db)->lockstats);
+  gint tag, lock, waits, holds;
+  int i;
 
-/* -------------------- child db testing ------------------------ */
+  if (printlevel>1)
+    printf("********* testing lock timing ********** \n");
 
-#ifdef USE_CHILD_DB
-static int childdb_mkindex(void *db, int cnt) {
-  int i;
-  for(i=0; i<cnt; i++) {
-    if(wg_column_to_index_id(db, i, WG_INDEX_TYPE_TTREE, NULL, 0) == -1) {
-      if(wg_create_index(db, i, WG_INDEX_TYPE_TTREE, NULL, 0)) {
-        return 0;
-      }
-    }
+  tag = wg_lock_tag(db, "dbtest");
+  if(tag < 1 || wg_lock_tag(db, "dbtest") != tag ||\
+    wg_lock_tag(db, "default") != 0) {
+    if(printlevel)
+      printf("lock timing tag lookup failed.\n");
+    return 1;
   }
-  return 1;
-}
-
-static int childdb_ckindex(void *db, int cnt, int printlevel) {
-  void *start, *rec;
-  int i, dbsize;
+  if(wg_reset_lockstats(db) || wg_set_lock_tag(db, tag) != 0) {
+    if(printlevel)
+      printf("failed to select lock timing tag.\n");
+    return 1;
+  }
+  for(i=0; i<3; i++) {
+    lock = wg_start_write(db);
+    wg_end_write(db, lock);
+  }
+  wg_set_lock_tag(db, 0);
 
-  start = rec = (void *) wg_get_first_record(db);
-  dbsize = 0;
+  waits = holds = 0;
+  for(i=0; i<WG_LOCKSTAT_BUCKETS; i++) {
+    waits += ls->hist[tag][WG_LOCKSTAT_WRITE].wait[i];
+    holds += ls->hist[tag][WG_LOCKSTAT_WRITE].hold[i];
+  }
+  if(ls->hist[tag][WG_LOCKSTAT_WRITE].count != 3 || waits != 3 ||\
+    holds != 3 || ls->hist[0][WG_LOCKSTAT_WRITE].count != 0) {
+    if(printlevel)
+      printf("lock timing histograms have unexpected values.\n");
+    return 1;
+  }
 
-  /* Get the number of records in database */
-  while(rec) {
-    dbsize++;
-    rec = wg_get_next_record(db, rec);
+  if (printlevel>1)
+    printf("********* lock timing test successful ********** \n");
+#else
+  if(wg_lock_tag(db, "dbtest") != -1 || wg_reset_lockstats(db) != -1) {
+    if(printlevel)
+      printf("lock timing reported as available when not enabled.\n");
+    return 1;
   }
+#endif
+  return 0;
+}
 
-  for(i=0; i<cnt; i++) {
-    if(printlevel > 1)
-      printf("checking (%p %d).\n", dbmemseg(db), i);
-    if(validate_index(db, start, dbsize, i, printlevel)) {
+/** Test memory usage reporting of the allocation areas
+ *
+ */
+static gint wg_check_area_usage(void *db, int printlevel) {
+  wg_area_usage before, after;
+  void *recs[10];
+  int i;
+
+  if (printlevel>1)
+    printf("********* testing area usage ********** \n");
+
+  for(i=0; i<WG_AREA_COUNT; i++) {
+    if(!wg_get_area_name(i) || wg_get_area_usage(db, i, &after)) {
       if(printlevel)
-        printf("index validation failed (%p %d).\n", dbmemseg(db), i);
-      return 0;
+        printf("failed to get usage of area %d.\n", i);
+      return 1;
+    }
+    if(after.used_bytes + after.free_bytes > after.size ||\
+      after.exact_bytes + after.var_bytes + after.dv_bytes !=\
+        after.free_bytes ||\
+      after.largest_free > after.free_bytes) {
+      if(printlevel)
+        printf("area %s usage is inconsistent.\n", wg_get_area_name(i));
+      return 1;
     }
   }
-  return 1;
-}
+  if(wg_get_area_name(WG_AREA_COUNT) ||\
+    wg_get_area_usage(db, WG_AREA_COUNT, &after) != -1) {
+    if(printlevel)
+      printf("invalid area accepted.\n");
+    return 1;
+  }
 
-static int childdb_dropindex(void *db, int cnt) {
-  int i;
-  for(i=0; i<cnt; i++) {
-    gint index_id;
-    if((index_id = \
-      wg_column_to_index_id(db, i, WG_INDEX_TYPE_TTREE, NULL, 0)) != -1) {
-      if(wg_drop_index(db, index_id)) {
-        return 0;
-      }
+  /* records are taken from the datarec area and freed objects
+   * that are not merged with the dv end up in the freelists */
+  wg_get_area_usage(db, WG_AREA_DATAREC, &before);
+  for(i=0; i<10; i++) {
+    recs[i] = wg_create_record(db, 4);
+    if(!recs[i]) {
+      if(printlevel)
+        printf("failed to create a record.\n");
+      return 1;
     }
   }
-  return 1;
+  for(i=0; i<10; i+=2)
+    wg_delete_record(db, recs[i]);
+  wg_get_area_usage(db, WG_AREA_DATAREC, &after);
+  if(after.used_objects != before.used_objects + 5 ||\
+    after.free_objects < before.free_objects + 4 ||\
+    after.used_bytes + after.free_bytes !=\
+      before.used_bytes + before.free_bytes) {
+    if(printlevel)
+      printf("datarec area usage has unexpected values.\n");
+    return 1;
+  }
+  for(i=1; i<10; i+=2)
+    wg_delete_record(db, recs[i]);
+
+  if (printlevel>1)
+    printf("********* area usage test successful ********** \n");
+  return 0;
 }
-#endif
 
-static gint wg_check_childdb(void* db, int printlevel) {
-#ifdef USE_CHILD_DB
-  void *foo;
-  void *rec1, *rec2, *foorec1, *foorec2, *foorec3, *foorec4;
-  gint tmp, str1, str2;
+/** Test the record pointer bitmap
+ *  Deleted records must be rejected and skipped by the record scan.
+ */
+static gint wg_check_recptr_bitmap(void *db, int printlevel) {
+#ifdef USE_RECPTR_BITMAP
+  void *recs[30], *rec, *prev;
+  int i, found;
 
-  if(printlevel>1) {
-    printf("********* testing child database ********** \n");
-  }
+  if (printlevel>1)
+    printf("********* testing record pointer bitmap ********** \n");
 
-  foo = wg_attach_local_database(500000);
+  for(i=0; i<30; i++) {
+    recs[i] = wg_create_record(db, 1 + i%5);
+    if(!recs[i]) {
+      if(printlevel)
+        printf("failed to create a record.\n");
+      return 1;
+    }
+  }
+  for(i=0; i<30; i+=3)
+    wg_delete_record(db, recs[i]);
 
-  if(foo) {
-    if(printlevel>1) {
-#ifndef _WIN32
-      printf("Parent: %p free %td.\nChild: %p free %td extdbs %td size %td\n",
-#else
-      printf("Parent: %p free %Id.\nChild: %p free %Id extdbs %Id size %Id\n",
-#endif
-        dbmemseg(db),
-        dbmemsegh(db)->free,
-        dbmemseg(foo),
-        dbmemsegh(foo)->free,
-        dbmemsegh(foo)->extdbs.count,
-        dbmemsegh(foo)->size);
+  for(i=0; i<30; i++) {
+    if((wg_recptr_check(db, recs[i]) == 0) != (i%3 != 0)) {
+      if(printlevel)
+        printf("record %d has an incorrect bitmap entry.\n", i);
+      return 1;
     }
-  } else {
-    printf("Failed to attach to local database.\n");
+  }
+  if(wg_recptr_check(db, ((char *) recs[1]) + sizeof(gint)) == 0) {
+    if(printlevel)
+      printf("pointer inside a record accepted.\n");
+    return 1;
+  }
+  if(wg_delete_record(db, recs[0]) != -2 ||\
+    wg_delete_record(db, ((char *) recs[1]) + sizeof(gint)) != -2) {
+    if(printlevel)
+      printf("deleted record accepted by the API.\n");
     return 1;
   }
 
-  if(dbmemsegh(db)->key != 0) {
-    /* Test invalid registering */
-    if(!wg_register_external_db(db, foo)) {
+  /* The scan must return the remaining records in order */
+  found = 0;
+  prev = NULL;
+  for(rec = wg_get_first_raw_record(db); rec;
+    rec = wg_get_next_raw_record(db, rec)) {
+    if((char *) rec <= (char *) prev || wg_recptr_check(db, rec)) {
       if(printlevel)
-        printf("Registering the local db in a shared db succeeded, should have failed\n");
-      wg_delete_local_database(foo);
+        printf("record scan returned an invalid record.\n");
       return 1;
     }
+    for(i=0; i<30; i++) {
+      if(rec == recs[i]) {
+        if(i%3 == 0) {
+          if(printlevel)
+            printf("record scan returned a deleted record.\n");
+          return 1;
+        }
+        found++;
+      }
+    }
+    prev = rec;
+  }
+  if(found != 20) {
+    if(printlevel)
+      printf("record scan found %d records instead of 20.\n", found);
+    return 1;
   }
 
-  /* Records in parent db */
-  rec1 = (void *) wg_create_raw_record(db, 3);
-  rec2 = (void *) wg_create_raw_record(db, 3);
+  for(i=0; i<30; i++) {
+    if(i%3)
+      wg_delete_record(db, recs[i]);
+  }
 
-  str1 = wg_encode_str(db, "hello", NULL);
-  wg_set_new_field(db, rec1, 0, str1);
-  wg_set_new_field(db, rec1, 1, wg_encode_str(db, "world", NULL));
-  wg_set_new_field(db, rec1, 2, wg_encode_double(db, 1.234));
-  wg_set_new_field(db, rec2, 0, wg_encode_record(db, rec1));
-  str2 = wg_encode_str(db, "bar", NULL);
-  wg_set_new_field(db, rec2, 1, str2);
+  if (printlevel>1)
+    printf("********* record pointer bitmap test successful ********** \n");
+#endif
+  return 0;
+}
 
-  /* Records in child db */
-  foorec1 = (void *) wg_create_raw_record(foo, 3);
-  foorec2 = (void *) wg_create_raw_record(foo, 3);
+/** Test the query plan and execution profile
+ *
+ */
+static gint wg_check_explain(void *db, int printlevel) {
+  wg_query_explain ex;
+  wg_query_arg arglist[3];
+  void *rec;
+  int i;
 
-  tmp = wg_encode_external_data(foo, db, str1);
+  if (printlevel>1)
+    printf("********* testing query explain ********** \n");
 
-  /* Try storing external data */
-  if(printlevel>1) {
-    printf("Expecting an error: \"wg data handling error: "\
-      "External reference not recognized\".\n");
+  for(i=0; i<20; i++) {
+    rec = wg_create_record(db, 2);
+    if(!rec) {
+      if(printlevel)
+        printf("failed to create a record.\n");
+      return 1;
+    }
+    wg_set_field(db, rec, 0, wg_encode_int(db, i));
+    wg_set_field(db, rec, 1, wg_encode_int(db, i % 2));
   }
-  if(!wg_set_new_field(foo, foorec1, 0, tmp)) {
+
+  /* col1 = 1: no index, every record is examined */
+  arglist[0].column = 1;
+  arglist[0].cond = WG_COND_EQUAL;
+  arglist[0].value = wg_encode_query_param_int(db, 1);
+  if(wg_explain_query(db, NULL, 0, arglist, 1, &ex) ||\
+    ex.qtype != WG_QTYPE_SCAN || ex.index_id != 0 || ex.argc != 1 ||\
+    ex.examined != 20 || ex.returned != 10 || ex.estimated < 20) {
     if(printlevel)
-      printf("Storing external data succeeded, should have failed\n");
-    wg_delete_local_database(foo);
+      printf("unexpected full scan plan or profile.\n");
     return 1;
   }
 
-  /* Test indexes */
-  if(printlevel>1) {
-    printf("Testing child database index.\n");
-  }
-  if(!childdb_mkindex(foo, 3)) {
+  /* 5 <= col0 < 15 and col1 = 1: range on the index on col0 */
+  if(wg_create_index(db, 0, WG_INDEX_TYPE_TTREE, NULL, 0)) {
     if(printlevel)
-      printf("Child database index creation failed\n");
-    wg_delete_local_database(foo);
+      printf("index creation failed.\n");
     return 1;
   }
-  if(!childdb_ckindex(foo, 3, printlevel)) {
+  arglist[1].column = 0;
+  arglist[1].cond = WG_COND_GTEQUAL;
+  arglist[1].value = wg_encode_query_param_int(db, 5);
+  arglist[2].column = 0;
+  arglist[2].cond = WG_COND_LESSTHAN;
+  arglist[2].value = wg_encode_query_param_int(db, 15);
+  if(wg_explain_query(db, NULL, 0, arglist, 3, &ex) ||\
+    ex.qtype != WG_QTYPE_TTREE || ex.column != 0 ||\
+    ex.index_id != wg_column_to_index_id(db, 0, WG_INDEX_TYPE_TTREE,\
+      NULL, 0) ||\
+    ex.start_bound != arglist[1].value || !ex.start_inclusive ||\
+    ex.end_bound != arglist[2].value || ex.end_inclusive ||\
+    ex.argc != 1 || ex.estimated != 10 || ex.examined != 10 ||\
+    ex.returned != 5 || ex.elapsed < 0) {
     if(printlevel)
-      printf("Child database index test failed\n");
-    wg_delete_local_database(foo);
+      printf("unexpected T-tree plan or profile.\n");
     return 1;
   }
 
-  /* Test registering (should fail, as we have indexes) */
-  if(printlevel>1) {
-    printf("Expecting an error: \"db memory allocation error: "\
-      "Database has indexes, external references not allowed\".\n");
-  }
-  if(!wg_register_external_db(foo, db)) {
-    if(printlevel)
-      printf("Registering the external db succeeded, but we have indexes\n");
-    wg_delete_local_database(foo);
-    return 1;
-  }
+  for(i=0; i<3; i++)
+    wg_free_query_param(db, arglist[i].value);
 
-  if(!childdb_dropindex(foo, 3)) {
-    if(printlevel)
-      printf("Dropping indexes failed\n");
-    wg_delete_local_database(foo);
-    return 1;
-  }
+  if (printlevel>1)
+    printf("********* query explain test successful ********** \n");
+  return 0;
+}
 
-  /* Test registering again */
-  if(wg_register_external_db(foo, db)) {
+/** Test record tables
+ *  Table scans, queries and indexes must only see the records
+ *  of the table.
+ */
+static gint wg_check_tables(void *db, int printlevel) {
+  wg_query_arg arglist[1];
+  wg_query *query;
+  void *recs[30], *rec, *prev;
+  gint t1, t2, tables[3], index_id = 0;
+  int i, cnt;
+
+  if (printlevel>1)
+    printf("********* testing tables ********** \n");
+
+  t1 = wg_create_table(db);
+  t2 = wg_create_table(db);
+  if(t1 <= 0 || t2 <= 0 || t1 == t2) {
     if(printlevel)
-      printf("Registering the shared db in local db failed, should have succeeded\n");
-    wg_delete_local_database(foo);
+      printf("table creation failed.\n");
     return 1;
   }
-  if(printlevel>1) {
-    printf("Expecting an error: \"index error: "\
-      "Database has external data, indexes disabled\".\n");
-  }
-  if(childdb_mkindex(foo, 1)) {
-    if(printlevel)
-      printf("Child database index creation succeeded (should have failed)\n");
-    wg_delete_local_database(foo);
-    return 1;
+  tables[0] = 0;
+  tables[1] = t1;
+  tables[2] = t2;
+
+  /* Records of the tables are interleaved with plain records */
+  for(i=0; i<30; i++) {
+    if(tables[i%3])
+      recs[i] = wg_create_table_record(db, tables[i%3], 2);
+    else
+      recs[i] = wg_create_record(db, 2);
+    if(!recs[i]) {
+      if(printlevel)
+        printf("failed to create a record.\n");
+      return 1;
+    }
+    wg_set_field(db, recs[i], 0, wg_encode_int(db, i));
+    wg_set_field(db, recs[i], 1, wg_encode_int(db, i % 2));
   }
 
-  /* Storing external data should now work */
-  if(wg_set_new_field(foo, foorec1, 0, tmp)) {
+  for(i=0; i<30; i++) {
+    if(wg_get_record_table(db, recs[i]) != tables[i%3]) {
+      if(printlevel)
+        printf("record %d has an incorrect table.\n", i);
+      return 1;
+    }
+  }
+  if(wg_get_table_record_count(db, t1) != 10 ||\
+    wg_get_table_record_count(db, t2) != 10 ||\
+    wg_get_table_record_count(db, 0) != -1) {
     if(printlevel)
-      printf("Storing external data failed, should have succeeded\n");
-    wg_delete_local_database(foo);
+      printf("incorrect table record count.\n");
     return 1;
   }
 
-  wg_set_new_field(foo, foorec1, 1, wg_encode_str(foo, "local data", NULL));
-
-  tmp = wg_encode_external_data(foo, db, wg_encode_record(db, rec1));
-  wg_set_new_field(foo, foorec2, 0, tmp);
-  wg_set_new_field(foo, foorec2, 1, wg_encode_str(foo, "more local data", NULL));
-  tmp = wg_encode_external_data(foo, db, str2);
-  wg_set_new_field(foo, foorec2, 2, tmp);
-
-  if(printlevel>1) {
-    printf("Testing data comparing.\n");
+  /* Table scan */
+  cnt = 0;
+  prev = NULL;
+  for(rec = wg_get_first_table_record(db, t1); rec;
+    rec = wg_get_next_table_record(db, t1, rec)) {
+    if((char *) rec <= (char *) prev || wg_get_record_table(db, rec) != t1) {
+      if(printlevel)
+        printf("table scan returned an invalid record.\n");
+      return 1;
+    }
+    prev = rec;
+    cnt++;
   }
-
-  /* Test comparing */
-  foorec3 = (void *) wg_create_raw_record(foo, 3);
-  foorec4 = (void *) wg_create_raw_record(foo, 3);
-
-  wg_set_new_field(foo, foorec3, 0, wg_encode_str(foo, "hello", NULL));
-  wg_set_new_field(foo, foorec3, 1, wg_encode_str(foo, "world", NULL));
-  wg_set_new_field(foo, foorec3, 2, wg_encode_double(foo, 1.234));
-
-  wg_set_new_field(foo, foorec4, 0, wg_encode_record(foo, foorec3));
-  wg_set_new_field(foo, foorec4, 1, wg_encode_str(foo, "more local data", NULL));
-  tmp = wg_encode_external_data(foo, db, str2);
-  wg_set_new_field(foo, foorec4, 2, tmp);
-
-#if WG_COMPARE_REC_DEPTH > 2
-  /* foorec2 and foorec4 should be equal */
-  if(WG_COMPARE(foo,
-    wg_encode_record(foo, foorec2),
-    wg_encode_record(foo, foorec4)) != WG_EQUAL) {
+  if(cnt != 10) {
     if(printlevel)
-      printf("foorec2 and foorec4 were not equal, but should be.\n");
-    wg_delete_local_database(foo);
+      printf("table scan found %d records instead of 10.\n", cnt);
     return 1;
   }
 
-  /* rec1 and foorec3 should be equal */
-  if(WG_COMPARE(foo,
-    wg_encode_external_data(foo, db, wg_encode_record(db, rec1)),
-    wg_encode_record(foo, foorec3)) != WG_EQUAL) {
+  /* Scan query, col1 = 1 */
+  arglist[0].column = 1;
+  arglist[0].cond = WG_COND_EQUAL;
+  arglist[0].value = wg_encode_query_param_int(db, 1);
+  query = wg_make_table_query(db, t2, NULL, 0, arglist, 1);
+  if(!query || query->res_count != 5) {
     if(printlevel)
-      printf("rec1 and foorec3 were not equal, but should be.\n");
-    wg_delete_local_database(foo);
+      printf("table scan query failed.\n");
     return 1;
   }
-#endif
+  while((rec = wg_fetch(db, query))) {
+    if(wg_get_record_table(db, rec) != t2) {
+      if(printlevel)
+        printf("table query returned a record of another table.\n");
+      return 1;
+    }
+  }
+  wg_free_query(db, query);
 
-  /* sanity check: foorec3 and foorec4 should not be equal */
-  if(WG_COMPARE(foo,
-    wg_encode_record(foo, foorec3),
-    wg_encode_record(foo, foorec4)) == WG_EQUAL) {
-    if(printlevel)
-      printf("foorec3 and foorec4 were equal, but should not be.\n");
-    wg_delete_local_database(foo);
-    return 1;
+  /* Index on all records is usable for table queries. An index on
+   * the table only has the records of the table and is not used
+   * by other queries. */
+  arglist[0].column = 0;
+  arglist[0].cond = WG_COND_GTEQUAL;
+  arglist[0].value = wg_encode_query_param_int(db, 0);
+  for(i=0; i<2; i++) {
+    if(!i) {
+      if(wg_create_index(db, 0, WG_INDEX_TYPE_TTREE, NULL, 0)) {
+        if(printlevel)
+          printf("index creation failed.\n");
+        return 1;
+      }
+    } else {
+      if(wg_create_table_index(db, t2, 0, WG_INDEX_TYPE_TTREE, NULL, 0)) {
+        if(printlevel)
+          printf("table index creation failed.\n");
+        return 1;
+      }
+      index_id = wg_table_column_to_index_id(db, t2, 0,
+        WG_INDEX_TYPE_TTREE, NULL, 0);
+      if(index_id < 1 || wg_get_index_table(db, index_id) != t2 ||\
+        wg_column_to_index_id(db, 0, WG_INDEX_TYPE_TTREE, NULL, 0) ==\
+        index_id) {
+        if(printlevel)
+          printf("table index lookup failed.\n");
+        return 1;
+      }
+    }
+    query = wg_make_table_query(db, t2, NULL, 0, arglist, 1);
+    if(!query || query->res_count != 10) {
+      if(printlevel)
+        printf("indexed table query failed.\n");
+      return 1;
+    }
+    while((rec = wg_fetch(db, query))) {
+      if(wg_get_record_table(db, rec) != t2) {
+        if(printlevel)
+          printf("indexed table query returned a record of another table.\n");
+        return 1;
+      }
+    }
+    wg_free_query(db, query);
+    query = wg_make_query(db, NULL, 0, arglist, 1);
+    if(!query || query->res_count != 30) {
+      if(printlevel)
+        printf("indexed query failed.\n");
+      return 1;
+    }
+    wg_free_query(db, query);
   }
 
-#ifdef USE_BACKLINKING
-  /* Test deleting */
-  if(wg_delete_record(db, rec1) != -1) {
+  /* Drop is refused while the table has records or indexes */
+  if(wg_drop_table(db, t1) != -2) {
     if(printlevel)
-      printf("Deleting referenced parent rec1 succeeded (should have failed)\n");
-    wg_delete_local_database(foo);
+      printf("non-empty table was dropped.\n");
     return 1;
   }
-#else
-  if(wg_delete_record(db, rec1) != 0) {
+  for(i=1; i<30; i+=3)
+    wg_delete_record(db, recs[i]);
+  if(wg_get_table_record_count(db, t1) != 0 ||\
+    wg_get_first_table_record(db, t1) || wg_drop_table(db, t1)) {
     if(printlevel)
-      printf("Deleting parent rec1 failed (should have succeeded)\n");
-    wg_delete_local_database(foo);
+      printf("dropping an empty table failed.\n");
     return 1;
   }
-#endif
-  if(wg_delete_record(db, rec2) != 0) {
+  for(i=2; i<30; i+=3)
+    wg_delete_record(db, recs[i]);
+  if(wg_drop_table(db, t2) != -2) {
     if(printlevel)
-      printf("Deleting non-referenced parent rec2 failed (should have succeeded)\n");
-    wg_delete_local_database(foo);
+      printf("table with an index was dropped.\n");
     return 1;
   }
-  if(wg_delete_record(foo, foorec2) != 0) {
+  wg_drop_index(db, index_id);
+  if(wg_drop_table(db, t2) || wg_create_table(db) != t1) {
     if(printlevel)
-      printf("Deleting child foorec2 failed (should have succeeded)\n");
-    wg_delete_local_database(foo);
+      printf("table id was not reused.\n");
     return 1;
   }
 
-  /* right now string refcounts are a bit fishy... skip this */
-  /* wg_set_field(foo, foorec4, 2, tmp); */
-
-  /* this should fail, but we don't want to interact with the
-   * filesystem in these automated tests
-  wg_dump(foo, "invalid.bin");*/
-
-  wg_delete_local_database(foo);
-
-  if(printlevel>1)
-    printf("********* child database test successful ********** \n");
-#else
-  printf("child databases disabled, skipping checks\n");
-#endif
+  if (printlevel>1)
+    printf("********* tables test successful ********** \n");
   return 0;
 }
 
-/* ---------------- schema/JSON related tests ----------------- */
-
-/*
- * Run this on a dedicated database to check the effects
- * of param bits and deleting.
+/** Test the column projection of a table
+ *  The projection must follow record creation, field updates and
+ *  deletes, and table queries on the projected columns must return
+ *  the same rows as a scan.
  */
-static gint wg_check_schema(void* db, int printlevel) {
-  void *rec, *arec, *orec, *trec;
-  gint *gptr;
-  gint tmp1, tmp2, tmp3;
-
-  if(printlevel>1) {
-    printf("********* testing schema functions ********** \n");
-  }
-
-  tmp1 = wg_encode_int(db, 99);
-  tmp2 = wg_encode_int(db, 98);
-  tmp3 = wg_encode_int(db, 97);
+static gint wg_check_table_columns(void *db, int printlevel) {
+  wg_query_arg arglist[1];
+  wg_query *query;
+  void *recs[160], *rec;
+  gint table, columns[2], *values, *values1, count, count1;
+  int i, j, cnt;
 
-  /* Triple */
-  rec = wg_create_triple(db, tmp1, tmp2, tmp3, 0);
+  if (printlevel>1)
+    printf("********* testing table column projection ********** \n");
 
-  /* Check the record (fields and meta bits).
-   * it is not a param.
-   */
-  gptr = ((gint *) rec + RECORD_META_POS);
-  if(*gptr) {
-    if(printlevel) {
-      printf("plain triple is expected to have no meta bits\n");
+  table = wg_create_table(db);
+  columns[0] = 1;
+  columns[1] = 0;
+  for(i=0; i<160; i++) {
+    /* The projection is created halfway through the first 100 records
+     * and the last 60 records are added after deleting most of them. */
+    if(i == 50 && wg_create_table_columns(db, table, columns, 2)) {
+      if(printlevel)
+        printf("projection creation failed.\n");
+      return 1;
     }
-    return 1;
+    if(i == 100) {
+      for(j=0; j<100; j++) {
+        if(j%5 && wg_delete_record(db, recs[j])) {
+          if(printlevel)
+            printf("failed to delete a record.\n");
+          return 1;
+        }
+      }
+    }
+    recs[i] = wg_create_table_record(db, table, 3);
+    if(!recs[i]) {
+      if(printlevel)
+        printf("failed to create a record.\n");
+      return 1;
+    }
+    wg_set_field(db, recs[i], 0, wg_encode_int(db, i));
+    wg_set_new_field(db, recs[i], 1, wg_encode_int(db, i % 4));
   }
-  gptr = ((gint *) rec + RECORD_HEADER_GINTS + WG_SCHEMA_TRIPLE_OFFSET);
-  if(*gptr != tmp1) {
+  wg_set_field(db, recs[155], 0, wg_encode_int(db, 1000));
+
+  /* Every live slot must hold the field values of its record */
+  values = wg_get_table_column(db, table, 0, &count);
+  values1 = wg_get_table_column(db, table, 1, &count1);
+  if(!values || !values1 || count1 != count ||\
+    wg_get_table_column(db, table, 2, &count1)) {
     if(printlevel)
-      printf("triple field 1 does not match\n");
+      printf("projection column lookup failed.\n");
     return 1;
   }
-  if(*(gptr+1) != tmp2) {
+  cnt = 0;
+  for(i=0; i<count; i++) {
+    rec = wg_get_table_column_record(db, table, i);
+    if(!rec) {
+      if(values[i] != WG_ILLEGAL || values1[i] != WG_ILLEGAL) {
+        if(printlevel)
+          printf("deleted row has values in the projection.\n");
+        return 1;
+      }
+      continue;
+    }
+    if(values[i] != wg_get_field(db, rec, 0) ||\
+      values1[i] != wg_get_field(db, rec, 1)) {
+      if(printlevel)
+        printf("projection slot %d differs from the record.\n", i);
+      return 1;
+    }
+    cnt++;
+  }
+  if(cnt != 80 || cnt != wg_get_table_record_count(db, table)) {
     if(printlevel)
-      printf("triple field 2 does not match\n");
+      printf("projection has %d rows instead of 80.\n", cnt);
     return 1;
   }
-  if(*(gptr+2) != tmp3) {
+  if(wg_set_atomic_field(db, recs[155], 0, wg_encode_int(db, 1)) != -13) {
     if(printlevel)
-      printf("triple field 3 does not match\n");
+      printf("atomic update of a projected field was allowed.\n");
     return 1;
   }
 
-  /* the next triple is a param.
-   */
-  rec = wg_create_triple(db, tmp1, tmp2, tmp3, 1);
-  gptr = ((gint *) rec + RECORD_META_POS);
-  if(*gptr != (RECORD_META_NOTDATA|RECORD_META_MATCH)) {
-    if(printlevel) {
-#ifndef _WIN32
-      printf("param triple had invalid meta bits (%td)\n", *gptr);
-#else
-      printf("param triple had invalid meta bits (%Id)\n", *gptr);
-#endif
+  /* The query result is the same with and without the projection */
+  arglist[0].column = 1;
+  arglist[0].cond = WG_COND_EQUAL;
+  arglist[0].value = wg_encode_query_param_int(db, 0);
+  for(j=0; j<2; j++) {
+    query = wg_make_table_query(db, table, NULL, 0, arglist, 1);
+    if(!query || query->res_count != 20) {
+      if(printlevel)
+        printf("projection query failed.\n");
+      return 1;
     }
-    return 1;
-  }
-
-  /* kv-pair */
-  rec = wg_create_kvpair(db, tmp2, tmp3, 1);
-
-  /* Check the record (fields and meta bits).
-   * it is a param.
-   */
-  gptr = ((gint *) rec + RECORD_META_POS);
-  if(*gptr != (RECORD_META_NOTDATA|RECORD_META_MATCH)) {
-    if(printlevel) {
-#ifndef _WIN32
-      printf("param kv-pair had invalid meta bits (%td)\n", *gptr);
-#else
-      printf("param kv-pair had invalid meta bits (%Id)\n", *gptr);
-#endif
+    while((rec = wg_fetch(db, query))) {
+      if(wg_decode_int(db, wg_get_field(db, rec, 1)) != 0) {
+        if(printlevel)
+          printf("projection query returned a wrong record.\n");
+        return 1;
+      }
+    }
+    wg_free_query(db, query);
+    if(!j && wg_drop_table_columns(db, table)) {
+      if(printlevel)
+        printf("failed to drop the projection.\n");
+      return 1;
     }
-    return 1;
-  }
-  gptr = ((gint *) rec + RECORD_HEADER_GINTS + WG_SCHEMA_TRIPLE_OFFSET);
-  if(*gptr != 0) {
-    if(printlevel)
-      printf("kv-pair prefix is not NULL\n");
-    return 1;
   }
-  if(*(gptr+1) != tmp2) {
+  if(wg_get_table_column(db, table, 0, &count) ||\
+    wg_drop_table_columns(db, table) != -1) {
     if(printlevel)
-      printf("kv-pair key does not match\n");
+      printf("projection was not dropped.\n");
     return 1;
   }
-  if(*(gptr+2) != tmp3) {
-    if(printlevel)
+
+  if (printlevel>1)
+    printf("********* table column projection test successful ********** \n");
+  return 0;
+}
+
+/** Test data inserting with multi-column hash indexes
+ *
+ */
+static gint wg_test_index3(void *db, int magnitude, int printlevel) {
+  const int dbsize = 10*magnitude, rand_updates = magnitude;
+  int i, j, k;
+  void *start = NULL, *rec = NULL;
+  long int newv, rnddata;
+  gint index1, index2;
+  gint columns[2];
+
+#ifdef _WIN32
+  srand(102435356);
+#else
+  srandom(102435356); /* fixed seed for repeatable sequences */
+#endif
+
+  /* index the typical key/value columns */
+  columns[0] = 1;
+  columns[1] = 2;
+
+  if(printlevel > 1) {
+    printf("------- hash index test: inserting data --------\n");
+  }
+
+  /* 1st loop: insert data */
+  for(i=0; i<dbsize; i++) {
+    gint enc;
+    rec = wg_create_record(db, 3);
+    if(!i)
+      start = rec;
+    for(j=0; j<2; j++) {
+#ifdef _WIN32
+      rnddata = rand();
+#else
+      rnddata = random();
+#endif
+      newv = rnddata>>4;
+
+      if(rnddata & 1) {
+        enc = wg_encode_int(db, newv);
+      } else {
+        char buf[30];
+        snprintf(buf, 29, "%ld", newv);
+        buf[29] = '\0';
+        enc = wg_encode_str(db, buf, NULL);
+      }
+
+      if(wg_set_field(db, rec, columns[j], enc)) {
+        if(printlevel)
+          fprintf(stderr, "insert error, aborting.\n");
+        return -1;
+      }
+    }
+  }
+
+  if(printlevel > 1) {
+    printf("------- hash index test: creating indexes --------\n");
+  }
+
+  /* Create indexes with data in db */
+  if(wg_create_multi_index(db, columns, 2, WG_INDEX_TYPE_HASH, NULL, 0)) {
+    if(printlevel)
+      fprintf(stderr, "index creation failed, aborting.\n");
+    return -3;
+  }
+  if((index1 = wg_multi_column_to_index_id(db,
+    columns, 2, WG_INDEX_TYPE_HASH, NULL, 0)) == -1) {
+    if(printlevel)
+      fprintf(stderr, "index not found after creation.\n");
+    return -3;
+  }
+
+  /* Create indexes with data in db */
+  if(wg_create_multi_index(db, columns, 2, WG_INDEX_TYPE_HASH_JSON, NULL, 0)) {
+    if(printlevel)
+      fprintf(stderr, "index creation failed, aborting.\n");
+    return -3;
+  }
+  if((index2 = wg_multi_column_to_index_id(db,
+    columns, 2, WG_INDEX_TYPE_HASH_JSON, NULL, 0)) == -1) {
+    if(printlevel)
+      fprintf(stderr, "index not found after creation.\n");
+    return -3;
+  }
+
+  if(printlevel > 1) {
+    printf("------- hash index test: validating indexes --------\n");
+  }
+
+  if(validate_mc_index(db, start, dbsize, index1, columns, 2, printlevel)) {
+    if(printlevel)
+      fprintf(stderr, "index1 validation failed after insert.\n");
+    return -2;
+  }
+
+  if(validate_mc_index(db, start, dbsize, index2, columns, 2, printlevel)) {
+    if(printlevel)
+      fprintf(stderr, "index2 validation failed after insert.\n");
+    return -2;
+  }
+
+  if(printlevel > 1) {
+    printf("------- hash index test: updating data --------\n");
+  }
+
+  /* 2nd loop: keep updating with random data */
+  for(k=0; k<rand_updates; k++) {
+    for(i=0; i<dbsize; i++) {
+      gint enc, oldenc;
+      if(!i)
+        rec = start;
+      else
+        rec = wg_get_next_record(db, rec);
+
+      for(j=0; j<2; j++) {
+#ifdef _WIN32
+        rnddata = rand();
+#else
+        rnddata = random();
+#endif
+        newv = rnddata>>4;
+
+        if(rnddata & 1) {
+          enc = wg_encode_int(db, newv);
+        } else {
+          char buf[30];
+          snprintf(buf, 29, "%ld", newv);
+          buf[29] = '\0';
+          enc = wg_encode_str(db, buf, NULL);
+        }
+
+        oldenc = wg_get_field(db, rec, columns[j]);
+        if(wg_set_field(db, rec, columns[j], enc)) {
+          if(printlevel) {
+            printf("loop: %d row: %d old (encoded): %d new (encoded): %d\n",
+              k, i, (int) oldenc, (int) enc);
+            fprintf(stderr, "insert error, aborting.\n");
+          }
+          return -1;
+        }
+      }
+
+      if(validate_mc_index(db,
+        start, dbsize, index1, columns, 2, printlevel)) {
+        if(printlevel) {
+          printf("loop: %d row: %d\n", k, i);
+          fprintf(stderr, "index1 validation failed after update.\n");
+        }
+        return -2;
+      }
+      if(validate_mc_index(db,
+        start, dbsize, index2, columns, 2, printlevel)) {
+        if(printlevel) {
+          printf("loop: %d row: %d\n", k, i);
+          fprintf(stderr, "index2 validation failed after update.\n");
+        }
+        return -2;
+      }
+    }
+  }
+
+  if(printlevel > 1) {
+    printf("------- hash index test: no errors found --------\n");
+  }
+
+  return 0;
+}
+
+
+/** Validate a T-tree index
+ *  1. validates a set of rows starting from *rec.
+ *  2. checks tree balance
+ *  3. checks tree min/max values
+ *  returns 0 if no errors found
+ *  returns -1 if value was not indexed
+ *  returns -2 if there was another error
+ */
+static int validate_index(void *db, void *rec, int rows, int column,
+  int printlevel) {
+  gint index_id = wg_column_to_index_id(db, column,
+    WG_INDEX_TYPE_TTREE, NULL, 0);
+  gint tnode_offset;
+  wg_index_header *hdr;
+
+  if(index_id == -1)
+    return -2;
+
+  /* Check if all values are indexed */
+  while(rec && rows) {
+    if(wg_get_record_len(db, rec) > column) {
+      gint val = wg_get_field(db, rec, column);
+      if(wg_search_ttree_index(db, index_id, val) < 1) {
+        if(printlevel) {
+          printf("missing: %d\n", (int) val);
+        }
+        return -1;
+      }
+    }
+    rec = wg_get_next_record(db, rec);
+    rows--;
+  }
+
+  hdr = (wg_index_header *) offsettoptr(db, index_id);
+
+  if(((struct wg_tnode *)(offsettoptr(db,
+    TTREE_ROOT_NODE(hdr))))->parent_offset != 0) {
+    if(printlevel)
+      printf("root node parent offset is not 0\n");
+    return -2;
+  }
+#ifdef TTREE_CHAINED_NODES
+  if(TTREE_MIN_NODE(hdr) == 0) {
+    if(printlevel)
+      printf("min node offset is 0\n");
+    return -2;
+  }
+  if(TTREE_MAX_NODE(hdr) == 0) {
+    if(printlevel)
+      printf("max node offset is 0\n");
+    return -2;
+  }
+#endif
+
+#ifdef TTREE_CHAINED_NODES
+  tnode_offset = TTREE_MIN_NODE(hdr);
+#else
+  tnode_offset = wg_ttree_find_lub_node(db, TTREE_ROOT_NODE(hdr));
+#endif
+  while(tnode_offset) {
+    int diff;
+    gint minval, maxval;
+    struct wg_tnode *node = (struct wg_tnode *) offsettoptr(db, tnode_offset);
+
+    /* Check index tree balance */
+    diff = node->left_subtree_height - node->right_subtree_height;
+    if(diff < -1 || diff > 1)
+      return -2;
+
+    /* Check min/max values */
+    minval = wg_get_field(db,
+      offsettoptr(db, node->array_of_values[0]), column);
+    maxval = wg_get_field(db,
+      offsettoptr(db, node->array_of_values[node->number_of_elements - 1]),
+      column);
+    if(minval != node->current_min) {
+      if(printlevel) {
+        printf("current_min invalid: %d is: %d should be: %d\n",
+          (int) tnode_offset, (int) node->current_min,
+          (int) minval);
+      }
+      return -2;
+    }
+    if(maxval != node->current_max) {
+      if(printlevel) {
+        printf("current_max invalid: %d is: %d should be: %d\n",
+          (int) tnode_offset, (int) node->current_max,
+          (int) maxval);
+      }
+      return -2;
+    }
+
+    tnode_offset = TNODE_SUCCESSOR(db, node);
+  }
+
+  return 0;
+}
+
+/** Validate a multi-column index
+ *  validates a set of rows starting from *rec.
+ *  uses the index_id provided (to facilitate separate testing of
+ *   multiple indexes on the same column set).
+ *
+ *  returns 0 if no errors found
+ *  returns -1 if value was not indexed or was indexed and shouldn't have been
+ *  returns -2 if there was another error
+ */
+static int validate_mc_index(void *db, void *rec, size_t rows, gint index_id,
+  gint *columns, size_t col_count, int printlevel) {
+  wg_index_header *hdr = (wg_index_header *) offsettoptr(db, index_id);
+  gint max_col = -1;
+  size_t i;
+
+  for(i=0; i<col_count; i++) {
+    if(columns[i] > max_col) {
+      max_col = columns[i];
+    }
+  }
+
+  if(hdr->type != WG_INDEX_TYPE_HASH_JSON &&
+    hdr->type != WG_INDEX_TYPE_HASH) {
+  }
+
+  /* Check if all values are indexed */
+  while(rec && rows) {
+    if(wg_get_record_len(db, rec) > max_col) {
+      gint values[MAX_INDEX_FIELDS];
+      gint reclist_offset;
+      int found = 0;
+      for(i=0; i<col_count; i++) {
+        values[i] = wg_get_field(db, rec, columns[i]);
+      }
+
+      reclist_offset = wg_search_hash(db, index_id, values, col_count);
+      /* Check that our original record was among the matched.
+       * also check that the other records have correct values.
+       */
+      if(reclist_offset > 0) {
+        gint *nextoffset = &reclist_offset;
+        while(*nextoffset) {
+          gcell *rec_cell = (gcell *) offsettoptr(db, *nextoffset);
+          void *match = offsettoptr(db, rec_cell->car);
+          if(match == rec) {
+            found = 1;
+          } else {
+            for(i=0; i<col_count; i++) {
+              if(wg_get_field(db, match, columns[i]) != values[i]) {
+                if(printlevel) {
+                  printf("invalid value in matched record: %p col %d\n",
+                    match, (int) columns[i]);
+                }
+                return -1;
+              }
+            }
+          }
+
+          if(hdr->type == WG_INDEX_TYPE_HASH_JSON && \
+            !is_plain_record(match)) {
+            if(printlevel) {
+              printf("record %p shouldn't be indexed\n", rec);
+            }
+            return -1;
+          }
+          nextoffset = &(rec_cell->cdr);
+        }
+      }
+
+      /* check if the record was supposed to have been indexed */
+      if(hdr->type == WG_INDEX_TYPE_HASH || is_plain_record(rec)) {
+        if(!found) {
+          if(printlevel) {
+            printf("missing: record %p\n", rec);
+          }
+          return -1;
+        }
+      }
+    }
+    rec = wg_get_next_record(db, rec);
+    rows--;
+  }
+
+  return 0;
+}
+
+
+/* -------------------- child db testing ------------------------ */
+
+#ifdef USE_CHILD_DB
+static int childdb_mkindex(void *db, int cnt) {
+  int i;
+  for(i=0; i<cnt; i++) {
+    if(wg_column_to_index_id(db, i, WG_INDEX_TYPE_TTREE, NULL, 0) == -1) {
+      if(wg_create_index(db, i, WG_INDEX_TYPE_TTREE, NULL, 0)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+static int childdb_ckindex(void *db, int cnt, int printlevel) {
+  void *start, *rec;
+  int i, dbsize;
+
+  start = rec = (void *) wg_get_first_record(db);
+  dbsize = 0;
+
+  /* Get the number of records in database */
+  while(rec) {
+    dbsize++;
+    rec = wg_get_next_record(db, rec);
+  }
+
+  for(i=0; i<cnt; i++) {
+    if(printlevel > 1)
+      printf("checking (%p %d).\n", dbmemseg(db), i);
+    if(validate_index(db, start, dbsize, i, printlevel)) {
+      if(printlevel)
+        printf("index validation failed (%p %d).\n", dbmemseg(db), i);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int childdb_dropindex(void *db, int cnt) {
+  int i;
+  for(i=0; i<cnt; i++) {
+    gint index_id;
+    if((index_id = \
+      wg_column_to_index_id(db, i, WG_INDEX_TYPE_TTREE, NULL, 0)) != -1) {
+      if(wg_drop_index(db, index_id)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+#endif
+
+static gint wg_check_childdb(void* db, int printlevel) {
+#ifdef USE_CHILD_DB
+  void *foo;
+  void *rec1, *rec2, *foorec1, *foorec2, *foorec3, *foorec4;
+  gint tmp, str1, str2;
+
+  if(printlevel>1) {
+    printf("********* testing child database ********** \n");
+  }
+
+  foo = wg_attach_local_database(500000);
+
+  if(foo) {
+    if(printlevel>1) {
+#ifndef _WIN32
+      printf("Parent: %p free %td.\nChild: %p free %td extdbs %td size %td\n",
+#else
+      printf("Parent: %p free %Id.\nChild: %p free %Id extdbs %Id size %Id\n",
+#endif
+        dbmemseg(db),
+        dbmemsegh(db)->free,
+        dbmemseg(foo),
+        dbmemsegh(foo)->free,
+        dbmemsegh(foo)->extdbs.count,
+        dbmemsegh(foo)->size);
+    }
+  } else {
+    printf("Failed to attach to local database.\n");
+    return 1;
+  }
+
+  if(dbmemsegh(db)->key != 0) {
+    /* Test invalid registering */
+    if(!wg_register_external_db(db, foo)) {
+      if(printlevel)
+        printf("Registering the local db in a shared db succeeded, should have failed\n");
+      wg_delete_local_database(foo);
+      return 1;
+    }
+  }
+
+  /* Records in parent db */
+  rec1 = (void *) wg_create_raw_record(db, 3);
+  rec2 = (void *) wg_create_raw_record(db, 3);
+
+  /* long enough not to be stored as an immediate tiny string */
+  str1 = wg_encode_str(db, "hello there", NULL);
+  wg_set_new_field(db, rec1, 0, str1);
+  wg_set_new_field(db, rec1, 1, wg_encode_str(db, "world", NULL));
+  wg_set_new_field(db, rec1, 2, wg_encode_double(db, 1.234));
+  wg_set_new_field(db, rec2, 0, wg_encode_record(db, rec1));
+  str2 = wg_encode_str(db, "bar", NULL);
+  wg_set_new_field(db, rec2, 1, str2);
+
+  /* Records in child db */
+  foorec1 = (void *) wg_create_raw_record(foo, 3);
+  foorec2 = (void *) wg_create_raw_record(foo, 3);
+
+  tmp = wg_encode_external_data(foo, db, str1);
+
+  /* Try storing external data */
+  if(printlevel>1) {
+    printf("Expecting an error: \"wg data handling error: "\
+      "External reference not recognized\".\n");
+  }
+  if(!wg_set_new_field(foo, foorec1, 0, tmp)) {
+    if(printlevel)
+      printf("Storing external data succeeded, should have failed\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+
+  /* Test indexes */
+  if(printlevel>1) {
+    printf("Testing child database index.\n");
+  }
+  if(!childdb_mkindex(foo, 3)) {
+    if(printlevel)
+      printf("Child database index creation failed\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+  if(!childdb_ckindex(foo, 3, printlevel)) {
+    if(printlevel)
+      printf("Child database index test failed\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+
+  /* Test registering (should fail, as we have indexes) */
+  if(printlevel>1) {
+    printf("Expecting an error: \"db memory allocation error: "\
+      "Database has indexes, external references not allowed\".\n");
+  }
+  if(!wg_register_external_db(foo, db)) {
+    if(printlevel)
+      printf("Registering the external db succeeded, but we have indexes\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+
+  if(!childdb_dropindex(foo, 3)) {
+    if(printlevel)
+      printf("Dropping indexes failed\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+
+  /* Test registering again */
+  if(wg_register_external_db(foo, db)) {
+    if(printlevel)
+      printf("Registering the shared db in local db failed, should have succeeded\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+  if(printlevel>1) {
+    printf("Expecting an error: \"index error: "\
+      "Database has external data, indexes disabled\".\n");
+  }
+  if(childdb_mkindex(foo, 1)) {
+    if(printlevel)
+      printf("Child database index creation succeeded (should have failed)\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+
+  /* Storing external data should now work */
+  if(wg_set_new_field(foo, foorec1, 0, tmp)) {
+    if(printlevel)
+      printf("Storing external data failed, should have succeeded\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+
+  wg_set_new_field(foo, foorec1, 1, wg_encode_str(foo, "local data", NULL));
+
+  tmp = wg_encode_external_data(foo, db, wg_encode_record(db, rec1));
+  wg_set_new_field(foo, foorec2, 0, tmp);
+  wg_set_new_field(foo, foorec2, 1, wg_encode_str(foo, "more local data", NULL));
+  tmp = wg_encode_external_data(foo, db, str2);
+  wg_set_new_field(foo, foorec2, 2, tmp);
+
+  if(printlevel>1) {
+    printf("Testing data comparing.\n");
+  }
+
+  /* Test comparing */
+  foorec3 = (void *) wg_create_raw_record(foo, 3);
+  foorec4 = (void *) wg_create_raw_record(foo, 3);
+
+  wg_set_new_field(foo, foorec3, 0, wg_encode_str(foo, "hello there", NULL));
+  wg_set_new_field(foo, foorec3, 1, wg_encode_str(foo, "world", NULL));
+  wg_set_new_field(foo, foorec3, 2, wg_encode_double(foo, 1.234));
+
+  wg_set_new_field(foo, foorec4, 0, wg_encode_record(foo, foorec3));
+  wg_set_new_field(foo, foorec4, 1, wg_encode_str(foo, "more local data", NULL));
+  tmp = wg_encode_external_data(foo, db, str2);
+  wg_set_new_field(foo, foorec4, 2, tmp);
+
+#if WG_COMPARE_REC_DEPTH > 2
+  /* foorec2 and foorec4 should be equal */
+  if(WG_COMPARE(foo,
+    wg_encode_record(foo, foorec2),
+    wg_encode_record(foo, foorec4)) != WG_EQUAL) {
+    if(printlevel)
+      printf("foorec2 and foorec4 were not equal, but should be.\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+
+  /* rec1 and foorec3 should be equal */
+  if(WG_COMPARE(foo,
+    wg_encode_external_data(foo, db, wg_encode_record(db, rec1)),
+    wg_encode_record(foo, foorec3)) != WG_EQUAL) {
+    if(printlevel)
+      printf("rec1 and foorec3 were not equal, but should be.\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+#endif
+
+  /* sanity check: foorec3 and foorec4 should not be equal */
+  if(WG_COMPARE(foo,
+    wg_encode_record(foo, foorec3),
+    wg_encode_record(foo, foorec4)) == WG_EQUAL) {
+    if(printlevel)
+      printf("foorec3 and foorec4 were equal, but should not be.\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+
+#ifdef USE_BACKLINKING
+  /* Test deleting */
+  if(wg_delete_record(db, rec1) != -1) {
+    if(printlevel)
+      printf("Deleting referenced parent rec1 succeeded (should have failed)\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+#else
+  if(wg_delete_record(db, rec1) != 0) {
+    if(printlevel)
+      printf("Deleting parent rec1 failed (should have succeeded)\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+#endif
+  if(wg_delete_record(db, rec2) != 0) {
+    if(printlevel)
+      printf("Deleting non-referenced parent rec2 failed (should have succeeded)\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+  if(wg_delete_record(foo, foorec2) != 0) {
+    if(printlevel)
+      printf("Deleting child foorec2 failed (should have succeeded)\n");
+    wg_delete_local_database(foo);
+    return 1;
+  }
+
+  /* right now string refcounts are a bit fishy... skip this */
+  /* wg_set_field(foo, foorec4, 2, tmp); */
+
+  /* this should fail, but we don't want to interact with the
+   * filesystem in these automated tests
+  wg_dump(foo, "invalid.bin");*/
+
+  wg_delete_local_database(foo);
+
+  if(printlevel>1)
+    printf("********* child database test successful ********** \n");
+#else
+  printf("child databases disabled, skipping checks\n");
+#endif
+  return 0;
+}
+
+/* ---------------- schema/JSON related tests ----------------- */
+
+/*
+ * Run this on a dedicated database to check the effects
+ * of param bits and deleting.
+ */
+static gint wg_check_schema(void* db, int printlevel) {
+  void *rec, *arec, *orec, *trec;
+  gint *gptr;
+  gint tmp1, tmp2, tmp3;
+
+  if(printlevel>1) {
+    printf("********* testing schema functions ********** \n");
+  }
+
+  tmp1 = wg_encode_int(db, 99);
+  tmp2 = wg_encode_int(db, 98);
+  tmp3 = wg_encode_int(db, 97);
+
+  /* Triple */
+  rec = wg_create_triple(db, tmp1, tmp2, tmp3, 0);
+
+  /* Check the record (fields and meta bits).
+   * it is not a param.
+   */
+  gptr = ((gint *) rec + RECORD_META_POS);
+  if(*gptr) {
+    if(printlevel) {
+      printf("plain triple is expected to have no meta bits\n");
+    }
+    return 1;
+  }
+  gptr = ((gint *) rec + RECORD_HEADER_GINTS + WG_SCHEMA_TRIPLE_OFFSET);
+  if(*gptr != tmp1) {
+    if(printlevel)
+      printf("triple field 1 does not match\n");
+    return 1;
+  }
+  if(*(gptr+1) != tmp2) {
+    if(printlevel)
+      printf("triple field 2 does not match\n");
+    return 1;
+  }
+  if(*(gptr+2) != tmp3) {
+    if(printlevel)
+      printf("triple field 3 does not match\n");
+    return 1;
+  }
+
+  /* the next triple is a param.
+   */
+  rec = wg_create_triple(db, tmp1, tmp2, tmp3, 1);
+  gptr = ((gint *) rec + RECORD_META_POS);
+  if(*gptr != (RECORD_META_NOTDATA|RECORD_META_MATCH)) {
+    if(printlevel) {
+#ifndef _WIN32
+      printf("param triple had invalid meta bits (%td)\n", *gptr);
+#else
+      printf("param triple had invalid meta bits (%Id)\n", *gptr);
+#endif
+    }
+    return 1;
+  }
+
+  /* kv-pair */
+  rec = wg_create_kvpair(db, tmp2, tmp3, 1);
+
+  /* Check the record (fields and meta bits).
+   * it is a param.
+   */
+  gptr = ((gint *) rec + RECORD_META_POS);
+  if(*gptr != (RECORD_META_NOTDATA|RECORD_META_MATCH)) {
+    if(printlevel) {
+#ifndef _WIN32
+      printf("param kv-pair had invalid meta bits (%td)\n", *gptr);
+#else
+      printf("param kv-pair had invalid meta bits (%Id)\n", *gptr);
+#endif
+    }
+    return 1;
+  }
+  gptr = ((gint *) rec + RECORD_HEADER_GINTS + WG_SCHEMA_TRIPLE_OFFSET);
+  if(*gptr != 0) {
+    if(printlevel)
+      printf("kv-pair prefix is not NULL\n");
+    return 1;
+  }
+  if(*(gptr+1) != tmp2) {
+    if(printlevel)
+      printf("kv-pair key does not match\n");
+    return 1;
+  }
+  if(*(gptr+2) != tmp3) {
+    if(printlevel)
       printf("kv-pair value does not match\n");
     return 1;
   }
@@ -3880,6 +5304,11 @@ static gint wg_check_schema(void* db, int printlevel) {
 static gint wg_check_json_parsing(void* db, int printlevel) {
   void *doc, *rec;
   gint enc;
+#ifdef USE_BACKLINKING
+  wg_json_query_arg arglist[1];
+  wg_query *query;
+  int cnt;
+#endif
 
   char *json1 = "[7,8,9]"; /* ok */
   char *json2 = "{ \"a\":{\n\"b\": 55.0\n}, \"c\"\n:\"hello\","\
@@ -4081,95 +5510,499 @@ static gint wg_check_json_parsing(void* db, int printlevel) {
     return 1;
   }
 
-  enc = wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET);
-  if(wg_get_encoded_type(db, enc) != WG_STRTYPE) {
-    if(printlevel)
-      printf("Document structure error: value type.\n");
-    return 1;
-  }
-  if(strncmp("hello", wg_decode_str(db, enc), 5)) {
-    if(printlevel)
-      printf("Document structure error: bad value.\n");
-    return 1;
+  enc = wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET);
+  if(wg_get_encoded_type(db, enc) != WG_STRTYPE) {
+    if(printlevel)
+      printf("Document structure error: value type.\n");
+    return 1;
+  }
+  if(strncmp("hello", wg_decode_str(db, enc), 5)) {
+    if(printlevel)
+      printf("Document structure error: bad value.\n");
+    return 1;
+  }
+
+  /* third kv-pair */
+  enc = wg_get_field(db, doc, 2);
+  if(wg_get_encoded_type(db, enc) != WG_RECORDTYPE) {
+    if(printlevel)
+      printf("Document structure error: bad object element(0).\n");
+    return 1;
+  }
+  rec = wg_decode_record(db, enc);
+
+  enc = wg_get_field(db, rec, WG_SCHEMA_KEY_OFFSET);
+  if(wg_get_encoded_type(db, enc) != WG_STRTYPE) {
+    if(printlevel)
+      printf("Document structure error: bad key type.\n");
+    return 1;
+  }
+  if(strncmp("d", wg_decode_str(db, enc), 1)) {
+    if(printlevel)
+      printf("Document structure error: bad key string.\n");
+    return 1;
+  }
+
+  enc = wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET);
+  if(wg_get_encoded_type(db, enc) != WG_RECORDTYPE) {
+    if(printlevel)
+      printf("Document structure error: bad value type.\n");
+    return 1;
+  }
+  rec = wg_decode_record(db, enc);
+  if(!is_schema_array(rec)) {
+    if(printlevel) {
+      printf("Document structure error: bad value (array expected)\n");
+    }
+  }
+  if(wg_get_record_len(db, rec) != 0) {
+    if(printlevel)
+      printf("Document structure error: bad array length.\n");
+    return 1;
+  }
+
+#ifdef USE_BACKLINKING
+  /* Store the document and query it, then free the query. Documents
+   * are found through backlinks, without them the query fails.
+   */
+  doc = NULL;
+  if(wg_parse_json_document(db, json2, &doc) || !doc) {
+    if(printlevel)
+      printf("Parsing a valid document failed.\n");
+    return 1;
+  }
+  memset(arglist, 0, sizeof(arglist));
+  arglist[0].key = wg_encode_query_param_str(db, "c", NULL);
+  arglist[0].value = wg_encode_query_param_str(db, "hello", NULL);
+  query = wg_make_json_query(db, arglist, 1);
+  if(!query) {
+    if(printlevel)
+      printf("Failed to create a JSON query.\n");
+    return 1;
+  }
+  cnt = 0;
+  while((rec = wg_fetch(db, query))) {
+    if(rec != doc) {
+      if(printlevel)
+        printf("JSON query returned a wrong document.\n");
+      return 1;
+    }
+    cnt++;
+  }
+  wg_free_query(db, query);
+  wg_free_query_param(db, arglist[0].key);
+  wg_free_query_param(db, arglist[0].value);
+  if(cnt != 1) {
+    if(printlevel)
+      printf("JSON query returned %d documents (expected 1).\n", cnt);
+    return 1;
+  }
+#endif
+
+  /* Invalid documents, expect a failure.
+   */
+  if(printlevel>1)
+    printf("testing invalid documents, the following errors are expected.\n");
+
+  if(!wg_check_json(db, NULL)) {
+    if(printlevel)
+      printf("Checking an invalid document succeeded (expected to fail).\n");
+    return 1;
+  }
+  if(!wg_check_json(db, json3)) {
+    if(printlevel)
+      printf("Checking an invalid document succeeded (expected to fail).\n");
+    return 1;
+  }
+  if(!wg_parse_json_document(db, json3, NULL)) {
+    if(printlevel)
+      printf("Parsing an invalid document succeeded.\n");
+    return 1;
+  }
+
+  if(!wg_check_json(db, json4)) {
+    if(printlevel)
+      printf("Checking an invalid document succeeded (expected to fail).\n");
+    return 1;
+  }
+  if(!wg_parse_json_param(db, json4, &doc)) {
+    if(printlevel)
+      printf("Parsing an invalid document succeeded.\n");
+    return 1;
+  }
+
+  if(printlevel>1)
+    printf("********* JSON parsing test successful ********** \n");
+
+  return 0;
+}
+
+#ifdef USE_BACKLINKING
+/*
+ * Test JSON queries with conditions. Each query is run with a full
+ * scan, with a T-tree value index, with a value index that has
+ * a template on the key and with a hash index.
+ */
+static gint wg_check_json_query(void* db, int printlevel) {
+  const int docs = 20;
+  char buf[100];
+  wg_json_query_arg arglist[3];
+  gint price, id, tags, pass, icols[2];
+  int i, cnt;
+#ifdef USE_INDEX_TEMPLATE
+  gint matchrec[2];
+#endif
+  struct {
+    gint cond;
+    int ival;       /* used if dval is 0 */
+    double dval;
+    int expected;
+  } tests[] = {
+    { WG_COND_GREATER, 10, 0, 9 },
+    { WG_COND_GTEQUAL, 10, 0, 10 },
+    { WG_COND_LESSTHAN, 0, 5.0, 5 },
+    { WG_COND_LTEQUAL, 0, 4.5, 5 },
+    { WG_COND_GTEQUAL, 0, 17.5, 3 },
+    { WG_COND_NOT_EQUAL, 2, 0, 20 },
+    { 0, 2, 0, 1 },
+    { 0, 0, 4.0, 1 },
+    { WG_COND_NOT_EQUAL, 0, 4.0, 20 },
+    { 0, 0, 0, 0 }
+  };
+
+  if (printlevel>1)
+    printf("********* testing JSON queries ********** \n");
+
+  /* prices are 0, 1.5, 2, 3.5, ... and each document has an
+   * array of tags. One document has a price of a different type. */
+  for(i=0; i<docs; i++) {
+    if(i%2)
+      snprintf(buf, 100, "{\"id\": %d, \"price\": %d.5, "\
+        "\"tags\": [%d, %d]}", i, i, i, i+100);
+    else
+      snprintf(buf, 100, "{\"id\": %d, \"price\": %d, "\
+        "\"tags\": [%d, %d]}", i, i, i, i+100);
+    if(wg_parse_json_document(db, buf, NULL)) {
+      if(printlevel)
+        printf("Parsing a JSON document failed.\n");
+      return 1;
+    }
+  }
+  snprintf(buf, 100, "{\"price\": \"cheap\"}");
+  if(wg_parse_json_document(db, buf, NULL)) {
+    if(printlevel)
+      printf("Parsing a JSON document failed.\n");
+    return 1;
+  }
+
+  price = wg_encode_query_param_str(db, "price", NULL);
+  id = wg_encode_query_param_str(db, "id", NULL);
+  tags = wg_encode_query_param_str(db, "tags", NULL);
+  arglist[0].path = arglist[1].path = 0;
+
+  for(pass=0; pass<4; pass++) {
+    if(pass == 1) {
+      if(wg_create_index(db, WG_SCHEMA_VALUE_OFFSET,
+        WG_INDEX_TYPE_TTREE_JSON, NULL, 0)) {
+        if(printlevel)
+          printf("Failed to create a T-tree JSON index.\n");
+        return 1;
+      }
+    } else if(pass == 2) {
+#ifdef USE_INDEX_TEMPLATE
+      /* only the prices are in the templated index */
+      wg_drop_index(db, wg_column_to_index_id(db, WG_SCHEMA_VALUE_OFFSET,
+        WG_INDEX_TYPE_TTREE_JSON, NULL, 0));
+      matchrec[0] = wg_encode_var(db, 0);
+      matchrec[1] = wg_encode_str(db, "price", NULL);
+      if(wg_create_index(db, WG_SCHEMA_VALUE_OFFSET,
+        WG_INDEX_TYPE_TTREE_JSON, matchrec, 2)) {
+        if(printlevel)
+          printf("Failed to create a templated T-tree JSON index.\n");
+        return 1;
+      }
+#else
+      continue;
+#endif
+    } else if(pass == 3) {
+      icols[0] = WG_SCHEMA_KEY_OFFSET;
+      icols[1] = WG_SCHEMA_VALUE_OFFSET;
+      if(wg_create_multi_index(db, icols, 2,
+        WG_INDEX_TYPE_HASH_JSON, NULL, 0)) {
+        if(printlevel)
+          printf("Failed to create a JSON hash index.\n");
+        return 1;
+      }
+    }
+
+    for(i=0; tests[i].expected || tests[i].cond; i++) {
+      arglist[0].key = price;
+      arglist[0].cond = tests[i].cond;
+      if(tests[i].dval != 0)
+        arglist[0].value = wg_encode_query_param_double(db, tests[i].dval);
+      else
+        arglist[0].value = wg_encode_query_param_int(db, tests[i].ival);
+      cnt = count_json_query(db, arglist, 1);
+      wg_free_query_param(db, arglist[0].value);
+      if(cnt != tests[i].expected) {
+        if(printlevel)
+          printf("JSON query %d (pass %d) returned %d documents, "\
+            "expected %d.\n", i, (int) pass, cnt, tests[i].expected);
+        return 1;
+      }
+    }
+
+    /* array members are compared separately */
+    arglist[0].key = tags;
+    arglist[0].value = wg_encode_query_param_int(db, 115);
+    arglist[0].cond = WG_COND_GREATER;
+    if(count_json_query(db, arglist, 1) != 4) {
+      if(printlevel)
+        printf("JSON range query on an array failed (pass %d).\n",
+          (int) pass);
+      return 1;
+    }
+
+    /* inequality holds if no member of the array is equal */
+    arglist[0].value = wg_encode_query_param_int(db, 105);
+    arglist[0].cond = WG_COND_NOT_EQUAL;
+    if(count_json_query(db, arglist, 1) != 19) {
+      if(printlevel)
+        printf("JSON inequality query on an array failed (pass %d).\n",
+          (int) pass);
+      return 1;
+    }
+    arglist[0].value = wg_encode_query_param_double(db, 105.0);
+    arglist[0].cond = WG_COND_EQUAL;
+    cnt = count_json_query(db, arglist, 1);
+    wg_free_query_param(db, arglist[0].value);
+    if(cnt != 1) {
+      if(printlevel)
+        printf("JSON equality query on an array failed (pass %d).\n",
+          (int) pass);
+      return 1;
+    }
+
+    /* range combined with another clause */
+    arglist[0].key = price;
+    arglist[0].value = wg_encode_query_param_int(db, 10);
+    arglist[0].cond = WG_COND_GTEQUAL;
+    arglist[1].key = id;
+    arglist[1].value = wg_encode_query_param_int(db, 15);
+    arglist[1].cond = WG_COND_LESSTHAN;
+    if(count_json_query(db, arglist, 2) != 5) {
+      if(printlevel)
+        printf("JSON query with two ranges failed (pass %d).\n",
+          (int) pass);
+      return 1;
+    }
+
+    /* the result sets of all three clauses are intersected */
+    arglist[0].value = wg_encode_query_param_int(db, 2);
+    arglist[2].key = tags;
+    arglist[2].value = wg_encode_query_param_int(db, 105);
+    arglist[2].cond = WG_COND_GREATER;
+    arglist[2].path = 0;
+    if(count_json_query(db, arglist, 3) != 9) {
+      if(printlevel)
+        printf("JSON query with three clauses failed (pass %d).\n",
+          (int) pass);
+      return 1;
+    }
   }
 
-  /* third kv-pair */
-  enc = wg_get_field(db, doc, 2);
-  if(wg_get_encoded_type(db, enc) != WG_RECORDTYPE) {
+  /* invalid condition */
+  arglist[0].key = price;
+  arglist[0].value = wg_encode_query_param_int(db, 10);
+  arglist[0].cond = 0x1000;
+  if(printlevel>1)
+    printf("testing an invalid condition, the following error is expected.\n");
+  if(count_json_query(db, arglist, 1) != -1) {
     if(printlevel)
-      printf("Document structure error: bad object element(0).\n");
+      printf("JSON query with an invalid condition succeeded.\n");
     return 1;
   }
-  rec = wg_decode_record(db, enc);
 
-  enc = wg_get_field(db, rec, WG_SCHEMA_KEY_OFFSET);
-  if(wg_get_encoded_type(db, enc) != WG_STRTYPE) {
-    if(printlevel)
-      printf("Document structure error: bad key type.\n");
-    return 1;
-  }
-  if(strncmp("d", wg_decode_str(db, enc), 1)) {
-    if(printlevel)
-      printf("Document structure error: bad key string.\n");
-    return 1;
-  }
+  if(printlevel>1)
+    printf("********* JSON query test successful ********** \n");
+  return 0;
+}
+#endif
 
-  enc = wg_get_field(db, rec, WG_SCHEMA_VALUE_OFFSET);
-  if(wg_get_encoded_type(db, enc) != WG_RECORDTYPE) {
-    if(printlevel)
-      printf("Document structure error: bad value type.\n");
-    return 1;
-  }
-  rec = wg_decode_record(db, enc);
-  if(!is_schema_array(rec)) {
-    if(printlevel) {
-      printf("Document structure error: bad value (array expected)\n");
+/*
+ * Test JSON queries on paths, with and without a path index.
+ */
+static gint wg_check_json_path(void* db, int printlevel) {
+  char *docs[] = {
+    "{\"a\": {\"id\": 5}}",
+    "{\"b\": {\"id\": 5}}",
+    "{\"a\": {\"id\": 6}}",
+    "{\"a\": [{\"id\": 5}, {\"id\": 7}]}",
+    "{\"id\": 5, \"a\": {\"b\": {\"id\": 5}}}",
+    NULL
+  };
+  char buf[100], bigdoc[400];
+  wg_json_query_arg arglist[2];
+  gint icols[2], values[2], index_id, pass;
+  void *first = NULL;
+  int i, len;
+  struct {
+    char *path;
+    gint cond;
+    int val;
+    int expected;
+  } tests[] = {
+    { "a.id", WG_COND_EQUAL, 5, 2 },
+    { "id", WG_COND_EQUAL, 5, 1 },
+    { "a.b.id", WG_COND_EQUAL, 5, 1 },
+    { "a.id", WG_COND_GREATER, 5, 2 },
+    { "b.id", WG_COND_EQUAL, 6, 0 },
+    { NULL, 0, 0, 0 }
+  };
+
+  if (printlevel>1)
+    printf("********* testing JSON path queries ********** \n");
+
+  for(i=0; docs[i]; i++) {
+    void *doc;
+    snprintf(buf, 100, "%s", docs[i]);
+    if(wg_parse_json_document(db, buf, &doc)) {
+      if(printlevel)
+        printf("Parsing a JSON document failed.\n");
+      return 1;
     }
+    if(!first)
+      first = doc;
   }
-  if(wg_get_record_len(db, rec) != 0) {
+
+  /* more keys than there are buffers for decoding tiny strings */
+  len = snprintf(bigdoc, 400, "{");
+  for(i=0; i<20; i++)
+    len += snprintf(bigdoc + len, 400 - len, "\"k%d\": %d, ", i, i);
+  snprintf(bigdoc + len, 400 - len, "\"x\": {\"id\": 42}}");
+  if(wg_parse_json_document(db, bigdoc, NULL)) {
     if(printlevel)
-      printf("Document structure error: bad array length.\n");
+      printf("Parsing a JSON document failed.\n");
     return 1;
   }
 
-  /* Invalid documents, expect a failure.
-   */
-  if(printlevel>1)
-    printf("testing invalid documents, the following errors are expected.\n");
+  icols[0] = WG_SCHEMA_KEY_OFFSET;
+  icols[1] = WG_SCHEMA_VALUE_OFFSET;
+  for(pass=0; pass<2; pass++) {
+    if(pass == 1) {
+      /* the existing documents are indexed */
+      if(wg_create_multi_index(db, icols, 2,
+        WG_INDEX_TYPE_HASH_JSON_PATH, NULL, 0)) {
+        if(printlevel)
+          printf("Failed to create a JSON path index.\n");
+        return 1;
+      }
+    }
 
-  if(!wg_check_json(db, NULL)) {
+    for(i=0; tests[i].path; i++) {
+      int cnt;
+      arglist[0].key = wg_encode_query_param_str(db, tests[i].path, NULL);
+      arglist[0].value = wg_encode_query_param_int(db, tests[i].val);
+      arglist[0].cond = tests[i].cond;
+      arglist[0].path = 1;
+      cnt = count_json_query(db, arglist, 1);
+      wg_free_query_param(db, arglist[0].key);
+      if(cnt != tests[i].expected) {
+        if(printlevel)
+          printf("JSON path query %d (pass %d) returned %d documents, "\
+            "expected %d.\n", i, (int) pass, cnt, tests[i].expected);
+        return 1;
+      }
+    }
+
+    arglist[0].key = wg_encode_query_param_str(db, "x.id", NULL);
+    arglist[0].value = wg_encode_query_param_int(db, 42);
+    arglist[0].cond = WG_COND_EQUAL;
+    arglist[0].path = 1;
+    i = count_json_query(db, arglist, 1);
+    wg_free_query_param(db, arglist[0].key);
+    if(i != 1) {
+      if(printlevel)
+        printf("JSON path query on a document with many keys returned "\
+          "%d documents (pass %d), expected 1.\n", i, (int) pass);
+      return 1;
+    }
+
+    /* two clauses on the same path */
+    arglist[0].key = arglist[1].key = \
+      wg_encode_query_param_str(db, "a.id", NULL);
+    arglist[0].value = wg_encode_query_param_int(db, 5);
+    arglist[0].cond = WG_COND_EQUAL;
+    arglist[1].value = wg_encode_query_param_int(db, 6);
+    arglist[1].cond = WG_COND_GREATER;
+    arglist[0].path = arglist[1].path = 1;
+    i = count_json_query(db, arglist, 2);
+    wg_free_query_param(db, arglist[0].key);
+    if(i != 1) {
+      if(printlevel)
+        printf("JSON path query with two clauses returned %d documents "\
+          "(pass %d), expected 1.\n", i, (int) pass);
+      return 1;
+    }
+  }
+
+  /* Documents added and deleted after creating the index */
+  index_id = wg_multi_column_to_index_id(db, icols, 2,
+    WG_INDEX_TYPE_HASH_JSON_PATH, NULL, 0);
+  snprintf(buf, 100, "%s", docs[0]);
+  if(wg_parse_json_document(db, buf, NULL)) {
     if(printlevel)
-      printf("Checking an invalid document succeeded (expected to fail).\n");
+      printf("Parsing a JSON document failed.\n");
     return 1;
   }
-  if(!wg_check_json(db, json3)) {
+  values[0] = wg_encode_query_param_str(db, "a.id", NULL);
+  values[1] = wg_encode_query_param_int(db, 5);
+  if(count_hash_rows(db, wg_search_hash(db, index_id, values, 2)) != 3) {
     if(printlevel)
-      printf("Checking an invalid document succeeded (expected to fail).\n");
+      printf("New document was not added to the JSON path index.\n");
     return 1;
   }
-  if(!wg_parse_json_document(db, json3, NULL)) {
+  if(wg_delete_document(db, first)) {
     if(printlevel)
-      printf("Parsing an invalid document succeeded.\n");
+      printf("Failed to delete a document.\n");
     return 1;
   }
-
-  if(!wg_check_json(db, json4)) {
+  if(count_hash_rows(db, wg_search_hash(db, index_id, values, 2)) != 2) {
     if(printlevel)
-      printf("Checking an invalid document succeeded (expected to fail).\n");
+      printf("Deleted document was not removed from the JSON path index.\n");
     return 1;
   }
-  if(!wg_parse_json_param(db, json4, &doc)) {
+  arglist[0].key = values[0];
+  arglist[0].value = values[1];
+  arglist[0].cond = WG_COND_EQUAL;
+  arglist[0].path = 1;
+  if(count_json_query(db, arglist, 1) != 2) {
     if(printlevel)
-      printf("Parsing an invalid document succeeded.\n");
+      printf("JSON path query failed after deleting a document.\n");
     return 1;
   }
+  wg_free_query_param(db, values[0]);
 
   if(printlevel>1)
-    printf("********* JSON parsing test successful ********** \n");
-
+    printf("********* JSON path query test successful ********** \n");
   return 0;
 }
 
+/*
+ * Count the documents returned by a JSON query.
+ * Returns -1 if the query fails.
+ */
+static int count_json_query(void *db, wg_json_query_arg *arglist, int argc) {
+  int count = 0;
+  wg_query *query = wg_make_json_query(db, arglist, argc);
+  if(!query)
+    return -1;
+  while(wg_fetch(db, query))
+    count++;
+  wg_free_query(db, query);
+  return count;
+}
+
 /*
  * Returns 1 if the offset is in list.
  * Returns 0 otherwise.
@@ -4187,6 +6020,44 @@ static int is_offset_in_list(void *db, gint reclist_offset, gint offset) {
   return 0;
 }
 
+/*
+ * Count the records in a list returned by wg_search_hash()
+ */
+static int count_hash_rows(void *db, gint reclist_offset) {
+  int count = 0;
+  while(reclist_offset > 0) {
+    gcell *rec_cell = (gcell *) offsettoptr(db, reclist_offset);
+    count++;
+    reclist_offset = rec_cell->cdr;
+  }
+  return count;
+}
+
+#ifdef USE_INDEX_TEMPLATE
+/*
+ * Count the records in a T-tree index
+ */
+static int count_ttree_rows(void *db, gint index_id) {
+  wg_index_header *hdr = (wg_index_header *) offsettoptr(db, index_id);
+  gint node_offset;
+  int count = 0;
+
+#ifdef TTREE_CHAINED_NODES
+  node_offset = TTREE_MIN_NODE(hdr);
+#else
+  node_offset = TTREE_ROOT_NODE(hdr);
+  if(node_offset)
+    node_offset = wg_ttree_find_lub_node(db, node_offset);
+#endif
+  while(node_offset) {
+    struct wg_tnode *node = (struct wg_tnode *) offsettoptr(db, node_offset);
+    count += node->number_of_elements;
+    node_offset = TNODE_SUCCESSOR(db, node);
+  }
+  return count;
+}
+#endif
+
 /*
  * Test index hash (low-level functions)
  */
@@ -4598,207 +6469,649 @@ static gint wg_test_query(void *db, int magnitude, int printlevel) {
   if(printlevel > 1)
     printf("------- Updating test data --------\n");
 
-  /* Update queries */
+  /* Update queries */
+  for(i=0; i<dbsize; i++) {
+    wg_query *query;
+    wg_query_arg arg;
+    char c1[20];
+    snprintf(c1, 19, "%d", 1000 * i);
+    c1[19] = '\0';
+
+    arg.column = 0;
+    arg.cond = WG_COND_EQUAL;
+    arg.value = wg_encode_query_param_str(db, c1, NULL);
+
+    query = wg_make_query(db, NULL, 0, &arg, 1);
+    if(!query) {
+      if(printlevel)
+        printf("wg_make_query() failed\n");
+      wg_free_query_param(db, arg.value);
+      return -4;
+    }
+
+    while((rec = wg_fetch(db, query))) {
+      gint c2 = wg_decode_int(db, wg_get_field(db, rec, 1));
+      if(wg_set_field(db, rec, 1, wg_encode_int(db, c2 + 21))) {
+        if(printlevel)
+          printf("update error, aborting.\n");
+        wg_free_query_param(db, arg.value);
+        return -5;
+      }
+    }
+
+    wg_free_query_param(db, arg.value);
+  }
+
+  for(i=0; i<50; i++) {
+    gint c2 = 100 * i + 21;
+    wg_query *query;
+    wg_query_arg arg;
+
+    arg.column = 1;
+    arg.cond = WG_COND_EQUAL;
+    arg.value = wg_encode_query_param_int(db, c2);
+
+    query = wg_make_query(db, NULL, 0, &arg, 1);
+    if(!query) {
+      if(printlevel)
+        printf("wg_make_query() failed\n");
+      wg_free_query_param(db, arg.value);
+      return -4;
+    }
+
+    while((rec = wg_fetch(db, query))) {
+      double c3 = wg_decode_double(db, wg_get_field(db, rec, 2));
+      if(wg_set_field(db, rec, 2, wg_encode_double(db, c3 - 77.42))) {
+        if(printlevel)
+          printf("update error, aborting.\n");
+        wg_free_query_param(db, arg.value);
+        return -5;
+      }
+    }
+
+    wg_free_query_param(db, arg.value);
+  }
+
+  for(i=0; i<50; i++) {
+    double c3 = 10 * i - 77.42;
+    wg_query *query;
+    wg_query_arg arg;
+
+    arg.column = 2;
+    arg.cond = WG_COND_EQUAL;
+    arg.value = wg_encode_query_param_double(db, c3);
+
+    query = wg_make_query(db, NULL, 0, &arg, 1);
+    if(!query) {
+      if(printlevel)
+        printf("wg_make_query() failed\n");
+      wg_free_query_param(db, arg.value);
+      return -4;
+    }
+
+    while((rec = wg_fetch(db, query))) {
+      char c1[20];
+      int c1val = atol(wg_decode_str(db, wg_get_field(db, rec, 0)));
+
+      snprintf(c1, 19, "%d", c1val * 7);
+      c1[19] = '\0';
+
+      if(wg_set_field(db, rec, 0, wg_encode_str(db, c1, NULL))) {
+        if(printlevel)
+          printf("update error, aborting.\n");
+        wg_free_query_param(db, arg.value);
+        return -5;
+      }
+    }
+
+    wg_free_query_param(db, arg.value);
+  }
+
+  if(printlevel > 1)
+    printf("------- Running read query tests --------\n");
+
+  /* Content check read queries, iteration 2 */
+  for(i=0; i<dbsize; i++) {
+    char buf[20];
+    snprintf(buf, 19, "%d", 1000 * i * 7);
+    buf[19] = '\0';
+
+    if(check_matching_rows(db, 0, WG_COND_EQUAL, (void *) buf,
+     WG_STRTYPE, 50*50, printlevel)) {
+      if(printlevel)
+        printf("content check col=0, i=%d failed.\n", i);
+      return -2;
+    }
+  }
+
+  for(i=0; i<50; i++) {
+    gint val = 100 * i + 21;
+    if(check_matching_rows(db, 1, WG_COND_EQUAL, (void *) &val,
+     WG_INTTYPE, dbsize*50, printlevel)) {
+      if(printlevel)
+        printf("content check col=1, i=%d failed.\n", i);
+      return -2;
+    }
+  }
+
+  for(i=0; i<50; i++) {
+    double val = 10 * i - 77.42;
+    if(check_matching_rows(db, 2, WG_COND_EQUAL, (void *) &val,
+     WG_DOUBLETYPE, dbsize*50, printlevel)) {
+      if(printlevel)
+        printf("content check col=2, i=%d failed.\n", i);
+      return -2;
+    }
+  }
+
+  if(printlevel > 1)
+    printf("------- Running delete queries --------\n");
+
+  /* Delete query */
   for(i=0; i<dbsize; i++) {
     wg_query *query;
-    wg_query_arg arg;
+    wg_query_arg arglist[3];
     char c1[20];
-    snprintf(c1, 19, "%d", 1000 * i);
+    snprintf(c1, 19, "%d", 1000 * i * 7);
     c1[19] = '\0';
 
-    arg.column = 0;
-    arg.cond = WG_COND_EQUAL;
-    arg.value = wg_encode_query_param_str(db, c1, NULL);
+    arglist[0].column = 0;
+    arglist[0].cond = WG_COND_EQUAL;
+    arglist[0].value = wg_encode_query_param_str(db, c1, NULL);
+    arglist[1].column = 1;
+    arglist[1].cond = WG_COND_LESSTHAN;
+    arglist[1].value = wg_encode_query_param_int(db, 2021); /* 20 matching */
+    arglist[2].column = 2;
+    arglist[2].cond = WG_COND_GREATER;
+    arglist[2].value = wg_encode_query_param_double(db, 112.58); /* 30 matching */
 
-    query = wg_make_query(db, NULL, 0, &arg, 1);
+    query = wg_make_query(db, NULL, 0, arglist, 3);
     if(!query) {
       if(printlevel)
         printf("wg_make_query() failed\n");
-      wg_free_query_param(db, arg.value);
+      wg_free_query_param(db, arglist[0].value);
+      wg_free_query_param(db, arglist[1].value);
+      wg_free_query_param(db, arglist[2].value);
       return -4;
     }
 
     while((rec = wg_fetch(db, query))) {
-      gint c2 = wg_decode_int(db, wg_get_field(db, rec, 1));
-      if(wg_set_field(db, rec, 1, wg_encode_int(db, c2 + 21))) {
+      if(wg_delete_record(db, rec)) {
         if(printlevel)
-          printf("update error, aborting.\n");
-        wg_free_query_param(db, arg.value);
-        return -5;
+          printf("delete failed, aborting.\n");
+        wg_free_query_param(db, arglist[0].value);
+        wg_free_query_param(db, arglist[1].value);
+        wg_free_query_param(db, arglist[2].value);
+        return -6;
       }
     }
 
-    wg_free_query_param(db, arg.value);
+    wg_free_query_param(db, arglist[0].value);
+    wg_free_query_param(db, arglist[1].value);
+    wg_free_query_param(db, arglist[2].value);
   }
 
-  for(i=0; i<50; i++) {
-    gint c2 = 100 * i + 21;
-    wg_query *query;
-    wg_query_arg arg;
+  if(printlevel > 1)
+    printf("------- Checking row count --------\n");
 
-    arg.column = 1;
-    arg.cond = WG_COND_EQUAL;
-    arg.value = wg_encode_query_param_int(db, c2);
+  /* Database scan */
+  if(check_db_rows(db, dbsize * (50 * 50 - 30 * 20), printlevel)) {
+    if(printlevel)
+      printf("row count check failed.\n");
+    return -7;
+  }
 
-    query = wg_make_query(db, NULL, 0, &arg, 1);
-    if(!query) {
-      if(printlevel)
-        printf("wg_make_query() failed\n");
-      wg_free_query_param(db, arg.value);
-      return -4;
-    }
+  return 0;
+}
 
-    while((rec = wg_fetch(db, query))) {
-      double c3 = wg_decode_double(db, wg_get_field(db, rec, 2));
-      if(wg_set_field(db, rec, 2, wg_encode_double(db, c3 - 77.42))) {
-        if(printlevel)
-          printf("update error, aborting.\n");
-        wg_free_query_param(db, arg.value);
-        return -5;
-      }
-    }
+/* ------------------------- log testing ------------------------ */
 
-    wg_free_query_param(db, arg.value);
+#ifndef _WIN32
+#define LOG_TESTFILE  "/tmp/wgdb.logtest"
+#else
+#define LOG_TESTFILE  "c:\\windows\\temp\\wgdb.logtest"
+#endif
+
+#if defined(USE_DBLOG)
+/* Create the test journal file and write the header.
+ * Returns the file descriptor, -1 on error.
+ */
+static int open_test_journal(char *logfn, int printlevel) {
+  int fd;
+
+#ifdef _WIN32
+  if(_sopen_s(&fd, logfn, _O_CREAT|_O_APPEND|_O_BINARY|_O_RDWR, _SH_DENYNO,
+    _S_IREAD|_S_IWRITE)) {
+#else
+  if((fd = open(logfn, O_CREAT|O_APPEND|O_RDWR,
+    S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH)) == -1) {
+#endif
+    if(printlevel)
+      printf("Failed to open the test journal\n");
+    return -1;
   }
 
-  for(i=0; i<50; i++) {
-    double c3 = 10 * i - 77.42;
-    wg_query *query;
-    wg_query_arg arg;
+#ifndef _WIN32
+  if(write(fd, WG_JOURNAL_MAGIC, WG_JOURNAL_MAGIC_BYTES) != \
+                                          WG_JOURNAL_MAGIC_BYTES) {
+    if(printlevel)
+      printf("Failed to initialize the test journal\n");
+    close(fd);
+    return -1;
+  }
+#else
+  if(_write(fd, WG_JOURNAL_MAGIC, WG_JOURNAL_MAGIC_BYTES) != \
+                                          WG_JOURNAL_MAGIC_BYTES) {
+    if(printlevel)
+      printf("Failed to initialize the test journal\n");
+    _close(fd);
+    return -1;
+  }
+#endif
+  return fd;
+}
 
-    arg.column = 2;
-    arg.cond = WG_COND_EQUAL;
-    arg.value = wg_encode_query_param_double(db, c3);
+/* Compare the database with the one restored from the test journal.
+ */
+static gint compare_log_clone(void* db, void* clonedb, gint table,
+  int printlevel) {
+  void *rec1, *rec2;
+  int i, err = 0;
 
-    query = wg_make_query(db, NULL, 0, &arg, 1);
-    if(!query) {
+  /* Compare the databases */
+  rec1 = wg_get_first_record(db);
+  rec2 = wg_get_first_record(clonedb);
+  while(rec1) {
+    int len1, len2;
+    gint meta1, meta2;
+
+    if(!rec2) {
       if(printlevel)
-        printf("wg_make_query() failed\n");
-      wg_free_query_param(db, arg.value);
-      return -4;
+        printf("Error: clone database had fewer records\n");
+      err = 1;
+      break;
     }
 
-    while((rec = wg_fetch(db, query))) {
-      char c1[20];
-      int c1val = atol(wg_decode_str(db, wg_get_field(db, rec, 0)));
+    len1 = wg_get_record_len(db, rec1);
+    len2 = wg_get_record_len(clonedb, rec2);
+    if(len1 != len2) {
+      if(printlevel)
+        printf("Error: records had different lengths\n");
+      err = 1;
+      break;
+    }
 
-      snprintf(c1, 19, "%d", c1val * 7);
-      c1[19] = '\0';
+    meta1 = *((gint *) rec1 + RECORD_META_POS);
+    meta2 = *((gint *) rec2 + RECORD_META_POS);
+    if(meta1 != meta2) {
+      if(printlevel)
+        printf("Error: records had different metadata\n");
+      err = 1;
+      break;
+    }
 
-      if(wg_set_field(db, rec, 0, wg_encode_str(db, c1, NULL))) {
+    for(i=0; i<len1; i++) {
+      gint type1, type2;
+      int intdata1, intdata2;
+      double doubledata1, doubledata2;
+      char *strdata1, *strdata2;
+
+      type1 = wg_get_field_type(db, rec1, i);
+      type2 = wg_get_field_type(clonedb, rec2, i);
+
+      if(type1 != type2) {
         if(printlevel)
-          printf("update error, aborting.\n");
-        wg_free_query_param(db, arg.value);
-        return -5;
+          printf("Error: fields had different type\n");
+        err = 1;
+        goto done;
+      }
+
+      switch(type1) {
+        case WG_NULLTYPE:
+          break;
+        case WG_INTTYPE:
+          intdata1 = wg_decode_int(db, wg_get_field(db, rec1, i));
+          intdata2 = wg_decode_int(db, wg_get_field(clonedb, rec2, i));
+          if(intdata1 != intdata2) {
+            if(printlevel)
+              printf("Error: fields had different value\n");
+            err = 1;
+            goto done;
+          }
+          break;
+        case WG_DOUBLETYPE:
+          doubledata1 = wg_decode_double(db, wg_get_field(db, rec1, i));
+          doubledata2 = wg_decode_double(db, wg_get_field(clonedb, rec2, i));
+          if(doubledata1 != doubledata2) {
+            if(printlevel)
+              printf("Error: fields had different value\n");
+            err = 1;
+            goto done;
+          }
+          break;
+        case WG_STRTYPE:
+          strdata1 = wg_decode_str(db, wg_get_field(db, rec1, i));
+          strdata2 = wg_decode_str(db, wg_get_field(clonedb, rec2, i));
+          if(strcmp(strdata1, strdata2)) {
+            if(printlevel)
+              printf("Error: fields had different value\n");
+            err = 1;
+            goto done;
+          }
+          break;
+        case WG_BLOBTYPE:
+          intdata1 = wg_decode_blob_len(db, wg_get_field(db, rec1, i));
+          intdata2 = wg_decode_blob_len(clonedb,
+            wg_get_field(clonedb, rec2, i));
+          strdata1 = wg_decode_blob(db, wg_get_field(db, rec1, i));
+          strdata2 = wg_decode_blob(clonedb, wg_get_field(clonedb, rec2, i));
+          if(intdata1 != intdata2 || memcmp(strdata1, strdata2, intdata1)) {
+            if(printlevel)
+              printf("Error: fields had different value\n");
+            err = 1;
+            goto done;
+          }
+          break;
+        default:
+          if(printlevel)
+            printf("Error: unexpected type\n");
+          err = 1;
+          goto done;
+      }
+    }
+    rec1 = wg_get_next_record(db, rec1);
+    rec2 = wg_get_next_record(clonedb, rec2);
+  }
+  if(rec2) {
+    if(printlevel)
+      printf("Error: clone database had more records\n");
+  }
+  if(wg_get_table_record_count(clonedb, table) != 1) {
+    if(printlevel)
+      printf("Error: table was not restored\n");
+    err = 1;
+  }
+
+
+done:
+  return err;
+}
+
+/* Apply the test journal to a replica database. Half of the journal
+ * is applied first (cutting an entry in the middle), then the rest,
+ * as if the primary database was still writing it.
+ */
+static gint check_log_replica(void* db, char *logfn, gint table,
+  int printlevel) {
+  void *repdb, *replica = NULL;
+  char replfn[110], *buf = NULL;
+  gint applied1, applied2, bytes;
+  long size = 0, half;
+  int err = 1;
+  FILE *f;
+
+  snprintf(replfn, 109, "%s.replica", logfn);
+  replfn[109] = '\0';
+
+  if((f = fopen(logfn, "rb"))) {
+    if(!fseek(f, 0, SEEK_END) && (size = ftell(f)) > 0) {
+      buf = (char *) malloc(size);
+      if(buf && (fseek(f, 0, SEEK_SET) || fread(buf, 1, size, f) != size)) {
+        free(buf);
+        buf = NULL;
       }
     }
+    fclose(f);
+  }
+  if(!buf) {
+    if(printlevel)
+      printf("Failed to read the test journal\n");
+    return 1;
+  }
+  half = size / 2;
 
-    wg_free_query_param(db, arg.value);
+  repdb = wg_attach_local_database(800000);
+  if(!repdb) {
+    if(printlevel)
+      printf("Failed to create a replica memory database\n");
+    free(buf);
+    return 1;
+  }
+
+  if(!(f = fopen(replfn, "wb")) || fwrite(buf, 1, half, f) != half) {
+    if(printlevel)
+      printf("Failed to write the replica journal\n");
+    goto done;
+  }
+  fclose(f);
+  f = NULL;
+
+  replica = wg_start_replica(repdb, replfn);
+  if(!replica) {
+    if(printlevel)
+      printf("Failed to start the replica\n");
+    goto done;
   }
+  applied1 = wg_apply_replica(repdb, replica);
 
-  if(printlevel > 1)
-    printf("------- Running read query tests --------\n");
+  if(!(f = fopen(replfn, "ab")) ||\
+    fwrite(buf + half, 1, size - half, f) != size - half) {
+    if(printlevel)
+      printf("Failed to write the replica journal\n");
+    goto done;
+  }
+  fclose(f);
+  f = NULL;
+  applied2 = wg_apply_replica(repdb, replica);
 
-  /* Content check read queries, iteration 2 */
-  for(i=0; i<dbsize; i++) {
-    char buf[20];
-    snprintf(buf, 19, "%d", 1000 * i * 7);
-    buf[19] = '\0';
+  if(applied1 <= 0 || applied2 <= 0 ||\
+    wg_replica_lag(repdb, &bytes, NULL) || bytes <= 0 ||\
+    wg_apply_replica(repdb, replica) != 0 ||\
+    wg_replica_lag(repdb, &bytes, NULL) || bytes != 0) {
+    if(printlevel)
+      printf("Error: replica did not apply the journal incrementally\n");
+    goto done;
+  }
+  err = compare_log_clone(db, repdb, table, printlevel);
 
-    if(check_matching_rows(db, 0, WG_COND_EQUAL, (void *) buf,
-     WG_STRTYPE, 50*50, printlevel)) {
-      if(printlevel)
-        printf("content check col=0, i=%d failed.\n", i);
-      return -2;
-    }
+  wg_stop_replica(repdb, replica);
+  replica = NULL;
+  if(!err && !wg_replica_lag(repdb, &bytes, NULL)) {
+    if(printlevel)
+      printf("Error: replica was not stopped\n");
+    err = 1;
   }
 
-  for(i=0; i<50; i++) {
-    gint val = 100 * i + 21;
-    if(check_matching_rows(db, 1, WG_COND_EQUAL, (void *) &val,
-     WG_INTTYPE, dbsize*50, printlevel)) {
-      if(printlevel)
-        printf("content check col=1, i=%d failed.\n", i);
-      return -2;
-    }
+done:
+  if(f)
+    fclose(f);
+  if(replica)
+    wg_stop_replica(repdb, replica);
+  wg_delete_local_database(repdb);
+  remove(replfn);
+  free(buf);
+  return err;
+}
+
+/* Apply a journal where a deleted record's offset is reused by a new
+ * record. The replica allocated the deleted record elsewhere and has
+ * the offset free, so the new record gets the same offset in both
+ * databases and the old translation must not be used for it.
+ */
+static gint check_log_replica_reuse(char *logfn, int printlevel) {
+  void *db, *repdb, *replica = NULL, *rec, *dummy;
+  db_handle_logdata *ld;
+  char replfn[110];
+  int fd = -1, err = 1;
+
+  snprintf(replfn, 109, "%s.reuse", logfn);
+  replfn[109] = '\0';
+
+  db = wg_attach_local_database(800000);
+  repdb = wg_attach_local_database(800000);
+  if(!db || !repdb) {
+    if(printlevel)
+      printf("Failed to create a memory database\n");
+    goto done;
   }
+  if((fd = open_test_journal(replfn, printlevel)) == -1)
+    goto done;
+  ld = ((db_handle *) db)->logdata;
+  ld->fd = fd;
+  ld->serial = dbmemsegh(db)->logging.serial;
+  dbmemsegh(db)->logging.active = 1;
 
-  for(i=0; i<50; i++) {
-    double val = 10 * i - 77.42;
-    if(check_matching_rows(db, 2, WG_COND_EQUAL, (void *) &val,
-     WG_DOUBLETYPE, dbsize*50, printlevel)) {
-      if(printlevel)
-        printf("content check col=2, i=%d failed.\n", i);
-      return -2;
-    }
+  dummy = wg_create_record(repdb, 4);
+  rec = wg_create_record(db, 4);
+  replica = wg_start_replica(repdb, replfn);
+  if(!replica || wg_apply_replica(repdb, replica) <= 0) {
+    if(printlevel)
+      printf("Failed to start the replica\n");
+    goto done;
   }
+  wg_delete_record(repdb, dummy);
 
-  if(printlevel > 1)
-    printf("------- Running delete queries --------\n");
+  wg_delete_record(db, rec);
+  rec = wg_create_record(db, 4);
+  wg_set_field(db, rec, 0, wg_encode_int(db, 77));
+  if(wg_apply_replica(repdb, replica) <= 0) {
+    if(printlevel)
+      printf("Failed to apply the journal\n");
+    goto done;
+  }
 
-  /* Delete query */
-  for(i=0; i<dbsize; i++) {
-    wg_query *query;
-    wg_query_arg arglist[3];
-    char c1[20];
-    snprintf(c1, 19, "%d", 1000 * i * 7);
-    c1[19] = '\0';
+  rec = wg_get_first_record(repdb);
+  if(!rec || wg_get_next_record(repdb, rec) ||\
+    wg_decode_int(repdb, wg_get_field(repdb, rec, 0)) != 77) {
+    if(printlevel)
+      printf("Error: replica used the translation of a deleted record\n");
+    goto done;
+  }
+  err = 0;
 
-    arglist[0].column = 0;
-    arglist[0].cond = WG_COND_EQUAL;
-    arglist[0].value = wg_encode_query_param_str(db, c1, NULL);
-    arglist[1].column = 1;
-    arglist[1].cond = WG_COND_LESSTHAN;
-    arglist[1].value = wg_encode_query_param_int(db, 2021); /* 20 matching */
-    arglist[2].column = 2;
-    arglist[2].cond = WG_COND_GREATER;
-    arglist[2].value = wg_encode_query_param_double(db, 112.58); /* 30 matching */
+done:
+  if(replica)
+    wg_stop_replica(repdb, replica);
+  if(fd != -1) {
+#ifndef _WIN32
+    close(fd);
+#else
+    _close(fd);
+#endif
+    ld->fd = -1;
+    remove(replfn);
+  }
+  if(db)
+    wg_delete_local_database(db);
+  if(repdb)
+    wg_delete_local_database(repdb);
+  return err;
+}
 
-    query = wg_make_query(db, NULL, 0, arglist, 3);
-    if(!query) {
-      if(printlevel)
-        printf("wg_make_query() failed\n");
-      wg_free_query_param(db, arglist[0].value);
-      wg_free_query_param(db, arglist[1].value);
-      wg_free_query_param(db, arglist[2].value);
-      return -4;
-    }
+/* Read the change events of the test journal written in wg_check_log().
+ * Also checks that an entry that is only partially written is
+ * returned once the rest of it appears in the file.
+ */
+static gint check_log_cursor(void* db, char *logfn, int printlevel) {
+  wg_journal_event ev;
+  void *cursor;
+  gint rec = 0, batchrec = 0, res;
+  int dels = 0, found_str = 0, found_double = 0, found_int = 0;
+  int found_batch = 0, found_blob = 0;
+  char buf[20];
+  FILE *f;
+
+  cursor = wg_open_journal_cursor(db, logfn, 0, 0);
+  if(!cursor) {
+    if(printlevel)
+      printf("Failed to open a journal cursor\n");
+    return 1;
+  }
 
-    while((rec = wg_fetch(db, query))) {
-      if(wg_delete_record(db, rec)) {
-        if(printlevel)
-          printf("delete failed, aborting.\n");
-        wg_free_query_param(db, arglist[0].value);
-        wg_free_query_param(db, arglist[1].value);
-        wg_free_query_param(db, arglist[2].value);
-        return -6;
-      }
+  while((res = wg_fetch_journal_event(db, cursor, &ev)) > 0) {
+    switch(ev.op) {
+      case WG_JOURNAL_ENTRY_CRE:
+        if(!rec) {
+          if(ev.length != 7) {
+            if(printlevel)
+              printf("Error: journal cursor returned wrong record length\n");
+            goto fail;
+          }
+          rec = ev.offset;
+        }
+        if(ev.length == 21)
+          batchrec = ev.offset;
+        break;
+      case WG_JOURNAL_ENTRY_DEL:
+        if(ev.offset != rec) {
+          if(printlevel)
+            printf("Error: journal cursor returned wrong deleted record\n");
+          goto fail;
+        }
+        dels++;
+        break;
+      case WG_JOURNAL_ENTRY_SET:
+        if(ev.offset == rec && !dels && ev.column == 4) {
+          if(ev.type == WG_STRTYPE && !strcmp(ev.strval,
+            "0000000001000000000200000000030000000004"))
+            found_str++;
+        } else if(ev.offset == rec && !dels && ev.column == 6) {
+          if(ev.type == WG_DOUBLETYPE && ev.doubleval == -6543.3412)
+            found_double++;
+        } else if(ev.offset == batchrec && ev.column < 20) {
+          snprintf(buf, 20, "batch string %d", (int) ev.column);
+          if(ev.type == WG_STRTYPE && !strcmp(ev.strval, buf))
+            found_batch++;
+        } else if(ev.offset == batchrec && ev.column == 20) {
+          if(ev.type == WG_BLOBTYPE && ev.intval == 5 &&\
+            !memcmp(ev.strval, "ab\0cd", 5))
+            found_blob++;
+        } else if(ev.type == WG_INTTYPE && ev.intval == -10) {
+          found_int++;
+        }
+        break;
+      default:
+        break;
     }
-
-    wg_free_query_param(db, arglist[0].value);
-    wg_free_query_param(db, arglist[1].value);
-    wg_free_query_param(db, arglist[2].value);
+  }
+  if(res || dels != 1 || found_str != 1 || found_double != 1 ||\
+    found_int != 1 || found_batch != 20 || found_blob != 1) {
+    if(printlevel)
+      printf("Error: journal cursor did not return the expected events\n");
+    goto fail;
   }
 
-  if(printlevel > 1)
-    printf("------- Checking row count --------\n");
-
-  /* Database scan */
-  if(check_db_rows(db, dbsize * (50 * 50 - 30 * 20), printlevel)) {
+  /* Append a deletion in two parts */
+  if(!(f = fopen(logfn, "ab"))) {
     if(printlevel)
-      printf("row count check failed.\n");
-    return -7;
+      printf("Failed to reopen the test journal\n");
+    goto fail;
+  }
+  fputc(WG_JOURNAL_ENTRY_DEL, f);
+  fflush(f);
+  if(wg_fetch_journal_event(db, cursor, &ev) != 0) {
+    if(printlevel)
+      printf("Error: journal cursor returned an incomplete entry\n");
+    fclose(f);
+    goto fail;
+  }
+  fputc(5, f);
+  fclose(f);
+  if(wg_fetch_journal_event(db, cursor, &ev) != 1 ||\
+    ev.op != WG_JOURNAL_ENTRY_DEL || ev.offset != 5 ||\
+    wg_fetch_journal_event(db, cursor, &ev) != 0) {
+    if(printlevel)
+      printf("Error: journal cursor did not follow the journal\n");
+    goto fail;
   }
 
+  wg_free_journal_cursor(db, cursor);
   return 0;
-}
 
-/* ------------------------- log testing ------------------------ */
-
-#ifndef _WIN32
-#define LOG_TESTFILE  "/tmp/wgdb.logtest"
-#else
-#define LOG_TESTFILE  "c:\\windows\\temp\\wgdb.logtest"
+fail:
+  wg_free_journal_cursor(db, cursor);
+  return 1;
+}
 #endif
 
 static gint wg_check_log(void* db, int printlevel) {
@@ -4807,8 +7120,9 @@ static gint wg_check_log(void* db, int printlevel) {
   db_handle_logdata *ld = ((db_handle *) db)->logdata;
   void *clonedb;
   void *rec1, *rec2;
-  gint tmp, str1, str2;
-  char logfn[100];
+  gint tmp, str1, str2, table, batchlen;
+  wg_batch_value batch[21];
+  char logfn[100], batchstr[20][20];
   int i, err, pid;
   int fd;
 
@@ -4827,35 +7141,8 @@ static gint wg_check_log(void* db, int printlevel) {
 #endif
   snprintf(logfn, 99, "%s.%d", LOG_TESTFILE, pid);
   logfn[99] = '\0';
-#ifdef _WIN32
-  if(_sopen_s(&fd, logfn, _O_CREAT|_O_APPEND|_O_BINARY|_O_RDWR, _SH_DENYNO,
-    _S_IREAD|_S_IWRITE)) {
-#else
-  if((fd = open(logfn, O_CREAT|O_APPEND|O_RDWR,
-    S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH)) == -1) {
-#endif
-    if(printlevel)
-      printf("Failed to open the test journal\n");
-    return 1;
-  }
-
-#ifndef _WIN32
-  if(write(fd, WG_JOURNAL_MAGIC, WG_JOURNAL_MAGIC_BYTES) != \
-                                          WG_JOURNAL_MAGIC_BYTES) {
-    if(printlevel)
-      printf("Failed to initialize the test journal\n");
-    close(fd);
-    return 1;
-  }
-#else
-  if(_write(fd, WG_JOURNAL_MAGIC, WG_JOURNAL_MAGIC_BYTES) != \
-                                          WG_JOURNAL_MAGIC_BYTES) {
-    if(printlevel)
-      printf("Failed to initialize the test journal\n");
-    _close(fd);
+  if((fd = open_test_journal(logfn, printlevel)) == -1)
     return 1;
-  }
-#endif
 
   ld->fd = fd;
   ld->serial = dbh->logging.serial;
@@ -4893,6 +7180,25 @@ static gint wg_check_log(void* db, int printlevel) {
   rec1 = wg_create_object(db, 1, 0, 0);
   rec1 = wg_create_array(db, 4, 1, 0);
 
+  table = wg_create_table(db);
+  rec1 = wg_create_table_record(db, table, 2);
+  wg_set_field(db, rec1, 1, wg_encode_int(db, 42));
+
+  /* A row with many strings that are encoded before the fields are
+   * set, and a blob that contains a zero byte. */
+  for(i=0; i<20; i++) {
+    snprintf(batchstr[i], 20, "batch string %d", i);
+    batch[i].type = WG_STRTYPE;
+    batch[i].v.s = batchstr[i];
+    batch[i].ext = NULL;
+  }
+  batch[20].type = WG_BLOBTYPE;
+  batch[20].v.s = "ab\0cd";
+  batch[20].ext = NULL;
+  batch[20].len = 5;
+  batchlen = 21;
+  wg_insert_batch(db, 1, &batchlen, batch, NULL);
+
 #ifndef _WIN32
   close(ld->fd);
 #else
@@ -4924,103 +7230,18 @@ static gint wg_check_log(void* db, int printlevel) {
 
   err = 0;
 
-  /* Compare the databases */
-  rec1 = wg_get_first_record(db);
-  rec2 = wg_get_first_record(clonedb);
-  while(rec1) {
-    int len1, len2;
-    gint meta1, meta2;
-
-    if(!rec2) {
-      if(printlevel)
-        printf("Error: clone database had fewer records\n");
-      err = 1;
-      break;
-    }
-
-    len1 = wg_get_record_len(db, rec1);
-    len2 = wg_get_record_len(clonedb, rec2);
-    if(len1 != len2) {
-      if(printlevel)
-        printf("Error: records had different lengths\n");
-      err = 1;
-      break;
-    }
-
-    meta1 = *((gint *) rec1 + RECORD_META_POS);
-    meta2 = *((gint *) rec2 + RECORD_META_POS);
-    if(meta1 != meta2) {
-      if(printlevel)
-        printf("Error: records had different metadata\n");
-      err = 1;
-      break;
-    }
-
-    for(i=0; i<len1; i++) {
-      gint type1, type2;
-      int intdata1, intdata2;
-      double doubledata1, doubledata2;
-      char *strdata1, *strdata2;
-
-      type1 = wg_get_field_type(db, rec1, i);
-      type2 = wg_get_field_type(clonedb, rec2, i);
+  err = compare_log_clone(db, clonedb, table, printlevel);
 
-      if(type1 != type2) {
-        if(printlevel)
-          printf("Error: fields had different type\n");
-        err = 1;
-        goto done;
-      }
+  /* Apply the journal again, as a replica that sees it grow */
+  if(!err)
+    err = check_log_replica(db, logfn, table, printlevel);
+  if(!err)
+    err = check_log_replica_reuse(logfn, printlevel);
 
-      switch(type1) {
-        case WG_NULLTYPE:
-          break;
-        case WG_INTTYPE:
-          intdata1 = wg_decode_int(db, wg_get_field(db, rec1, i));
-          intdata2 = wg_decode_int(db, wg_get_field(clonedb, rec2, i));
-          if(intdata1 != intdata2) {
-            if(printlevel)
-              printf("Error: fields had different value\n");
-            err = 1;
-            goto done;
-          }
-          break;
-        case WG_DOUBLETYPE:
-          doubledata1 = wg_decode_double(db, wg_get_field(db, rec1, i));
-          doubledata2 = wg_decode_double(db, wg_get_field(clonedb, rec2, i));
-          if(doubledata1 != doubledata2) {
-            if(printlevel)
-              printf("Error: fields had different value\n");
-            err = 1;
-            goto done;
-          }
-          break;
-        case WG_STRTYPE:
-          strdata1 = wg_decode_str(db, wg_get_field(db, rec1, i));
-          strdata2 = wg_decode_str(db, wg_get_field(clonedb, rec2, i));
-          if(strcmp(strdata1, strdata2)) {
-            if(printlevel)
-              printf("Error: fields had different value\n");
-            err = 1;
-            goto done;
-          }
-          break;
-        default:
-          if(printlevel)
-            printf("Error: unexpected type\n");
-          err = 1;
-          goto done;
-      }
-    }
-    rec1 = wg_get_next_record(db, rec1);
-    rec2 = wg_get_next_record(clonedb, rec2);
-  }
-  if(rec2) {
-    if(printlevel)
-      printf("Error: clone database had more records\n");
-  }
+  /* The clone is not needed for reading the changes */
+  if(!err)
+    err = check_log_cursor(db, logfn, printlevel);
 
-done:
   wg_delete_local_database(clonedb);
   remove(logfn);
   if(err)
@@ -66,6 +66,9 @@
 /* Use single-compare T-tree mode */
 #define TTREE_SINGLE_COMPARE 1
 
+/* Store short strings as immediate values */
+#define USETINYSTR 1
+
 /* Use record banklinks */
 #define USE_BACKLINKING 1
 
@@ -75,12 +78,24 @@
 /* Use dblog module for transaction logging */
 /* #undef USE_DBLOG */
 
+/* Collect runtime statistics */
+/* #undef USE_DBSTATS */
+
+/* Collect lock wait and hold time histograms */
+/* #undef USE_LOCKSTATS */
+
 /* Use match templates for indexes */
 #define USE_INDEX_TEMPLATE 1
 
+/* Encode doubles as immediate values when possible */
+/* #undef USE_INLINE_DOUBLE */
+
 /* Enable reasoner */
 /* #undef USE_REASONER */
 
+/* Maintain the record pointer bitmap */
+#define USE_RECPTR_BITMAP 1
+
 /* Version number of package */
 #define VERSION "0.8-alpha"
 
@@ -40,6 +40,7 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 
 #if 0
 void* get_database_from_java_object(JNIEnv *env, jobject database) {
@@ -262,6 +263,314 @@ JNIEXPORT jbyteArray JNICALL Java_whitedb_driver_WhiteDB_getBlobFieldValue (JNIE
     }
 }
 
+/*
+ * Locate the bytes of a string or blob value in the database.
+ * Returns the data pointer and stores the length in lenp,
+ * NULL if the value does not have such data.
+ */
+char *get_field_bytes(void *database, gint enc, gint *lenp) {
+    switch(wg_get_encoded_type(database, enc)) {
+        case WG_STRTYPE:
+            *lenp = wg_decode_str_len(database, enc);
+            return wg_decode_str(database, enc);
+        case WG_URITYPE:
+            *lenp = wg_decode_uri_len(database, enc);
+            return wg_decode_uri(database, enc);
+        case WG_XMLLITERALTYPE:
+            *lenp = wg_decode_xmlliteral_len(database, enc);
+            return wg_decode_xmlliteral(database, enc);
+        case WG_BLOBTYPE:
+            *lenp = wg_decode_blob_len(database, enc);
+            return wg_decode_blob(database, enc);
+        default:
+            break;
+    }
+    return NULL;
+}
+
+/*
+ * Wrap the bytes of a field value in a ByteBuffer. Tiny strings are
+ * kept in the encoded value itself, so there is no database memory to
+ * point to and they are returned in a heap buffer instead.
+ */
+jobject new_field_buffer(JNIEnv *env, gint enc, char *data, gint len) {
+#ifdef USETINYSTR
+    if(istinystr(enc)) {
+        jclass bufclazz;
+        jmethodID wrap;
+        jbyteArray arr = (*env)->NewByteArray(env, len);
+        if(!arr)
+            return NULL;
+        (*env)->SetByteArrayRegion(env, arr, 0, len, (const jbyte *) data);
+        bufclazz = (*env)->FindClass(env, "java/nio/ByteBuffer");
+        wrap = (*env)->GetStaticMethodID(env, bufclazz, "wrap",
+            "([B)Ljava/nio/ByteBuffer;");
+        return (*env)->CallStaticObjectMethod(env, bufclazz, wrap, arr);
+    }
+#endif
+    return (*env)->NewDirectByteBuffer(env, data, (jlong) len);
+}
+
+/*
+ * Direct buffer view of string or blob data in the database. The data
+ * is not copied; the buffer is only valid while a read or write lock
+ * is held and the field is not modified.
+ */
+JNIEXPORT jobject JNICALL Java_whitedb_driver_WhiteDB_getFieldBuffer(
+  JNIEnv *env, jobject obj, jlong dbptr, jlong rptr, jint field) {
+    void* database;
+    gint enc, len = 0;
+    char *data;
+
+    database = (void *) dbptr;
+    enc = wg_get_field(database, (void *) rptr, (int)field);
+    data = get_field_bytes(database, enc, &len);
+    if(!data)
+        return NULL;
+    return new_field_buffer(env, enc, data, len);
+}
+
+/*
+ * Read all fields of a record at once. Values are converted to
+ * Integer (Long if the value does not fit), Double, String, byte[],
+ * Record or null. If direct is set, strings and blobs are returned as
+ * direct buffers like getFieldBuffer().
+ */
+JNIEXPORT jobjectArray JNICALL Java_whitedb_driver_WhiteDB_getRecordFields(
+  JNIEnv *env, jobject obj, jlong dbptr, jlong rptr, jboolean direct) {
+    void* database;
+    jclass objclazz, intclazz, longclazz, dblclazz;
+    jmethodID intvalueof, longvalueof, dblvalueof;
+    jobjectArray result;
+    gint reclen, i;
+
+    database = (void *) dbptr;
+    reclen = wg_get_record_len(database, (void *) rptr);
+    if(reclen < 0)
+        return NULL;
+
+    objclazz = (*env)->FindClass(env, "java/lang/Object");
+    intclazz = (*env)->FindClass(env, "java/lang/Integer");
+    intvalueof = (*env)->GetStaticMethodID(env, intclazz, "valueOf",
+        "(I)Ljava/lang/Integer;");
+    longclazz = (*env)->FindClass(env, "java/lang/Long");
+    longvalueof = (*env)->GetStaticMethodID(env, longclazz, "valueOf",
+        "(J)Ljava/lang/Long;");
+    dblclazz = (*env)->FindClass(env, "java/lang/Double");
+    dblvalueof = (*env)->GetStaticMethodID(env, dblclazz, "valueOf",
+        "(D)Ljava/lang/Double;");
+
+    result = (*env)->NewObjectArray(env, reclen, objclazz, NULL);
+    if(!result)
+        return NULL;
+
+    for(i=0; i<reclen; i++) {
+        jobject item = NULL;
+        gint enc = wg_get_field(database, (void *) rptr, i);
+        gint type = wg_get_encoded_type(database, enc);
+        gint len = 0, ival;
+        char *data;
+        char cbuf[2];
+
+        switch(type) {
+            case WG_INTTYPE:
+                ival = wg_decode_int(database, enc);
+                if(ival == (jint) ival)
+                    item = (*env)->CallStaticObjectMethod(env, intclazz,
+                        intvalueof, (jint) ival);
+                else
+                    item = (*env)->CallStaticObjectMethod(env, longclazz,
+                        longvalueof, (jlong) ival);
+                break;
+            case WG_DOUBLETYPE:
+                item = (*env)->CallStaticObjectMethod(env, dblclazz,
+                    dblvalueof, (jdouble) wg_decode_double(database, enc));
+                break;
+            case WG_FIXPOINTTYPE:
+                item = (*env)->CallStaticObjectMethod(env, dblclazz,
+                    dblvalueof, (jdouble) wg_decode_fixpoint(database, enc));
+                break;
+            case WG_DATETYPE:
+                item = (*env)->CallStaticObjectMethod(env, intclazz,
+                    intvalueof, (jint) wg_decode_date(database, enc));
+                break;
+            case WG_TIMETYPE:
+                item = (*env)->CallStaticObjectMethod(env, intclazz,
+                    intvalueof, (jint) wg_decode_time(database, enc));
+                break;
+            case WG_CHARTYPE:
+                cbuf[0] = wg_decode_char(database, enc);
+                cbuf[1] = '\0';
+                item = (*env)->NewStringUTF(env, cbuf);
+                break;
+            case WG_RECORDTYPE:
+                item = create_database_record_for_java(env,
+                    wg_decode_record(database, enc));
+                break;
+            case WG_STRTYPE:
+            case WG_URITYPE:
+            case WG_XMLLITERALTYPE:
+            case WG_BLOBTYPE:
+                data = get_field_bytes(database, enc, &len);
+                if(!data)
+                    break;
+                if(direct) {
+                    item = new_field_buffer(env, enc, data, len);
+                } else if(type == WG_BLOBTYPE) {
+                    item = (*env)->NewByteArray(env, len);
+                    if(item)
+                        (*env)->SetByteArrayRegion(env, item, 0, len,
+                            (const jbyte *) data);
+                } else {
+                    item = (*env)->NewStringUTF(env, (const char *) data);
+                }
+                break;
+            default:
+                break;
+        }
+        if(item) {
+            (*env)->SetObjectArrayElement(env, result, i, item);
+            (*env)->DeleteLocalRef(env, item);
+        }
+    }
+    return result;
+}
+
+/*
+ * Convert a Java object to a batch insert value. Strings and byte
+ * arrays are copied to malloc()-ed buffers that are freed
+ * by free_batch_values().
+ * Returns 0 on success, -1 if the type is not supported or
+ * memory could not be allocated.
+ */
+int java_to_batch_value(JNIEnv *env, jobject item, wg_batch_value *val) {
+    jclass clazz;
+
+    memset(val, 0, sizeof(wg_batch_value));
+    if(item == NULL) {
+        val->type = WG_NULLTYPE;
+        return 0;
+    }
+
+    clazz = (*env)->FindClass(env, "java/lang/Integer");
+    if((*env)->IsInstanceOf(env, item, clazz)) {
+        val->type = WG_INTTYPE;
+        val->v.i = (gint) (*env)->CallIntMethod(env, item,
+            (*env)->GetMethodID(env, clazz, "intValue", "()I"));
+        return 0;
+    }
+    clazz = (*env)->FindClass(env, "java/lang/Double");
+    if((*env)->IsInstanceOf(env, item, clazz)) {
+        val->type = WG_DOUBLETYPE;
+        val->v.d = (double) (*env)->CallDoubleMethod(env, item,
+            (*env)->GetMethodID(env, clazz, "doubleValue", "()D"));
+        return 0;
+    }
+    clazz = (*env)->FindClass(env, "java/lang/String");
+    if((*env)->IsInstanceOf(env, item, clazz)) {
+        const char *valuep = (*env)->GetStringUTFChars(env, item, 0);
+        if(!valuep)
+            return -1;
+        val->v.s = malloc(strlen(valuep) + 1);
+        if(val->v.s) {
+            strcpy(val->v.s, valuep);
+            val->type = WG_STRTYPE;
+        }
+        (*env)->ReleaseStringUTFChars(env, item, valuep);
+        return (val->v.s ? 0 : -1);
+    }
+    clazz = (*env)->FindClass(env, "whitedb/holder/Record");
+    if((*env)->IsInstanceOf(env, item, clazz)) {
+        val->type = WG_RECORDTYPE;
+        val->v.rec = (void *) (*env)->GetLongField(env, item,
+            (*env)->GetFieldID(env, clazz, "pointer", "J"));
+        return 0;
+    }
+    clazz = (*env)->FindClass(env, "[B");
+    if((*env)->IsInstanceOf(env, item, clazz)) {
+        val->len = (*env)->GetArrayLength(env, item);
+        val->v.s = malloc(val->len ? val->len : 1);
+        if(!val->v.s)
+            return -1;
+        (*env)->GetByteArrayRegion(env, item, 0, val->len,
+            (jbyte *) val->v.s);
+        val->type = WG_BLOBTYPE;
+        return 0;
+    }
+    return -1;
+}
+
+void free_batch_values(wg_batch_value *values, gint count) {
+    gint i;
+    for(i=0; i<count; i++) {
+        if(values[i].type == WG_STRTYPE || values[i].type == WG_BLOBTYPE)
+            free(values[i].v.s);
+    }
+    free(values);
+}
+
+JNIEXPORT jobjectArray JNICALL Java_whitedb_driver_WhiteDB_insertBatch(
+  JNIEnv *env, jobject obj, jlong dbptr, jobjectArray rows) {
+    jclass clazz;
+    jobjectArray result = NULL;
+    wg_batch_value *values = NULL;
+    wg_int *rowlen = NULL;
+    void **records = NULL;
+    gint rowcount, total = 0, count = 0, i, j;
+
+    rowcount = (*env)->GetArrayLength(env, rows);
+    rowlen = malloc(sizeof(wg_int) * (rowcount ? rowcount : 1));
+    records = malloc(sizeof(void *) * (rowcount ? rowcount : 1));
+    if(!rowlen || !records)
+        goto done;
+
+    for(i=0; i<rowcount; i++) {
+        jobjectArray row = (*env)->GetObjectArrayElement(env, rows, i);
+        rowlen[i] = (row ? (*env)->GetArrayLength(env, row) : 0);
+        total += rowlen[i];
+        (*env)->DeleteLocalRef(env, row);
+    }
+
+    values = malloc(sizeof(wg_batch_value) * (total ? total : 1));
+    if(!values)
+        goto done;
+
+    for(i=0; i<rowcount; i++) {
+        jobjectArray row = (*env)->GetObjectArrayElement(env, rows, i);
+        for(j=0; j<rowlen[i]; j++) {
+            jobject item = (*env)->GetObjectArrayElement(env, row, j);
+            int err = java_to_batch_value(env, item, &values[count]);
+            (*env)->DeleteLocalRef(env, item);
+            if(err)
+                goto done;
+            count++;
+        }
+        (*env)->DeleteLocalRef(env, row);
+    }
+
+    if(wg_insert_batch((void *) dbptr, rowcount, rowlen, values, records))
+        goto done;
+
+    clazz = (*env)->FindClass(env, "whitedb/holder/Record");
+    result = (*env)->NewObjectArray(env, rowcount, clazz, NULL);
+    if(result) {
+        for(i=0; i<rowcount; i++) {
+            jobject item = create_database_record_for_java(env, records[i]);
+            (*env)->SetObjectArrayElement(env, result, i, item);
+            (*env)->DeleteLocalRef(env, item);
+        }
+    }
+
+done:
+    if(values)
+        free_batch_values(values, count);
+    if(rowlen)
+        free(rowlen);
+    if(records)
+        free(records);
+    return result;
+}
+
 gint map_cond(jint cond) {
     /* Robust method of mapping constants. This way redefining
      * something on either side doesn't break. */
@@ -38,6 +38,7 @@ import whitedb.util.ArgListEntry;
 import java.lang.reflect.Field;
 import java.util.Collections;
 import java.util.Arrays;
+import java.nio.ByteBuffer;
 
 public class WhiteDB {
 
@@ -72,6 +73,7 @@ public class WhiteDB {
     private native Record getNextRecord(long dbptr, long rptr);
     private native int deleteRecord(long dbptr, long rptr);
     private native int getRecordLength(long dbptr, long rptr);
+    private native Record[] insertBatch(long dbptr, Object[][] rows);
 
     /*
      * Read/write field data: wrapped in Java functions
@@ -82,6 +84,8 @@ public class WhiteDB {
     private native String getStringFieldValue(long dbptr, long rptr, int field);
     private native int setRecordBlobField(long dbptr, long rptr, int field, byte[] value);
     private native byte[] getBlobFieldValue(long dbptr, long rptr, int field);
+    private native ByteBuffer getFieldBuffer(long dbptr, long rptr, int field);
+    private native Object[] getRecordFields(long dbptr, long rptr, boolean direct);
 
     /*
      * Query functions: wrapped.
@@ -170,6 +174,15 @@ public class WhiteDB {
         return getRecordLength(database.pointer, record.pointer);
     }
 
+    /*
+     * Create a record for each row. Supported field values are
+     * Integer, Double, String, byte[] (blob), Record and null.
+     * Call between startWrite() and endWrite(). Returns null on error.
+     */
+    public Record[] insertBatch(Object[][] rows) {
+        return insertBatch(database.pointer, rows);
+    }
+
     public int setRecordIntField(Record record, int field, int value) {
         return setRecordIntField(database.pointer, record.pointer, field, value);
     }
@@ -194,6 +207,45 @@ public class WhiteDB {
         return getBlobFieldValue(database.pointer, record.pointer, field);
     }
 
+    /*
+     * Read-only view of string or blob field contents in the database
+     * without copying. The buffer is valid only while the read lock
+     * (or the write lock) is held and the field is not modified.
+     * Strings short enough to be stored in the field itself are
+     * returned as a copy.
+     * Returns null if the field does not contain a string or a blob.
+     */
+    public ByteBuffer getFieldBuffer(Record record, int field) {
+        ByteBuffer buf = getFieldBuffer(database.pointer, record.pointer, field);
+        return (buf == null ? null : buf.asReadOnlyBuffer());
+    }
+
+    /*
+     * Read all fields of the record in one call. Values are returned
+     * as Integer (Long for large values), Double, String, byte[] (blob),
+     * Record or null. Dates and times are returned as their integer
+     * encoding.
+     */
+    public Object[] getRecordFields(Record record) {
+        return getRecordFields(database.pointer, record.pointer, false);
+    }
+
+    /*
+     * Like getRecordFields(), but strings and blobs are returned as
+     * read-only buffers as with getFieldBuffer(). The same locking
+     * rules apply.
+     */
+    public Object[] getRecordFieldBuffers(Record record) {
+        Object[] fields = getRecordFields(database.pointer, record.pointer, true);
+        if(fields != null) {
+            for(int i=0; i<fields.length; i++) {
+                if(fields[i] instanceof ByteBuffer)
+                    fields[i] = ((ByteBuffer) fields[i]).asReadOnlyBuffer();
+            }
+        }
+        return fields;
+    }
+
     /****************** Wrappers for query functions ********************/
 
     public Query makeQuery(Record record) {
@@ -115,6 +115,22 @@ public class tests {
         }
         db.freeQuery(query);
 
+        long lock = db.startWrite();
+        Record[] batch = db.insertBatch(new Object[][] {
+            {1, "first", null},
+            {2, 2.5, new byte[] {1, 2}}
+        });
+        db.endWrite(lock);
+        System.out.println("Batch inserted records: " + batch.length);
+        System.out.println("Get field 1 value: " + db.getStringFieldValue(batch[0], 1));
+
+        lock = db.startRead();
+        java.nio.ByteBuffer buf = db.getFieldBuffer(batch[1], 2);
+        System.out.println("Blob field 2 size (no copy): " + buf.remaining());
+        Object[] fields = db.getRecordFields(batch[0]);
+        System.out.println("Record fields: " + java.util.Arrays.toString(fields));
+        db.endRead(lock);
+
         db.close();
     }
 }
@@ -30,6 +30,8 @@ $(amal Db/dbmpool.h)
 $(amal Db/dbjson.h)
 $(amal Db/dblock.h)
 $(amal Db/dbschema.h)
+$(amal Db/dbstats.h)
+$(amal Db/dbtable.h)
 EOT
 
 cat << EOT > whitedb.c
@@ -50,5 +52,7 @@ $(amal Db/dbutil.c)
 $(amal Db/dbmpool.c)
 $(amal Db/dbjson.c)
 $(amal Db/dbschema.c)
+$(amal Db/dbstats.c)
+$(amal Db/dbtable.c)
 $(amal Db/dblock.c)
 EOT